@@ -37,6 +37,175 @@ def asset_needs_update(asset, version):
     return False
 
 
+# Sources of each converter. Their contents go into the cache keys, so that
+# changing a converter invalidates what it produced before.
+CONVERTER_SOURCES = {
+    "raw": [],
+    "n64graphics": [
+        "tools/n64graphics.c",
+        "tools/n64graphics.h",
+        "tools/utils.c",
+        "tools/utils.h",
+        "tools/parallel.c",
+        "tools/parallel.h",
+    ],
+    "skyconv": ["tools/skyconv.c", "tools/n64graphics.c", "tools/n64graphics.h", "tools/utils.c", "tools/utils.h"],
+    # disassemble_sound.py runs tools/aifc_decode, which builds src/pc/vadpcm.c in.
+    "sound": ["tools/disassemble_sound.py", "tools/aifc_decode.c", "src/pc/vadpcm.c", "src/pc/vadpcm.h"],
+}
+
+
+def asset_converter(asset, mio0):
+    if mio0 == "@sound":
+        return "sound"
+    if not asset.endswith(".png"):
+        return "raw"
+    if asset.startswith("textures/skyboxes/") or asset.startswith("levels/ending/cake"):
+        return "skyconv"
+    return "n64graphics"
+
+
+def converter_hashes(new_version):
+    import hashlib
+
+    ret = {}
+    for converter, sources in CONVERTER_SOURCES.items():
+        h = hashlib.sha1((converter + ":" + str(new_version)).encode())
+        for fname in sources:
+            with open(fname, "rb") as f:
+                h.update(f.read())
+        ret[converter] = h.hexdigest()
+    return ret
+
+
+def asset_cache_dir():
+    # Shared between worktrees by default; ASSET_CACHE_DIR= disables the cache.
+    path = os.environ.get("ASSET_CACHE_DIR")
+    if path is None:
+        base = os.environ.get("XDG_CACHE_HOME") or os.path.join(os.path.expanduser("~"), ".cache")
+        path = os.path.join(base, "sm64-assets")
+    return path or None
+
+
+def cache_path(cache_dir, key):
+    return os.path.join(cache_dir, key[:2], key[2:])
+
+
+def cache_restore(cache_dir, key, asset):
+    import shutil
+
+    try:
+        os.makedirs(os.path.dirname(asset), exist_ok=True)
+        shutil.copyfile(cache_path(cache_dir, key), asset)
+        return True
+    except OSError:
+        return False
+
+
+def cache_store(cache_dir, key, asset):
+    import shutil
+
+    # Copy under a temporary name first so that concurrent extractions never
+    # see a partial file.
+    path = cache_path(cache_dir, key)
+    tmp = path + "." + str(os.getpid()) + ".tmp"
+    try:
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        shutil.copyfile(asset, tmp)
+        os.replace(tmp, path)
+    except OSError:
+        try:
+            os.remove(tmp)
+        except OSError:
+            pass
+
+
+def decompress_mio0(lang, mio0):
+    import subprocess
+
+    return subprocess.run(
+        [
+            "./tools/mio0",
+            "-d",
+            "-o",
+            str(mio0),
+            "baserom." + lang + ".z64",
+            "-",
+        ],
+        check=True,
+        stdout=subprocess.PIPE,
+    ).stdout
+
+
+def extract_skybox(asset, input):
+    import subprocess
+    import tempfile
+
+    os.makedirs(os.path.dirname(asset), exist_ok=True)
+    png_file = tempfile.NamedTemporaryFile(prefix="asset", delete=False)
+    try:
+        png_file.write(input)
+        png_file.flush()
+        png_file.close()
+        if asset.startswith("textures/skyboxes/"):
+            imagetype = "sky"
+        else:
+            imagetype =  "cake" + ("-eu" if "eu" in asset else "")
+        subprocess.run(
+            [
+                "./tools/skyconv",
+                "--type",
+                imagetype,
+                "--combine",
+                png_file.name,
+                asset,
+            ],
+            check=True,
+        )
+    finally:
+        png_file.close()
+        os.remove(png_file.name)
+    return [asset]
+
+
+def extract_textures(textures, jobs):
+    import shutil
+    import subprocess
+    import tempfile
+
+    # One n64graphics run converts every texture on its own threads, from a
+    # manifest with one line of arguments per texture. The temporary directory
+    # is relative so that no path in the manifest holds a space.
+    tmp_dir = tempfile.mkdtemp(prefix=".assets-", dir=".")
+    try:
+        manifest = []
+        for i, (asset, input, meta) in enumerate(textures):
+            os.makedirs(os.path.dirname(asset), exist_ok=True)
+            bin_file = os.path.join(tmp_dir, str(i) + ".bin")
+            with open(bin_file, "wb") as f:
+                f.write(input)
+            w, h = meta
+            fmt = asset.split(".")[-2]
+            manifest.append(" ".join(["-e", bin_file, "-g", asset, "-f", fmt, "-w", str(w), "-h", str(h)]))
+        manifest_file = os.path.join(tmp_dir, "manifest")
+        with open(manifest_file, "w") as f:
+            f.write("\n".join(manifest) + "\n")
+        subprocess.run(
+            ["./tools/n64graphics", "-b", manifest_file, "-j", str(jobs)],
+            check=True,
+        )
+    finally:
+        shutil.rmtree(tmp_dir, ignore_errors=True)
+    return [asset for (asset, input, meta) in textures]
+
+
+def extract_sound(args, assets):
+    import subprocess
+
+    subprocess.run(args + [asset + ":" + str(pos) for (asset, pos) in assets], check=True)
+    return [asset for (asset, pos) in assets]
+
+
 def remove_file(fname):
     os.remove(fname)
     print("deleting", fname)
@@ -76,11 +245,17 @@ def main():
         clean_assets(local_asset_file)
         sys.exit(0)
 
+    jobs = os.cpu_count() or 1
+    if len(langs) >= 2 and langs[0] == "-j" and langs[1].isdigit():
+        jobs = max(int(langs[1]), 1)
+        langs = langs[2:]
+
     all_langs = ["jp", "us", "eu", "sh"]
     if not langs or not all(a in all_langs for a in langs):
         langs_str = " ".join("[" + lang + "]" for lang in all_langs)
-        print("Usage: " + sys.argv[0] + " " + langs_str)
+        print("Usage: " + sys.argv[0] + " [-j JOBS] " + langs_str)
         print("For each version, baserom.<version>.z64 must exist")
+        print("Extracted assets are cached in $ASSET_CACHE_DIR (default: ~/.cache/sm64-assets), empty to disable")
         sys.exit(1)
 
     asset_map = read_asset_map()
@@ -104,7 +279,6 @@ def main():
     # Late imports (to optimize startup perf)
     import subprocess
     import hashlib
-    import tempfile
     from collections import defaultdict
 
     new_assets = {a[0] for a in all_assets}
@@ -133,6 +307,7 @@ def main():
 
     # Load ROMs
     roms = {}
+    rom_sha1s = {}
     for lang in langs:
         fname = "baserom." + lang + ".z64"
         try:
@@ -153,6 +328,7 @@ def main():
                 + expected_sha1
             )
             sys.exit(1)
+        rom_sha1s[lang] = sha1
 
     make = "make"
 
@@ -169,102 +345,103 @@ def main():
     # mio0 file still go together).
     keys = sorted(list(todo.keys()), key=lambda k: todo[k][0][0])
 
-    # Import new assets
+    def sound_args(lang):
+        args = [
+            "python3",
+            "tools/disassemble_sound.py",
+            "baserom." + lang + ".z64",
+        ]
+        def append_args(key):
+            size, locs = asset_map["@sound " + key + " " + lang]
+            offset = locs[lang][0]
+            args.append(str(offset))
+            args.append(str(size))
+        append_args("ctl")
+        append_args("tbl")
+        if lang == "sh":
+            args.append("--shindou-headers")
+            append_args("ctl header")
+            append_args("tbl header")
+        args.append("--only-samples")
+        return args
+
+    # An asset is identified by the ROM it comes from, where it is in that ROM
+    # and how it is converted, so there is no need to read the ROM region itself.
+    cache_dir = asset_cache_dir()
+    hashes = converter_hashes(new_version)
+    asset_keys = {}
+    restored = 0
     for key in keys:
-        assets = todo[key]
         lang, mio0 = key
-        if mio0 == "@sound":
-            rom = roms[lang]
-            args = [
-                "python3",
-                "tools/disassemble_sound.py",
-                "baserom." + lang + ".z64",
-            ]
-            def append_args(key):
-                size, locs = asset_map["@sound " + key + " " + lang]
-                offset = locs[lang][0]
-                args.append(str(offset))
-                args.append(str(size))
-            append_args("ctl")
-            append_args("tbl")
-            if lang == "sh":
-                args.append("--shindou-headers")
-                append_args("ctl header")
-                append_args("tbl header")
-            args.append("--only-samples")
+        remaining = []
+        for (asset, pos, size, meta) in todo[key]:
+            ident = [hashes[asset_converter(asset, mio0)], rom_sha1s[lang], lang, mio0, pos, size, meta, asset]
+            if mio0 == "@sound":
+                ident.append(sound_args(lang))
+            asset_keys[asset] = hashlib.sha1(json.dumps(ident).encode()).hexdigest()
+            if cache_dir is not None and cache_restore(cache_dir, asset_keys[asset], asset):
+                restored += 1
+            else:
+                remaining.append((asset, pos, size, meta))
+        todo[key] = remaining
+    keys = [key for key in keys if todo[key]]
+    if restored > 0:
+        print("restored", restored, "assets from", cache_dir)
+
+    # Import new assets. Textures are converted by a single n64graphics batch,
+    # other conversions run in a process pool, and raw assets are written here
+    # directly.
+    from concurrent.futures import ProcessPoolExecutor
+
+    with ProcessPoolExecutor(max_workers=jobs) as pool:
+        images = {
+            key: pool.submit(decompress_mio0, *key)
+            for key in keys
+            if key[1] is not None and key[1] != "@sound"
+        }
+        futures = []
+        extracted = []
+        textures = []
+        for key in keys:
+            assets = todo[key]
+            lang, mio0 = key
+            if mio0 == "@sound":
+                # Every disassemble_sound.py run parses the whole bank, so only
+                # split the samples into as many runs as there are jobs.
+                for (asset, pos, size, meta) in assets:
+                    print("extracting", asset)
+                samples = [(asset, pos) for (asset, pos, size, meta) in assets]
+                for i in range(jobs):
+                    if samples[i::jobs]:
+                        futures.append(pool.submit(extract_sound, sound_args(lang), samples[i::jobs]))
+                continue
+
+            if mio0 is not None:
+                image = images[key].result()
+            else:
+                image = roms[lang]
+
             for (asset, pos, size, meta) in assets:
                 print("extracting", asset)
-                args.append(asset + ":" + str(pos))
-            subprocess.run(args, check=True)
-            continue
-
-        if mio0 is not None:
-            image = subprocess.run(
-                [
-                    "./tools/mio0",
-                    "-d",
-                    "-o",
-                    str(mio0),
-                    "baserom." + lang + ".z64",
-                    "-",
-                ],
-                check=True,
-                stdout=subprocess.PIPE,
-            ).stdout
-        else:
-            image = roms[lang]
-
-        for (asset, pos, size, meta) in assets:
-            print("extracting", asset)
-            input = image[pos : pos + size]
-            os.makedirs(os.path.dirname(asset), exist_ok=True)
-            if asset.endswith(".png"):
-                png_file = tempfile.NamedTemporaryFile(prefix="asset", delete=False)
-                try:
-                    png_file.write(input)
-                    png_file.flush()
-                    png_file.close()
-                    if asset.startswith("textures/skyboxes/") or asset.startswith("levels/ending/cake"):
-                        if asset.startswith("textures/skyboxes/"):
-                            imagetype = "sky"
-                        else:
-                            imagetype =  "cake" + ("-eu" if "eu" in asset else "")
-                        subprocess.run(
-                            [
-                                "./tools/skyconv",
-                                "--type",
-                                imagetype,
-                                "--combine",
-                                png_file.name,
-                                asset,
-                            ],
-                            check=True,
-                        )
-                    else:
-                        w, h = meta
-                        fmt = asset.split(".")[-2]
-                        subprocess.run(
-                            [
-                                "./tools/n64graphics",
-                                "-e",
-                                png_file.name,
-                                "-g",
-                                asset,
-                                "-f",
-                                fmt,
-                                "-w",
-                                str(w),
-                                "-h",
-                                str(h),
-                            ],
-                            check=True,
-                        )
-                finally:
-                    png_file.close()
-                    os.remove(png_file.name)
-            else:
-                with open(asset, "wb") as f:
-                    f.write(input)
+                input = image[pos : pos + size]
+                if asset_converter(asset, mio0) == "skyconv":
+                    futures.append(pool.submit(extract_skybox, asset, input))
+                elif asset.endswith(".png"):
+                    textures.append((asset, input, meta))
+                else:
+                    os.makedirs(os.path.dirname(asset), exist_ok=True)
+                    with open(asset, "wb") as f:
+                        f.write(input)
+                    extracted.append(asset)
+
+        if textures:
+            extracted.extend(extract_textures(textures, jobs))
+        for future in futures:
+            extracted.extend(future.result())
+
+    if cache_dir is not None:
+        for asset in extracted:
+            cache_store(cache_dir, asset_keys[asset], asset)
 
     # Remove old assets
     for asset in previous_assets:
@@ -287,4 +464,5 @@ def main():
         f.write(output)
 
 
-main()
+if __name__ == "__main__":
+    main()
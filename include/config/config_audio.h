@@ -53,7 +53,9 @@
 
 /**
  * Global sample rate to be used by the game and for the audio dumps. Higher number correlates to higher audio resolution. (Functional Limit: ~128000)
- * NOTE: IF CHANGING, MAKE SURE YOU UPDATE THE VALUE IN `assemble_sound.py` AS WELL AND RUN `make clean` BEFORE REBUILDING!
+ * On PC the audio buffers are sized for this times AUDIO_OVERSAMPLE_MAX (a make option, 1 by default), and the rate selected at runtime (`audio_sample_rate` in sm64config.txt or `--sample-rate`) times `audio_oversample` can't go above that.
+ * So 96000 Hz output on a 48000 Hz build needs `make AUDIO_OVERSAMPLE_MAX=2` or higher.
+ * NOTE: IF CHANGING, RUN `make clean` BEFORE REBUILDING! The sound banks are tuned for this rate as well.
  */
 #define FINAL_SAMPLE_RATE 48000
 
@@ -335,6 +335,7 @@ l1138:
         }
 
         layer->delay = sp3A;
+        SEQ_TRACE_NOTE(layer, cmdSemitone);
         layer->duration = layer->noteDuration * sp3A / 256;
         if ((seqPlayer->muted && (seqChannel->muteBehavior & MUTE_BEHAVIOR_STOP_NOTES) != 0)
             || seqChannel->stopSomething2
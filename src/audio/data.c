@@ -224,6 +224,13 @@ struct ReverbSettingsUS gReverbSettings[18] = {
 struct AudioSessionSettings gAudioSessionSettings = { FINAL_SAMPLE_RATE, MAX_SIMULTANEOUS_NOTES, 0x7FFF, PERSISTENT_SEQ_MEM, PERSISTENT_BANK_MEM, TEMPORARY_SEQ_MEM, TEMPORARY_BANK_MEM };
 #endif
 
+#ifndef TARGET_N64
+// Output sample rate selected at startup; clamped and applied to the session settings by audio_init().
+s32 gAudioSampleRate = FINAL_SAMPLE_RATE;
+// The engine synthesizes at this multiple of gAudioSampleRate, see audio_oversample_render().
+s32 gAudioOversample = 1;
+#endif
+
 // gAudioCosineTable[k] = round((2**15 - 1) * cos(pi/2 * k / 127)). Unused.
 #if defined(VERSION_JP) || defined(VERSION_US)
 u16 gAudioCosineTable[128] = {
@@ -24,6 +24,12 @@
 
 #include "config/config_audio.h"
 
+#if !defined(TARGET_N64) && defined(__SSE__)
+#include <xmmintrin.h>
+#elif !defined(TARGET_N64) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 // N.B. sound banks are different from the audio banks referred to in other
 // files. We should really fix our naming to be less ambiguous...
 #define MAX_BACKGROUND_MUSIC_QUEUE_SIZE 6
@@ -864,6 +870,104 @@ static void update_background_music_after_sound(u8 bank, u8 soundIndex) {
     }
 }
 
+/**
+ * Computes the distance of 'count' sound sources from the camera in one pass. Sound positions are
+ * already relative to the camera, so this is just the length of each position.
+ */
+static void compute_sound_distances(f32 *dist, f32 *x, f32 *y, f32 *z, s32 count) {
+    s32 i = 0;
+
+#if !defined(TARGET_N64) && defined(__SSE__)
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(&x[i]);
+        __m128 vy = _mm_loadu_ps(&y[i]);
+        __m128 vz = _mm_loadu_ps(&z[i]);
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+        _mm_storeu_ps(&dist[i], _mm_sqrt_ps(sum));
+    }
+#elif !defined(TARGET_N64) && defined(__aarch64__)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t vx = vld1q_f32(&x[i]);
+        float32x4_t vy = vld1q_f32(&y[i]);
+        float32x4_t vz = vld1q_f32(&z[i]);
+        float32x4_t sum = vaddq_f32(vaddq_f32(vmulq_f32(vx, vx), vmulq_f32(vy, vy)), vmulq_f32(vz, vz));
+        vst1q_f32(&dist[i], vsqrtq_f32(sum));
+    }
+#endif
+    for (; i < count; i++) {
+        dist[i] = sqrtf(sqr(x[i]) + sqr(y[i]) + sqr(z[i]));
+    }
+}
+
+/**
+ * Bounded priority queue of the most important live sounds in a bank, kept as a max-heap with the least
+ * important sound at the root so that it's the one pushed out when a more important sound comes along.
+ * Lower priority values are more important, and on equal priority the later sound (higher order) wins.
+ */
+struct LiveSoundQueue {
+    u32 priorities[16];
+    u8 orders[16];
+    u8 soundIndices[16];
+    u8 count;
+};
+
+static s32 live_sound_is_more_important(struct LiveSoundQueue *queue, s32 a, u32 priority, u8 order) {
+    return queue->priorities[a] < priority || (queue->priorities[a] == priority && queue->orders[a] > order);
+}
+
+static void live_sound_queue_swap(struct LiveSoundQueue *queue, s32 a, s32 b) {
+    u32 priority = queue->priorities[a];
+    u8 order = queue->orders[a];
+    u8 soundIndex = queue->soundIndices[a];
+
+    queue->priorities[a] = queue->priorities[b];
+    queue->orders[a] = queue->orders[b];
+    queue->soundIndices[a] = queue->soundIndices[b];
+    queue->priorities[b] = priority;
+    queue->orders[b] = order;
+    queue->soundIndices[b] = soundIndex;
+}
+
+static void live_sound_queue_sift_down(struct LiveSoundQueue *queue, s32 i) {
+    s32 child;
+    s32 least;
+
+    while (TRUE) {
+        least = i;
+        for (child = 2 * i + 1; child <= 2 * i + 2 && child < queue->count; child++) {
+            if (live_sound_is_more_important(queue, least, queue->priorities[child], queue->orders[child])) {
+                least = child;
+            }
+        }
+        if (least == i) {
+            break;
+        }
+        live_sound_queue_swap(queue, i, least);
+        i = least;
+    }
+}
+
+static void live_sound_queue_push(struct LiveSoundQueue *queue, u8 capacity, u32 priority, u8 order, u8 soundIndex) {
+    s32 i;
+
+    if (queue->count < capacity) {
+        i = queue->count++;
+        queue->priorities[i] = priority;
+        queue->orders[i] = order;
+        queue->soundIndices[i] = soundIndex;
+
+        while (i > 0 && live_sound_is_more_important(queue, (i - 1) / 2, priority, order)) {
+            live_sound_queue_swap(queue, i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    } else if (capacity != 0 && !live_sound_is_more_important(queue, 0, priority, order)) {
+        queue->priorities[0] = priority;
+        queue->orders[0] = order;
+        queue->soundIndices[0] = soundIndex;
+        live_sound_queue_sift_down(queue, 0);
+    }
+}
+
 /**
  * Called from threads: thread4_sound, thread5_game_loop (EU only)
  */
@@ -871,18 +975,18 @@ static void select_current_sounds(u8 bank) {
     u32 isDiscreteAndStatus;
     u8 latestSoundIndex;
     u8 i;
-    u8 j;
     u8 soundIndex;
-    u32 liveSoundPriorities[16] = { 0x10000000, 0x10000000, 0x10000000, 0x10000000,
-                                    0x10000000, 0x10000000, 0x10000000, 0x10000000,
-                                    0x10000000, 0x10000000, 0x10000000, 0x10000000,
-                                    0x10000000, 0x10000000, 0x10000000, 0x10000000 };
     u8 liveSoundIndices[16] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
                                 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
-    u8 liveSoundStatuses[16] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-                                 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    struct LiveSoundQueue liveSounds;
+    u8 candidateIndices[ARRAY_COUNT(sSoundBanks[0])];
+    f32 candidateX[ARRAY_COUNT(sSoundBanks[0])];
+    f32 candidateY[ARRAY_COUNT(sSoundBanks[0])];
+    f32 candidateZ[ARRAY_COUNT(sSoundBanks[0])];
+    f32 candidateDistances[ARRAY_COUNT(sSoundBanks[0])];
     u8 numSoundsInBank = 0;
     u8 requestedPriority;
+    u32 priority;
 
     //
     // Delete stale sounds and prioritize remaining sounds into the liveSound arrays
@@ -922,56 +1026,53 @@ static void select_current_sounds(u8 bank) {
         // playing sound
         if (sSoundBanks[bank][soundIndex].soundStatus != SOUND_STATUS_STOPPED
             && soundIndex == latestSoundIndex) {
+            candidateIndices[numSoundsInBank] = soundIndex;
+            candidateX[numSoundsInBank] = *sSoundBanks[bank][soundIndex].x;
+            candidateY[numSoundsInBank] = *sSoundBanks[bank][soundIndex].y;
+            candidateZ[numSoundsInBank] = *sSoundBanks[bank][soundIndex].z;
+            numSoundsInBank++;
+        }
 
-            // Recompute distance each frame since the sound's position may have changed
-            sSoundBanks[bank][soundIndex].distance =
-                sqrtf(sqr(*sSoundBanks[bank][soundIndex].x)
-                    + sqr(*sSoundBanks[bank][soundIndex].y)
-                    + sqr(*sSoundBanks[bank][soundIndex].z));
-
-            requestedPriority = (sSoundBanks[bank][soundIndex].soundBits & SOUNDARGS_MASK_PRIORITY)
-                                >> SOUNDARGS_SHIFT_PRIORITY;
-
-            // Recompute priority, possibly based on the sound's source position relative to the camera.
-            // (Note that the sound's priority is the opposite of requestedPriority; lower is more important)
-            if (sSoundBanks[bank][soundIndex].soundBits & SOUND_NO_PRIORITY_LOSS) {
-                sSoundBanks[bank][soundIndex].priority = 0x4c * (0xff - requestedPriority);
-            } else if (*sSoundBanks[bank][soundIndex].z > 0.0f) {
-                sSoundBanks[bank][soundIndex].priority =
-                    (u32) sSoundBanks[bank][soundIndex].distance
-                    + (u32)(*sSoundBanks[bank][soundIndex].z / 6.0f)
-                    + 0x4c * (0xff - requestedPriority);
-            } else {
-                sSoundBanks[bank][soundIndex].priority =
-                    (u32) sSoundBanks[bank][soundIndex].distance + 0x4c * (0xff - requestedPriority);
-            }
+        soundIndex = sSoundBanks[bank][latestSoundIndex].next;
+    }
 
-            // Insert the sound into the liveSound arrays, keeping the arrays sorted by priority.
-            // If more than sMaxChannelsForSoundBank[bank] sounds are live, then the
-            // sound with lowest priority will be removed from the arrays.
-            // In practice sMaxChannelsForSoundBank is always 1, so this code is overly general.
-            for (i = 0; i < sMaxChannelsForSoundBank[bank]; i++) {
-                // If the correct position is found
-                if (liveSoundPriorities[i] >= sSoundBanks[bank][soundIndex].priority) {
-                    // Shift remaining sounds to the right
-                    for (j = sMaxChannelsForSoundBank[bank] - 1; j > i; j--) {
-                        liveSoundPriorities[j] = liveSoundPriorities[j - 1];
-                        liveSoundIndices[j] = liveSoundIndices[j - 1];
-                        liveSoundStatuses[j] = liveSoundStatuses[j - 1];
-                    }
-                    // Insert the sound at index i
-                    liveSoundPriorities[i] = sSoundBanks[bank][soundIndex].priority;
-                    liveSoundIndices[i] = soundIndex;
-                    liveSoundStatuses[i] = sSoundBanks[bank][soundIndex].soundStatus; // unused
-                    // Break
-                    i = sMaxChannelsForSoundBank[bank];
-                }
-            }
+    // Recompute distances each frame since the sounds' positions may have changed
+    compute_sound_distances(candidateDistances, candidateX, candidateY, candidateZ, numSoundsInBank);
 
-            numSoundsInBank++;
+    // Keep the sMaxChannelsForSoundBank[bank] most important candidates.
+    // In practice sMaxChannelsForSoundBank is always 1, so this code is overly general.
+    liveSounds.count = 0;
+    for (i = 0; i < numSoundsInBank; i++) {
+        soundIndex = candidateIndices[i];
+        sSoundBanks[bank][soundIndex].distance = candidateDistances[i];
+
+        requestedPriority = (sSoundBanks[bank][soundIndex].soundBits & SOUNDARGS_MASK_PRIORITY)
+                            >> SOUNDARGS_SHIFT_PRIORITY;
+
+        // Recompute priority, possibly based on the sound's source position relative to the camera.
+        // (Note that the sound's priority is the opposite of requestedPriority; lower is more important)
+        if (sSoundBanks[bank][soundIndex].soundBits & SOUND_NO_PRIORITY_LOSS) {
+            priority = 0x4c * (0xff - requestedPriority);
+        } else if (candidateZ[i] > 0.0f) {
+            priority = (u32) candidateDistances[i] + (u32)(candidateZ[i] / 6.0f)
+                       + 0x4c * (0xff - requestedPriority);
+        } else {
+            priority = (u32) candidateDistances[i] + 0x4c * (0xff - requestedPriority);
         }
+        sSoundBanks[bank][soundIndex].priority = priority;
 
-        soundIndex = sSoundBanks[bank][latestSoundIndex].next;
+        // Sounds with a priority past 0x10000000 are too far away to ever be picked
+        if (priority <= 0x10000000) {
+            live_sound_queue_push(&liveSounds, sMaxChannelsForSoundBank[bank], priority, i, soundIndex);
+        }
+    }
+
+    // Drain the queue into liveSoundIndices, most important first
+    while (liveSounds.count > 0) {
+        liveSoundIndices[liveSounds.count - 1] = liveSounds.soundIndices[0];
+        liveSounds.count--;
+        live_sound_queue_swap(&liveSounds, 0, liveSounds.count);
+        live_sound_queue_sift_down(&liveSounds, 0);
     }
 
     sNumSoundsInBank[bank] = numSoundsInBank;
@@ -9,6 +9,10 @@
 #include "game/debug.h"
 #include "string.h"
 
+#ifdef AUDIO_LRU_CACHE
+#include <stdlib.h>
+#endif
+
 #ifdef PUPPYPRINT
 #include "game/puppyprint.h"
 #else
@@ -171,7 +175,220 @@ void build_vol_rampings_table(s32 UNUSED unused, s32 len) {
 }
 #endif
 
+#ifdef AUDIO_LRU_CACHE
+u32 gAudioCacheBudget = AUDIO_CACHE_DEFAULT_BUDGET;
+
+struct AudioCacheEntry {
+    u8 *ptr;
+    u32 size;
+    u32 lastUse;
+};
+
+// Indexed by id: sequences in [0], banks in [1]
+static struct AudioCacheEntry sAudioCache[2][ARRAY_COUNT(gSeqLoadStatus)];
+static u32 sAudioCacheSize = 0;
+static u32 sAudioCacheClock = 0;
+
+static u8 *audio_cache_load_status(s32 isBank) {
+    return isBank ? gBankLoadStatus : gSeqLoadStatus;
+}
+
+static s32 audio_cache_capacity(s32 isBank) {
+    return isBank ? ARRAY_COUNT(gBankLoadStatus) : ARRAY_COUNT(gSeqLoadStatus);
+}
+
+static void *audio_cache_lookup(struct SoundMultiPool *pool, s32 id) {
+    s32 isBank = (pool == &gBankLoadedPool);
+    struct AudioCacheEntry *entry;
+
+    if (id < 0 || id >= audio_cache_capacity(isBank)) {
+        return NULL;
+    }
+
+    entry = &sAudioCache[isBank][id];
+    if (entry->ptr != NULL) {
+        entry->lastUse = ++sAudioCacheClock;
+    }
+    return entry->ptr;
+}
+
+static void audio_cache_free(s32 isBank, s32 id) {
+    struct AudioCacheEntry *entry = &sAudioCache[isBank][id];
+
+    sAudioCacheSize -= entry->size;
+    free(entry->ptr);
+    entry->ptr = NULL;
+    entry->size = 0;
+}
+
+/**
+ * Evicts the least recently used entries that nothing depends on any more until 'size' more bytes fit in
+ * the budget. The budget is soft: if everything resident is still in use, the cache grows past it instead.
+ */
+static void audio_cache_make_room(u32 size) {
+    struct AudioCacheEntry *entry;
+    s32 lruIsBank, lruId;
+    u32 lruTime;
+    s32 isBank, id;
+    u8 status;
+
+    while (sAudioCacheSize + size > gAudioCacheBudget) {
+        lruId = -1;
+        lruIsBank = FALSE;
+        lruTime = 0;
+
+        for (isBank = 0; isBank < 2; isBank++) {
+            for (id = 0; id < audio_cache_capacity(isBank); id++) {
+                entry = &sAudioCache[isBank][id];
+                status = audio_cache_load_status(isBank)[id];
+                if (entry->ptr == NULL
+                    || (status != SOUND_LOAD_STATUS_NOT_LOADED && status != SOUND_LOAD_STATUS_DISCARDABLE)) {
+                    continue;
+                }
+                if (lruId < 0 || entry->lastUse < lruTime) {
+                    lruId = id;
+                    lruIsBank = isBank;
+                    lruTime = entry->lastUse;
+                }
+            }
+        }
+
+        if (lruId < 0) {
+            break;
+        }
+
+        audio_cache_load_status(lruIsBank)[lruId] = SOUND_LOAD_STATUS_NOT_LOADED;
+        if (lruIsBank) {
+            discard_bank(lruId);
+        }
+        audio_cache_free(lruIsBank, lruId);
+    }
+}
+
+static void *audio_cache_alloc(struct SoundMultiPool *pool, u32 size, s32 id) {
+    s32 isBank = (pool == &gBankLoadedPool);
+    struct AudioCacheEntry *entry;
+
+    if (id < 0 || id >= audio_cache_capacity(isBank)) {
+        return NULL;
+    }
+
+    entry = &sAudioCache[isBank][id];
+    if (entry->ptr != NULL) {
+        // Loading over a resident entry, so the caller is about to rewrite it anyway
+        if (entry->size >= size) {
+            entry->lastUse = ++sAudioCacheClock;
+            return entry->ptr;
+        }
+        audio_cache_free(isBank, id);
+    }
+
+    audio_cache_make_room(size);
+
+    entry->ptr = malloc(size);
+    if (entry->ptr == NULL) {
+        return NULL;
+    }
+    entry->size = size;
+    entry->lastUse = ++sAudioCacheClock;
+    sAudioCacheSize += size;
+    return entry->ptr;
+}
+
+/**
+ * Hands over a bank or sequence that was loaded into a malloc'd buffer outside of the regular load path.
+ * It becomes resident as discardable, i.e. loaded but not in use. Returns FALSE if the id is loaded or
+ * being loaded already, in which case 'ptr' still belongs to the caller.
+ */
+s32 audio_cache_insert(struct SoundMultiPool *pool, s32 id, void *ptr, u32 size) {
+    s32 isBank = (pool == &gBankLoadedPool);
+    struct AudioCacheEntry *entry;
+
+    if (gAudioCacheBudget == 0 || id < 0 || id >= audio_cache_capacity(isBank)
+        || audio_cache_load_status(isBank)[id] != SOUND_LOAD_STATUS_NOT_LOADED) {
+        return FALSE;
+    }
+
+    entry = &sAudioCache[isBank][id];
+    if (entry->ptr != NULL) {
+        audio_cache_free(isBank, id);
+    }
+
+    audio_cache_make_room(size);
+
+    entry->ptr = ptr;
+    entry->size = size;
+    entry->lastUse = ++sAudioCacheClock;
+    sAudioCacheSize += size;
+    audio_cache_load_status(isBank)[id] = SOUND_LOAD_STATUS_DISCARDABLE;
+    return TRUE;
+}
+
+/**
+ * Resident entries outlive session resets, since they aren't carved out of the session pools.
+ * Marks them discardable (which still counts as loaded) so the next sequence using them skips the reload.
+ */
+static void audio_cache_session_reset(void) {
+    s32 isBank, id;
+
+    for (isBank = 0; isBank < 2; isBank++) {
+        for (id = 0; id < audio_cache_capacity(isBank); id++) {
+            if (sAudioCache[isBank][id].ptr != NULL) {
+                audio_cache_load_status(isBank)[id] = SOUND_LOAD_STATUS_DISCARDABLE;
+            }
+        }
+    }
+}
+
+#ifdef VERSION_EU
+static s32 audio_cache_sound_uses_session_pool(struct AudioBankSound *sound) {
+    return sound->sample != NULL && sound->sample->loaded == 0x81;
+}
+
+/**
+ * patch_sound() copies samples flagged 0x80 into gNotesAndBuffersPool, which belongs to the session rather than to
+ * the cache entry, so a bank holding such a copy can't outlive the reset. Drops those banks so the next sequence
+ * using them reloads and re-patches them. Needs the load statuses from before the reset, since only fully loaded
+ * banks have been patched.
+ */
+static void audio_cache_drop_session_samples(void) {
+    struct AudioBank *bank;
+    struct Instrument *inst;
+    struct Drum *drum;
+    s32 id, i, drop;
+
+    for (id = 0; id < audio_cache_capacity(TRUE); id++) {
+        bank = (struct AudioBank *) sAudioCache[TRUE][id].ptr;
+        if (bank == NULL || !IS_BANK_LOAD_COMPLETE(id)) {
+            continue;
+        }
+
+        drop = FALSE;
+        for (i = 0; !drop && bank->drums != NULL && i < gCtlEntries[id].numDrums; i++) {
+            drum = bank->drums[i];
+            drop = drum != NULL && drum->loaded && audio_cache_sound_uses_session_pool(&drum->sound);
+        }
+        for (i = 0; !drop && i < gCtlEntries[id].numInstruments; i++) {
+            inst = bank->instruments[i];
+            drop = inst != NULL && inst->loaded
+                   && (audio_cache_sound_uses_session_pool(&inst->lowNotesSound)
+                       || audio_cache_sound_uses_session_pool(&inst->normalNotesSound)
+                       || audio_cache_sound_uses_session_pool(&inst->highNotesSound));
+        }
+
+        if (drop) {
+            discard_bank(id);
+            audio_cache_free(TRUE, id);
+        }
+    }
+}
+#endif
+#endif
+
 void reset_bank_and_seq_load_status(void) {
+#if defined(AUDIO_LRU_CACHE) && defined(VERSION_EU)
+    audio_cache_drop_session_samples();
+#endif
 #ifdef VERSION_SH
     bzero(&gBankLoadStatus, sizeof(gBankLoadStatus));
     bzero(&gUnkLoadStatus,  sizeof(gUnkLoadStatus));
@@ -180,6 +397,9 @@ void reset_bank_and_seq_load_status(void) {
     bzero(&gBankLoadStatus, sizeof(gBankLoadStatus)); // Setting this array to zero is equivilent to SOUND_LOAD_STATUS_NOT_LOADED
     bzero(&gSeqLoadStatus,  sizeof(gSeqLoadStatus));  // Same dealio
 #endif
+#ifdef AUDIO_LRU_CACHE
+    audio_cache_session_reset();
+#endif
 }
 
 void discard_bank(s32 bankId) {
@@ -304,7 +524,7 @@ void sound_init_main_pools(s32 sizeForAudioInitPool) {
     sound_alloc_pool_init(&gAudioSessionPool, (gAudioHeap + sizeForAudioInitPool), (gAudioHeapSize - sizeForAudioInitPool));
 }
 
-#ifdef PUPPYPRINT_DEBUG
+#if defined(PUPPYPRINT_DEBUG) || defined(PC_AUDIO_STATS)
 void puppyprint_get_allocated_pools(s32 *audioPoolList) {
     u32 i, j;
     const struct SoundAllocPool *pools[NUM_AUDIO_POOLS] = {
@@ -414,6 +634,13 @@ void *alloc_bank_or_seq(struct SoundMultiPool *arg0, s32 arg1, s32 size, s32 arg
 
 size = ALIGN16(size);
 
+#ifdef AUDIO_LRU_CACHE
+    // Everything but the explicitly persistent-only loads goes to the resident cache
+    if (gAudioCacheBudget != 0 && arg3 != 1 && (arg0 == &gSeqLoadedPool || arg0 == &gBankLoadedPool)) {
+        return audio_cache_alloc(arg0, arg1 * size, id);
+    }
+#endif
+
 #ifdef VERSION_SH
     switch (poolIdx) {
         case 0:
@@ -810,6 +1037,11 @@ void *get_bank_or_seq(struct SoundMultiPool *arg0, s32 arg1, s32 id) {
     struct TemporaryPool *temporary = &arg0->temporary;
 
     if (arg1 == 0) {
+#ifdef AUDIO_LRU_CACHE
+        if (gAudioCacheBudget != 0) {
+            return audio_cache_lookup(arg0, id);
+        }
+#endif
         // Try not to overwrite sound that we have just accessed, by setting nextSide appropriately.
         if (temporary->entries[0].id == id) {
             temporary->nextSide = 1;
@@ -1046,7 +1278,7 @@ void init_reverb_us(s32 presetId) {
     s16 *mem;
     s32 i;
 
-    s32 reverbWindowSize = ALIGN16((s32) (gReverbSettings[presetId].windowSize * SAMPLE_RATE_DIFF));
+    s32 reverbWindowSize = ALIGN16((s32) (gReverbSettings[presetId].windowSize * AUDIO_SAMPLE_RATE_DIFF));
     gReverbDownsampleRate = gReverbSettings[presetId].downsampleRate;
 #ifdef BETTER_REVERB
     struct BetterReverbSettings *betterReverbPreset = &gBetterReverbSettings[gBetterReverbPresetValue];
@@ -1072,7 +1304,7 @@ void init_reverb_us(s32 presetId) {
     if (betterReverbPreset->windowSize <= 0) {
         betterReverbWindowsSize = betterReverbPreset->windowSize;
     } else {
-        betterReverbWindowsSize = ALIGN16((s32) (betterReverbPreset->windowSize * SAMPLE_RATE_DIFF));
+        betterReverbWindowsSize = ALIGN16((s32) (betterReverbPreset->windowSize * AUDIO_SAMPLE_RATE_DIFF));
     }
     betterReverbRevIndex = betterReverbPreset->reverbIndex;
     betterReverbGainIndex = betterReverbPreset->gainIndex;
@@ -1342,13 +1574,19 @@ void audio_reset_session(void) {
     gMaxAudioCmds = gMaxSimultaneousNotes * 0x10 * gAudioBufferParameters.updatesPerFrame + preset->numReverbs * 0x20 + 0x300;
 #endif
 #else
+#ifdef TARGET_N64
     gAiFrequency = osAiSetFrequency(gAudioSessionSettings.frequency);
+#else
+    // The PC backends play exactly the rate asked for. osAiSetFrequency() would round it to what the N64 video
+    // clock can divide down to, which is a few cents off at the oversampled rates and detunes every note.
+    gAiFrequency = gAudioSessionSettings.frequency;
+#endif
     gMaxSimultaneousNotes = gAudioSessionSettings.maxSimultaneousNotes;
     gSamplesPerFrameTarget = ALIGN16(gAiFrequency / 60);
 
     gVolume = gAudioSessionSettings.volume;
     gMinAiBufferLength = gSamplesPerFrameTarget - 0x10;
-    gAudioUpdatesPerFrame = updatesPerFrame = gSamplesPerFrameTarget / ALIGN16((s32) (160 * SAMPLE_RATE_DIFF)) + 1;
+    gAudioUpdatesPerFrame = updatesPerFrame = gSamplesPerFrameTarget / ALIGN16((s32) (160 * AUDIO_SAMPLE_RATE_DIFF)) + 1;
 
     gMaxSimultaneousNotes = MAX_SIMULTANEOUS_NOTES;
 
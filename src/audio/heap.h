@@ -99,6 +99,14 @@ struct UnkPool {
 };
 #endif
 
+#if !defined(TARGET_N64) && !defined(VERSION_SH)
+// PC only: banks and sequences that would otherwise share the two-slot temporary pools (or fill up the
+// persistent ones) are kept resident in an LRU cache of up to gAudioCacheBudget bytes. 0 disables it.
+#define AUDIO_LRU_CACHE
+#define AUDIO_CACHE_DEFAULT_BUDGET (16 * 1024 * 1024)
+extern u32 gAudioCacheBudget;
+#endif
+
 extern u8 gAudioHeap[];
 extern s16 gVolume;
 extern s8 gReverbDownsampleRate;
@@ -129,7 +137,15 @@ void *soundAlloc(struct SoundAllocPool *pool, u32 size);
 void *sound_alloc_uninitialized(struct SoundAllocPool *pool, u32 size);
 void sound_init_main_pools(s32 sizeForAudioInitPool);
 void sound_alloc_pool_init(struct SoundAllocPool *pool, void *memAddr, u32 size);
-#ifdef PUPPYPRINT_DEBUG
+#if defined(PUPPYPRINT_DEBUG) || defined(PC_AUDIO_STATS)
+#ifndef NUM_AUDIO_POOLS
+#ifdef BETTER_REVERB
+#define NUM_AUDIO_POOLS 7
+#else
+#define NUM_AUDIO_POOLS 6
+#endif
+#endif
+// Fills audioPoolList with a (size, used) pair for each pool
 void puppyprint_get_allocated_pools(s32 *audioPoolList);
 #endif
 #ifdef VERSION_SH
@@ -148,6 +164,9 @@ void init_reverb_us(s32 presetId);
 void audio_reset_session(s32 reverbPresetId);
 #endif
 void discard_bank(s32 bankId);
+#ifdef AUDIO_LRU_CACHE
+s32 audio_cache_insert(struct SoundMultiPool *pool, s32 id, void *ptr, u32 size);
+#endif
 
 #ifdef VERSION_SH
 void fill_filter(s16 filter[8], s32 arg1, s32 arg2);
@@ -6,8 +6,36 @@
 #include "types.h"
 #include "game/profiling.h"
 
+// Compile-time ratio of the output rate; instrument tunings and the AI and DMA buffers follow it.
 #define SAMPLE_RATE_DIFF (FINAL_SAMPLE_RATE / 32000.0f)
 
+// Rate the engine actually synthesizes at. On PC this is the output rate times the oversampling factor, and it can
+// be anything up to MAX_AUDIO_SAMPLE_RATE, so the output rate can only go above FINAL_SAMPLE_RATE in builds with
+// AUDIO_OVERSAMPLE_MAX above 1.
+#ifdef TARGET_N64
+#define AUDIO_SAMPLE_RATE FINAL_SAMPLE_RATE
+#define MAX_AUDIO_SAMPLE_RATE FINAL_SAMPLE_RATE
+#else
+#ifdef __cplusplus
+extern "C" s32 gAudioSampleRate;
+extern "C" s32 gAudioOversample;
+#else
+extern s32 gAudioSampleRate;
+extern s32 gAudioOversample;
+#endif
+#define AUDIO_SAMPLE_RATE (gAudioSampleRate * gAudioOversample)
+// Set with 'make AUDIO_OVERSAMPLE_MAX=N', since everything sized by MAX_AUDIO_SAMPLE_RATE grows with it
+#ifdef PC_AUDIO_OVERSAMPLE_MAX
+#define AUDIO_OVERSAMPLE_MAX PC_AUDIO_OVERSAMPLE_MAX
+#else
+#define AUDIO_OVERSAMPLE_MAX 1
+#endif
+#define MAX_AUDIO_SAMPLE_RATE (FINAL_SAMPLE_RATE * AUDIO_OVERSAMPLE_MAX)
+#endif
+#define AUDIO_SAMPLE_RATE_DIFF (AUDIO_SAMPLE_RATE / 32000.0f)
+// Ratio of the highest rate the engine can run at; DMEM offsets and reverb buffers are sized with this.
+#define MAX_SAMPLE_RATE_DIFF (MAX_AUDIO_SAMPLE_RATE / 32000.0f)
+
 #if defined(VERSION_EU) || defined(VERSION_SH)
 #define SEQUENCE_PLAYERS 4
 #else
@@ -332,6 +360,9 @@ struct SequencePlayer {
 #endif
     /*0x138, 0x140*/ uintptr_t bankDmaCurrDevAddr;
     /*0x13C, 0x144*/ ssize_t bankDmaRemaining;
+#ifndef TARGET_N64
+    u32 ticks; // PC only: ticks the script has run since the sequence started
+#endif
 }; // size = 0x140, 0x148 on EU, 0x14C on SH
 
 struct AdsrSettings {
@@ -725,6 +756,9 @@ struct Note {
 struct NoteSynthesisBuffers {
     s16 adpcmdecState[0x10];
     s16 finalResampleState[0x10];
+#ifndef TARGET_N64
+    s16 finalResampleStateHQ[0x28]; // RESAMPLE_HQ_STATE, see aResampleHQ in src/pc/mixer.c
+#endif
 #ifdef VERSION_SH
     s16 unk[0x10];
     s16 filterBuffer[0x20];
@@ -6,6 +6,8 @@
 #include "heap.h"
 #include "load.h"
 #include "seqplayer.h"
+#include "../pc/audio_data_map.h"
+#include "../pc/audio_stats.h"
 
 struct SharedDma {
     /*0x0*/ u8 *buffer;       // target, points to pre-allocated buffer
@@ -91,10 +93,12 @@ s8 gAudioUpdatesPerFrame;
 extern u64 gAudioGlobalsStartMarker;
 extern u64 gAudioGlobalsEndMarker;
 
+#ifndef AUDIO_DATA_MAP
 extern u8 gSoundDataADSR[]; // sound_data.ctl
 extern u8 gSoundDataRaw[];  // sound_data.tbl
 extern u8 gMusicData[];     // sequences.s
 extern u8 gBankSetsData[];  // bank_sets.s
+#endif
 
 ALSeqFile *get_audio_file_header(s32 poolIdx);
 
@@ -202,6 +206,7 @@ void *dma_sample_data(uintptr_t devAddr, u32 size, s32 arg2, u8 *dmaIndexRef) {
                 }
                 sSampleTTLs[i] = 60;
                 *dmaIndexRef = (u8) i;
+                AUDIO_STATS_COUNT(dmaHits);
                 return (devAddr - dma->source) + dma->buffer;
             }
         }
@@ -232,6 +237,7 @@ void *dma_sample_data(uintptr_t devAddr, u32 size, s32 arg2, u8 *dmaIndexRef) {
                 sSampleDmaReuseQueueTail1++;
             }
             sSampleTTLs[*dmaIndexRef] = 2;
+            AUDIO_STATS_COUNT(dmaHits);
             return dma->buffer + (devAddr - dma->source);
         }
     }
@@ -245,6 +251,7 @@ void *dma_sample_data(uintptr_t devAddr, u32 size, s32 arg2, u8 *dmaIndexRef) {
         hasDma = TRUE;
     }
 
+    AUDIO_STATS_COUNT(dmaMisses);
     transfer = dma->bufSize;
     dmaDevAddr = devAddr & ~0xF;
     dma->source = dmaDevAddr;
@@ -761,6 +768,28 @@ void audio_init() {
 
     gAudioLoadLock = AUDIO_LOCK_UNINITIALIZED;
 
+#ifndef TARGET_N64
+    if (gAudioOversample > AUDIO_OVERSAMPLE_MAX) {
+        gAudioOversample = AUDIO_OVERSAMPLE_MAX;
+    } else if (gAudioOversample < 1) {
+        gAudioOversample = 1;
+    }
+    // Buffers that follow the engine rate are sized for MAX_AUDIO_SAMPLE_RATE, so the output rate can go as high
+    // as that leaves room for at this factor
+    if (gAudioSampleRate <= 0) {
+        gAudioSampleRate = FINAL_SAMPLE_RATE;
+    } else if (gAudioSampleRate > MAX_AUDIO_SAMPLE_RATE / gAudioOversample) {
+        gAudioSampleRate = MAX_AUDIO_SAMPLE_RATE / gAudioOversample;
+    } else if (gAudioSampleRate < 8000) {
+        gAudioSampleRate = 8000;
+    }
+#if defined(VERSION_EU)
+    gAudioSessionPresets[0].frequency = AUDIO_SAMPLE_RATE;
+#else
+    gAudioSessionSettings.frequency = AUDIO_SAMPLE_RATE;
+#endif
+#endif
+
 #if defined(VERSION_JP) || defined(VERSION_US)
     s32 lim2 = gAudioHeapSize;
     for (i = 0; i <= lim2 / 8 - 1; i++) {
@@ -846,6 +875,10 @@ void audio_init() {
     eu_stubbed_printf_3("Heap %x %x %x\n", 0, 0, 0);
     eu_stubbed_printf_0("Main Heap Initialize.\n");
 
+#ifdef AUDIO_DATA_MAP
+    audio_data_map();
+#endif
+
     // Load headers for sounds and sequences
     gSeqFileHeader = (ALSeqFile *) dmaTempBuffer;
     data = gMusicData;
@@ -6,6 +6,8 @@
 #include "heap.h"
 #include "load.h"
 #include "seqplayer.h"
+#include "../pc/audio_data_map.h"
+#include "../pc/audio_stats.h"
 
 struct SharedDma {
     /*0x0*/ u8 *buffer;       // target, points to pre-allocated buffer
@@ -102,9 +104,11 @@ s8 gAudioUpdatesPerFrame;
 extern u64 gAudioGlobalsStartMarker;
 extern u64 gAudioGlobalsEndMarker;
 
+#ifndef AUDIO_DATA_MAP
 extern u8 gSoundDataADSR[]; // ctl
 extern u8 gSoundDataRaw[];  // tbl
 extern u8 gMusicData[];     // sequences
+#endif
 
 ALSeqFile *get_audio_file_header(s32 poolIdx);
 
@@ -184,6 +188,7 @@ void *dma_sample_data(uintptr_t devAddr, u32 size, s32 arg2, u8 *dmaIndexRef, s3
                 }
                 dma->ttl = 60;
                 *dmaIndexRef = (u8) i;
+                AUDIO_STATS_COUNT(dmaHits);
                 return &dma->buffer[(devAddr - dma->source)];
             }
         }
@@ -213,6 +218,7 @@ void *dma_sample_data(uintptr_t devAddr, u32 size, s32 arg2, u8 *dmaIndexRef, s3
                 sSampleDmaReuseQueueTail1++;
             }
             dma->ttl = 2;
+            AUDIO_STATS_COUNT(dmaHits);
             return dma->buffer + (devAddr - dma->source);
         }
     }
@@ -225,6 +231,7 @@ void *dma_sample_data(uintptr_t devAddr, u32 size, s32 arg2, u8 *dmaIndexRef, s3
         hasDma = TRUE;
     }
 
+    AUDIO_STATS_COUNT(dmaMisses);
     transfer = dma->bufSize;
     dmaDevAddr = devAddr & ~0xF;
     dma->ttl = 2;
@@ -926,7 +933,7 @@ void func_sh_802f41e4(s32 audioResetStatus) {
     func_sh_802f4dcc(audioResetStatus);
 }
 
-#if defined(VERSION_SH)
+#if defined(VERSION_SH) && !defined(AUDIO_DATA_MAP)
 u8 gShindouSoundBanksHeader[] = {
 #include "sound/ctl_header.inc.c"
 };
@@ -954,6 +961,24 @@ void audio_init() {
 
     gAudioLoadLockSH = 0;
 
+#ifndef TARGET_N64
+    if (gAudioOversample > AUDIO_OVERSAMPLE_MAX) {
+        gAudioOversample = AUDIO_OVERSAMPLE_MAX;
+    } else if (gAudioOversample < 1) {
+        gAudioOversample = 1;
+    }
+    // Buffers that follow the engine rate are sized for MAX_AUDIO_SAMPLE_RATE, so the output rate can go as high
+    // as that leaves room for at this factor
+    if (gAudioSampleRate <= 0) {
+        gAudioSampleRate = FINAL_SAMPLE_RATE;
+    } else if (gAudioSampleRate > MAX_AUDIO_SAMPLE_RATE / gAudioOversample) {
+        gAudioSampleRate = MAX_AUDIO_SAMPLE_RATE / gAudioOversample;
+    } else if (gAudioSampleRate < 8000) {
+        gAudioSampleRate = 8000;
+    }
+    gAudioSessionPresets[0].frequency = AUDIO_SAMPLE_RATE;
+#endif
+
     for (i = 0; i < gAudioHeapSize / 8; i++) {
         ((u64 *) gAudioHeap)[i] = 0;
     }
@@ -1020,6 +1045,10 @@ void audio_init() {
     eu_stubbed_printf_3("Heap %x %x %x\n", 0, 0, 0);
     eu_stubbed_printf_0("Main Heap Initialize.\n");
 
+#ifdef AUDIO_DATA_MAP
+    audio_data_map();
+#endif
+
     // Load headers for sounds and sequences
     gSeqFileHeader = (ALSeqFile *) gShindouSequencesHeader;
     gAlCtlHeader = (ALSeqFile *) gShindouSoundBanksHeader;
@@ -8,6 +8,7 @@
 #include "synthesis.h"
 #include "effects.h"
 #include "external.h"
+#include "../pc/audio_stats.h"
 
 void note_set_resampling_rate(struct Note *note, f32 resamplingRateInput);
 
@@ -595,11 +596,12 @@ void process_notes(void) {
 
             scale = note->adsrVolScale;
             frequency *= note->vibratoFreqScale * note->portamentoFreqScale;
-#if (FINAL_SAMPLE_RATE > 32000) && defined(LIMIT_PITCH_CEILING)
-            cap = 3.99992f / SAMPLE_RATE_DIFF;
+#ifdef LIMIT_PITCH_CEILING
+            cap = (AUDIO_SAMPLE_RATE > 32000) ? (3.99992f / AUDIO_SAMPLE_RATE_DIFF) : 3.99992f;
 #else
             cap = 3.99992f;
 #endif
+            // Instrument tunings are baked for FINAL_SAMPLE_RATE; compensate if the output runs at another rate.
             if (gAiFrequency != (s32) (32006.0f * SAMPLE_RATE_DIFF + 0.5f)) {
                 frequency *= (FINAL_SAMPLE_RATE / (f32) gAiFrequency);
             }
@@ -1240,6 +1242,7 @@ struct Note *alloc_note_from_active(struct NotePool *pool, struct SequenceChanne
 #ifdef VERSION_SH
         aPriority = aNote->priority;
 #else
+        AUDIO_STATS_COUNT(noteSteals);
         func_80319728(aNote, seqLayer);
         audio_list_push_back(&pool->releasing, &aNote->listItem);
 #endif
@@ -1250,6 +1253,8 @@ struct Note *alloc_note_from_active(struct NotePool *pool, struct SequenceChanne
         return NULL;
     }
 
+    AUDIO_STATS_COUNT(noteSteals);
+
     if (aPriority < rPriority) {
         audio_list_remove(&aNote->listItem);
         func_80319728(aNote, seqLayer);
@@ -1295,6 +1300,7 @@ struct Note *alloc_note(struct SequenceChannelLayer *seqLayer) {
             goto null_return;
 #else
             eu_stubbed_printf_0("Sub Limited Warning: Drop Voice");
+            AUDIO_STATS_COUNT(noteDrops);
             seqLayer->status = SOUND_LOAD_STATUS_NOT_LOADED;
             return NULL;
 #endif
@@ -1313,6 +1319,7 @@ struct Note *alloc_note(struct SequenceChannelLayer *seqLayer) {
             goto null_return;
 #else
             eu_stubbed_printf_0("Warning: Drop Voice");
+            AUDIO_STATS_COUNT(noteDrops);
             seqLayer->status = SOUND_LOAD_STATUS_NOT_LOADED;
             return NULL;
 #endif
@@ -1328,6 +1335,7 @@ struct Note *alloc_note(struct SequenceChannelLayer *seqLayer) {
             goto null_return;
 #else
             eu_stubbed_printf_0("Warning: Drop Voice");
+            AUDIO_STATS_COUNT(noteDrops);
             seqLayer->status = SOUND_LOAD_STATUS_NOT_LOADED;
             return NULL;
 #endif
@@ -1348,6 +1356,7 @@ struct Note *alloc_note(struct SequenceChannelLayer *seqLayer) {
         goto null_return;
 #else
         eu_stubbed_printf_0("Warning: Drop Voice");
+        AUDIO_STATS_COUNT(noteDrops);
         seqLayer->status = SOUND_LOAD_STATUS_NOT_LOADED;
         return NULL;
 #endif
@@ -1356,6 +1365,7 @@ struct Note *alloc_note(struct SequenceChannelLayer *seqLayer) {
 
 #ifdef VERSION_SH
 null_return:
+    AUDIO_STATS_COUNT(noteDrops);
     seqLayer->status = SOUND_LOAD_STATUS_NOT_LOADED;
     return NULL;
 #endif
@@ -0,0 +1,324 @@
+#ifndef AUDIO_SEQ_OPCODES_H
+#define AUDIO_SEQ_OPCODES_H
+
+/**
+ * Command tables for the sequence, channel and layer scripts of .m64 data, for host tools that walk sequences
+ * without playing them. They are a hand-written copy of the switches in seqplayer.c for the version being built;
+ * the player itself does not read them, so a command added or moved there has to be added or moved here too.
+ * make seq-check plays sequences on the real player and checks that seq_walk.c, driven by these tables,
+ * finds the same notes and tempo changes.
+ *
+ * Each entry covers the opcodes first..last; commands that take a channel, layer or IO slot in their low bits
+ * span the whole range. 'args' lists the operand bytes that follow the opcode, one character each:
+ *   b  u8
+ *   h  16-bit big-endian value or offset into the sequence
+ *   v  compressed u16: one byte, or two if the first has its top bit set
+ *   p  portamento time: u8 if the mode read before it has its top bit set, else as 'v'
+ * 'kind' tells a walker what the command does to control flow, timing and state it can follow; everything it
+ * can step over is SEQ_OP_OTHER.
+ */
+
+enum SeqOpKind {
+    SEQ_OP_OTHER,
+
+    // Control flow, shared by all three script levels
+    SEQ_OP_END,
+    SEQ_OP_DELAY1,
+    SEQ_OP_DELAY,       // delay 'v' ticks
+    SEQ_OP_DELAY_SHORT, // delay by the low bits of the opcode
+    SEQ_OP_HANG,
+    SEQ_OP_CALL,
+    SEQ_OP_LOOP,
+    SEQ_OP_LOOPEND,
+    SEQ_OP_BREAK,
+    SEQ_OP_JUMP,
+    SEQ_OP_BEQZ,
+    SEQ_OP_BLTZ,
+    SEQ_OP_BGEZ,
+    SEQ_OP_JUMP_REL,
+    SEQ_OP_BEQZ_REL,
+    SEQ_OP_BLTZ_REL,
+
+    // Script value
+    SEQ_OP_SETVAL,
+    SEQ_OP_SUBTRACT,
+    SEQ_OP_BITAND,
+    SEQ_OP_READSEQ,
+    SEQ_OP_WRITESEQ,
+
+    // Sequence level
+    SEQ_OP_SETTEMPO,
+    SEQ_OP_ADDTEMPO,
+    SEQ_OP_INITCHANNELS,
+    SEQ_OP_DISABLECHANNELS,
+    SEQ_OP_TESTCHDISABLED,
+    SEQ_OP_SUBVARIATION,
+    SEQ_OP_SETVARIATION,
+    SEQ_OP_GETVARIATION,
+    SEQ_OP_TRANSPOSEREL,
+    SEQ_OP_SETSHORTNOTEVELOCITYTABLE,
+    SEQ_OP_SETSHORTNOTEDURATIONTABLE,
+
+    // Channel level
+    SEQ_OP_STARTCHANNEL,
+    SEQ_OP_DISABLECHANNEL,
+    SEQ_OP_DISABLECHANNEL_ARG,
+    SEQ_OP_SETLAYER,
+    SEQ_OP_FREELAYER,
+    SEQ_OP_FREELAYERS,
+    SEQ_OP_DYNSETLAYER,
+    SEQ_OP_TESTLAYERSFINISHED,
+    SEQ_OP_TESTLAYERFINISHED,
+    SEQ_OP_SETDYNTABLE,
+    SEQ_OP_DYNSETDYNTABLE,
+    SEQ_OP_DYNCALL,
+    SEQ_OP_IOWRITEVAL,
+    SEQ_OP_IOREADVAL,
+    SEQ_OP_IOREADVALSUB,
+    SEQ_OP_IOWRITEVAL2,
+    SEQ_OP_IOREADVAL2,
+    SEQ_OP_LARGENOTESON,
+    SEQ_OP_LARGENOTESOFF,
+    SEQ_OP_SETBANK,
+    SEQ_OP_SETBANKANDINSTR,
+    SEQ_OP_SETINSTR,
+    SEQ_OP_SETVOL,
+    SEQ_OP_PITCHBEND,
+    SEQ_OP_SETCHANPARAMS,
+    SEQ_OP_SETCHANPARAMSFROMSEQ,
+
+    // Layer level
+    SEQ_OP_NOTE,
+    SEQ_OP_LAYER_DELAY,
+    SEQ_OP_LAYER_SETINSTR,
+    SEQ_OP_SETSHORTNOTEVELOCITY,
+    SEQ_OP_SETSHORTNOTEDURATION,
+    SEQ_OP_SETSHORTNOTEDEFAULTPLAYPERCENTAGE,
+    SEQ_OP_SHORTNOTEVELOCITYFROMTABLE,
+    SEQ_OP_SHORTNOTEDURATIONFROMTABLE,
+
+    // More than one level
+    SEQ_OP_TRANSPOSE,
+    SEQ_OP_SETPAN,
+};
+
+struct SeqOpcode {
+    u8 first;
+    u8 last;
+    u8 kind;
+    const char *name;
+    const char *args;
+};
+
+static const struct SeqOpcode sSeqSequenceOpcodes[] = {
+    { 0xff, 0xff, SEQ_OP_END,             "end",                         "" },
+    { 0xfe, 0xfe, SEQ_OP_DELAY1,          "delay1",                      "" },
+    { 0xfd, 0xfd, SEQ_OP_DELAY,           "delay",                       "v" },
+    { 0xfc, 0xfc, SEQ_OP_CALL,            "call",                        "h" },
+    { 0xfb, 0xfb, SEQ_OP_JUMP,            "jump",                        "h" },
+    { 0xfa, 0xfa, SEQ_OP_BEQZ,            "beqz",                        "h" },
+    { 0xf9, 0xf9, SEQ_OP_BLTZ,            "bltz",                        "h" },
+    { 0xf8, 0xf8, SEQ_OP_LOOP,            "loop",                        "b" },
+    { 0xf7, 0xf7, SEQ_OP_LOOPEND,         "loopend",                     "" },
+    { 0xf5, 0xf5, SEQ_OP_BGEZ,            "bgez",                        "h" },
+#if defined(VERSION_EU) || defined(VERSION_SH)
+    { 0xf4, 0xf4, SEQ_OP_JUMP_REL,        "jump_rel",                    "b" },
+    { 0xf3, 0xf3, SEQ_OP_BEQZ_REL,        "beqz_rel",                    "b" },
+    { 0xf2, 0xf2, SEQ_OP_BLTZ_REL,        "bltz_rel",                    "b" },
+    { 0xf1, 0xf1, SEQ_OP_OTHER,           "reservenotes",                "b" },
+    { 0xf0, 0xf0, SEQ_OP_OTHER,           "unreservenotes",              "" },
+#else
+    { 0xf2, 0xf2, SEQ_OP_OTHER,           "reservenotes",                "b" },
+    { 0xf1, 0xf1, SEQ_OP_OTHER,           "unreservenotes",              "" },
+#endif
+    { 0xdf, 0xdf, SEQ_OP_TRANSPOSE,       "transpose",                   "b" },
+    { 0xde, 0xde, SEQ_OP_TRANSPOSEREL,    "transposerel",                "b" },
+    { 0xdd, 0xdd, SEQ_OP_SETTEMPO,        "settempo",                    "b" },
+#ifdef VERSION_SH
+    // Added to the tempo accumulator each update rather than to the tempo
+    { 0xdc, 0xdc, SEQ_OP_OTHER,           "addtempo",                    "b" },
+#else
+    { 0xdc, 0xdc, SEQ_OP_ADDTEMPO,        "addtempo",                    "b" },
+#endif
+#if defined(VERSION_EU) || defined(VERSION_SH)
+    { 0xdb, 0xdb, SEQ_OP_OTHER,           "setvol",                      "b" },
+    { 0xda, 0xda, SEQ_OP_OTHER,           "fade",                        "bh" },
+    { 0xd9, 0xd9, SEQ_OP_OTHER,           "setvolscale",                 "b" },
+#else
+    { 0xdb, 0xdb, SEQ_OP_OTHER,           "setvol",                      "b" },
+    { 0xda, 0xda, SEQ_OP_OTHER,           "changevol",                   "b" },
+#endif
+    { 0xd7, 0xd7, SEQ_OP_INITCHANNELS,    "initchannels",                "h" },
+    { 0xd6, 0xd6, SEQ_OP_DISABLECHANNELS, "disablechannels",             "h" },
+    { 0xd5, 0xd5, SEQ_OP_OTHER,           "setmutescale",                "b" },
+    { 0xd4, 0xd4, SEQ_OP_OTHER,           "mute",                        "" },
+    { 0xd3, 0xd3, SEQ_OP_OTHER,           "setmutebhv",                  "b" },
+    { 0xd2, 0xd2, SEQ_OP_SETSHORTNOTEVELOCITYTABLE, "setshortnotevelocitytable", "h" },
+    { 0xd1, 0xd1, SEQ_OP_SETSHORTNOTEDURATIONTABLE, "setshortnotedurationtable", "h" },
+    { 0xd0, 0xd0, SEQ_OP_OTHER,           "setnoteallocationpolicy",     "b" },
+    { 0xcc, 0xcc, SEQ_OP_SETVAL,          "setval",                      "b" },
+    { 0xc9, 0xc9, SEQ_OP_BITAND,          "bitand",                      "b" },
+    { 0xc8, 0xc8, SEQ_OP_SUBTRACT,        "subtract",                    "b" },
+#ifdef VERSION_SH
+    { 0xc7, 0xc7, SEQ_OP_WRITESEQ,        "writeseq",                    "bh" },
+    { 0xc6, 0xc6, SEQ_OP_OTHER,           "stop",                        "" },
+#endif
+    { 0x00, 0x0f, SEQ_OP_TESTCHDISABLED,  "testchdisabled",              "" },
+    { 0x50, 0x5f, SEQ_OP_SUBVARIATION,    "subvariation",                "" },
+    { 0x70, 0x7f, SEQ_OP_SETVARIATION,    "setvariation",                "" },
+    { 0x80, 0x8f, SEQ_OP_GETVARIATION,    "getvariation",                "" },
+    { 0x90, 0x9f, SEQ_OP_STARTCHANNEL,    "startchannel",                "h" },
+};
+
+static const struct SeqOpcode sSeqChannelOpcodes[] = {
+    { 0xff, 0xff, SEQ_OP_END,             "end",                         "" },
+    { 0xfe, 0xfe, SEQ_OP_DELAY1,          "delay1",                      "" },
+    { 0xfd, 0xfd, SEQ_OP_DELAY,           "delay",                       "v" },
+    { 0xfc, 0xfc, SEQ_OP_CALL,            "call",                        "h" },
+    { 0xfb, 0xfb, SEQ_OP_JUMP,            "jump",                        "h" },
+    { 0xfa, 0xfa, SEQ_OP_BEQZ,            "beqz",                        "h" },
+    { 0xf9, 0xf9, SEQ_OP_BLTZ,            "bltz",                        "h" },
+    { 0xf8, 0xf8, SEQ_OP_LOOP,            "loop",                        "b" },
+    { 0xf7, 0xf7, SEQ_OP_LOOPEND,         "loopend",                     "" },
+    { 0xf6, 0xf6, SEQ_OP_BREAK,           "break",                       "" },
+    { 0xf5, 0xf5, SEQ_OP_BGEZ,            "bgez",                        "h" },
+#if defined(VERSION_EU) || defined(VERSION_SH)
+    { 0xf4, 0xf4, SEQ_OP_JUMP_REL,        "jump_rel",                    "b" },
+    { 0xf3, 0xf3, SEQ_OP_BEQZ_REL,        "beqz_rel",                    "b" },
+    { 0xf2, 0xf2, SEQ_OP_BLTZ_REL,        "bltz_rel",                    "b" },
+    { 0xf1, 0xf1, SEQ_OP_OTHER,           "reservenotes",                "b" },
+    { 0xf0, 0xf0, SEQ_OP_OTHER,           "unreservenotes",              "" },
+    { 0xea, 0xea, SEQ_OP_HANG,            "hang",                        "" },
+    { 0xeb, 0xeb, SEQ_OP_SETBANKANDINSTR, "setbankandinstr",             "bb" },
+    { 0xe5, 0xe5, SEQ_OP_OTHER,           "setreverbindex",              "b" },
+    { 0xe6, 0xe6, SEQ_OP_OTHER,           "setbookoffset",               "b" },
+    { 0xe7, 0xe7, SEQ_OP_SETCHANPARAMSFROMSEQ, "setchanparamsfromseq",    "h" },
+    { 0xe8, 0xe8, SEQ_OP_SETCHANPARAMS,   "setchanparams",               "bbbbbbbb" },
+    { 0xec, 0xec, SEQ_OP_OTHER,           "resetvibrato",                "" },
+    { 0xe9, 0xe9, SEQ_OP_OTHER,           "setnotepriority",             "b" },
+#else
+    { 0xf3, 0xf3, SEQ_OP_HANG,            "hang",                        "" },
+    { 0xf2, 0xf2, SEQ_OP_OTHER,           "reservenotes",                "b" },
+    { 0xf1, 0xf1, SEQ_OP_OTHER,           "unreservenotes",              "" },
+    { 0xd6, 0xd6, SEQ_OP_OTHER,           "setupdatesperframe",          "b" },
+#endif
+    { 0xc2, 0xc2, SEQ_OP_SETDYNTABLE,     "setdyntable",                 "h" },
+    { 0xc5, 0xc5, SEQ_OP_DYNSETDYNTABLE,  "dynsetdyntable",              "" },
+    { 0xc1, 0xc1, SEQ_OP_SETINSTR,        "setinstr",                    "b" },
+    { 0xc3, 0xc3, SEQ_OP_LARGENOTESOFF,   "largenotesoff",               "" },
+    { 0xc4, 0xc4, SEQ_OP_LARGENOTESON,    "largenoteson",                "" },
+    { 0xdf, 0xdf, SEQ_OP_SETVOL,          "setvol",                      "b" },
+    { 0xe0, 0xe0, SEQ_OP_OTHER,           "setvolscale",                 "b" },
+    { 0xde, 0xde, SEQ_OP_OTHER,           "freqscale",                   "h" },
+    { 0xd3, 0xd3, SEQ_OP_PITCHBEND,       "pitchbend",                   "b" },
+    { 0xdd, 0xdd, SEQ_OP_SETPAN,          "setpan",                      "b" },
+    { 0xdc, 0xdc, SEQ_OP_OTHER,           "setpanmix",                   "b" },
+    { 0xdb, 0xdb, SEQ_OP_TRANSPOSE,       "transpose",                   "b" },
+    { 0xda, 0xda, SEQ_OP_OTHER,           "setenvelope",                 "h" },
+    { 0xd9, 0xd9, SEQ_OP_OTHER,           "setdecayrelease",             "b" },
+    { 0xd8, 0xd8, SEQ_OP_OTHER,           "setvibratoextent",            "b" },
+    { 0xd7, 0xd7, SEQ_OP_OTHER,           "setvibratorate",              "b" },
+    { 0xe2, 0xe2, SEQ_OP_OTHER,           "setvibratoextentlinear",      "bbb" },
+    { 0xe1, 0xe1, SEQ_OP_OTHER,           "setvibratoratelinear",        "bbb" },
+    { 0xe3, 0xe3, SEQ_OP_OTHER,           "setvibratodelay",             "b" },
+    { 0xd4, 0xd4, SEQ_OP_OTHER,           "setreverb",                   "b" },
+    { 0xc6, 0xc6, SEQ_OP_SETBANK,         "setbank",                     "b" },
+    { 0xc7, 0xc7, SEQ_OP_WRITESEQ,        "writeseq",                    "bh" },
+    { 0xc8, 0xc8, SEQ_OP_SUBTRACT,        "subtract",                    "b" },
+    { 0xc9, 0xc9, SEQ_OP_BITAND,          "bitand",                      "b" },
+    { 0xcc, 0xcc, SEQ_OP_SETVAL,          "setval",                      "b" },
+    { 0xca, 0xca, SEQ_OP_OTHER,           "setmutebhv",                  "b" },
+    { 0xcb, 0xcb, SEQ_OP_READSEQ,         "readseq",                     "h" },
+    { 0xd0, 0xd0, SEQ_OP_OTHER,           "stereoheadseteffects",        "b" },
+    { 0xd1, 0xd1, SEQ_OP_OTHER,           "setnoteallocationpolicy",     "b" },
+    { 0xd2, 0xd2, SEQ_OP_OTHER,           "setsustain",                  "b" },
+    { 0xe4, 0xe4, SEQ_OP_DYNCALL,         "dyncall",                     "" },
+#ifdef VERSION_SH
+    { 0xee, 0xee, SEQ_OP_OTHER,           "pitchbendfine",               "b" },
+    { 0xcd, 0xcd, SEQ_OP_DISABLECHANNEL_ARG, "disablechannel",           "b" },
+    { 0xce, 0xce, SEQ_OP_OTHER,           "setunkc8",                    "h" },
+    { 0xcf, 0xcf, SEQ_OP_OTHER,           "writeunkc8",                  "h" },
+    { 0xed, 0xed, SEQ_OP_OTHER,           "setsynthesisvolume",          "b" },
+    { 0xef, 0xef, SEQ_OP_OTHER,           "unused_ef",                   "hb" },
+    { 0xb0, 0xb0, SEQ_OP_OTHER,           "setfilter",                   "h" },
+    { 0xb1, 0xb1, SEQ_OP_OTHER,           "clearfilter",                 "" },
+    { 0xb2, 0xb2, SEQ_OP_OTHER,           "readunkc8",                   "h" },
+    // Only reads its operand while a filter is set, which is where a script would use it
+    { 0xb3, 0xb3, SEQ_OP_OTHER,           "fillfilter",                  "b" },
+    { 0xb4, 0xb4, SEQ_OP_OTHER,           "setdyntablefromunkc8",        "" },
+    { 0xb5, 0xb5, SEQ_OP_OTHER,           "dynreadunkc8",                "" },
+    { 0xb6, 0xb6, SEQ_OP_OTHER,           "dynread",                     "" },
+
+    { 0x80, 0x87, SEQ_OP_TESTLAYERFINISHED, "testlayerfinished",         "" },
+    { 0x88, 0x8f, SEQ_OP_SETLAYER,        "setlayer",                    "h" },
+    { 0x90, 0x97, SEQ_OP_FREELAYER,       "freelayer",                   "" },
+    { 0x98, 0x9f, SEQ_OP_DYNSETLAYER,     "dynsetlayer",                 "" },
+    { 0x00, 0x0f, SEQ_OP_DELAY_SHORT,     "delayshort",                  "" },
+    { 0x10, 0x1f, SEQ_OP_OTHER,           "loadsample",                  "" },
+    { 0x20, 0x2f, SEQ_OP_STARTCHANNEL,    "startchannel",                "h" },
+    { 0x60, 0x6f, SEQ_OP_IOREADVAL,       "ioreadval",                   "" },
+#else
+    { 0x00, 0x0f, SEQ_OP_TESTLAYERSFINISHED, "testlayersfinished",       "" },
+    { 0x10, 0x1f, SEQ_OP_STARTCHANNEL,    "startchannel",                "h" },
+    { 0x20, 0x2f, SEQ_OP_DISABLECHANNEL,  "disablechannel",              "" },
+    { 0x80, 0x8f, SEQ_OP_IOREADVAL,       "ioreadval",                   "" },
+    { 0x90, 0x9f, SEQ_OP_SETLAYER,        "setlayer",                    "h" },
+    { 0xa0, 0xaf, SEQ_OP_FREELAYERS,      "freelayers",                  "" },
+    { 0xb0, 0xbf, SEQ_OP_DYNSETLAYER,     "dynsetlayer",                 "" },
+#ifdef VERSION_EU
+    { 0x60, 0x6f, SEQ_OP_DELAY_SHORT,     "delayshort",                  "" },
+#else
+    { 0x60, 0x6f, SEQ_OP_OTHER,           "setnotepriority",             "" },
+#endif
+#endif
+    { 0x70, 0x7f, SEQ_OP_IOWRITEVAL,      "iowriteval",                  "" },
+    { 0x50, 0x5f, SEQ_OP_IOREADVALSUB,    "ioreadvalsub",                "" },
+    { 0x30, 0x3f, SEQ_OP_IOWRITEVAL2,     "iowriteval2",                 "b" },
+    { 0x40, 0x4f, SEQ_OP_IOREADVAL2,      "ioreadval2",                  "b" },
+};
+
+static const struct SeqOpcode sSeqLayerOpcodes[] = {
+    { 0xff, 0xff, SEQ_OP_END,             "end",                         "" },
+    { 0xfc, 0xfc, SEQ_OP_CALL,            "call",                        "h" },
+    { 0xfb, 0xfb, SEQ_OP_JUMP,            "jump",                        "h" },
+    { 0xf8, 0xf8, SEQ_OP_LOOP,            "loop",                        "b" },
+    { 0xf7, 0xf7, SEQ_OP_LOOPEND,         "loopend",                     "" },
+#if defined(VERSION_EU) || defined(VERSION_SH)
+    { 0xf4, 0xf4, SEQ_OP_JUMP_REL,        "jump_rel",                    "b" },
+    { 0xcb, 0xcb, SEQ_OP_OTHER,           "setenvelope",                 "hb" },
+    { 0xcc, 0xcc, SEQ_OP_OTHER,           "ignoredrumpan",               "" },
+#endif
+#ifdef VERSION_SH
+    { 0xcd, 0xcd, SEQ_OP_OTHER,           "setreverbbits",               "b" },
+    { 0xce, 0xce, SEQ_OP_OTHER,           "pitchbendfine",               "b" },
+#endif
+    { 0xc1, 0xc1, SEQ_OP_SETSHORTNOTEVELOCITY, "setshortnotevelocity",    "b" },
+    { 0xca, 0xca, SEQ_OP_SETPAN,          "setpan",                      "b" },
+    { 0xc2, 0xc2, SEQ_OP_TRANSPOSE,       "transpose",                   "b" },
+    { 0xc9, 0xc9, SEQ_OP_SETSHORTNOTEDURATION, "setshortnoteduration",    "b" },
+    { 0xc4, 0xc4, SEQ_OP_OTHER,           "somethingon",                 "" },
+    { 0xc5, 0xc5, SEQ_OP_OTHER,           "somethingoff",                "" },
+    { 0xc3, 0xc3, SEQ_OP_SETSHORTNOTEDEFAULTPLAYPERCENTAGE, "setshortnotedefaultplaypercentage", "v" },
+    { 0xc6, 0xc6, SEQ_OP_LAYER_SETINSTR,  "setinstr",                    "b" },
+    { 0xc7, 0xc7, SEQ_OP_OTHER,           "portamento",                  "bbp" },
+    { 0xc8, 0xc8, SEQ_OP_OTHER,           "disableportamento",           "" },
+    { 0xd0, 0xdf, SEQ_OP_SHORTNOTEVELOCITYFROMTABLE, "setshortnotevelocityfromtable", "" },
+    { 0xe0, 0xef, SEQ_OP_SHORTNOTEDURATIONFROMTABLE, "setshortnotedurationfromtable", "" },
+    { 0xc0, 0xc0, SEQ_OP_LAYER_DELAY,     "delay",                       "v" },
+};
+
+// Layer notes 0x00-0xbf: the top two bits pick the form, the rest is the semitone. Which operands follow
+// depends on whether the channel has large notes on (chan_largenoteson).
+static const struct SeqOpcode sSeqLayerLargeNotes[] = {
+    { 0x00, 0x3f, SEQ_OP_NOTE,            "note0",                       "vbb" }, // length, velocity, gate
+    { 0x40, 0x7f, SEQ_OP_NOTE,            "note1",                       "vb" },  // length, velocity
+    { 0x80, 0xbf, SEQ_OP_NOTE,            "note2",                       "bb" },  // velocity, gate; last length
+};
+
+static const struct SeqOpcode sSeqLayerSmallNotes[] = {
+    { 0x00, 0x3f, SEQ_OP_NOTE,            "smallnote0",                  "v" }, // length
+    { 0x40, 0x7f, SEQ_OP_NOTE,            "smallnote1",                  "" },  // default length
+    { 0x80, 0xbf, SEQ_OP_NOTE,            "smallnote2",                  "" },  // last length
+};
+
+#endif // AUDIO_SEQ_OPCODES_H
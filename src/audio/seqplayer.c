@@ -8,6 +8,10 @@
 #include "seqplayer.h"
 #include "game/debug.h"
 #include "game/main.h"
+#include "../pc/seq/seq_trace.h"
+
+// seq_opcodes.h keeps a hand-written copy of the script commands handled here for host tools; it is not used
+// by this file, so update it along with any command added or moved here. make seq-check compares the two.
 
 #ifdef VERSION_SH
 void seq_channel_layer_process_script_part1(struct SequenceChannelLayer *layer);
@@ -732,6 +736,7 @@ void seq_channel_layer_process_script(struct SequenceChannelLayer *layer) {
         }
 
         layer->delay = sp3A;
+        SEQ_TRACE_NOTE(layer, cmd);
 #if defined(VERSION_EU) || defined(VERSION_SH)
         layer->duration = layer->noteDuration * sp3A >> 8;
 #else
@@ -1349,6 +1354,7 @@ s32 seq_channel_layer_process_script_part3(struct SequenceChannelLayer *layer, s
     }
 
     layer->delay = sp3A;
+    SEQ_TRACE_NOTE(layer, cmd);
     layer->duration = layer->noteDuration * sp3A >> 8;
     if ((seqPlayer->muted && (seqChannel->muteBehavior & 0x50) != 0)
         || seqChannel->stopSomething2) {
@@ -2299,6 +2305,10 @@ void sequence_player_process_sequence(struct SequencePlayer *seqPlayer) {
             return;
         }
         seqPlayer->tempoAcc -= (u16) gTempoInternalToExternal;
+#ifndef TARGET_N64
+        SEQ_TRACE_TICK(seqPlayer);
+        seqPlayer->ticks++;
+#endif
 
         state = &seqPlayer->scriptState;
         if (seqPlayer->delay > 1) {
@@ -2739,6 +2749,9 @@ void init_sequence_player(u32 player) {
     seqPlayer->fadeTimerUnkEu = 0;
 #endif
     seqPlayer->tempoAcc = 0;
+#ifndef TARGET_N64
+    seqPlayer->ticks = 0;
+#endif
     seqPlayer->tempo = 120 * TEMPO_SCALE; // 120 BPM
 #ifdef VERSION_SH
     seqPlayer->tempoAdd = 0;
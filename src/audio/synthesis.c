@@ -17,14 +17,14 @@
 #endif
 
 #define DMEM_ADDR_TEMP                   0x0
-#define DMEM_ADDR_RESAMPLED              FLOOR16((s32) (0x20 * SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_RESAMPLED              FLOOR16((s32) (0x20 * MAX_SAMPLE_RATE_DIFF))
 #define DMEM_ADDR_RESAMPLED2             (DMEM_ADDR_RESAMPLED + DEFAULT_LEN_1CH)
 #define DMEM_ADDR_UNCOMPRESSED_NOTE      (DMEM_ADDR_RESAMPLED2 + DMEM_ADDR_RESAMPLED)
-#define DMEM_ADDR_NOTE_PAN_TEMP          FLOOR16((s32) (0x280 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_STEREO_STRONG_TEMP_DRY FLOOR16((s32) (0x280 * SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_NOTE_PAN_TEMP          FLOOR16((s32) (0x280 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_STEREO_STRONG_TEMP_DRY FLOOR16((s32) (0x280 * MAX_SAMPLE_RATE_DIFF))
 #define DMEM_ADDR_STEREO_STRONG_TEMP_WET (DMEM_ADDR_STEREO_STRONG_TEMP_DRY + DEFAULT_LEN_1CH)
-#define DMEM_ADDR_COMPRESSED_ADPCM_DATA  FLOOR16((s32) (0x500 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_LEFT_CH                FLOOR16((s32) (0x640 * SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_COMPRESSED_ADPCM_DATA  FLOOR16((s32) (0x500 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_LEFT_CH                FLOOR16((s32) (0x640 * MAX_SAMPLE_RATE_DIFF))
 #define DMEM_ADDR_RIGHT_CH               (DMEM_ADDR_LEFT_CH + DEFAULT_LEN_1CH)
 #define DMEM_ADDR_WET_LEFT_CH            (DMEM_ADDR_RIGHT_CH + DEFAULT_LEN_1CH)
 #define DMEM_ADDR_WET_RIGHT_CH           (DMEM_ADDR_WET_LEFT_CH + DEFAULT_LEN_1CH)
@@ -203,7 +203,7 @@ void set_better_reverb_buffers(u32 *inputDelaysL, u32 *inputDelaysR) {
     for (s32 channel = 0; channel < SYNTH_CHANNEL_STEREO_COUNT; channel++) {
         historySamplesLight[channel] = 0;
         for (s32 filter = 0; filter < filterCount; filter++) {
-            betterReverbDelays[channel][filter] = (s32) ((f32) inputDelayPtrs[channel][filter] * SAMPLE_RATE_DIFF / (f32) gReverbDownsampleRate + 0.5f);
+            betterReverbDelays[channel][filter] = (s32) ((f32) inputDelayPtrs[channel][filter] * AUDIO_SAMPLE_RATE_DIFF / (f32) gReverbDownsampleRate + 0.5f);
             delayBufs[channel][filter] = soundAlloc(&gBetterReverbPool, betterReverbDelays[channel][filter] * sizeof(s16));
             bufOffset += betterReverbDelays[channel][filter];
         }
@@ -217,12 +217,24 @@ void set_better_reverb_buffers(u32 *inputDelaysL, u32 *inputDelaysR) {
 }
 #endif
 
+#ifndef TARGET_N64
+// Anti-alias filter history for the reverb downsampling, per channel
+static s16 sReverbDownsampleHistory[2][DECIMATE_MAX_TAPS];
+#endif
+
 void prepare_reverb_ring_buffer(s32 chunkLen, u32 updateIndex) {
     struct ReverbRingBufferItem *item;
     s32 srcPos, dstPos;
     s32 nSamples;
     s32 excessiveSamples;
 
+#ifndef TARGET_N64
+    // The ring buffer starts out silent after a reverb change, so the filter does too
+    if (gSynthesisReverb.framesLeftToIgnore != 0) {
+        bzero(sReverbDownsampleHistory, sizeof(sReverbDownsampleHistory));
+    }
+#endif
+
     if (gSynthesisReverb.framesLeftToIgnore == 0) {
 #ifdef BETTER_REVERB
         if (!toggleBetterReverb && gReverbDownsampleRate != 1) {
@@ -236,14 +248,31 @@ void prepare_reverb_ring_buffer(s32 chunkLen, u32 updateIndex) {
             // Touches both left and right since they are adjacent in memory
             osInvalDCache(item->toDownsampleLeft, DEFAULT_LEN_2CH);
 
-            for (srcPos = 0, dstPos = 0; dstPos < item->lengthA / 2;
-                 srcPos += gReverbDownsampleRate, dstPos++) {
-                gSynthesisReverb.ringBuffer.left[dstPos + item->startPos] = item->toDownsampleLeft[srcPos];
-                gSynthesisReverb.ringBuffer.right[dstPos + item->startPos] = item->toDownsampleRight[srcPos];
-            }
-            for (dstPos = 0; dstPos < item->lengthB / 2; srcPos += gReverbDownsampleRate, dstPos++) {
-                gSynthesisReverb.ringBuffer.left[dstPos] = item->toDownsampleLeft[srcPos];
-                gSynthesisReverb.ringBuffer.right[dstPos] = item->toDownsampleRight[srcPos];
+#ifndef TARGET_N64
+            // Lowpass before decimating instead, so that the reverb doesn't pick up aliases of everything above
+            // its new Nyquist frequency
+            if (gReverbDownsampleRate <= DECIMATE_MAX_FACTOR) {
+                srcPos = item->lengthA / 2 * gReverbDownsampleRate;
+                aDecimateImpl(&gSynthesisReverb.ringBuffer.left[item->startPos], item->toDownsampleLeft,
+                              item->lengthA / 2, gReverbDownsampleRate, sReverbDownsampleHistory[0]);
+                aDecimateImpl(&gSynthesisReverb.ringBuffer.right[item->startPos], item->toDownsampleRight,
+                              item->lengthA / 2, gReverbDownsampleRate, sReverbDownsampleHistory[1]);
+                aDecimateImpl(gSynthesisReverb.ringBuffer.left, &item->toDownsampleLeft[srcPos],
+                              item->lengthB / 2, gReverbDownsampleRate, sReverbDownsampleHistory[0]);
+                aDecimateImpl(gSynthesisReverb.ringBuffer.right, &item->toDownsampleRight[srcPos],
+                              item->lengthB / 2, gReverbDownsampleRate, sReverbDownsampleHistory[1]);
+            } else
+#endif
+            {
+                for (srcPos = 0, dstPos = 0; dstPos < item->lengthA / 2;
+                     srcPos += gReverbDownsampleRate, dstPos++) {
+                    gSynthesisReverb.ringBuffer.left[dstPos + item->startPos] = item->toDownsampleLeft[srcPos];
+                    gSynthesisReverb.ringBuffer.right[dstPos + item->startPos] = item->toDownsampleRight[srcPos];
+                }
+                for (dstPos = 0; dstPos < item->lengthB / 2; srcPos += gReverbDownsampleRate, dstPos++) {
+                    gSynthesisReverb.ringBuffer.left[dstPos] = item->toDownsampleLeft[srcPos];
+                    gSynthesisReverb.ringBuffer.right[dstPos] = item->toDownsampleRight[srcPos];
+                }
             }
         }
 #ifdef BETTER_REVERB
@@ -394,6 +423,7 @@ u64 *synthesis_execute(u64 *cmdBuf, s32 *writtenCmds, s16 *aiBuf, s32 bufLen) {
         cmd = synthesis_do_one_audio_update((s16 *) aiBufPtr, chunkLen * 2, cmd, gAudioUpdatesPerFrame - i);
 
         AUDIO_PROFILER_COMPLETE_AND_SWITCH(PROFILER_TIME_SUB_AUDIO_SYNTHESIS_ENVELOPE_REVERB, PROFILER_TIME_SUB_AUDIO_SYNTHESIS, PROFILER_TIME_SUB_AUDIO_UPDATE);
+        AUDIO_PROFILER_UPDATE_COMPLETED(gAudioUpdatesPerFrame - i);
 
         bufLen -= chunkLen;
         aiBufPtr += chunkLen;
@@ -447,9 +477,15 @@ u64 *synthesis_do_one_audio_update(s16 *aiBuf, u32 bufLen, u64 *cmd, s32 updateI
                 aSetLoadBufferPair(cmd++, ra, 0);
             }
             aSetBuffer(cmd++, 0, t4 + DMEM_ADDR_WET_LEFT_CH, DMEM_ADDR_LEFT_CH, bufLen);
+#ifdef TARGET_N64
             aResample(cmd++, gSynthesisReverb.resampleFlags, (u16) gSynthesisReverb.resampleRate, VIRTUAL_TO_PHYSICAL2(gSynthesisReverb.resampleStateLeft));
             aSetBuffer(cmd++, 0, t4 + DMEM_ADDR_WET_RIGHT_CH, DMEM_ADDR_RIGHT_CH, bufLen);
             aResample(cmd++, gSynthesisReverb.resampleFlags, (u16) gSynthesisReverb.resampleRate, VIRTUAL_TO_PHYSICAL2(gSynthesisReverb.resampleStateRight));
+#else
+            // Both channels in one pass; the right ones sit DEFAULT_LEN_1CH after the left ones on both sides
+            aResampleStereo(cmd++, gSynthesisReverb.resampleFlags, (u16) gSynthesisReverb.resampleRate, DEFAULT_LEN_1CH,
+                            gSynthesisReverb.resampleStateLeft, gSynthesisReverb.resampleStateRight);
+#endif
 #ifdef BETTER_REVERB
             // NOTE: Technically using an if/else here means using BETTER_REVERB vanilla presets with downsampling won't match 1-to-1 in volume with BETTER_REVERB being disabled.
             // This chunk is actually preferable to what vanilla uses, but was mainly ifdef'd here as a means of documenting BETTER_REVERB changes for other non-HackerSM64 repos.
@@ -776,6 +812,11 @@ u64 *synthesis_process_notes(s16 *aiBuf, u32 bufLen, u64 *cmd) {
 
             // final resample
             aSetBuffer(cmd++, /*flags*/ 0, noteSamplesDmemAddrBeforeResampling, /*dmemout*/ DMEM_ADDR_TEMP, bufLen);
+#ifndef TARGET_N64
+            if (gResamplerTaps != 0) {
+                aResampleHQ(cmd++, flags, resamplingRateFixedPoint, note->synthesisBuffers->finalResampleStateHQ);
+            } else
+#endif
             aResample(cmd++, flags, resamplingRateFixedPoint, VIRTUAL_TO_PHYSICAL2(note->synthesisBuffers->finalResampleState));
 
 #ifdef ENABLE_STEREO_HEADSET_EFFECTS
@@ -986,6 +1027,20 @@ u64 *note_apply_headset_pan_effects(u64 *cmd, struct Note *note, s32 bufLen, s32
             return cmd;
     }
 
+#ifndef TARGET_N64
+    // Same result as the commands below, in a single pass
+    if (flags == 1) {
+        pitch = 0;
+    } else if (prevPanShift == 0) {
+        pitch = (bufLen << 0xf) / (bufLen + panShift - prevPanShift + 8);
+    } else if (panShift == 0) {
+        pitch = (bufLen << 0xf) / (bufLen - prevPanShift - 4);
+    } else {
+        pitch = (bufLen << 0xf) / (bufLen + panShift - prevPanShift);
+    }
+    aHeadsetPan(cmd++, flags, pitch, DMEM_ADDR_NOTE_PAN_TEMP, DMEM_ADDR_TEMP, dest, bufLen, panShift, prevPanShift,
+                note->synthesisBuffers->panResampleState, note->synthesisBuffers->panSamplesBuffer);
+#else
     if (flags != 1) { // A_INIT?
         // Slightly adjust the sample rate in order to fit a change in pan shift
         if (prevPanShift == 0) {
@@ -1034,6 +1089,7 @@ u64 *note_apply_headset_pan_effects(u64 *cmd, struct Note *note, s32 bufLen, s32
 
     aSetBuffer(cmd++, 0, 0, 0, bufLen);
     aMix(cmd++, 0, /*gain*/ 0x7fff, /*in*/ DMEM_ADDR_NOTE_PAN_TEMP, /*out*/ dest);
+#endif
 
     return cmd;
 }
@@ -4,13 +4,16 @@
 #include "internal.h"
 
 #ifdef VERSION_SH
-#define DEFAULT_LEN_1CH FLOOR32((s32) (0x180 * FINAL_SAMPLE_RATE / 32000))
+#define DEFAULT_LEN_1CH FLOOR32((s32) (0x180 * MAX_AUDIO_SAMPLE_RATE / 32000))
 #else
-#define DEFAULT_LEN_1CH FLOOR32((s32) (0x140 * FINAL_SAMPLE_RATE / 32000))
+#define DEFAULT_LEN_1CH FLOOR32((s32) (0x140 * MAX_AUDIO_SAMPLE_RATE / 32000))
 #endif
 #define DEFAULT_LEN_2CH (2 * DEFAULT_LEN_1CH)
 
-#if defined(VERSION_EU) || defined(VERSION_SH)
+#if !defined(TARGET_N64) && (defined(VERSION_EU) || defined(VERSION_SH))
+// audio_reset_session() splits a 60 Hz frame (rounded up to 16 samples) into updates of at most 160, at any rate
+#define MAX_UPDATES_PER_FRAME ((MAX_AUDIO_SAMPLE_RATE / 60 + 15 + 0x10) / 160 + 1)
+#elif defined(VERSION_EU) || defined(VERSION_SH)
 #define MAX_UPDATES_PER_FRAME 5
 #else
 #define MAX_UPDATES_PER_FRAME 4
@@ -24,7 +27,7 @@ enum ChannelIndexes {
 
 #ifdef BETTER_REVERB
 
-#define REVERB_WINDOW_SIZE_MAX ALIGN16(0x2000 * FINAL_SAMPLE_RATE / 32000)
+#define REVERB_WINDOW_SIZE_MAX ALIGN16(0x2000 * MAX_AUDIO_SAMPLE_RATE / 32000)
 
 
 /* ------------ BETTER REVERB GENERAL PARAMETERS ------------ */
@@ -36,7 +39,7 @@ enum ChannelIndexes {
 // The default value can be increased or decreased in conjunction with the values in delaysL/R.
 // This can be significantly decreased if a downsample rate of 1 is not being used or if filter count is less than NUM_ALLPASS,
 // as this default is configured to handle the emulator RCVI settings.
-#define BETTER_REVERB_SIZE ALIGN16(0x80000ULL * FINAL_SAMPLE_RATE / 32000ULL + BETTER_REVERB_PTR_SIZE)
+#define BETTER_REVERB_SIZE ALIGN16(0x80000ULL * MAX_AUDIO_SAMPLE_RATE / 32000ULL + BETTER_REVERB_PTR_SIZE)
 
 
 /* ------ BETTER REVERB LIGHTWEIGHT PARAMETER OVERRIDES ------ */
@@ -81,9 +84,9 @@ STATIC_ASSERT(BETTER_REVERB_FILTER_COUNT_LIGHT <= NUM_ALLPASS, "BETTER_REVERB_FI
 #define BETTER_REVERB_SIZE 0
 
 #ifdef VERSION_EU
-#define REVERB_WINDOW_SIZE_MAX ALIGN16((s32) (0x1000 * FINAL_SAMPLE_RATE / 32000))
+#define REVERB_WINDOW_SIZE_MAX ALIGN16((s32) (0x1000 * MAX_AUDIO_SAMPLE_RATE / 32000))
 #else
-#define REVERB_WINDOW_SIZE_MAX ALIGN16((s32) (0x1000 * FINAL_SAMPLE_RATE / 32000))
+#define REVERB_WINDOW_SIZE_MAX ALIGN16((s32) (0x1000 * MAX_AUDIO_SAMPLE_RATE / 32000))
 #endif
 
 #endif
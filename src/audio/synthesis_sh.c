@@ -14,16 +14,16 @@
 #endif
 
 // TODO: Probably not safe...
-#define DMEM_ADDR_TEMP ALIGN16((s32) (0x0 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_RESAMPLED ALIGN16((s32) (0x20 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_RESAMPLED2 ALIGN16((s32) (0x1a0 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_UNCOMPRESSED_NOTE ALIGN16((s32) (0x1a0 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_NOTE_PAN_TEMP ALIGN16((s32) (0x200 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_COMPRESSED_ADPCM_DATA ALIGN16((s32) (0x540 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_LEFT_CH ALIGN16((s32) (0x540 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_RIGHT_CH ALIGN16((s32) (0x6c0 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_WET_LEFT_CH ALIGN16((s32) (0x840 * SAMPLE_RATE_DIFF))
-#define DMEM_ADDR_WET_RIGHT_CH ALIGN16((s32) (0x8c0 * SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_TEMP ALIGN16((s32) (0x0 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_RESAMPLED ALIGN16((s32) (0x20 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_RESAMPLED2 ALIGN16((s32) (0x1a0 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_UNCOMPRESSED_NOTE ALIGN16((s32) (0x1a0 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_NOTE_PAN_TEMP ALIGN16((s32) (0x200 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_COMPRESSED_ADPCM_DATA ALIGN16((s32) (0x540 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_LEFT_CH ALIGN16((s32) (0x540 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_RIGHT_CH ALIGN16((s32) (0x6c0 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_WET_LEFT_CH ALIGN16((s32) (0x840 * MAX_SAMPLE_RATE_DIFF))
+#define DMEM_ADDR_WET_RIGHT_CH ALIGN16((s32) (0x8c0 * MAX_SAMPLE_RATE_DIFF))
 
 #define aSetLoadBufferPair(pkt, c, off)                                                                \
     aSetBuffer(pkt, 0, c + DMEM_ADDR_WET_LEFT_CH, 0, DEFAULT_LEN_1CH - c);                             \
@@ -729,6 +729,11 @@ u64 *final_resample(u64 *cmd, struct NoteSynthesisState *synthesisState, s32 cou
         aClearBuffer(cmd++, DMEM_ADDR_TEMP, count);
     } else {
         aSetBuffer(cmd++, /*flags*/ 0, dmemIn, /*dmemout*/ DMEM_ADDR_TEMP, count);
+#ifndef TARGET_N64
+        if (gResamplerTaps != 0) {
+            aResampleHQ(cmd++, flags, pitch, synthesisState->synthesisBuffers->finalResampleStateHQ);
+        } else
+#endif
         aResample(cmd++, flags, pitch, VIRTUAL_TO_PHYSICAL2(synthesisState->synthesisBuffers->finalResampleState));
     }
     return cmd;
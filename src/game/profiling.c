@@ -29,8 +29,8 @@ u32 audio_buffer_index;
 u32 preempted_time;
 
 #ifdef AUDIO_PROFILING
-u32 audio_subset_starts[AUDIO_SUBSET_SIZE];
-u32 audio_subset_tallies[AUDIO_SUBSET_SIZE];
+AudioProfilerTime audio_subset_starts[AUDIO_SUBSET_SIZE];
+AudioProfilerTime audio_subset_tallies[AUDIO_SUBSET_SIZE];
 #endif
 
 static void buffer_update(ProfileTimeData* data, u32 new, int buffer_index) {
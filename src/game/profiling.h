@@ -10,10 +10,25 @@
  * Toggle this define to enable verbose audio profiling with Pupprprint Debug.
 */
 #define AUDIO_PROFILING
+#elif !defined(TARGET_N64) && defined(PC_AUDIO_PROFILER)
+/**
+ * PC only: time every audio update with the host's monotonic clock and write the results to
+ * audio_profile.json (Chrome trace format) and audio_profile.csv. Enabled with `make AUDIO_PROFILER=1`.
+ */
+#define AUDIO_PROFILING
 #endif
 
 #define OS_GET_COUNT_INLINE(x) asm volatile("mfc0 %0, $9" : "=r"(x): )
 
+#ifdef TARGET_N64
+typedef u32 AudioProfilerTime; // CPU count register ticks
+#define AUDIO_PROFILER_GET_TIME(x) OS_GET_COUNT_INLINE(x)
+#else
+typedef u64 AudioProfilerTime; // Nanoseconds
+u64 audio_profiler_get_time(void);
+#define AUDIO_PROFILER_GET_TIME(x) ((x) = audio_profiler_get_time())
+#endif
+
 #define PROFILING_BUFFER_SIZE 64
 
 #define AUDIO_SUBSET_ENTRIES \
@@ -87,20 +102,20 @@ static inline __attribute__((always_inline)) void profiler_rsp_yielded() {
 
 #ifdef AUDIO_PROFILING
 #define AUDIO_SUBSET_SIZE PROFILER_TIME_SUB_AUDIO_END - PROFILER_TIME_SUB_AUDIO_START
-extern u32 audio_subset_starts[AUDIO_SUBSET_SIZE];
-extern u32 audio_subset_tallies[AUDIO_SUBSET_SIZE];
+extern AudioProfilerTime audio_subset_starts[AUDIO_SUBSET_SIZE];
+extern AudioProfilerTime audio_subset_tallies[AUDIO_SUBSET_SIZE];
 
 static ALWAYS_INLINE void profiler_audio_subset_switch_func(enum ProfilerTime complete, enum ProfilerTime start) {
-    u32 time;
-    OS_GET_COUNT_INLINE(time);
+    AudioProfilerTime time;
+    AUDIO_PROFILER_GET_TIME(time);
 
     audio_subset_tallies[complete] += time - audio_subset_starts[complete];
     audio_subset_starts[start] = time;
 }
 
 static ALWAYS_INLINE void profiler_audio_subset_complete_and_switch_func(enum ProfilerTime complete1, enum ProfilerTime complete2, enum ProfilerTime start) {
-    u32 time;
-    OS_GET_COUNT_INLINE(time);
+    AudioProfilerTime time;
+    AUDIO_PROFILER_GET_TIME(time);
 
     audio_subset_tallies[complete1] += time - audio_subset_starts[complete1];
     audio_subset_tallies[complete2] += time - audio_subset_starts[complete2];
@@ -112,12 +127,12 @@ static ALWAYS_INLINE void profiler_audio_subset_start_shared_func(enum ProfilerT
 }
 
 static ALWAYS_INLINE void profiler_audio_subset_start_func(enum ProfilerTime index) {
-    OS_GET_COUNT_INLINE(audio_subset_starts[index]);
+    AUDIO_PROFILER_GET_TIME(audio_subset_starts[index]);
 }
 
 static ALWAYS_INLINE void profiler_audio_subset_complete_func(enum ProfilerTime index) {
-    u32 time;
-    OS_GET_COUNT_INLINE(time);
+    AudioProfilerTime time;
+    AUDIO_PROFILER_GET_TIME(time);
 
     audio_subset_tallies[index] += time - audio_subset_starts[index];
 }
@@ -130,6 +145,16 @@ static ALWAYS_INLINE void profiler_audio_subset_complete_func(enum ProfilerTime
 // These two are unused by the default audio profiler; left in for cases of manual profiling of smaller functions as needed
 #define AUDIO_PROFILER_START(which) profiler_audio_subset_start_func(which - PROFILER_TIME_SUB_AUDIO_START)
 #define AUDIO_PROFILER_COMPLETE(which) profiler_audio_subset_complete_func(which - PROFILER_TIME_SUB_AUDIO_START)
+
+#ifdef TARGET_N64
+#define AUDIO_PROFILER_UPDATE_COMPLETED(updateIndex)
+#else
+// Per-stage sums over every update since last cleared, and whether updates are also written to the trace files
+extern AudioProfilerTime audio_subset_totals[AUDIO_SUBSET_SIZE];
+extern u8 gAudioProfilerFileOutput;
+void audio_profiler_update_completed(s32 updateIndex);
+#define AUDIO_PROFILER_UPDATE_COMPLETED(updateIndex) audio_profiler_update_completed(updateIndex)
+#endif
 #else // AUDIO_PROFILING
 enum ProfilerTimeAudioUnused {
     AUDIO_SUBSET_ENTRIES
@@ -141,6 +166,7 @@ enum ProfilerTimeAudioUnused {
 // These two are unused by the default audio profiler; left in for cases of manual profiling of smaller functions as needed
 #define AUDIO_PROFILER_START(which)
 #define AUDIO_PROFILER_COMPLETE(which)
+#define AUDIO_PROFILER_UPDATE_COMPLETED(updateIndex)
 #endif // AUDIO_PROFILING
 
 #endif
@@ -26,6 +26,10 @@
 #include "sm64.h"
 #include "text_strings.h"
 
+#ifndef TARGET_N64
+#include "../pc/audio_prefetch.h"
+#endif
+
 #include "eu_translation.h"
 #ifdef VERSION_EU
 #undef LANGUAGE_FUNCTION
@@ -3167,6 +3171,10 @@ Gfx *geo_file_select_strings_and_menu_cursor(s32 callContext, UNUSED struct Grap
         print_menu_cursor();
     }
 
+#ifdef AUDIO_PREFETCH
+    audio_prefetch_update();
+#endif
+
     if (sAudioSwapTimer >= 0 && sAudioSwapTimer < 10) {
         sAudioSwapTimer++;
         if (sAudioSwapTimer == 10 || instAudioSwap) {
@@ -3175,6 +3183,10 @@ Gfx *geo_file_select_strings_and_menu_cursor(s32 callContext, UNUSED struct Grap
                 gBetterReverbPresetValue = BETTER_REVERB_SOUND_PLAYER_PRESET;
 #endif
                 set_background_music(0, seqNum, 0);
+#ifdef AUDIO_PREFETCH
+                // Have the tracks either side ready by the time the player steps to them
+                audio_prefetch_neighbors(seqNum);
+#endif
             }
             sAudioSwapTimer = -1;
         }
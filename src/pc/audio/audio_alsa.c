@@ -54,7 +54,7 @@ static bool audio_alsa_init(void) {
 	snd_pcm_hw_params_t *params;
 	snd_pcm_uframes_t frames;
 
-	rate 	 = FINAL_SAMPLE_RATE;
+	rate 	 = gAudioSampleRate;
 	channels = 2;
 
 	/* Open the PCM device in playback mode */
@@ -135,7 +135,7 @@ static int audio_alsa_buffered(void) {
 }
 
 static int audio_alsa_get_desired_buffered(void) {
-    return ceil(FINAL_SAMPLE_RATE / 60.0f);
+    return ceil(gAudioSampleRate / 60.0f);
 }
 
 static void audio_alsa_play(const uint8_t* buff, size_t len) {
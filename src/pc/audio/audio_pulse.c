@@ -79,7 +79,7 @@ static bool audio_pulse_init(void) {
     // Create stream
     pa_sample_spec ss;
     ss.format = PA_SAMPLE_S16LE;
-    ss.rate = FINAL_SAMPLE_RATE;
+    ss.rate = gAudioSampleRate;
     ss.channels = 2;
     
     pa_buffer_attr attr;
@@ -173,7 +173,7 @@ static int audio_pulse_buffered(void) {
 }
 
 static int audio_pulse_get_desired_buffered(void) {
-    return ceil(FINAL_SAMPLE_RATE / 60.0f);
+    return ceil(gAudioSampleRate / 60.0f);
 }
 
 static void audio_pulse_play(const uint8_t *buf, size_t len) {
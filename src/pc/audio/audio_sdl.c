@@ -19,7 +19,7 @@ static bool audio_sdl_init(void) {
     }
     SDL_AudioSpec want, have;
     SDL_zero(want);
-    want.freq = FINAL_SAMPLE_RATE;
+    want.freq = gAudioSampleRate;
     want.format = AUDIO_S16;
     want.channels = 2;
     want.samples = 512;
@@ -38,7 +38,7 @@ static int audio_sdl_buffered(void) {
 }
 
 static int audio_sdl_get_desired_buffered(void) {
-    return ceil(FINAL_SAMPLE_RATE / 60.0f);
+    return ceil(gAudioSampleRate / 60.0f);
 }
 
 static void audio_sdl_play(const uint8_t *buf, size_t len) {
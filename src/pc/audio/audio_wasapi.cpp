@@ -125,8 +125,8 @@ static bool audio_wasapi_setup_stream(void) {
         WAVEFORMATEX desired;
         desired.wFormatTag = WAVE_FORMAT_PCM;
         desired.nChannels = 2;
-        desired.nSamplesPerSec = FINAL_SAMPLE_RATE;
-        desired.nAvgBytesPerSec = FINAL_SAMPLE_RATE * 2 * 2;
+        desired.nSamplesPerSec = gAudioSampleRate;
+        desired.nAvgBytesPerSec = gAudioSampleRate * 2 * 2;
         desired.nBlockAlign = 4;
         desired.wBitsPerSample = 16;
         desired.cbSize = 0;
@@ -163,7 +163,7 @@ static int audio_wasapi_buffered(void) {
 }
 
 static int audio_wasapi_get_desired_buffered(void) {
-    return ceil(FINAL_SAMPLE_RATE / 60.0f);
+    return ceil(gAudioSampleRate / 60.0f);
 }
 
 //#include <stdio.h>
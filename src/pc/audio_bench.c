@@ -0,0 +1,358 @@
+// audio_bench.c - headless whole-soundtrack benchmark (--audio-bench SECONDS) and output hash check (--audio-hash SEQ)
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sm64.h"
+
+#include "audio/data.h"
+#include "audio/external.h"
+#include "audio/internal.h"
+#include "audio/load.h"
+#include "audio/seqplayer.h"
+#include "audio/synthesis.h"
+#include "game/profiling.h"
+
+#include "audio_bench.h"
+#include "audio_oversample.h"
+#include "mixer.h"
+
+#if defined(VERSION_JP)
+#define AUDIO_BENCH_VERSION "jp"
+#elif defined(VERSION_US)
+#define AUDIO_BENCH_VERSION "us"
+#elif defined(VERSION_EU)
+#define AUDIO_BENCH_VERSION "eu"
+#elif defined(VERSION_SH)
+#define AUDIO_BENCH_VERSION "sh"
+#else
+#define AUDIO_BENCH_VERSION "unknown"
+#endif
+
+#if defined(__SSE4_1__)
+#define AUDIO_BENCH_SIMD "sse4.1"
+#elif defined(__ARM_NEON)
+#define AUDIO_BENCH_SIMD "neon"
+#else
+#define AUDIO_BENCH_SIMD "none"
+#endif
+
+// produce_one_frame() renders two buffers per 30 Hz game frame
+#define AUDIO_BENCH_BUFFERS_PER_SECOND 60
+#define AUDIO_BENCH_SAMPLES_MAX ALIGN16(MAX_AUDIO_SAMPLE_RATE / 50)
+
+// Rendered after each sequence is stopped, so its released notes don't get billed to the next one
+#define AUDIO_BENCH_SETTLE_BUFFERS 30
+
+#define NS_TO_MS(x) ((double) (x) / 1000000.0)
+
+// Fixed gAudioRandom seed for --audio-hash, so anything that rolls the dice plays out the same every run
+#define AUDIO_HASH_SEED 0x2C8B5E17
+
+#define FNV64_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV64_PRIME        0x00000100000001B3ULL
+
+#ifdef AUDIO_PROFILING
+#define SUBSET(x) (PROFILER_TIME_SUB_AUDIO_##x - PROFILER_TIME_SUB_AUDIO_START)
+
+static const struct {
+    const char *name;
+    s32 subset;
+} sAudioBenchStages[] = {
+    { "sequences",        SUBSET(SEQUENCES)                 },
+    { "script",           SUBSET(SEQUENCES_SCRIPT)          },
+    { "reclaim",          SUBSET(SEQUENCES_RECLAIM)         },
+    { "seq_processing",   SUBSET(SEQUENCES_PROCESSING)      },
+    { "synthesis",        SUBSET(SYNTHESIS)                 },
+    { "note_processing",  SUBSET(SYNTHESIS_PROCESSING)      },
+    { "envelope_reverb",  SUBSET(SYNTHESIS_ENVELOPE_REVERB) },
+    { "dma",              SUBSET(SYNTHESIS_DMA)             },
+};
+#endif
+
+struct AudioBenchResult {
+    u64 wallTime;
+    u64 samples;
+    s32 peakVoices;
+#ifdef AUDIO_PROFILING
+    AudioProfilerTime stages[AUDIO_SUBSET_SIZE];
+#endif
+};
+
+extern s32 calculate_next_audio_buffer_size(void);
+
+static u64 audio_bench_get_time(void) {
+#if defined(_WIN32) || defined(_WIN64)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER count;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&count);
+    return (u64) ((count.QuadPart / frequency.QuadPart) * 1000000000ULL
+                  + (count.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64) ts.tv_sec * 1000000000ULL + (u64) ts.tv_nsec;
+#endif
+}
+
+static s32 audio_bench_count_voices(void) {
+    s32 count = 0;
+    s32 i;
+
+    for (i = 0; i < gMaxSimultaneousNotes; i++) {
+#if defined(VERSION_EU) || defined(VERSION_SH)
+        if (gNotes[i].noteSubEu.enabled) {
+#else
+        if (gNotes[i].enabled) {
+#endif
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Renders 'buffers' buffers the same way the game loop does. Returns the number of stereo samples rendered.
+ */
+static u64 audio_bench_render(s32 buffers, s32 *peakVoices) {
+    s16 buffer[AUDIO_BENCH_SAMPLES_MAX * 2];
+    u64 samples = 0;
+    s32 voices;
+    s32 i;
+
+    for (i = 0; i < buffers; i++) {
+        u32 numSamples = calculate_next_audio_buffer_size();
+
+        audio_oversample_render(buffer, numSamples);
+        samples += numSamples;
+
+        voices = audio_bench_count_voices();
+        if (peakVoices != NULL && voices > *peakVoices) {
+            *peakVoices = voices;
+        }
+    }
+    return samples;
+}
+
+static void audio_bench_print_result(FILE *file, const struct AudioBenchResult *result) {
+    double audioSeconds = (double) result->samples / gAudioSampleRate;
+    double wallSeconds = (double) result->wallTime / 1000000000.0;
+
+    fprintf(file, "\"audio_seconds\": %.3f, \"wall_ms\": %.3f, \"realtime_factor\": %.2f, \"peak_voices\": %d",
+            audioSeconds, NS_TO_MS(result->wallTime),
+            (wallSeconds > 0.0) ? audioSeconds / wallSeconds : 0.0, (int) result->peakVoices);
+#ifdef AUDIO_PROFILING
+    fprintf(file, ", \"stages_ms\": {");
+    for (u32 i = 0; i < ARRAY_COUNT(sAudioBenchStages); i++) {
+        fprintf(file, "%s\"%s\": %.3f", (i == 0) ? "" : ", ", sAudioBenchStages[i].name,
+                NS_TO_MS(result->stages[sAudioBenchStages[i].subset]));
+    }
+    fprintf(file, "}");
+#else
+    fprintf(file, ", \"stages_ms\": null");
+#endif
+}
+
+/**
+ * Plays every sequence on the level player for 'seconds' seconds of audio, without graphics or audio
+ * output, and writes the realtime factor, peak voice count and per-stage time (with AUDIO_PROFILER=1)
+ * of each sequence and of the whole run to outputPath as JSON. Expects audio_init() and sound_init()
+ * to have been called. Returns the process exit code.
+ */
+s32 audio_bench_run(s32 seconds, const char *outputPath) {
+    struct SequencePlayer *seqPlayer = &gSequencePlayers[SEQ_PLAYER_LEVEL];
+    struct AudioBenchResult total;
+    struct AudioBenchResult result;
+    s32 buffers = seconds * AUDIO_BENCH_BUFFERS_PER_SECOND;
+    FILE *file;
+    u64 start;
+    s32 seqId;
+#ifdef AUDIO_PROFILING
+    s32 i;
+#endif
+
+    file = fopen(outputPath, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Audio bench: could not open %s for writing\n", outputPath);
+        return 1;
+    }
+
+#ifdef AUDIO_PROFILING
+    gAudioProfilerFileOutput = FALSE;
+#endif
+    memset(&total, 0, sizeof(total));
+
+    fprintf(file, "{\n\"version\": \"%s\", \"sample_rate\": %d, \"max_simultaneous_notes\": %d, ",
+            AUDIO_BENCH_VERSION, (int) gAudioSampleRate, (int) gMaxSimultaneousNotes);
+#ifdef BETTER_REVERB
+    fprintf(file, "\"better_reverb_preset\": %d, ", (int) gBetterReverbPresetValue);
+#else
+    fprintf(file, "\"better_reverb_preset\": null, ");
+#endif
+    fprintf(file, "\"resampler_taps\": %d, \"oversample\": %d, \"simd\": \"%s\", \"seconds_per_sequence\": %d,\n\"sequences\": [",
+            gResamplerTaps, (int) gAudioOversample, AUDIO_BENCH_SIMD, (int) seconds);
+    printf("%4s %10s %10s %8s\n", "seq", "wall ms", "realtime", "voices");
+
+    for (seqId = 0; seqId < gSequenceCount; seqId++) {
+        memset(&result, 0, sizeof(result));
+
+        load_sequence(SEQ_PLAYER_LEVEL, seqId, FALSE);
+        if (!seqPlayer->enabled) {
+            fprintf(stderr, "Audio bench: sequence %d failed to load, skipping\n", (int) seqId);
+            continue;
+        }
+
+#ifdef AUDIO_PROFILING
+        memset(audio_subset_totals, 0, sizeof(audio_subset_totals));
+#endif
+        start = audio_bench_get_time();
+        result.samples = audio_bench_render(buffers, &result.peakVoices);
+        result.wallTime = audio_bench_get_time() - start;
+#ifdef AUDIO_PROFILING
+        memcpy(result.stages, audio_subset_totals, sizeof(result.stages));
+#endif
+
+        // Sequences that end early still count; they are simply cheaper for the rest of the run
+        fprintf(file, "%s\n  {\"id\": %d, \"finished\": %s, ", (total.samples == 0) ? "" : ",",
+                (int) seqId, seqPlayer->enabled ? "false" : "true");
+        audio_bench_print_result(file, &result);
+        fprintf(file, "}");
+        printf("%4d %10.3f %9.2fx %8d\n", (int) seqId, NS_TO_MS(result.wallTime),
+               ((double) result.samples / gAudioSampleRate) / ((double) result.wallTime / 1000000000.0),
+               (int) result.peakVoices);
+
+        total.wallTime += result.wallTime;
+        total.samples += result.samples;
+        if (result.peakVoices > total.peakVoices) {
+            total.peakVoices = result.peakVoices;
+        }
+#ifdef AUDIO_PROFILING
+        for (i = 0; i < AUDIO_SUBSET_SIZE; i++) {
+            total.stages[i] += result.stages[i];
+        }
+#endif
+
+        sequence_player_disable(seqPlayer);
+        audio_bench_render(AUDIO_BENCH_SETTLE_BUFFERS, NULL);
+    }
+
+    fprintf(file, "\n],\n\"aggregate\": {");
+    audio_bench_print_result(file, &total);
+    fprintf(file, "}\n}\n");
+    fclose(file);
+
+    printf("total %9.3f %9.2fx %8d -> %s\n", NS_TO_MS(total.wallTime),
+           (total.wallTime != 0) ? ((double) total.samples / gAudioSampleRate) / ((double) total.wallTime / 1000000000.0) : 0.0,
+           (int) total.peakVoices, outputPath);
+    return 0;
+}
+
+/**
+ * FNV-1a over the samples, continuing from 'hash' so that each value also covers everything before it.
+ */
+static u64 audio_hash_samples(u64 hash, const s16 *samples, u32 count) {
+    const u8 *bytes = (const u8 *) samples;
+    u32 i;
+
+    for (i = 0; i < count * sizeof(s16); i++) {
+        hash ^= bytes[i];
+        hash *= FNV64_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Plays sequence 'seqId' on the level player from a fixed gAudioRandom seed for 'frames' audio frames (calls to
+ * audio_oversample_render()), keeping a rolling hash of the output after each one. With 'record' set the hashes
+ * are written to goldenPath; otherwise they are compared against it and the first divergent frame is reported.
+ * Expects audio_init() and sound_init() to have been called. Returns the process exit code.
+ */
+s32 audio_hash_run(s32 seqId, s32 frames, const char *goldenPath, u8 record) {
+    s16 buffer[AUDIO_BENCH_SAMPLES_MAX * 2];
+    char header[128];
+    char line[128];
+    FILE *file;
+    u64 hash = FNV64_OFFSET_BASIS;
+    u64 expected;
+    s32 firstMismatch = -1;
+    s32 frame;
+    s32 goldenFrame;
+
+    if (seqId < 0 || seqId >= gSequenceCount || frames <= 0) {
+        fprintf(stderr, "Audio hash: need a sequence below %d and a positive frame count\n", (int) gSequenceCount);
+        return 2;
+    }
+
+    file = fopen(goldenPath, record ? "w" : "r");
+    if (file == NULL) {
+        fprintf(stderr, "Audio hash: could not open %s for %s\n", goldenPath, record ? "writing" : "reading");
+        return 2;
+    }
+
+    // Golden files are only comparable between runs with the same settings, so the header has to match
+    sprintf(header, "# audio hash v1 version=%s sample_rate=%d seq=%d frames=%d seed=0x%08X",
+            AUDIO_BENCH_VERSION, (int) gAudioSampleRate, (int) seqId, (int) frames, AUDIO_HASH_SEED);
+    // Only mentioned when enabled, so that goldens recorded with the default resampler stay valid
+    if (gResamplerTaps != 0) {
+        sprintf(header + strlen(header), " resampler_taps=%d", gResamplerTaps);
+    }
+    if (gAudioOversample > 1) {
+        sprintf(header + strlen(header), " oversample=%d", (int) gAudioOversample);
+    }
+    strcat(header, "\n");
+    if (record) {
+        fputs(header, file);
+    } else if (fgets(line, sizeof(line), file) == NULL || strcmp(line, header) != 0) {
+        fprintf(stderr, "Audio hash: %s was recorded with different settings:\n  expected %s", goldenPath, header);
+        fclose(file);
+        return 2;
+    }
+
+    gAudioFrameCount = 0;
+    gAudioRandom = AUDIO_HASH_SEED;
+    load_sequence(SEQ_PLAYER_LEVEL, seqId, FALSE);
+
+    for (frame = 0; frame < frames; frame++) {
+        u32 numSamples = calculate_next_audio_buffer_size();
+
+        audio_oversample_render(buffer, numSamples);
+        hash = audio_hash_samples(hash, buffer, numSamples * 2);
+
+        if (record) {
+            fprintf(file, "%d %016llX\n", (int) frame, (unsigned long long) hash);
+            continue;
+        }
+
+        if (fgets(line, sizeof(line), file) == NULL
+            || sscanf(line, "%d %llX", &goldenFrame, (unsigned long long *) &expected) != 2
+            || goldenFrame != frame || expected != hash) {
+            // Every later hash covers this frame too, so they can't say anything more
+            firstMismatch = frame;
+            break;
+        }
+    }
+    fclose(file);
+
+    if (record) {
+        printf("Audio hash: recorded %d frames of sequence %d to %s, final hash %016llX\n",
+               (int) frames, (int) seqId, goldenPath, (unsigned long long) hash);
+        return 0;
+    }
+    if (firstMismatch >= 0) {
+        printf("Audio hash: MISMATCH against %s, first at frame %d of %d\n",
+               goldenPath, (int) firstMismatch, (int) frames);
+        return 1;
+    }
+    printf("Audio hash: %d frames of sequence %d match %s\n", (int) frames, (int) seqId, goldenPath);
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef AUDIO_BENCH_H
+#define AUDIO_BENCH_H
+
+#include <PR/ultratypes.h>
+
+#define AUDIO_BENCH_DEFAULT_OUTPUT "audio_bench.json"
+#define AUDIO_HASH_DEFAULT_FRAMES 1800 // 30 seconds
+
+s32 audio_bench_run(s32 seconds, const char *outputPath);
+s32 audio_hash_run(s32 seqId, s32 frames, const char *goldenPath, u8 record);
+
+#endif // AUDIO_BENCH_H
@@ -0,0 +1,140 @@
+// audio_data_map.c - maps the sound data built by assemble_sound.py from files instead of linking it in
+#include "audio_data_map.h"
+
+#ifdef AUDIO_DATA_MAP
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#define AUDIO_DATA_READ
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Sample DMAs copy whole buffers and sequence and bank loads round their size up, so reads can run past
+// the end of a file. When linked in, whatever came next was read instead; here it's zero pages.
+#define AUDIO_DATA_TAIL 0x10000
+
+u8 *gSoundDataADSR;
+u8 *gSoundDataRaw;
+u8 *gMusicData;
+u8 *gBankSetsData;
+#ifdef VERSION_SH
+u8 *gShindouSoundBanksHeader;
+u8 *gShindouSampleBanksHeader;
+u8 *gShindouSequencesHeader;
+#endif
+
+static char sDir[1024] = AUDIO_DATA_DEFAULT_DIR;
+
+void audio_data_set_dir(const char *exePath, const char *dir) {
+    const char *slash;
+    const char *backslash;
+
+    if (dir != NULL) {
+        snprintf(sDir, sizeof(sDir), "%s", dir);
+        return;
+    }
+    if (exePath == NULL) {
+        return;
+    }
+    slash = strrchr(exePath, '/');
+    backslash = strrchr(exePath, '\\');
+    if (backslash != NULL && (slash == NULL || backslash > slash)) {
+        slash = backslash;
+    }
+    if (slash != NULL) {
+        snprintf(sDir, sizeof(sDir), "%.*s/%s", (int) (slash - exePath), exePath, AUDIO_DATA_DEFAULT_DIR);
+    }
+}
+
+#ifdef AUDIO_DATA_READ
+// No copy-on-write file mappings with zeroed pages after them here, so read the file into memory.
+static u8 *audio_data_map_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    long size;
+    u8 *data;
+
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = (size < 0) ? NULL : calloc(size + AUDIO_DATA_TAIL, 1);
+    if (data != NULL && fread(data, 1, size, file) != (size_t) size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+#else
+static u8 *audio_data_map_file(const char *path) {
+    struct stat st;
+    size_t length;
+    u8 *data;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    length = (size_t) st.st_size;
+
+    // Reserve room for the tail first, then put the file over the start of it. Private mappings are
+    // copy-on-write, so the data stays writable like the linked-in arrays were without touching the file.
+    data = mmap(NULL, length + AUDIO_DATA_TAIL, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    if (length > 0
+        && mmap(data, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(data, length + AUDIO_DATA_TAIL);
+        close(fd);
+        return NULL;
+    }
+    // The mapping keeps its own reference to the file
+    close(fd);
+    return data;
+}
+#endif
+
+static u8 *audio_data_map_named(const char *name) {
+    char path[sizeof(sDir) + 32];
+    u8 *data;
+
+    snprintf(path, sizeof(path), "%s/%s", sDir, name);
+    data = audio_data_map_file(path);
+    if (data == NULL) {
+        fprintf(stderr, "Sound data: could not load %s\n", path);
+        exit(1);
+    }
+    return data;
+}
+
+void audio_data_map(void) {
+    if (gSoundDataADSR != NULL) {
+        return;
+    }
+    gSoundDataADSR = audio_data_map_named("sound_data.ctl");
+    gSoundDataRaw = audio_data_map_named("sound_data.tbl");
+    gMusicData = audio_data_map_named("sequences.bin");
+    gBankSetsData = audio_data_map_named("bank_sets");
+#ifdef VERSION_SH
+    // The offsets into the files above come from these, so they have to be loaded from the same set
+    gShindouSoundBanksHeader = audio_data_map_named("ctl_header");
+    gShindouSampleBanksHeader = audio_data_map_named("tbl_header");
+    gShindouSequencesHeader = audio_data_map_named("sequences_header");
+#endif
+}
+#endif
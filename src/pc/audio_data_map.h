@@ -0,0 +1,37 @@
+#ifndef AUDIO_DATA_MAP_H
+#define AUDIO_DATA_MAP_H
+
+#include <PR/ultratypes.h>
+
+/**
+ * PC only: load sound_data.ctl, sound_data.tbl, sequences.bin and bank_sets (plus ctl_header, tbl_header and
+ * sequences_header on Shindou) from files at startup instead of linking them into the executable, so sound sets
+ * can be swapped without relinking. The files are memory-mapped, so sample data is only read from disk once it
+ * is played. Enabled with `make EXTERNAL_SOUND_DATA=1`; not available on the web target.
+ */
+#if !defined(TARGET_N64) && defined(PC_EXTERNAL_SOUND_DATA)
+#define AUDIO_DATA_MAP
+
+// Looked up next to the executable unless --sound-data says otherwise
+#define AUDIO_DATA_DEFAULT_DIR "sound"
+
+// Set in audio_data_map(), in place of the arrays sound/sound_data.s would link in
+extern u8 *gSoundDataADSR; // sound_data.ctl
+extern u8 *gSoundDataRaw;  // sound_data.tbl
+extern u8 *gMusicData;     // sequences.bin
+extern u8 *gBankSetsData;  // bank_sets
+#ifdef VERSION_SH
+// In place of the tables load_sh.c would compile in, which have to describe the files above
+extern u8 *gShindouSoundBanksHeader;  // ctl_header
+extern u8 *gShindouSampleBanksHeader; // tbl_header
+extern u8 *gShindouSequencesHeader;   // sequences_header
+#endif
+
+// Where audio_data_map() looks: 'dir' if given, otherwise AUDIO_DATA_DEFAULT_DIR in the directory of 'exePath'
+void audio_data_set_dir(const char *exePath, const char *dir);
+
+// Maps the files. Exits if one can't be mapped, as there would be nothing to play.
+void audio_data_map(void);
+#endif
+
+#endif // AUDIO_DATA_MAP_H
@@ -0,0 +1,410 @@
+// audio_loudness.c - loudness and true-peak meter for audio dumps (ITU-R BS.1770-4, EBU R128)
+//
+// Fed with the same interleaved stereo buffers that get written to the dump, so the levels are known as soon as
+// the dump is closed. Gating uses histograms with 0.01 LU bins, which keeps the memory fixed for dumps of any
+// length at the cost of up to 0.01 LU of error where a gate falls inside a bin.
+#include "audio_loudness.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define LOUDNESS_CHANNELS 2
+
+// Gating blocks advance in steps of 100 ms; momentary loudness spans 4 of them and short-term loudness 30
+#define LOUDNESS_STEPS_MOMENTARY  4
+#define LOUDNESS_STEPS_SHORT_TERM 30
+
+#define LOUDNESS_ABSOLUTE_GATE     -70.0
+#define LOUDNESS_RELATIVE_GATE     -10.0 // integrated loudness
+#define LOUDNESS_RANGE_GATE        -20.0 // loudness range
+#define LOUDNESS_HISTOGRAM_BINS    10000 // 0.01 LU steps from the absolute gate up to +30 LUFS
+#define LOUDNESS_HISTOGRAM_STEP    0.01
+
+// 48 tap interpolation filter for 4x oversampling, from BS.1770-4 Annex 2, split into its phases
+#define TRUE_PEAK_PHASES 4
+#define TRUE_PEAK_TAPS   12
+
+// Broadcast Wave Format extension chunk, version 2 (EBU Tech 3285)
+#define BEXT_FIXED_SIZE  602
+#define BEXT_VERSION     2
+#define BEXT_UNMEASURED  0x7FFF
+
+struct LoudnessBiquad {
+    f64 b0, b1, b2, a1, a2;
+};
+
+struct LoudnessHistogram {
+    u32 counts[LOUDNESS_HISTOGRAM_BINS];
+    f64 energies[LOUDNESS_HISTOGRAM_BINS];
+};
+
+static const f32 sTruePeakFilter[TRUE_PEAK_PHASES][TRUE_PEAK_TAPS] = {
+    {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+      -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+       0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+      -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+       0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+      -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+       0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+      -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+       0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+};
+
+static struct LoudnessBiquad sShelf;
+static struct LoudnessBiquad sHighPass;
+static f64 sShelfState[LOUDNESS_CHANNELS][2];
+static f64 sHighPassState[LOUDNESS_CHANNELS][2];
+
+static u32 sStepFrames;
+static u32 sStepFramesDone;
+static f64 sStepEnergy;
+static f64 sSteps[LOUDNESS_STEPS_SHORT_TERM];
+static u32 sStepCount;
+
+static struct LoudnessHistogram sBlockHistogram;
+static struct LoudnessHistogram sShortTermHistogram;
+static f64 sMomentaryMax;
+static f64 sShortTermMax;
+
+// Each channel's history is stored twice in a row, so the newest TRUE_PEAK_TAPS are always contiguous
+static f32 sTruePeakHistory[LOUDNESS_CHANNELS][TRUE_PEAK_TAPS * 2];
+static u32 sTruePeakPos;
+static f32 sTruePeakMax;
+static s32 sSamplePeakMax;
+
+static u64 sFrames;
+static s32 sSampleRate;
+
+static f64 energy_to_lufs(f64 energy) {
+    return (energy > 0.0) ? -0.691 + 10.0 * log10(energy) : -HUGE_VAL;
+}
+
+/**
+ * Both stages of the K-weighting filter, derived for any sample rate from the analog prototypes of the 48 kHz
+ * coefficients in BS.1770-4: a +4 dB high shelf around 1.7 kHz followed by a 38 Hz high pass.
+ */
+static void loudness_init_filters(s32 sampleRate) {
+    f64 k, q, a0, vh, vb;
+
+    k = tan(M_PI * 1681.974450955533 / sampleRate);
+    q = 0.7071752369554196;
+    vh = pow(10.0, 3.999843853973347 / 20.0);
+    vb = pow(vh, 0.4996667741545416);
+    a0 = 1.0 + k / q + k * k;
+    sShelf.b0 = (vh + vb * k / q + k * k) / a0;
+    sShelf.b1 = 2.0 * (k * k - vh) / a0;
+    sShelf.b2 = (vh - vb * k / q + k * k) / a0;
+    sShelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    sShelf.a2 = (1.0 - k / q + k * k) / a0;
+
+    k = tan(M_PI * 38.13547087602444 / sampleRate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    sHighPass.b0 = 1.0;
+    sHighPass.b1 = -2.0;
+    sHighPass.b2 = 1.0;
+    sHighPass.a1 = 2.0 * (k * k - 1.0) / a0;
+    sHighPass.a2 = (1.0 - k / q + k * k) / a0;
+}
+
+// Transposed direct form II
+static f64 loudness_biquad(const struct LoudnessBiquad *filter, f64 *state, f64 x) {
+    f64 y = filter->b0 * x + state[0];
+
+    state[0] = filter->b1 * x - filter->a1 * y + state[1];
+    state[1] = filter->b2 * x - filter->a2 * y;
+    return y;
+}
+
+static void loudness_histogram_add(struct LoudnessHistogram *histogram, f64 energy) {
+    f64 lufs = energy_to_lufs(energy);
+    s32 bin;
+
+    if (lufs < LOUDNESS_ABSOLUTE_GATE) {
+        return;
+    }
+
+    bin = (s32) ((lufs - LOUDNESS_ABSOLUTE_GATE) / LOUDNESS_HISTOGRAM_STEP);
+    if (bin >= LOUDNESS_HISTOGRAM_BINS) {
+        bin = LOUDNESS_HISTOGRAM_BINS - 1;
+    }
+    histogram->counts[bin]++;
+    histogram->energies[bin] += energy;
+}
+
+// First bin at or above the given loudness
+static s32 loudness_histogram_bin(f64 lufs) {
+    f64 bin = ceil((lufs - LOUDNESS_ABSOLUTE_GATE) / LOUDNESS_HISTOGRAM_STEP);
+
+    return (bin < 0.0) ? 0 : (bin > LOUDNESS_HISTOGRAM_BINS) ? LOUDNESS_HISTOGRAM_BINS : (s32) bin;
+}
+
+/**
+ * Mean energy of the blocks in bins from 'first' on, as loudness. Sets count to the number of those blocks.
+ */
+static f64 loudness_histogram_mean(const struct LoudnessHistogram *histogram, s32 first, u64 *count) {
+    f64 energy = 0.0;
+    s32 i;
+
+    *count = 0;
+    for (i = first; i < LOUDNESS_HISTOGRAM_BINS; i++) {
+        *count += histogram->counts[i];
+        energy += histogram->energies[i];
+    }
+    return (*count != 0) ? energy_to_lufs(energy / *count) : LOUDNESS_UNMEASURED;
+}
+
+static void loudness_end_step(void) {
+    f64 energy;
+    u32 i;
+
+    sSteps[sStepCount % LOUDNESS_STEPS_SHORT_TERM] = sStepEnergy / sStepFramesDone;
+    sStepCount++;
+    sStepEnergy = 0.0;
+    sStepFramesDone = 0;
+
+    if (sStepCount >= LOUDNESS_STEPS_MOMENTARY) {
+        energy = 0.0;
+        for (i = sStepCount - LOUDNESS_STEPS_MOMENTARY; i < sStepCount; i++) {
+            energy += sSteps[i % LOUDNESS_STEPS_SHORT_TERM];
+        }
+        energy /= LOUDNESS_STEPS_MOMENTARY;
+        loudness_histogram_add(&sBlockHistogram, energy);
+        if (energy_to_lufs(energy) > sMomentaryMax) {
+            sMomentaryMax = energy_to_lufs(energy);
+        }
+    }
+
+    if (sStepCount >= LOUDNESS_STEPS_SHORT_TERM) {
+        energy = 0.0;
+        for (i = 0; i < LOUDNESS_STEPS_SHORT_TERM; i++) {
+            energy += sSteps[i];
+        }
+        energy /= LOUDNESS_STEPS_SHORT_TERM;
+        loudness_histogram_add(&sShortTermHistogram, energy);
+        if (energy_to_lufs(energy) > sShortTermMax) {
+            sShortTermMax = energy_to_lufs(energy);
+        }
+    }
+}
+
+static void loudness_true_peak(s32 channel, f32 sample) {
+    f32 *history = sTruePeakHistory[channel];
+    const f32 *newest;
+    f32 acc;
+    s32 phase, k;
+
+    history[sTruePeakPos] = sample;
+    history[sTruePeakPos + TRUE_PEAK_TAPS] = sample;
+    newest = &history[sTruePeakPos + TRUE_PEAK_TAPS];
+
+    for (phase = 0; phase < TRUE_PEAK_PHASES; phase++) {
+        acc = 0.0f;
+        for (k = 0; k < TRUE_PEAK_TAPS; k++) {
+            acc += sTruePeakFilter[phase][k] * newest[-k];
+        }
+        acc = fabsf(acc);
+        if (acc > sTruePeakMax) {
+            sTruePeakMax = acc;
+        }
+    }
+}
+
+/**
+ * Starts a new measurement for audio at the given rate.
+ */
+void audio_loudness_init(s32 sampleRate) {
+    sSampleRate = sampleRate;
+    loudness_init_filters(sampleRate);
+    memset(sShelfState, 0, sizeof(sShelfState));
+    memset(sHighPassState, 0, sizeof(sHighPassState));
+
+    sStepFrames = (sampleRate + 5) / 10;
+    sStepFramesDone = 0;
+    sStepEnergy = 0.0;
+    sStepCount = 0;
+    memset(&sBlockHistogram, 0, sizeof(sBlockHistogram));
+    memset(&sShortTermHistogram, 0, sizeof(sShortTermHistogram));
+    sMomentaryMax = -HUGE_VAL;
+    sShortTermMax = -HUGE_VAL;
+
+    memset(sTruePeakHistory, 0, sizeof(sTruePeakHistory));
+    sTruePeakPos = 0;
+    sTruePeakMax = 0.0f;
+    sSamplePeakMax = 0;
+    sFrames = 0;
+}
+
+/**
+ * Measures numFrames frames of interleaved stereo.
+ */
+void audio_loudness_feed(const s16 *samples, u32 numFrames) {
+    f64 x, y;
+    u32 i;
+    s32 c;
+
+    for (i = 0; i < numFrames; i++) {
+        sTruePeakPos = (sTruePeakPos + 1) % TRUE_PEAK_TAPS;
+        for (c = 0; c < LOUDNESS_CHANNELS; c++) {
+            if (abs(samples[c]) > sSamplePeakMax) {
+                sSamplePeakMax = abs(samples[c]);
+            }
+            x = samples[c] / 32768.0;
+            loudness_true_peak(c, (f32) x);
+
+            y = loudness_biquad(&sShelf, sShelfState[c], x);
+            y = loudness_biquad(&sHighPass, sHighPassState[c], y);
+            sStepEnergy += y * y;
+        }
+        samples += LOUDNESS_CHANNELS;
+
+        if (++sStepFramesDone == sStepFrames) {
+            loudness_end_step();
+        }
+    }
+    sFrames += numFrames;
+}
+
+void audio_loudness_get_result(struct LoudnessResult *result) {
+    f64 threshold, lufs;
+    u64 count, seen, low, high;
+    s32 i;
+
+    // Integrated: absolute gate, then relative to the loudness of what passed it
+    threshold = loudness_histogram_mean(&sBlockHistogram, 0, &count);
+    if (count != 0) {
+        threshold += LOUDNESS_RELATIVE_GATE;
+        result->integrated = loudness_histogram_mean(&sBlockHistogram, loudness_histogram_bin(threshold), &count);
+    } else {
+        result->integrated = LOUDNESS_UNMEASURED;
+    }
+
+    // Range: the spread between the 10th and 95th percentile of the gated short-term loudness
+    result->range = LOUDNESS_UNMEASURED;
+    threshold = loudness_histogram_mean(&sShortTermHistogram, 0, &count);
+    if (count != 0) {
+        threshold = loudness_histogram_bin(threshold + LOUDNESS_RANGE_GATE);
+        loudness_histogram_mean(&sShortTermHistogram, (s32) threshold, &count);
+        low = (u64) (count * 0.10);
+        high = (u64) (count * 0.95);
+        seen = 0;
+        lufs = LOUDNESS_UNMEASURED;
+        for (i = (s32) threshold; i < LOUDNESS_HISTOGRAM_BINS && count != 0; i++) {
+            if (seen <= low && seen + sShortTermHistogram.counts[i] > low) {
+                lufs = LOUDNESS_ABSOLUTE_GATE + (i + 0.5) * LOUDNESS_HISTOGRAM_STEP;
+            }
+            if (seen <= high && seen + sShortTermHistogram.counts[i] > high) {
+                result->range = LOUDNESS_ABSOLUTE_GATE + (i + 0.5) * LOUDNESS_HISTOGRAM_STEP - lufs;
+                break;
+            }
+            seen += sShortTermHistogram.counts[i];
+        }
+    }
+
+    result->momentaryMax = (sMomentaryMax > LOUDNESS_UNMEASURED) ? sMomentaryMax : LOUDNESS_UNMEASURED;
+    result->shortTermMax = (sShortTermMax > LOUDNESS_UNMEASURED) ? sShortTermMax : LOUDNESS_UNMEASURED;
+    result->truePeak = (sTruePeakMax > 0.0f) ? 20.0 * log10(sTruePeakMax) : LOUDNESS_UNMEASURED;
+    result->samplePeak = (sSamplePeakMax > 0) ? 20.0 * log10(sSamplePeakMax / 32768.0) : LOUDNESS_UNMEASURED;
+    result->frames = sFrames;
+    result->sampleRate = sSampleRate;
+}
+
+static void write_le16(u8 *dest, s32 value) {
+    dest[0] = value & 0xFF;
+    dest[1] = (value >> 8) & 0xFF;
+}
+
+static s32 bext_loudness(f64 value) {
+    return (value > LOUDNESS_UNMEASURED) ? (s32) floor(value * 100.0 + 0.5) : BEXT_UNMEASURED;
+}
+
+/**
+ * Appends a bext chunk carrying the loudness fields at the current position of a RIFF WAVE file. The caller
+ * updates the RIFF size.
+ */
+void audio_loudness_write_bext(FILE *file, const struct LoudnessResult *result) {
+    u8 chunk[8 + BEXT_FIXED_SIZE + 64];
+    char history[64];
+    time_t now = time(NULL);
+    struct tm *local = localtime(&now);
+    u32 size;
+    s32 historyLen;
+
+    historyLen = sprintf(history, "A=PCM,F=%d,W=16,M=stereo,T=sm64\r\n", (int) result->sampleRate);
+    size = BEXT_FIXED_SIZE + ((historyLen + 1) & ~1);
+
+    memset(chunk, 0, sizeof(chunk));
+    memcpy(chunk, "bext", 4);
+    chunk[4] = size & 0xFF;
+    chunk[5] = (size >> 8) & 0xFF;
+    chunk[6] = (size >> 16) & 0xFF;
+    chunk[7] = (size >> 24) & 0xFF;
+
+    strcpy((char *) &chunk[8], "Super Mario 64 audio dump");       // Description
+    strcpy((char *) &chunk[8 + 256], "sm64");                      // Originator
+    if (local != NULL) {
+        strftime((char *) &chunk[8 + 320], 11, "%Y-%m-%d", local); // OriginationDate
+        strftime((char *) &chunk[8 + 330], 9, "%H:%M:%S", local);  // OriginationTime
+    }
+    write_le16(&chunk[8 + 346], BEXT_VERSION);
+    write_le16(&chunk[8 + 412], bext_loudness(result->integrated));
+    write_le16(&chunk[8 + 414], bext_loudness(result->range));
+    write_le16(&chunk[8 + 416], bext_loudness(result->truePeak));
+    write_le16(&chunk[8 + 418], bext_loudness(result->momentaryMax));
+    write_le16(&chunk[8 + 420], bext_loudness(result->shortTermMax));
+    memcpy(&chunk[8 + BEXT_FIXED_SIZE], history, historyLen);
+
+    fwrite(chunk, 1, 8 + size, file);
+}
+
+static void write_json_value(FILE *file, const char *name, f64 value, u8 last) {
+    if (value > LOUDNESS_UNMEASURED) {
+        fprintf(file, "  \"%s\": %.2f%s\n", name, value, last ? "" : ",");
+    } else {
+        fprintf(file, "  \"%s\": null%s\n", name, last ? "" : ",");
+    }
+}
+
+/**
+ * Writes the results to a JSON file next to the dump, named after it: dump_1.wav gets dump_1.loudness.json.
+ */
+void audio_loudness_write_sidecar(const char *wavPath, const struct LoudnessResult *result) {
+    char path[256];
+    const char *ext = strrchr(wavPath, '.');
+    size_t stemLen = (ext != NULL) ? (size_t) (ext - wavPath) : strlen(wavPath);
+    FILE *file;
+
+    if (stemLen > sizeof(path) - sizeof(".loudness.json")) {
+        return;
+    }
+    memcpy(path, wavPath, stemLen);
+    strcpy(path + stemLen, ".loudness.json");
+
+    file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Audio dump: could not open %s for writing\n", path);
+        return;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"file\": \"%s\",\n", wavPath);
+    fprintf(file, "  \"sample_rate\": %d,\n", (int) result->sampleRate);
+    fprintf(file, "  \"duration_s\": %.3f,\n", (double) result->frames / result->sampleRate);
+    write_json_value(file, "integrated_lufs", result->integrated, FALSE);
+    write_json_value(file, "loudness_range_lu", result->range, FALSE);
+    write_json_value(file, "momentary_max_lufs", result->momentaryMax, FALSE);
+    write_json_value(file, "short_term_max_lufs", result->shortTermMax, FALSE);
+    write_json_value(file, "true_peak_dbtp", result->truePeak, FALSE);
+    write_json_value(file, "sample_peak_dbfs", result->samplePeak, TRUE);
+    fprintf(file, "}\n");
+    fclose(file);
+}
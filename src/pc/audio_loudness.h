@@ -0,0 +1,28 @@
+#ifndef AUDIO_LOUDNESS_H
+#define AUDIO_LOUDNESS_H
+
+#include <stdio.h>
+
+#include <PR/ultratypes.h>
+
+// Stands in for loudness values that couldn't be measured, e.g. a dump that is silent or under 400 ms long
+#define LOUDNESS_UNMEASURED -1000.0
+
+struct LoudnessResult {
+    f64 integrated;     // LUFS, gated over the whole dump (ITU-R BS.1770-4)
+    f64 range;          // LU (EBU Tech 3342)
+    f64 momentaryMax;   // LUFS, 400 ms windows
+    f64 shortTermMax;   // LUFS, 3 s windows
+    f64 truePeak;       // dBTP, 4x oversampled
+    f64 samplePeak;     // dBFS
+    u64 frames;
+    s32 sampleRate;
+};
+
+void audio_loudness_init(s32 sampleRate);
+void audio_loudness_feed(const s16 *samples, u32 numFrames);
+void audio_loudness_get_result(struct LoudnessResult *result);
+void audio_loudness_write_bext(FILE *file, const struct LoudnessResult *result);
+void audio_loudness_write_sidecar(const char *wavPath, const struct LoudnessResult *result);
+
+#endif // AUDIO_LOUDNESS_H
@@ -0,0 +1,40 @@
+// audio_oversample.c - runs the audio engine at a multiple of the output rate and decimates its output back down
+#include "audio_oversample.h"
+
+#include "macros.h"
+#include "audio/internal.h"
+#include "mixer.h"
+
+STATIC_ASSERT(AUDIO_OVERSAMPLE_MAX <= DECIMATE_MAX_FACTOR, "the decimator must support every oversampling factor");
+
+// Output buffers hold at most a 50 Hz frame at MAX_AUDIO_SAMPLE_RATE / gAudioOversample. Rounding that frame up
+// to 16 samples can add up to 15 per factor once it is multiplied back up.
+#define OVERSAMPLE_FRAMES_MAX (ALIGN16(MAX_AUDIO_SAMPLE_RATE / 50) + 16 * AUDIO_OVERSAMPLE_MAX)
+
+extern void create_next_audio_buffer(s16 *samples, u32 num_samples);
+
+#if AUDIO_OVERSAMPLE_MAX > 1
+static s16 sOversampleBuffer[OVERSAMPLE_FRAMES_MAX * 2];
+static DECIMATE_STATE sDecimateState;
+#endif
+
+/**
+ * Drop-in for create_next_audio_buffer(). With gAudioOversample above 1 the engine renders that many times
+ * num_samples, so notes get resampled, enveloped and reverbed at the higher rate, and anything they put above
+ * the output Nyquist frequency is filtered out instead of folding back down. audio_init() keeps the output rate
+ * low enough for num_samples times the factor to always fit, so every factor up to AUDIO_OVERSAMPLE_MAX goes
+ * through the decimator.
+ */
+void audio_oversample_render(s16 *samples, u32 num_samples) {
+#if AUDIO_OVERSAMPLE_MAX > 1
+    if (gAudioOversample <= 1 || num_samples * gAudioOversample > OVERSAMPLE_FRAMES_MAX) {
+        create_next_audio_buffer(samples, num_samples);
+        return;
+    }
+
+    create_next_audio_buffer(sOversampleBuffer, num_samples * gAudioOversample);
+    aDecimateStereoImpl(samples, sOversampleBuffer, num_samples, gAudioOversample, sDecimateState);
+#else
+    create_next_audio_buffer(samples, num_samples);
+#endif
+}
@@ -0,0 +1,8 @@
+#ifndef AUDIO_OVERSAMPLE_H
+#define AUDIO_OVERSAMPLE_H
+
+#include <PR/ultratypes.h>
+
+void audio_oversample_render(s16 *samples, u32 num_samples);
+
+#endif // AUDIO_OVERSAMPLE_H
@@ -0,0 +1,215 @@
+// audio_prefetch.c - loads the sequence data and banks of the neighboring sound test tracks on a worker thread
+#include "audio_prefetch.h"
+
+#ifdef AUDIO_PREFETCH
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sm64.h"
+#include "seq_ids.h"
+
+#include "audio/internal.h"
+#include "audio/load.h"
+
+#define AUDIO_PREFETCH_MAX_JOBS 16
+
+enum AudioPrefetchJobState {
+    PREFETCH_JOB_FREE,
+    PREFETCH_JOB_QUEUED,
+    PREFETCH_JOB_RUNNING,
+    PREFETCH_JOB_DONE,
+};
+
+struct AudioPrefetchJob {
+    u8 state;
+    u8 isBank;
+    s32 id;
+    u8 *data;
+    u32 size;
+    u32 numInstruments;
+    u32 numDrums;
+};
+
+static struct AudioPrefetchJob sPrefetchJobs[AUDIO_PREFETCH_MAX_JOBS];
+static pthread_mutex_t sPrefetchMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sPrefetchCond = PTHREAD_COND_INITIALIZER;
+static pthread_t sPrefetchThread;
+static u8 sPrefetchThreadStarted = FALSE;
+
+/**
+ * Worker side of a job. Only touches the job itself and the read-only sound data, so it runs without the
+ * lock. Mirrors the sizes and layout used by bank_load_immediate and sequence_dma_immediate.
+ */
+static void audio_prefetch_load(struct AudioPrefetchJob *job) {
+    u32 header[4];
+    u8 *ctlData;
+
+    if (job->isBank) {
+        ctlData = gAlCtlHeader->seqArray[job->id].offset;
+        job->size = ALIGN16(gAlCtlHeader->seqArray[job->id].len + 0xf) - 0x10;
+        job->data = malloc(job->size);
+        if (job->data == NULL) {
+            return;
+        }
+
+        memcpy(header, ctlData, sizeof(header));
+        job->numInstruments = header[0];
+        job->numDrums = header[1];
+        memcpy(job->data, ctlData + 0x10, job->size);
+#ifndef VERSION_EU
+        // EU's patch_sound may allocate from the audio heap, so there the patching waits for the main thread
+        patch_audio_bank((struct AudioBank *) job->data, gAlTbl->seqArray[job->id].offset,
+                         job->numInstruments, job->numDrums);
+#endif
+    } else {
+        job->size = ALIGN16(gSeqFileHeader->seqArray[job->id].len + 0xf);
+        job->data = malloc(job->size);
+        if (job->data == NULL) {
+            return;
+        }
+
+        memcpy(job->data, gSeqFileHeader->seqArray[job->id].offset, job->size);
+    }
+}
+
+static void *audio_prefetch_thread(UNUSED void *arg) {
+    struct AudioPrefetchJob *job;
+    s32 i;
+
+    pthread_mutex_lock(&sPrefetchMutex);
+    while (TRUE) {
+        job = NULL;
+        for (i = 0; i < AUDIO_PREFETCH_MAX_JOBS; i++) {
+            if (sPrefetchJobs[i].state == PREFETCH_JOB_QUEUED) {
+                job = &sPrefetchJobs[i];
+                break;
+            }
+        }
+
+        if (job == NULL) {
+            pthread_cond_wait(&sPrefetchCond, &sPrefetchMutex);
+            continue;
+        }
+
+        job->state = PREFETCH_JOB_RUNNING;
+        pthread_mutex_unlock(&sPrefetchMutex);
+        audio_prefetch_load(job);
+        pthread_mutex_lock(&sPrefetchMutex);
+        job->state = PREFETCH_JOB_DONE;
+    }
+
+    return NULL;
+}
+
+// Called with the lock held
+static void audio_prefetch_queue(u8 isBank, s32 id) {
+    struct AudioPrefetchJob *freeJob = NULL;
+    s32 i;
+
+    if (isBank ? (id >= (s32) ARRAY_COUNT(gBankLoadStatus) || gBankLoadStatus[id] != SOUND_LOAD_STATUS_NOT_LOADED)
+               : (id >= gSequenceCount || gSeqLoadStatus[id] != SOUND_LOAD_STATUS_NOT_LOADED)) {
+        return;
+    }
+
+    for (i = 0; i < AUDIO_PREFETCH_MAX_JOBS; i++) {
+        if (sPrefetchJobs[i].state == PREFETCH_JOB_FREE) {
+            if (freeJob == NULL) {
+                freeJob = &sPrefetchJobs[i];
+            }
+        } else if (sPrefetchJobs[i].isBank == isBank && sPrefetchJobs[i].id == id) {
+            return;
+        }
+    }
+
+    if (freeJob != NULL) {
+        freeJob->isBank = isBank;
+        freeJob->id = id;
+        freeJob->data = NULL;
+        freeJob->state = PREFETCH_JOB_QUEUED;
+    }
+}
+
+/**
+ * Queues the sequences next to seqId in the sound test, along with every bank they use that isn't loaded yet.
+ */
+void audio_prefetch_neighbors(s32 seqId) {
+    s32 neighbor;
+    s32 dir;
+    u16 offset;
+    u8 i;
+
+    if (gAudioCacheBudget == 0 || gSequenceCount <= 1) {
+        return;
+    }
+
+    if (!sPrefetchThreadStarted) {
+        if (pthread_create(&sPrefetchThread, NULL, audio_prefetch_thread, NULL) != 0) {
+            return;
+        }
+        sPrefetchThreadStarted = TRUE;
+    }
+
+    audio_prefetch_update();
+
+    pthread_mutex_lock(&sPrefetchMutex);
+    for (dir = -1; dir <= 1; dir += 2) {
+        neighbor = (seqId + dir + gSequenceCount) % gSequenceCount;
+        // The sound player is always loaded, and stands for "none" in the sound test
+        if (neighbor == SEQ_SOUND_PLAYER) {
+            continue;
+        }
+
+        audio_prefetch_queue(FALSE, neighbor);
+
+        // Same walk over the bank set as get_missing_bank
+        offset = ((u16 *) gAlBankSets)[neighbor];
+        for (i = gAlBankSets[offset++]; i != 0; i--) {
+            audio_prefetch_queue(TRUE, gAlBankSets[offset++]);
+        }
+    }
+    pthread_cond_signal(&sPrefetchCond);
+    pthread_mutex_unlock(&sPrefetchMutex);
+}
+
+/**
+ * Hands finished jobs over to the bank and sequence cache. Must be called from the thread that runs the audio
+ * engine. Anything that got loaded the regular way in the meantime is dropped.
+ */
+void audio_prefetch_update(void) {
+    struct AudioPrefetchJob *job;
+    struct AudioBank *bank;
+    s32 i;
+
+    if (!sPrefetchThreadStarted) {
+        return;
+    }
+
+    pthread_mutex_lock(&sPrefetchMutex);
+    for (i = 0; i < AUDIO_PREFETCH_MAX_JOBS; i++) {
+        job = &sPrefetchJobs[i];
+        if (job->state != PREFETCH_JOB_DONE) {
+            continue;
+        }
+
+        if (job->data != NULL) {
+            if (!audio_cache_insert(job->isBank ? &gBankLoadedPool : &gSeqLoadedPool, job->id, job->data, job->size)) {
+                free(job->data);
+            } else if (job->isBank) {
+                bank = (struct AudioBank *) job->data;
+#ifdef VERSION_EU
+                patch_audio_bank(bank, gAlTbl->seqArray[job->id].offset, job->numInstruments, job->numDrums);
+#endif
+                gCtlEntries[job->id].numInstruments = (u8) job->numInstruments;
+                gCtlEntries[job->id].numDrums = (u8) job->numDrums;
+                gCtlEntries[job->id].instruments = bank->instruments;
+                gCtlEntries[job->id].drums = bank->drums;
+            }
+        }
+
+        job->data = NULL;
+        job->state = PREFETCH_JOB_FREE;
+    }
+    pthread_mutex_unlock(&sPrefetchMutex);
+}
+#endif
@@ -0,0 +1,16 @@
+#ifndef AUDIO_PREFETCH_H
+#define AUDIO_PREFETCH_H
+
+#include <PR/ultratypes.h>
+
+#include "audio/heap.h"
+
+// Prefetched data is handed over to the resident bank cache, so this needs it (and threads)
+#if defined(AUDIO_LRU_CACHE) && !defined(TARGET_WEB)
+#define AUDIO_PREFETCH
+
+void audio_prefetch_neighbors(s32 seqId);
+void audio_prefetch_update(void);
+#endif
+
+#endif // AUDIO_PREFETCH_H
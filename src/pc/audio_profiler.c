@@ -0,0 +1,144 @@
+// audio_profiler.c - PC backend for the AUDIO_PROFILER_* hooks in the audio driver
+#include "game/profiling.h"
+
+#ifdef AUDIO_PROFILING
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "audio/data.h"
+
+#define AUDIO_PROFILE_TRACE_FILE "audio_profile.json"
+#define AUDIO_PROFILE_CSV_FILE   "audio_profile.csv"
+
+#define SUBSET(x) (PROFILER_TIME_SUB_AUDIO_##x - PROFILER_TIME_SUB_AUDIO_START)
+#define NS_TO_US(x) ((double) (x) / 1000.0)
+
+AudioProfilerTime audio_subset_starts[AUDIO_SUBSET_SIZE];
+AudioProfilerTime audio_subset_tallies[AUDIO_SUBSET_SIZE];
+AudioProfilerTime audio_subset_totals[AUDIO_SUBSET_SIZE];
+u8 gAudioProfilerFileOutput = TRUE;
+
+static FILE *sTraceFile = NULL;
+static FILE *sCsvFile = NULL;
+static u8 sProfilerFailed = FALSE;
+static u64 sProfilerEpoch;
+
+u64 audio_profiler_get_time(void) {
+#if defined(_WIN32) || defined(_WIN64)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER count;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&count);
+    return (u64) ((count.QuadPart / frequency.QuadPart) * 1000000000ULL
+                  + (count.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64) ts.tv_sec * 1000000000ULL + (u64) ts.tv_nsec;
+#endif
+}
+
+static void audio_profiler_close(void) {
+    if (sTraceFile != NULL) {
+        fprintf(sTraceFile, "\n]}\n");
+        fclose(sTraceFile);
+        sTraceFile = NULL;
+    }
+    if (sCsvFile != NULL) {
+        fclose(sCsvFile);
+        sCsvFile = NULL;
+    }
+}
+
+static u8 audio_profiler_open(void) {
+    sTraceFile = fopen(AUDIO_PROFILE_TRACE_FILE, "w");
+    sCsvFile = fopen(AUDIO_PROFILE_CSV_FILE, "w");
+    if (sTraceFile == NULL || sCsvFile == NULL) {
+        fprintf(stderr, "Audio profiler: could not open %s / %s for writing\n",
+                AUDIO_PROFILE_TRACE_FILE, AUDIO_PROFILE_CSV_FILE);
+        audio_profiler_close();
+        return FALSE;
+    }
+
+    sProfilerEpoch = audio_subset_starts[SUBSET(SEQUENCES)];
+
+    fprintf(sTraceFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(sTraceFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"audio\"}}");
+    fprintf(sCsvFile, "frame,update,start_us,total_us,sequences_us,script_us,reclaim_us,seq_processing_us,"
+                      "synthesis_us,note_processing_us,envelope_reverb_us,dma_us\n");
+
+    atexit(audio_profiler_close);
+    return TRUE;
+}
+
+static void audio_profiler_write_update(s32 updateIndex) {
+    AudioProfilerTime updateStart = audio_subset_starts[SUBSET(SEQUENCES)];
+    AudioProfilerTime synthesisStart = audio_subset_starts[SUBSET(SYNTHESIS)];
+    AudioProfilerTime updateEnd = audio_subset_starts[SUBSET(UPDATE)];
+    AudioProfilerTime *tallies = audio_subset_tallies;
+    double ts;
+
+    if (sProfilerFailed) {
+        return;
+    }
+    if (sTraceFile == NULL && !audio_profiler_open()) {
+        sProfilerFailed = TRUE;
+        return;
+    }
+
+    ts = NS_TO_US(updateStart - sProfilerEpoch);
+
+    fprintf(sTraceFile, ",\n{\"name\":\"update %d\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+            (int) updateIndex, ts, NS_TO_US(updateEnd - updateStart), (int) gAudioFrameCount);
+    fprintf(sTraceFile, ",\n{\"name\":\"sequences\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+            ts, NS_TO_US(synthesisStart - updateStart));
+    fprintf(sTraceFile, ",\n{\"name\":\"synthesis\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+            NS_TO_US(synthesisStart - sProfilerEpoch), NS_TO_US(updateEnd - synthesisStart));
+    // Note processing and reverb interleave per note, so they are reported as counters rather than spans
+    fprintf(sTraceFile, ",\n{\"name\":\"stages (us)\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{"
+                        "\"script\":%.3f,\"reclaim\":%.3f,\"seq_processing\":%.3f,"
+                        "\"note_processing\":%.3f,\"envelope_reverb\":%.3f,\"dma\":%.3f}}",
+            ts, NS_TO_US(tallies[SUBSET(SEQUENCES_SCRIPT)]), NS_TO_US(tallies[SUBSET(SEQUENCES_RECLAIM)]),
+            NS_TO_US(tallies[SUBSET(SEQUENCES_PROCESSING)]), NS_TO_US(tallies[SUBSET(SYNTHESIS_PROCESSING)]),
+            NS_TO_US(tallies[SUBSET(SYNTHESIS_ENVELOPE_REVERB)]), NS_TO_US(tallies[SUBSET(SYNTHESIS_DMA)]));
+
+    fprintf(sCsvFile, "%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+            (int) gAudioFrameCount, (int) updateIndex, ts, NS_TO_US(updateEnd - updateStart),
+            NS_TO_US(tallies[SUBSET(SEQUENCES)]), NS_TO_US(tallies[SUBSET(SEQUENCES_SCRIPT)]),
+            NS_TO_US(tallies[SUBSET(SEQUENCES_RECLAIM)]), NS_TO_US(tallies[SUBSET(SEQUENCES_PROCESSING)]),
+            NS_TO_US(tallies[SUBSET(SYNTHESIS)]), NS_TO_US(tallies[SUBSET(SYNTHESIS_PROCESSING)]),
+            NS_TO_US(tallies[SUBSET(SYNTHESIS_ENVELOPE_REVERB)]), NS_TO_US(tallies[SUBSET(SYNTHESIS_DMA)]));
+}
+
+/**
+ * Called once at the end of every audio update in synthesis_execute(). Adds the time spent in each stage
+ * since the previous update to the running totals and writes it out, then clears the tallies for the next one.
+ */
+void audio_profiler_update_completed(s32 updateIndex) {
+    s32 i;
+
+    for (i = 0; i < AUDIO_SUBSET_SIZE; i++) {
+        audio_subset_totals[i] += audio_subset_tallies[i];
+    }
+
+    if (gAudioProfilerFileOutput) {
+        audio_profiler_write_update(updateIndex);
+    }
+
+    for (i = 0; i < AUDIO_SUBSET_SIZE; i++) {
+        audio_subset_tallies[i] = 0;
+    }
+}
+
+#endif // AUDIO_PROFILING
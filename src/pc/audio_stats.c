@@ -0,0 +1,204 @@
+// audio_stats.c - voice, sample DMA and audio heap counters for tuning polyphony and heap sizes
+#include "audio_stats.h"
+
+#ifdef AUDIO_STATS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "sm64.h"
+#include "config.h"
+#include "gfx_dimensions.h"
+#include "game/print.h"
+
+#include "audio/internal.h"
+#include "audio/heap.h"
+#include "audio/load.h"
+
+// The overlay shows totals over this many frames, about a second
+#define AUDIO_STATS_WINDOW 30
+
+enum AudioStatsVoiceState {
+    VOICES_ACTIVE,
+    VOICES_DECAYING,
+    VOICES_RELEASING,
+    VOICES_FREE,
+    VOICES_STATE_COUNT,
+};
+
+struct AudioStatsWindow {
+    struct AudioStatsCounters counters;
+    u32 renderTimeUs;
+    u32 renderTimeMaxUs;
+};
+
+struct AudioStatsCounters gAudioStatsCounters;
+
+static struct AudioStatsWindow sCurrentWindow;
+static struct AudioStatsWindow sShownWindow;
+static u32 sVoices[VOICES_STATE_COUNT];
+static s32 sPools[NUM_AUDIO_POOLS * 2];
+static u32 sFrame = 0;
+static struct timeval sRenderStart;
+
+static FILE *sLogFile = NULL;
+static u8 sLogFailed = FALSE;
+
+static void audio_stats_close(void) {
+    if (sLogFile != NULL) {
+        fclose(sLogFile);
+        sLogFile = NULL;
+    }
+}
+
+static u8 audio_stats_open(void) {
+    sLogFile = fopen(AUDIO_STATS_LOG_FILE, "w");
+    if (sLogFile == NULL) {
+        fprintf(stderr, "Audio stats: could not open %s for writing\n", AUDIO_STATS_LOG_FILE);
+        return FALSE;
+    }
+
+    fprintf(sLogFile, "frame,render_us,active,decaying,releasing,free,steals,drops,dma_hits,dma_misses,"
+                      "init_used,init_size,notes_used,notes_size,seq_persistent_used,seq_persistent_size,"
+                      "bank_persistent_used,bank_persistent_size,seq_temporary_used,seq_temporary_size,"
+                      "bank_temporary_used,bank_temporary_size"
+#ifdef BETTER_REVERB
+                      ",reverb_used,reverb_size"
+#endif
+                      "\n");
+
+    atexit(audio_stats_close);
+    return TRUE;
+}
+
+static void audio_stats_count_pool(struct NotePool *pool) {
+    sVoices[VOICES_ACTIVE] += pool->active.u.count;
+    sVoices[VOICES_DECAYING] += pool->decaying.u.count;
+    sVoices[VOICES_RELEASING] += pool->releasing.u.count;
+    sVoices[VOICES_FREE] += pool->disabled.u.count;
+}
+
+/**
+ * Every note sits in exactly one list of one pool: the global free lists, a sequence player's or a channel's.
+ */
+static void audio_stats_count_voices(void) {
+    struct SequencePlayer *seqPlayer;
+    s32 i, j;
+
+    memset(sVoices, 0, sizeof(sVoices));
+    audio_stats_count_pool(&gNoteFreeLists);
+    for (i = 0; i < SEQUENCE_PLAYERS; i++) {
+        seqPlayer = &gSequencePlayers[i];
+        audio_stats_count_pool(&seqPlayer->notePool);
+        for (j = 0; j < CHANNELS_MAX; j++) {
+            if (IS_SEQUENCE_CHANNEL_VALID(seqPlayer->channels[j])) {
+                audio_stats_count_pool(&seqPlayer->channels[j]->notePool);
+            }
+        }
+    }
+}
+
+static void audio_stats_write_frame(u32 renderTimeUs) {
+    s32 i;
+
+    if (sLogFailed) {
+        return;
+    }
+    if (sLogFile == NULL && !audio_stats_open()) {
+        sLogFailed = TRUE;
+        return;
+    }
+
+    fprintf(sLogFile, "%u,%u,%u,%u,%u,%u,%u,%u,%u,%u", (unsigned) sFrame, (unsigned) renderTimeUs,
+            (unsigned) sVoices[VOICES_ACTIVE], (unsigned) sVoices[VOICES_DECAYING],
+            (unsigned) sVoices[VOICES_RELEASING], (unsigned) sVoices[VOICES_FREE],
+            (unsigned) gAudioStatsCounters.noteSteals, (unsigned) gAudioStatsCounters.noteDrops,
+            (unsigned) gAudioStatsCounters.dmaHits, (unsigned) gAudioStatsCounters.dmaMisses);
+    for (i = 0; i < NUM_AUDIO_POOLS; i++) {
+        fprintf(sLogFile, ",%d,%d", (int) sPools[i * 2 + 1], (int) sPools[i * 2]);
+    }
+    fprintf(sLogFile, "\n");
+}
+
+void audio_stats_render_begin(void) {
+    gettimeofday(&sRenderStart, NULL);
+}
+
+/**
+ * Called after each frame's audio has been rendered. Takes a snapshot of the voices and pools, logs the frame
+ * and adds it to the overlay's window before clearing the counters.
+ */
+void audio_stats_render_end(void) {
+    struct timeval renderEnd;
+    u32 renderTimeUs;
+
+    gettimeofday(&renderEnd, NULL);
+    renderTimeUs = (u32) ((renderEnd.tv_sec - sRenderStart.tv_sec) * 1000000L
+                          + (renderEnd.tv_usec - sRenderStart.tv_usec));
+
+    audio_stats_count_voices();
+    puppyprint_get_allocated_pools(sPools);
+    audio_stats_write_frame(renderTimeUs);
+
+    sCurrentWindow.counters.noteSteals += gAudioStatsCounters.noteSteals;
+    sCurrentWindow.counters.noteDrops += gAudioStatsCounters.noteDrops;
+    sCurrentWindow.counters.dmaHits += gAudioStatsCounters.dmaHits;
+    sCurrentWindow.counters.dmaMisses += gAudioStatsCounters.dmaMisses;
+    sCurrentWindow.renderTimeUs += renderTimeUs;
+    if (renderTimeUs > sCurrentWindow.renderTimeMaxUs) {
+        sCurrentWindow.renderTimeMaxUs = renderTimeUs;
+    }
+    memset(&gAudioStatsCounters, 0, sizeof(gAudioStatsCounters));
+
+    if (++sFrame % AUDIO_STATS_WINDOW == 0) {
+        sShownWindow = sCurrentWindow;
+        memset(&sCurrentWindow, 0, sizeof(sCurrentWindow));
+    }
+}
+
+static s32 audio_stats_pool_percent(s32 pool) {
+    s32 size = sPools[pool * 2];
+
+    return (size > 0) ? (s32) ((s64) sPools[pool * 2 + 1] * 100 / size) : 0;
+}
+
+/**
+ * Draws the overlay below the audio dump banner. Voices and pools are from the last frame, the rest are totals
+ * over the last completed window, with the average and worst render time in microseconds.
+ */
+void audio_stats_print(void) {
+    char buffer[64];
+    s32 y = 197 - BORDER_HEIGHT - 20;
+    s32 len;
+    s32 i;
+
+    sprintf(buffer, "NOTES %u D%u R%u F%u", (unsigned) sVoices[VOICES_ACTIVE],
+            (unsigned) sVoices[VOICES_DECAYING], (unsigned) sVoices[VOICES_RELEASING],
+            (unsigned) sVoices[VOICES_FREE]);
+    print_text(GFX_DIMENSIONS_RECT_FROM_LEFT_EDGE(22), y, buffer);
+    y -= 18;
+
+    sprintf(buffer, "STEAL %u DROP %u", (unsigned) sShownWindow.counters.noteSteals,
+            (unsigned) sShownWindow.counters.noteDrops);
+    print_text(GFX_DIMENSIONS_RECT_FROM_LEFT_EDGE(22), y, buffer);
+    y -= 18;
+
+    sprintf(buffer, "DMA %u MISS %u", (unsigned) sShownWindow.counters.dmaHits,
+            (unsigned) sShownWindow.counters.dmaMisses);
+    print_text(GFX_DIMENSIONS_RECT_FROM_LEFT_EDGE(22), y, buffer);
+    y -= 18;
+
+    sprintf(buffer, "AUDIO %u MAX %u", (unsigned) (sShownWindow.renderTimeUs / AUDIO_STATS_WINDOW),
+            (unsigned) sShownWindow.renderTimeMaxUs);
+    print_text(GFX_DIMENSIONS_RECT_FROM_LEFT_EDGE(22), y, buffer);
+    y -= 18;
+
+    // Percent used, in the order of puppyprint_get_allocated_pools()
+    len = sprintf(buffer, "HEAP");
+    for (i = 0; i < NUM_AUDIO_POOLS; i++) {
+        len += sprintf(buffer + len, " %d", (int) audio_stats_pool_percent(i));
+    }
+    print_text(GFX_DIMENSIONS_RECT_FROM_LEFT_EDGE(22), y, buffer);
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef AUDIO_STATS_H
+#define AUDIO_STATS_H
+
+#include <PR/ultratypes.h>
+
+/**
+ * PC only: count voice allocations and sample DMAs in the audio driver, and show them together with the voice
+ * counts, audio heap usage and render time on screen. Every frame is also written to audio_stats.csv.
+ * Enabled with `make AUDIO_STATS=1`.
+ */
+#if !defined(TARGET_N64) && defined(PC_AUDIO_STATS)
+#define AUDIO_STATS
+
+#define AUDIO_STATS_LOG_FILE "audio_stats.csv"
+
+struct AudioStatsCounters {
+    u32 noteSteals; // notes taken over from a lower priority layer by alloc_note_from_active()
+    u32 noteDrops;  // layers left without a note by alloc_note()
+    u32 dmaHits;    // dma_sample_data() requests served from a buffer already holding the data
+    u32 dmaMisses;  // dma_sample_data() requests that needed a new transfer
+};
+
+// Cleared at the end of every frame by audio_stats_render_end()
+extern struct AudioStatsCounters gAudioStatsCounters;
+
+#define AUDIO_STATS_COUNT(counter) (gAudioStatsCounters.counter++)
+
+void audio_stats_render_begin(void);
+void audio_stats_render_end(void);
+void audio_stats_print(void);
+#else
+#define AUDIO_STATS_COUNT(counter)
+#endif
+
+#endif // AUDIO_STATS_H
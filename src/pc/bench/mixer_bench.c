@@ -0,0 +1,694 @@
+// mixer_bench.c - standalone timing and bit-exactness harness for the RSP kernels in mixer.c
+//
+// Built with `make mixer-bench`. Each kernel is fed the same synthetic inputs through the regular mixer
+// (SSE4.1/NEON when the compiler targets them) and through a scalar-only copy of it (mixer_bench_ref.c),
+// timed, and the resulting DMEM and state compared. On the US/JP microcode aHeadsetPan is also checked against
+// the command sequence it replaces. It then renders the largest frame through audio_oversample_render() at each
+// factor, with a stand-in for the engine. Usage: mixer_bench [iterations] [seed]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "config.h"
+#include "macros.h"
+#include "../audio_oversample.h"
+#include "../mixer.h"
+
+#if defined(__SSE4_1__)
+#define BENCH_SIMD_NAME "SSE4.1"
+#elif defined(__ARM_NEON)
+#define BENCH_SIMD_NAME "NEON"
+#else
+#define BENCH_SIMD_NAME NULL
+#endif
+
+#define BENCH_DEFAULT_ITERATIONS 200000
+#define BENCH_DEFAULT_SEED       0x5EED5EED
+#define BENCH_CHECK_CALLS        64
+
+// Bytes processed per channel per call, about one audio update's worth
+#define BENCH_NBYTES 0x200
+
+// DMEM layout shared by every kernel. All of it fits in the 0x1000 byte buffer of a 32 kHz build.
+#define BENCH_IN       0x040 // room for 2x resampling input; also the interleave destination
+#define BENCH_OUT      0x4C0 // 16 samples of decoder history, then BENCH_NBYTES of output
+#define BENCH_DRY_L    0x6E0
+#define BENCH_DRY_R    (BENCH_DRY_L + BENCH_NBYTES)
+#define BENCH_WET_L    (BENCH_DRY_R + BENCH_NBYTES)
+#define BENCH_WET_R    (BENCH_WET_L + BENCH_NBYTES)
+#define BENCH_DMEM_END (BENCH_WET_R + BENCH_NBYTES)
+
+// 9 byte VADPCM frames per 16 output samples, padded for the DMEM copy
+#define BENCH_ADPCM_BYTES ((BENCH_NBYTES / 32 * 9 + 15) & ~15)
+
+#define BENCH_STATE_SIZE (2 * DECIMATE_MAX_TAPS) // the largest state, DECIMATE_STATE
+
+// Output frames of the largest buffer the game renders, a 50 Hz frame at FINAL_SAMPLE_RATE
+#define BENCH_OVERSAMPLE_FRAMES ALIGN16(FINAL_SAMPLE_RATE / 50)
+#define BENCH_OVERSAMPLE_CALLS  4
+
+struct MixerApi {
+    void (*clearBuffer)(uint16_t addr, int nbytes);
+    void (*setBuffer)(uint8_t flags, uint16_t in, uint16_t out, uint16_t nbytes);
+    void (*loadADPCM)(int num_entries_times_16, const int16_t *book_source_addr);
+    void (*adpcmDec)(uint8_t flags, ADPCM_STATE state);
+    void (*resample)(uint8_t flags, uint16_t pitch, RESAMPLE_STATE state);
+    void (*resampleStereo)(uint8_t flags, uint16_t pitch, uint16_t right_offset,
+                           RESAMPLE_STATE state_left, RESAMPLE_STATE state_right);
+    void (*resampleHQ)(uint8_t flags, uint16_t pitch, RESAMPLE_HQ_STATE state);
+    int *resamplerTaps;
+    void (*decimateStereo)(int16_t *out, const int16_t *in, int n_frames, int factor, DECIMATE_STATE state);
+    void (*headsetPan)(uint8_t flags, uint16_t pitch, uint16_t pan_addr, uint16_t temp_addr, uint16_t dest_addr,
+                       uint16_t nbytes, uint16_t pan_shift, uint16_t prev_pan_shift,
+                       RESAMPLE_STATE state, int16_t *pan_samples);
+    void (*dmemMove)(uint16_t in_addr, uint16_t out_addr, int nbytes);
+#ifdef NEW_AUDIO_UCODE
+    void (*loadBuffer)(const void *source_addr, uint16_t dest_addr, uint16_t nbytes);
+    void (*saveBuffer)(uint16_t source_addr, int16_t *dest_addr, uint16_t nbytes);
+    void (*interleave)(uint16_t dest, uint16_t left, uint16_t right, uint16_t c);
+    void (*mix)(int16_t gain, uint16_t in_addr, uint16_t out_addr, uint16_t count);
+    void (*envSetup1)(uint8_t initial_vol_wet, uint16_t rate_wet, uint16_t rate_left, uint16_t rate_right);
+    void (*envSetup2)(uint16_t initial_vol_left, uint16_t initial_vol_right);
+    void (*envMixer)(uint16_t in_addr, uint16_t n_samples, bool swap_reverb, bool neg_left, bool neg_right,
+                     uint16_t dry_left_addr, uint16_t dry_right_addr,
+                     uint16_t wet_left_addr, uint16_t wet_right_addr);
+    void (*s8Dec)(uint8_t flags, ADPCM_STATE state);
+    void (*filter)(uint8_t flags, uint16_t count_or_buf, int16_t state_or_filter[8]);
+#else
+    void (*setVolume)(uint8_t flags, int16_t v, int16_t t, int16_t r);
+    void (*loadBuffer)(const void *source_addr);
+    void (*saveBuffer)(int16_t *dest_addr);
+    void (*interleave)(uint16_t left, uint16_t right);
+    void (*mix)(int16_t gain, uint16_t in_addr, uint16_t out_addr);
+    void (*envMixer)(uint8_t flags, ENVMIX_STATE state);
+#endif
+};
+
+// Expanded once with the regular names and once after mixer_bench_ref.h has renamed them to ref_*
+#ifdef NEW_AUDIO_UCODE
+#define MIXER_API_INIT {                                                                        \
+    aClearBufferImpl, aSetBufferImpl, aLoadADPCMImpl, aADPCMdecImpl, aResampleImpl,             \
+    aResampleStereoImpl, aResampleHQImpl, &gResamplerTaps, aDecimateStereoImpl, aHeadsetPanImpl, aDMEMMoveImpl,       \
+    aLoadBufferImpl, aSaveBufferImpl, aInterleaveImpl, aMixImpl, aEnvSetup1Impl, aEnvSetup2Impl, \
+    aEnvMixerImpl, aS8DecImpl, aFilterImpl,                                                      \
+}
+#else
+#define MIXER_API_INIT {                                                                        \
+    aClearBufferImpl, aSetBufferImpl, aLoadADPCMImpl, aADPCMdecImpl, aResampleImpl,             \
+    aResampleStereoImpl, aResampleHQImpl, &gResamplerTaps, aDecimateStereoImpl, aHeadsetPanImpl, aDMEMMoveImpl,       \
+    aSetVolumeImpl, aLoadBufferImpl, aSaveBufferImpl, aInterleaveImpl, aMixImpl, aEnvMixerImpl, \
+}
+#endif
+
+static const struct MixerApi sSimdMixer = MIXER_API_INIT;
+
+#include "mixer_bench_ref.h"
+
+static const struct MixerApi sRefMixer = MIXER_API_INIT;
+
+struct BenchParams {
+    uint16_t pitch;
+    int16_t gain;
+};
+
+struct BenchCase {
+    const char *name;
+    // Whether the SIMD path is expected to match the scalar one bit for bit
+    bool exact;
+    // Number of leading state entries with a layout shared by both paths
+    int stateCompareCount;
+    void (*prepare)(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params);
+    void (*run)(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state);
+};
+
+/**
+ * xorshift32, so that every run (and both mixers within a run) sees the same inputs for a given seed.
+ */
+static uint32_t bench_rand(uint32_t *rng) {
+    uint32_t x = *rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *rng = x;
+}
+
+static int32_t bench_rand_range(uint32_t *rng, int32_t min, int32_t max) {
+    return min + (int32_t) (bench_rand(rng) % (uint32_t) (max - min + 1));
+}
+
+static void bench_rand_samples(uint32_t *rng, int16_t *dest, int count, int16_t amplitude) {
+    int i;
+
+    for (i = 0; i < count; i++) {
+        dest[i] = (int16_t) bench_rand_range(rng, -amplitude, amplitude);
+    }
+}
+
+static uint64_t bench_get_time(void) {
+#if defined(_WIN32) || defined(_WIN64)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER count;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&count);
+    return (uint64_t) ((count.QuadPart / frequency.QuadPart) * 1000000000ULL
+                       + (count.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+static void dmem_write(const struct MixerApi *api, uint16_t addr, const void *src, uint16_t nbytes) {
+#ifdef NEW_AUDIO_UCODE
+    api->loadBuffer(src, addr, nbytes);
+#else
+    api->setBuffer(0, addr, 0, nbytes);
+    api->loadBuffer(src);
+#endif
+}
+
+static void dmem_read(const struct MixerApi *api, uint16_t addr, int16_t *dest, uint16_t nbytes) {
+#ifdef NEW_AUDIO_UCODE
+    api->saveBuffer(addr, dest, nbytes);
+#else
+    api->setBuffer(0, 0, addr, nbytes);
+    api->saveBuffer(dest);
+#endif
+}
+
+static void dmem_write_random(const struct MixerApi *api, uint32_t *rng, uint16_t addr, uint16_t nbytes,
+                              int16_t amplitude) {
+    int16_t samples[BENCH_DMEM_END / sizeof(int16_t)];
+
+    bench_rand_samples(rng, samples, nbytes / sizeof(int16_t), amplitude);
+    dmem_write(api, addr, samples, nbytes);
+}
+
+static void prepare_adpcm(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    int16_t book[8][2][8];
+    uint8_t frames[BENCH_ADPCM_BYTES];
+    uint32_t i;
+
+    // Typical predictor coefficients stay well inside +/-2.0 in 2.11 fixed point
+    bench_rand_samples(rng, &book[0][0][0], sizeof(book) / sizeof(int16_t), 0x1000);
+    api->loadADPCM(sizeof(book), &book[0][0][0]);
+
+    for (i = 0; i < sizeof(frames); i++) {
+        frames[i] = (uint8_t) bench_rand(rng);
+        if (i % 9 == 0) {
+            frames[i] = (uint8_t) (bench_rand_range(rng, 0, 12) << 4 | bench_rand_range(rng, 0, 7));
+        }
+    }
+    dmem_write(api, BENCH_IN, frames, sizeof(frames));
+}
+
+static void run_adpcm(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+    api->setBuffer(0, BENCH_IN, BENCH_OUT, BENCH_NBYTES);
+    api->adpcmDec(flags, state);
+}
+
+static void prepare_resample(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    dmem_write_random(api, rng, BENCH_IN, BENCH_NBYTES * 2, 0x6000);
+    // Anything from pitching down to a little under two octaves up
+    params->pitch = (uint16_t) bench_rand_range(rng, 0x1000, 0xFFFF);
+}
+
+static void run_resample(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+    api->setBuffer(0, BENCH_IN, BENCH_OUT, BENCH_NBYTES);
+    api->resample(flags, params->pitch, state);
+}
+
+static void prepare_resample_stereo(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    dmem_write_random(api, rng, BENCH_IN, BENCH_NBYTES * 2, 0x6000);
+    // Upsampling the reverb by 2 to 4, like synthesis_do_one_audio_update() does
+    params->pitch = (uint16_t) bench_rand_range(rng, 0x2000, 0x4000);
+}
+
+static void run_resample_stereo(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags,
+                                int16_t *state) {
+    api->setBuffer(0, BENCH_IN, BENCH_OUT, BENCH_NBYTES);
+    api->resampleStereo(flags, params->pitch, BENCH_NBYTES, state, state + 16);
+}
+
+static void prepare_resample_hq_16(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    *api->resamplerTaps = 16;
+    prepare_resample(api, rng, params);
+}
+
+static void prepare_resample_hq_32(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    *api->resamplerTaps = 32;
+    prepare_resample(api, rng, params);
+}
+
+static void run_resample_hq(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+    api->setBuffer(0, BENCH_IN, BENCH_OUT, BENCH_NBYTES);
+    api->resampleHQ(flags, params->pitch, state);
+}
+
+static void prepare_decimate(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    // Interleaved stereo, as it comes out of the engine
+    dmem_write_random(api, rng, BENCH_IN, BENCH_NBYTES * 2, 0x6000);
+}
+
+static void run_decimate(const struct MixerApi *api, uint8_t flags, int16_t *state, int factor) {
+    int16_t in[BENCH_NBYTES];
+    int16_t out[BENCH_NBYTES / 2];
+    int frames = BENCH_NBYTES / 2 / factor;
+
+    if (flags & A_INIT) {
+        memset(state, 0, sizeof(DECIMATE_STATE));
+    }
+    dmem_read(api, BENCH_IN, in, BENCH_NBYTES * 2);
+    api->decimateStereo(out, in, frames, factor, (int16_t (*)[DECIMATE_MAX_TAPS]) state);
+    dmem_write(api, BENCH_OUT, out, frames * 2 * sizeof(int16_t));
+}
+
+static void run_decimate_2(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+    run_decimate(api, flags, state, 2);
+}
+
+static void run_decimate_4(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+    run_decimate(api, flags, state, 4);
+}
+
+static void prepare_mix_buses(const struct MixerApi *api, uint32_t *rng) {
+    dmem_write_random(api, rng, BENCH_IN, BENCH_NBYTES, 0x7FFF);
+    dmem_write_random(api, rng, BENCH_DRY_L, BENCH_NBYTES * 4, 0x4000);
+}
+
+static void prepare_envmixer(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+#ifdef NEW_AUDIO_UCODE
+    api->envSetup1((uint8_t) bench_rand_range(rng, 0, 0x7F), (uint16_t) bench_rand_range(rng, 0, 0x100),
+                   (uint16_t) bench_rand_range(rng, 0, 0x100), (uint16_t) bench_rand_range(rng, 0, 0x100));
+    api->envSetup2((uint16_t) bench_rand_range(rng, 0, 0x7FFF), (uint16_t) bench_rand_range(rng, 0, 0x7FFF));
+#else
+    int32_t rate;
+    int c;
+
+    for (c = 0; c < 2; c++) {
+        uint8_t side = (c == 0) ? A_LEFT : A_RIGHT;
+
+        // Ramps multiply the volume by rate / 65536 every 8 samples until the target is reached
+        rate = 0x10000 + bench_rand_range(rng, -0x800, 0x800);
+        api->setVolume(A_VOL | side, (int16_t) bench_rand_range(rng, 0, 0x7FFF), 0, 0);
+        api->setVolume(A_RATE | side, (int16_t) bench_rand_range(rng, 0, 0x7FFF),
+                       (int16_t) (rate >> 16), (int16_t) (rate & 0xFFFF));
+    }
+    api->setVolume(A_AUX, (int16_t) bench_rand_range(rng, 0, 0x7FFF), 0, (int16_t) bench_rand_range(rng, 0, 0x7FFF));
+#endif
+    prepare_mix_buses(api, rng);
+}
+
+static void run_envmixer(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+#ifdef NEW_AUDIO_UCODE
+    api->envMixer(BENCH_IN, BENCH_NBYTES / sizeof(int16_t), false, false, false,
+                  BENCH_DRY_L, BENCH_DRY_R, BENCH_WET_L, BENCH_WET_R);
+#else
+    api->setBuffer(0, BENCH_IN, BENCH_DRY_L, BENCH_NBYTES);
+    api->setBuffer(A_AUX, BENCH_DRY_R, BENCH_WET_L, BENCH_WET_R);
+    api->envMixer(flags, state);
+#endif
+}
+
+static void prepare_mix(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    prepare_mix_buses(api, rng);
+    // -0x8000 takes a separate subtract-only path
+    params->gain = (bench_rand(rng) % 8 == 0) ? -0x8000 : (int16_t) bench_rand_range(rng, -0x7FFF, 0x7FFF);
+}
+
+static void run_mix(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+#ifdef NEW_AUDIO_UCODE
+    api->mix(params->gain, BENCH_IN, BENCH_DRY_L, BENCH_NBYTES);
+#else
+    api->setBuffer(0, 0, 0, BENCH_NBYTES);
+    api->mix(params->gain, BENCH_IN, BENCH_DRY_L);
+#endif
+}
+
+static void prepare_headset_pan(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    dmem_write_random(api, rng, BENCH_IN, BENCH_NBYTES * 2, 0x6000);
+    prepare_mix_buses(api, rng);
+    // Delay growing from 8 to 16 samples, as note_apply_headset_pan_effects() would compute it
+    params->pitch = (uint16_t) ((BENCH_NBYTES << 15) / (BENCH_NBYTES + 0x10));
+}
+
+static void run_headset_pan(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags,
+                            int16_t *state) {
+    api->headsetPan(flags, params->pitch, BENCH_IN, BENCH_OUT, BENCH_DRY_L, BENCH_NBYTES, 0x20, 0x10,
+                    state, state + 16);
+}
+
+static void prepare_interleave(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    prepare_mix_buses(api, rng);
+}
+
+static void run_interleave(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+#ifdef NEW_AUDIO_UCODE
+    api->interleave(BENCH_IN, BENCH_DRY_L, BENCH_DRY_R, BENCH_NBYTES);
+#else
+    api->setBuffer(0, 0, BENCH_IN, BENCH_NBYTES);
+    api->interleave(BENCH_DRY_L, BENCH_DRY_R);
+#endif
+}
+
+#ifdef NEW_AUDIO_UCODE
+static void prepare_s8dec(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    dmem_write_random(api, rng, BENCH_IN, BENCH_NBYTES / 2, 0x7FFF);
+}
+
+static void run_s8dec(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+    api->setBuffer(0, BENCH_IN, BENCH_OUT, BENCH_NBYTES);
+    api->s8Dec(flags, state);
+}
+
+static void prepare_filter(const struct MixerApi *api, uint32_t *rng, struct BenchParams *params) {
+    int16_t coefficients[8];
+
+    bench_rand_samples(rng, coefficients, 8, 0x4000);
+    api->filter(A_INIT + 1, BENCH_NBYTES, coefficients);
+    dmem_write_random(api, rng, BENCH_OUT, BENCH_NBYTES, 0x6000);
+}
+
+static void run_filter(const struct MixerApi *api, const struct BenchParams *params, uint8_t flags, int16_t *state) {
+    api->filter(flags & A_INIT, BENCH_OUT, state);
+}
+#endif
+
+static const struct BenchCase sBenchCases[] = {
+    { "aADPCMdec",   true,  16, prepare_adpcm,      run_adpcm      },
+    { "aResample",   true,  16, prepare_resample,   run_resample   },
+    { "aResampleStereo", true, 32, prepare_resample_stereo, run_resample_stereo },
+    { "aResampleHQ16", true, BENCH_STATE_SIZE, prepare_resample_hq_16, run_resample_hq },
+    { "aResampleHQ32", true, BENCH_STATE_SIZE, prepare_resample_hq_32, run_resample_hq },
+    { "aDecimate2x", true, BENCH_STATE_SIZE, prepare_decimate, run_decimate_2 },
+    { "aDecimate4x", true, BENCH_STATE_SIZE, prepare_decimate, run_decimate_4 },
+    { "aHeadsetPan", true,  48, prepare_headset_pan, run_headset_pan },
+    // The SIMD envelope ramps are computed in float, the scalar ones in fixed point
+    { "aEnvMixer",   false, 0,  prepare_envmixer,   run_envmixer   },
+    // The SIMD paths add the rounded product to out instead of rounding out * 0x7FFF with it like the RSP
+    { "aMix",        false, 0,  prepare_mix,        run_mix        },
+    { "aInterleave", true,  0,  prepare_interleave, run_interleave },
+#ifdef NEW_AUDIO_UCODE
+    { "aS8Dec",      true,  16, prepare_s8dec,      run_s8dec      },
+    { "aFilter",     true,  8,  prepare_filter,     run_filter     },
+#endif
+};
+
+/**
+ * Average time of one kernel call in nanoseconds, with the inputs staged once up front.
+ */
+static double bench_time(const struct BenchCase *bench, const struct MixerApi *api, uint32_t seed, int iterations) {
+    int16_t state[BENCH_STATE_SIZE] = { 0 };
+    struct BenchParams params = { 0 };
+    uint32_t rng = seed;
+    uint64_t start;
+    int i;
+
+    api->clearBuffer(0, BENCH_DMEM_END);
+    bench->prepare(api, &rng, &params);
+    bench->run(api, &params, A_INIT, state);
+
+    start = bench_get_time();
+    for (i = 0; i < iterations; i++) {
+        bench->run(api, &params, A_CONTINUE, state);
+    }
+    return (double) (bench_get_time() - start) / iterations;
+}
+
+/**
+ * Runs a chain of calls with fresh inputs through both mixers and compares DMEM and state after each.
+ * Returns the number of differing samples and stores the largest difference in maxDiff.
+ */
+static int bench_check(const struct BenchCase *bench, uint32_t seed, int *maxDiff) {
+    int16_t simdState[BENCH_STATE_SIZE] = { 0 };
+    int16_t refState[BENCH_STATE_SIZE] = { 0 };
+    int16_t simdDmem[BENCH_DMEM_END / sizeof(int16_t)];
+    int16_t refDmem[BENCH_DMEM_END / sizeof(int16_t)];
+    struct BenchParams simdParams = { 0 };
+    struct BenchParams refParams = { 0 };
+    uint32_t simdRng = seed;
+    uint32_t refRng = seed;
+    int mismatches = 0;
+    int call, i, diff;
+
+    *maxDiff = 0;
+    sSimdMixer.clearBuffer(0, BENCH_DMEM_END);
+    sRefMixer.clearBuffer(0, BENCH_DMEM_END);
+
+    for (call = 0; call < BENCH_CHECK_CALLS; call++) {
+        uint8_t flags = (call == 0) ? A_INIT : A_CONTINUE;
+
+        bench->prepare(&sSimdMixer, &simdRng, &simdParams);
+        bench->prepare(&sRefMixer, &refRng, &refParams);
+        bench->run(&sSimdMixer, &simdParams, flags, simdState);
+        bench->run(&sRefMixer, &refParams, flags, refState);
+
+        dmem_read(&sSimdMixer, 0, simdDmem, BENCH_DMEM_END);
+        dmem_read(&sRefMixer, 0, refDmem, BENCH_DMEM_END);
+
+        for (i = 0; i < BENCH_DMEM_END / (int) sizeof(int16_t) + bench->stateCompareCount; i++) {
+            if (i < BENCH_DMEM_END / (int) sizeof(int16_t)) {
+                diff = abs(simdDmem[i] - refDmem[i]);
+            } else {
+                diff = abs(simdState[i - BENCH_DMEM_END / sizeof(int16_t)]
+                           - refState[i - BENCH_DMEM_END / sizeof(int16_t)]);
+            }
+            if (diff != 0) {
+                mismatches++;
+                if (diff > *maxDiff) {
+                    *maxDiff = diff;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+#ifndef NEW_AUDIO_UCODE
+// Scratch space for the resampled pan signal, DMEM_ADDR_TEMP in synthesis.c
+#define BENCH_HEADSET_TEMP BENCH_WET_L
+
+/**
+ * The command sequence note_apply_headset_pan_effects() issues on the N64, which aHeadsetPan replaces, with
+ * BENCH_IN as DMEM_ADDR_NOTE_PAN_TEMP. DMEM_ADDR_TEMP is 0 there, so its literal clear at 8 is temp + 8 here.
+ */
+static void run_headset_pan_commands(const struct MixerApi *api, uint8_t flags, uint16_t pitch, uint16_t panShift,
+                                     uint16_t prevPanShift, int16_t *state, int16_t *panSamples) {
+    if (flags != A_INIT) {
+        if (prevPanShift == 0) {
+            api->dmemMove(BENCH_IN, BENCH_HEADSET_TEMP, 8);
+            api->clearBuffer(BENCH_HEADSET_TEMP + 8, 8);
+            api->dmemMove(BENCH_IN, BENCH_HEADSET_TEMP + 16, 16);
+            api->setBuffer(0, 0, BENCH_HEADSET_TEMP, 32);
+            api->saveBuffer(state);
+            api->setBuffer(0, BENCH_IN + 8, BENCH_HEADSET_TEMP, panShift + BENCH_NBYTES - prevPanShift);
+        } else {
+            api->setBuffer(0, BENCH_IN, BENCH_HEADSET_TEMP, panShift + BENCH_NBYTES - prevPanShift);
+        }
+        api->resample(0, pitch, state);
+
+        if (prevPanShift != 0) {
+            api->setBuffer(0, BENCH_IN, 0, prevPanShift);
+            api->loadBuffer(panSamples);
+            api->dmemMove(BENCH_HEADSET_TEMP, BENCH_IN + prevPanShift, panShift + BENCH_NBYTES - prevPanShift);
+        } else {
+            api->dmemMove(BENCH_HEADSET_TEMP, BENCH_IN, panShift + BENCH_NBYTES - prevPanShift);
+        }
+    } else {
+        api->dmemMove(BENCH_IN, BENCH_HEADSET_TEMP, BENCH_NBYTES);
+        api->dmemMove(BENCH_HEADSET_TEMP, BENCH_IN + panShift, BENCH_NBYTES);
+        api->clearBuffer(BENCH_IN, panShift);
+    }
+
+    if (panShift != 0) {
+        api->setBuffer(0, 0, BENCH_IN + BENCH_NBYTES, panShift);
+        api->saveBuffer(panSamples);
+    }
+    api->setBuffer(0, 0, 0, BENCH_NBYTES);
+    api->mix(0x7fff, BENCH_IN, BENCH_DRY_L);
+}
+
+/**
+ * Pans a note around the US pan delays, from A_INIT on, through aHeadsetPan on the regular mixer and through the
+ * command sequence on the scalar one, and compares the mixed channel, resample state and held-back samples after
+ * each update. Returns the number of differing samples.
+ */
+static int bench_check_headset_pan(uint32_t seed) {
+    static const uint16_t panShifts[] = { 0x40, 0x30, 0x20, 0x10, 0 };
+    int16_t simdState[16 + 0x20] = { 0 };
+    int16_t refState[16 + 0x20] = { 0 };
+    int16_t samples[BENCH_NBYTES];
+    int16_t simdDest[BENCH_NBYTES / sizeof(int16_t)];
+    int16_t refDest[BENCH_NBYTES / sizeof(int16_t)];
+    uint32_t rng = seed;
+    uint16_t panShift = 0;
+    uint16_t prevPanShift;
+    uint16_t pitch;
+    uint8_t flags;
+    int mismatches = 0;
+    int call, i;
+
+    sSimdMixer.clearBuffer(0, BENCH_DMEM_END);
+    sRefMixer.clearBuffer(0, BENCH_DMEM_END);
+
+    for (call = 0; call < BENCH_CHECK_CALLS; call++) {
+        flags = (call == 0) ? A_INIT : A_CONTINUE;
+        prevPanShift = panShift;
+        // Mostly hold the delay, as a note does between pan changes
+        if (call == 0 || bench_rand(&rng) % 3 == 0) {
+            panShift = panShifts[bench_rand(&rng) % ARRAY_COUNT(panShifts)];
+        }
+
+        // Same formulas as note_apply_headset_pan_effects()
+        if (flags == A_INIT) {
+            pitch = 0;
+        } else if (prevPanShift == 0) {
+            pitch = (BENCH_NBYTES << 15) / (BENCH_NBYTES + panShift - prevPanShift + 8);
+        } else if (panShift == 0) {
+            pitch = (BENCH_NBYTES << 15) / (BENCH_NBYTES - prevPanShift - 4);
+        } else {
+            pitch = (BENCH_NBYTES << 15) / (BENCH_NBYTES + panShift - prevPanShift);
+        }
+
+        bench_rand_samples(&rng, samples, BENCH_NBYTES, 0x6000);
+        dmem_write(&sSimdMixer, BENCH_IN, samples, BENCH_NBYTES * 2);
+        dmem_write(&sRefMixer, BENCH_IN, samples, BENCH_NBYTES * 2);
+        bench_rand_samples(&rng, samples, BENCH_NBYTES / sizeof(int16_t), 0x6000);
+        dmem_write(&sSimdMixer, BENCH_DRY_L, samples, BENCH_NBYTES);
+        dmem_write(&sRefMixer, BENCH_DRY_L, samples, BENCH_NBYTES);
+
+        sSimdMixer.headsetPan(flags, pitch, BENCH_IN, BENCH_HEADSET_TEMP, BENCH_DRY_L, BENCH_NBYTES, panShift,
+                              prevPanShift, simdState, simdState + 16);
+        run_headset_pan_commands(&sRefMixer, flags, pitch, panShift, prevPanShift, refState, refState + 16);
+
+        dmem_read(&sSimdMixer, BENCH_DRY_L, simdDest, BENCH_NBYTES);
+        dmem_read(&sRefMixer, BENCH_DRY_L, refDest, BENCH_NBYTES);
+        for (i = 0; i < BENCH_NBYTES / (int) sizeof(int16_t); i++) {
+            mismatches += (simdDest[i] != refDest[i]);
+        }
+        // Only the held-back samples of the current delay are live
+        for (i = 0; i < 16 + panShift / (int) sizeof(int16_t); i++) {
+            mismatches += (simdState[i] != refState[i]);
+        }
+    }
+    return mismatches;
+}
+#endif
+
+// Stand-in for the engine behind audio_oversample_render(), since the benchmark is linked without the game
+s32 gAudioOversample = 1;
+static s16 sEngineOutput[BENCH_OVERSAMPLE_FRAMES * DECIMATE_MAX_FACTOR * 2];
+static u32 sEngineFrames;
+static uint32_t sEngineRng = BENCH_DEFAULT_SEED;
+
+void create_next_audio_buffer(s16 *samples, u32 num_samples) {
+    sEngineFrames = num_samples;
+    if (num_samples > BENCH_OVERSAMPLE_FRAMES * DECIMATE_MAX_FACTOR) {
+        return;
+    }
+    bench_rand_samples(&sEngineRng, sEngineOutput, num_samples * 2, 0x6000);
+    memcpy(samples, sEngineOutput, num_samples * 2 * sizeof(s16));
+}
+
+/**
+ * Renders a chain of the largest frames at 'factor' through audio_oversample_render(). Each must have the engine
+ * render 'factor' times the frames and come out as their decimation, with 'state' kept in step with the
+ * renderer's own. Returns the number of frames the engine was asked for on the first failing call, or 0.
+ */
+static u32 bench_check_oversample(int factor, DECIMATE_STATE state) {
+    s16 out[BENCH_OVERSAMPLE_FRAMES * 2];
+    s16 expected[BENCH_OVERSAMPLE_FRAMES * 2];
+    int call;
+
+    gAudioOversample = factor;
+    for (call = 0; call < BENCH_OVERSAMPLE_CALLS; call++) {
+        audio_oversample_render(out, BENCH_OVERSAMPLE_FRAMES);
+        if (sEngineFrames != (u32) (BENCH_OVERSAMPLE_FRAMES * factor)) {
+            return sEngineFrames;
+        }
+        sSimdMixer.decimateStereo(expected, sEngineOutput, BENCH_OVERSAMPLE_FRAMES, factor, state);
+        if (memcmp(out, expected, sizeof(out)) != 0) {
+            return sEngineFrames;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    static DECIMATE_STATE oversampleState;
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    uint32_t seed = BENCH_DEFAULT_SEED;
+    bool failed = false;
+    size_t i;
+    int mismatches;
+    u32 engineFrames;
+    int factor;
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        seed = (uint32_t) strtoul(argv[2], NULL, 0);
+    }
+    if (iterations <= 0 || seed == 0) {
+        fprintf(stderr, "usage: %s [iterations] [seed]\n", argv[0]);
+        return 2;
+    }
+
+    printf("mixer_bench: %s, %d iterations, %d bytes per call, seed 0x%08X\n",
+           (BENCH_SIMD_NAME != NULL) ? BENCH_SIMD_NAME : "no SIMD (comparing scalar to scalar)",
+           iterations, BENCH_NBYTES, (unsigned) seed);
+    printf("%-15s %12s %12s %8s  %s\n", "kernel", "scalar ns", "simd ns", "speedup", "check");
+
+    for (i = 0; i < sizeof(sBenchCases) / sizeof(sBenchCases[0]); i++) {
+        const struct BenchCase *bench = &sBenchCases[i];
+        double refTime = bench_time(bench, &sRefMixer, seed, iterations);
+        double simdTime = bench_time(bench, &sSimdMixer, seed, iterations);
+        int maxDiff;
+        mismatches = bench_check(bench, seed, &maxDiff);
+
+        printf("%-15s %12.1f %12.1f %7.2fx  ", bench->name, refTime, simdTime, refTime / simdTime);
+        if (mismatches == 0) {
+            printf("bit-exact\n");
+        } else if (!bench->exact) {
+            printf("approximate (%d differing, max %d)\n", mismatches, maxDiff);
+        } else {
+            printf("MISMATCH (%d differing, max %d)\n", mismatches, maxDiff);
+            failed = true;
+        }
+    }
+
+#ifndef NEW_AUDIO_UCODE
+    mismatches = bench_check_headset_pan(seed);
+    if (mismatches == 0) {
+        printf("aHeadsetPan matches the N64 command sequence bit for bit\n");
+    } else {
+        printf("aHeadsetPan differs from the N64 command sequence (%d differing)\n", mismatches);
+        failed = true;
+    }
+#endif
+
+    for (factor = 2; factor <= DECIMATE_MAX_FACTOR; factor *= 2) {
+        engineFrames = bench_check_oversample(factor, oversampleState);
+        printf("oversample %dx: %d Hz frames of %d ", factor, FINAL_SAMPLE_RATE, BENCH_OVERSAMPLE_FRAMES);
+        if (engineFrames == 0) {
+            printf("render through the decimator\n");
+        } else {
+            printf("FAILED (engine rendered %u frames)\n", (unsigned) engineFrames);
+            failed = true;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
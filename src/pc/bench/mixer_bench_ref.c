@@ -0,0 +1,6 @@
+// mixer_bench_ref.c - scalar reference copy of the mixer for mixer_bench, with its own DMEM state
+#define MIXER_NO_SIMD
+
+#include "mixer_bench_ref.h"
+
+#include "../mixer.c"
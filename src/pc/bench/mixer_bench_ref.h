@@ -0,0 +1,44 @@
+#ifndef MIXER_BENCH_REF_H
+#define MIXER_BENCH_REF_H
+
+// Renames every mixer entry point to ref_*, so a scalar-only copy of mixer.c can be linked next to the
+// regular one. Included by mixer_bench_ref.c before mixer.c, and by mixer_bench.c to declare the copy.
+
+#define aClearBufferImpl     ref_aClearBufferImpl
+#define aLoadADPCMImpl       ref_aLoadADPCMImpl
+#define aSetBufferImpl       ref_aSetBufferImpl
+#define aDMEMMoveImpl        ref_aDMEMMoveImpl
+#define aSetLoopImpl         ref_aSetLoopImpl
+#define aADPCMdecImpl        ref_aADPCMdecImpl
+#define aResampleImpl        ref_aResampleImpl
+#define aResampleStereoImpl  ref_aResampleStereoImpl
+#define aResampleHQImpl      ref_aResampleHQImpl
+#define gResamplerTaps       ref_gResamplerTaps
+#define aDecimateStereoImpl  ref_aDecimateStereoImpl
+#define aDecimateImpl        ref_aDecimateImpl
+#define aHeadsetPanImpl      ref_aHeadsetPanImpl
+#define aSignalStartImpl     ref_aSignalStartImpl
+#define aSignalEndImpl       ref_aSignalEndImpl
+#define aSetVolumeImpl       ref_aSetVolumeImpl
+#define aLoadBufferImpl      ref_aLoadBufferImpl
+#define aSaveBufferImpl      ref_aSaveBufferImpl
+#define aInterleaveImpl      ref_aInterleaveImpl
+#define aMixImpl             ref_aMixImpl
+#define aEnvMixerImpl        ref_aEnvMixerImpl
+#define aEnvSetup1Impl       ref_aEnvSetup1Impl
+#define aEnvSetup2Impl       ref_aEnvSetup2Impl
+#define aS8DecImpl           ref_aS8DecImpl
+#define aAddMixerImpl        ref_aAddMixerImpl
+#define aDuplicateImpl       ref_aDuplicateImpl
+#define aDMEMMove2Impl       ref_aDMEMMove2Impl
+#define aResampleZohImpl     ref_aResampleZohImpl
+#define aDownsampleHalfImpl  ref_aDownsampleHalfImpl
+#define aFilterImpl          ref_aFilterImpl
+#define aHiLoGainImpl        ref_aHiLoGainImpl
+#define aUnknown25Impl       ref_aUnknown25Impl
+
+// mixer.h may already have been included with the regular names
+#undef MIXER_H
+#include "../mixer.h"
+
+#endif // MIXER_BENCH_REF_H
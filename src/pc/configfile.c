@@ -53,6 +53,19 @@ unsigned int configKeyDDown      = 0x50;
 unsigned int configKeyDLeft      = 0x4B;
 unsigned int configKeyDRight     = 0x4D;
 unsigned int configSpeedupKey    = 0x0F;
+// Audio output rate in Hz; 0 uses the FINAL_SAMPLE_RATE the game was built with. At most FINAL_SAMPLE_RATE times
+// the build's AUDIO_OVERSAMPLE_MAX, divided by audio_oversample
+unsigned int configAudioSampleRate = 0;
+// Memory budget for resident banks and sequences in KiB; 0 falls back to the original two-slot pools
+unsigned int configAudioCacheKB = 16 * 1024;
+// Taps of the windowed-sinc note resampler (8, 16 or 32); 0 keeps the original 4-tap RSP filter
+unsigned int configAudioResamplerTaps = 0;
+// Synthesize at this multiple of the output rate (2 up to the build's AUDIO_OVERSAMPLE_MAX) and filter back down;
+// 0 or 1 renders at the output rate
+unsigned int configAudioOversample = 0;
+// L arms the audio dump instead of starting it: it starts at the first sound and stops after this much silence
+bool configAudioDumpAuto = false;
+unsigned int configAudioDumpSilenceMs = 3000;
 
 
 static const struct ConfigOption options[] = {
@@ -77,6 +90,12 @@ static const struct ConfigOption options[] = {
     {.name = "key_dpadleft",          .type = CONFIG_TYPE_UINT, .uintValue = &configKeyDLeft},
     {.name = "key_dpadright",         .type = CONFIG_TYPE_UINT, .uintValue = &configKeyDRight},
     {.name = "key_speedup",           .type = CONFIG_TYPE_UINT, .uintValue = &configSpeedupKey},
+    {.name = "audio_sample_rate",     .type = CONFIG_TYPE_UINT, .uintValue = &configAudioSampleRate},
+    {.name = "audio_cache_kb",        .type = CONFIG_TYPE_UINT, .uintValue = &configAudioCacheKB},
+    {.name = "audio_resampler_taps",  .type = CONFIG_TYPE_UINT, .uintValue = &configAudioResamplerTaps},
+    {.name = "audio_oversample",      .type = CONFIG_TYPE_UINT, .uintValue = &configAudioOversample},
+    {.name = "audio_dump_auto",       .type = CONFIG_TYPE_BOOL, .boolValue = &configAudioDumpAuto},
+    {.name = "audio_dump_silence_ms", .type = CONFIG_TYPE_UINT, .uintValue = &configAudioDumpSilenceMs},
 };
 
 // Reads an entire line from a file (excluding the newline character) and returns an allocated string
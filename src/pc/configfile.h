@@ -22,6 +22,12 @@ extern unsigned int configKeyDDown;
 extern unsigned int configKeyDLeft;
 extern unsigned int configKeyDRight;
 extern unsigned int configSpeedupKey;
+extern unsigned int configAudioSampleRate;
+extern unsigned int configAudioCacheKB;
+extern unsigned int configAudioResamplerTaps;
+extern unsigned int configAudioOversample;
+extern bool         configAudioDumpAuto;
+extern unsigned int configAudioDumpSilenceMs;
 
 void configfile_load(const char *filename);
 void configfile_save(const char *filename);
@@ -1,17 +1,20 @@
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include <ultra64.h>
 
 #include "mixer.h"
+#include "vadpcm.h"
 
 #include "src/audio/internal.h"
 
-#ifdef __SSE4_1__
+// MIXER_NO_SIMD forces the scalar kernels, e.g. for the reference build in src/pc/bench/mixer_bench_ref.c
+#if defined(__SSE4_1__) && !defined(MIXER_NO_SIMD)
 #include <immintrin.h>
 #define HAS_SSE41 1
 #define HAS_NEON 0
-#elif __ARM_NEON
+#elif defined(__ARM_NEON) && !defined(MIXER_NO_SIMD)
 #include <arm_neon.h>
 #define HAS_SSE41 0
 #define HAS_NEON 1
@@ -33,11 +36,11 @@
 #define ROUND_DOWN_16(v) ((v) & ~0xf)
 
 #ifdef NEW_AUDIO_UCODE
-#define BUF_SIZE ROUND_UP_32(0x1000 * FINAL_SAMPLE_RATE / 32000)
+#define BUF_SIZE ROUND_UP_32(0x1000 * MAX_AUDIO_SAMPLE_RATE / 32000)
 #define BUF_U8(a) (rspa.buf.as_u8 + ((a)))
 #define BUF_S16(a) (rspa.buf.as_s16 + ((a)) / sizeof(int16_t))
 #else
-#define BUF_SIZE ROUND_UP_32(0x1000 * FINAL_SAMPLE_RATE / 32000)
+#define BUF_SIZE ROUND_UP_32(0x1000 * MAX_AUDIO_SAMPLE_RATE / 32000)
 #define BUF_U8(a) (rspa.buf.as_u8 + (a))
 #define BUF_S16(a) (rspa.buf.as_s16 + (a) / sizeof(int16_t))
 #endif
@@ -69,6 +72,7 @@ static struct {
     ADPCM_STATE *adpcm_loop_state;
 
     int16_t adpcm_table[8][2][8];
+    struct VadpcmDecoder adpcm_decoder; // adpcm_table expanded for vadpcm.c
 
 #ifdef NEW_AUDIO_UCODE
     uint16_t filter_count;
@@ -159,6 +163,7 @@ void aSaveBufferImpl(int16_t *dest_addr) {
 
 void aLoadADPCMImpl(int num_entries_times_16, const int16_t *book_source_addr) {
     memcpy(rspa.adpcm_table, book_source_addr, num_entries_times_16);
+    vadpcm_decoder_init(&rspa.adpcm_decoder, &rspa.adpcm_table[0][0][0], 2, 8);
 }
 
 void aSetBufferImpl(uint8_t flags, uint16_t in, uint16_t out, uint16_t nbytes) {
@@ -278,23 +283,6 @@ void aSetLoopImpl(ADPCM_STATE *adpcm_loop_state) {
 }
 
 void aADPCMdecImpl(uint8_t flags, ADPCM_STATE state) {
-#if HAS_SSE41
-    const __m128i tblrev = _mm_setr_epi8(12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1, -1, -1);
-    const __m128i pos0 = _mm_set_epi8(3, -1, 3, -1, 2, -1, 2, -1, 1, -1, 1, -1, 0, -1, 0, -1);
-    const __m128i pos1 = _mm_set_epi8(7, -1, 7, -1, 6, -1, 6, -1, 5, -1, 5, -1, 4, -1, 4, -1);
-    const __m128i mult = _mm_set_epi16(0x10, 0x01, 0x10, 0x01, 0x10, 0x01, 0x10, 0x01);
-    const __m128i mask = _mm_set1_epi16((int16_t)0xf000);
-#elif HAS_NEON
-    static const int8_t pos0_data[] = {-1, 0, -1, 0, -1, 1, -1, 1, -1, 2, -1, 2, -1, 3, -1, 3};
-    static const int8_t pos1_data[] = {-1, 4, -1, 4, -1, 5, -1, 5, -1, 6, -1, 6, -1, 7, -1, 7};
-    static const int16_t mult_data[] = {0x01, 0x10, 0x01, 0x10, 0x01, 0x10, 0x01, 0x10};
-    static const int16_t table_prefix_data[] = {0, 0, 0, 0, 0, 0, 0, 1 << 11};
-    const int8x16_t pos0 = vld1q_s8(pos0_data);
-    const int8x16_t pos1 = vld1q_s8(pos1_data);
-    const int16x8_t mult = vld1q_s16(mult_data);
-    const int16x8_t mask = vdupq_n_s16((int16_t)0xf000);
-    const int16x8_t table_prefix = vld1q_s16(table_prefix_data);
-#endif
     uint8_t *in = BUF_U8(rspa.in);
     int16_t *out = BUF_S16(rspa.out);
     int nbytes = ROUND_UP_32(rspa.nbytes);
@@ -306,142 +294,13 @@ void aADPCMdecImpl(uint8_t flags, ADPCM_STATE state) {
         memcpy(out, state, 16 * sizeof(int16_t));
     }
     out += 16;
-#if HAS_SSE41
-    __m128i prev_interleaved = _mm_set1_epi32((uint16_t)out[-2] | ((uint16_t)out[-1] << 16));
-    //__m128i prev_interleaved = _mm_shuffle_epi32(_mm_loadu_si32(out - 2), 0); // GCC misses this?
-#elif HAS_NEON
-    int16x8_t result = vld1q_s16(out - 8);
-#endif
-    while (nbytes > 0) {
-        int shift = *in >> 4; // should be in 0..12
-        int table_index = *in++ & 0xf; // should be in 0..7
-        int16_t (*tbl)[8] = rspa.adpcm_table[table_index];
-        int i;
-#if HAS_SSE41
-        // The _mm_loadu_si64 instruction was added in GCC 9, and results in the same
-        // asm as the following instructions, so better be compatible with old GCC.
-        //__m128i inv = _mm_loadu_si64(in);
-        uint64_t v; memcpy(&v, in, 8);
-        __m128i inv = _mm_set_epi64x(0, v);
-        __m128i invec[2] = {_mm_shuffle_epi8(inv, pos0), _mm_shuffle_epi8(inv, pos1)};
-        __m128i tblvec0 = _mm_loadu_si128((const __m128i *)tbl[0]);
-        __m128i tblvec1 = _mm_loadu_si128((const __m128i *)(tbl[1]));
-        __m128i tbllo = _mm_unpacklo_epi16(tblvec0, tblvec1);
-        __m128i tblhi = _mm_unpackhi_epi16(tblvec0, tblvec1);
-        __m128i shiftcount = _mm_set_epi64x(0, 12 - shift); // _mm_cvtsi64_si128 does not exist on 32-bit x86
-        __m128i tblvec1_rev[8];
-
-        tblvec1_rev[0] = _mm_insert_epi16(_mm_shuffle_epi8(tblvec1, tblrev), 1 << 11, 7);
-        tblvec1_rev[1] = _mm_bsrli_si128(tblvec1_rev[0], 2);
-        tblvec1_rev[2] = _mm_bsrli_si128(tblvec1_rev[0], 4);
-        tblvec1_rev[3] = _mm_bsrli_si128(tblvec1_rev[0], 6);
-        tblvec1_rev[4] = _mm_bsrli_si128(tblvec1_rev[0], 8);
-        tblvec1_rev[5] = _mm_bsrli_si128(tblvec1_rev[0], 10);
-        tblvec1_rev[6] = _mm_bsrli_si128(tblvec1_rev[0], 12);
-        tblvec1_rev[7] = _mm_bsrli_si128(tblvec1_rev[0], 14);
-        in += 8;
-        for (i = 0; i < 2; i++) {
-            __m128i acc0 = _mm_madd_epi16(prev_interleaved, tbllo);
-            __m128i acc1 = _mm_madd_epi16(prev_interleaved, tblhi);
-            __m128i muls[8];
-            __m128i result;
-            invec[i] = _mm_sra_epi16(_mm_and_si128(_mm_mullo_epi16(invec[i], mult), mask), shiftcount);
-
-            muls[7] = _mm_madd_epi16(tblvec1_rev[0], invec[i]);
-            muls[6] = _mm_madd_epi16(tblvec1_rev[1], invec[i]);
-            muls[5] = _mm_madd_epi16(tblvec1_rev[2], invec[i]);
-            muls[4] = _mm_madd_epi16(tblvec1_rev[3], invec[i]);
-            muls[3] = _mm_madd_epi16(tblvec1_rev[4], invec[i]);
-            muls[2] = _mm_madd_epi16(tblvec1_rev[5], invec[i]);
-            muls[1] = _mm_madd_epi16(tblvec1_rev[6], invec[i]);
-            muls[0] = _mm_madd_epi16(tblvec1_rev[7], invec[i]);
-
-            acc0 = _mm_add_epi32(acc0, _mm_hadd_epi32(_mm_hadd_epi32(muls[0], muls[1]), _mm_hadd_epi32(muls[2], muls[3])));
-            acc1 = _mm_add_epi32(acc1, _mm_hadd_epi32(_mm_hadd_epi32(muls[4], muls[5]), _mm_hadd_epi32(muls[6], muls[7])));
-
-            acc0 = _mm_srai_epi32(acc0, 11);
-            acc1 = _mm_srai_epi32(acc1, 11);
-
-            result = _mm_packs_epi32(acc0, acc1);
-            _mm_storeu_si128((__m128i *)out, result);
-            out += 8;
-
-            prev_interleaved = _mm_shuffle_epi32(result, _MM_SHUFFLE(3, 3, 3, 3));
-        }
-#elif HAS_NEON
-        int8x8_t inv = vld1_s8((int8_t *)in);
-        int16x8_t tblvec[2] = {vld1q_s16(tbl[0]), vld1q_s16(tbl[1])};
-        int16x8_t invec[2] = {vreinterpretq_s16_s8(vcombine_s8(vtbl1_s8(inv, vget_low_s8(pos0)),
-                                                               vtbl1_s8(inv, vget_high_s8(pos0)))),
-                              vreinterpretq_s16_s8(vcombine_s8(vtbl1_s8(inv, vget_low_s8(pos1)),
-                                                               vtbl1_s8(inv, vget_high_s8(pos1))))};
-        int16x8_t shiftcount = vdupq_n_s16(shift - 12); // negative means right shift
-        int16x8_t tblvec1[8];
-
-        in += 8;
-        tblvec1[0] = vextq_s16(table_prefix, tblvec[1], 7);
-        invec[0] = vmulq_s16(invec[0], mult);
-        tblvec1[1] = vextq_s16(table_prefix, tblvec[1], 6);
-        invec[1] = vmulq_s16(invec[1], mult);
-        tblvec1[2] = vextq_s16(table_prefix, tblvec[1], 5);
-        tblvec1[3] = vextq_s16(table_prefix, tblvec[1], 4);
-        invec[0] = vandq_s16(invec[0], mask);
-        tblvec1[4] = vextq_s16(table_prefix, tblvec[1], 3);
-        invec[1] = vandq_s16(invec[1], mask);
-        tblvec1[5] = vextq_s16(table_prefix, tblvec[1], 2);
-        tblvec1[6] = vextq_s16(table_prefix, tblvec[1], 1);
-        invec[0] = vqshlq_s16(invec[0], shiftcount);
-        invec[1] = vqshlq_s16(invec[1], shiftcount);
-        tblvec1[7] = table_prefix;
-        for (i = 0; i < 2; i++) {
-            int32x4_t acc0;
-            int32x4_t acc1;
-
-            acc1 = vmull_lane_s16(vget_high_s16(tblvec[0]), vget_high_s16(result), 2);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec[1]), vget_high_s16(result), 3);
-            acc0 = vmull_lane_s16(vget_low_s16(tblvec[0]), vget_high_s16(result), 2);
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec[1]), vget_high_s16(result), 3);
-
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[0]), vget_low_s16(invec[i]), 0);
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[1]), vget_low_s16(invec[i]), 1);
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[2]), vget_low_s16(invec[i]), 2);
-            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[3]), vget_low_s16(invec[i]), 3);
-
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[0]), vget_low_s16(invec[i]), 0);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[1]), vget_low_s16(invec[i]), 1);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[2]), vget_low_s16(invec[i]), 2);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[3]), vget_low_s16(invec[i]), 3);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[4]), vget_high_s16(invec[i]), 0);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[5]), vget_high_s16(invec[i]), 1);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[6]), vget_high_s16(invec[i]), 2);
-            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[7]), vget_high_s16(invec[i]), 3);
-
-            result = vcombine_s16(vqshrn_n_s32(acc0, 11), vqshrn_n_s32(acc1, 11));
-            vst1q_s16(out, result);
-            out += 8;
-        }
+    // The shared decoder picks its own SSE4.1, SSE2 or NEON kernel; each 9-byte frame gives 32 bytes
+#ifdef MIXER_NO_SIMD
+    vadpcm_decode_scalar(&rspa.adpcm_decoder, in, nbytes / 32, out);
 #else
-        for (i = 0; i < 2; i++) {
-            int16_t ins[8];
-            int16_t prev1 = out[-1];
-            int16_t prev2 = out[-2];
-            int j, k;
-            for (j = 0; j < 4; j++) {
-                ins[j * 2] = (((*in >> 4) << 28) >> 28) << shift;
-                ins[j * 2 + 1] = (((*in++ & 0xf) << 28) >> 28) << shift;
-            }
-            for (j = 0; j < 8; j++) {
-                int32_t acc = tbl[0][j] * prev2 + tbl[1][j] * prev1 + (ins[j] << 11);
-                for (k = 0; k < j; k++) {
-                    acc += tbl[1][((j - k) - 1)] * ins[k];
-                }
-                acc >>= 11;
-                *out++ = clamp16(acc);
-            }
-        }
+    vadpcm_decode(&rspa.adpcm_decoder, in, nbytes / 32, out);
 #endif
-        nbytes -= 16 * sizeof(int16_t);
-    }
+    out += nbytes / sizeof(int16_t);
     memcpy(state, out - 16, 16 * sizeof(int16_t));
 }
 
@@ -595,6 +454,738 @@ void aResampleImpl(uint8_t flags, uint16_t pitch, RESAMPLE_STATE state) {
     memcpy(state + 8, in, 8 * sizeof(int16_t));
 }
 
+/*
+ * Two aResample calls with the same flags and pitch, on rspa.in/rspa.out and on the buffers right_offset bytes
+ * past them, done in one pass. Both channels step through their input identically, so the positions and
+ * filter taps are only worked out once per output sample. Used to upsample the downsampled reverb.
+ */
+void aResampleStereoImpl(uint8_t flags, uint16_t pitch, uint16_t right_offset,
+                         RESAMPLE_STATE state_left, RESAMPLE_STATE state_right) {
+    int16_t tmp[2][16];
+    int16_t *state[2] = { state_left, state_right };
+    int16_t *in_initial[2];
+    int16_t *in[2];
+    int16_t *out[2];
+    int nbytes = ROUND_UP_16(rspa.nbytes);
+    uint32_t pitch_accumulator;
+    uint16_t in_addr = rspa.in;
+    uint16_t out_addr = rspa.out;
+    int c, i;
+#if !HAS_SSE41 && !HAS_NEON
+    int16_t *tbl;
+    int32_t sample;
+#endif
+
+    // Channels that have drifted apart, or a loop restart, take the regular path
+    if ((flags & 2) || (!(flags & A_INIT) && state_left[4] != state_right[4])) {
+        aResampleImpl(flags, pitch, state_left);
+        rspa.in += right_offset;
+        rspa.out += right_offset;
+        aResampleImpl(flags, pitch, state_right);
+        rspa.in = in_addr;
+        rspa.out = out_addr;
+        return;
+    }
+
+    for (c = 0; c < 2; c++) {
+        if (flags & A_INIT) {
+            memset(tmp[c], 0, 5 * sizeof(int16_t));
+        } else {
+            memcpy(tmp[c], state[c], 16 * sizeof(int16_t));
+        }
+        in_initial[c] = BUF_S16(in_addr + (c == 0 ? 0 : right_offset));
+        out[c] = BUF_S16(out_addr + (c == 0 ? 0 : right_offset));
+        in[c] = in_initial[c] - 4;
+        memcpy(in[c], tmp[c], 4 * sizeof(int16_t));
+    }
+    pitch_accumulator = (uint16_t)tmp[0][4];
+
+#if HAS_SSE41
+    __m128i multiples = _mm_setr_epi16(0, 2, 4, 6, 8, 10, 12, 14);
+    __m128i pitchvec = _mm_set1_epi16((int16_t)pitch);
+    __m128i pitchvec_8_steps = _mm_set1_epi32((pitch << 1) * 8);
+    __m128i pitchacclo_vec = _mm_set1_epi32((uint16_t)pitch_accumulator);
+    __m128i pl = _mm_mullo_epi16(multiples, pitchvec);
+    __m128i ph = _mm_mulhi_epu16(multiples, pitchvec);
+    __m128i acc_a = _mm_add_epi32(_mm_unpacklo_epi16(pl, ph), pitchacclo_vec);
+    __m128i acc_b = _mm_add_epi32(_mm_unpackhi_epi16(pl, ph), pitchacclo_vec);
+
+    do {
+        __m128i tbl_positions = _mm_srli_epi16(_mm_packus_epi32(
+            _mm_and_si128(acc_a, _mm_set1_epi32(0xffff)),
+            _mm_and_si128(acc_b, _mm_set1_epi32(0xffff))), 10);
+
+        __m128i in_positions = _mm_packus_epi32(_mm_srli_epi32(acc_a, 16), _mm_srli_epi32(acc_b, 16));
+        __m128i tbl_entries[4];
+        __m128i samples[4];
+        int p[8];
+
+        tbl_entries[0] = LOADLH(resample_table[_mm_extract_epi16(tbl_positions, 0)], resample_table[_mm_extract_epi16(tbl_positions, 1)]);
+        tbl_entries[1] = LOADLH(resample_table[_mm_extract_epi16(tbl_positions, 2)], resample_table[_mm_extract_epi16(tbl_positions, 3)]);
+        tbl_entries[2] = LOADLH(resample_table[_mm_extract_epi16(tbl_positions, 4)], resample_table[_mm_extract_epi16(tbl_positions, 5)]);
+        tbl_entries[3] = LOADLH(resample_table[_mm_extract_epi16(tbl_positions, 6)], resample_table[_mm_extract_epi16(tbl_positions, 7)]);
+        p[0] = _mm_extract_epi16(in_positions, 0);
+        p[1] = _mm_extract_epi16(in_positions, 1);
+        p[2] = _mm_extract_epi16(in_positions, 2);
+        p[3] = _mm_extract_epi16(in_positions, 3);
+        p[4] = _mm_extract_epi16(in_positions, 4);
+        p[5] = _mm_extract_epi16(in_positions, 5);
+        p[6] = _mm_extract_epi16(in_positions, 6);
+        p[7] = _mm_extract_epi16(in_positions, 7);
+
+        for (c = 0; c < 2; c++) {
+            samples[0] = _mm_mulhrs_epi16(LOADLH(&in[c][p[0]], &in[c][p[1]]), tbl_entries[0]);
+            samples[1] = _mm_mulhrs_epi16(LOADLH(&in[c][p[2]], &in[c][p[3]]), tbl_entries[1]);
+            samples[2] = _mm_mulhrs_epi16(LOADLH(&in[c][p[4]], &in[c][p[5]]), tbl_entries[2]);
+            samples[3] = _mm_mulhrs_epi16(LOADLH(&in[c][p[6]], &in[c][p[7]]), tbl_entries[3]);
+            _mm_storeu_si128((__m128i *)out[c], _mm_hadds_epi16(_mm_hadds_epi16(samples[0], samples[1]), _mm_hadds_epi16(samples[2], samples[3])));
+            out[c] += 8;
+        }
+
+        acc_a = _mm_add_epi32(acc_a, pitchvec_8_steps);
+        acc_b = _mm_add_epi32(acc_b, pitchvec_8_steps);
+        nbytes -= 8 * sizeof(int16_t);
+    } while (nbytes > 0);
+    in[0] += (uint16_t)_mm_extract_epi16(acc_a, 1);
+    in[1] += (uint16_t)_mm_extract_epi16(acc_a, 1);
+    pitch_accumulator = (uint16_t)_mm_extract_epi16(acc_a, 0);
+#elif HAS_NEON
+    static const uint16_t multiples_data[8] = {0, 2, 4, 6, 8, 10, 12, 14};
+    uint16x8_t multiples = vld1q_u16(multiples_data);
+    uint32x4_t pitchvec_8_steps = vdupq_n_u32((pitch << 1) * 8);
+    uint32x4_t pitchacclo_vec = vdupq_n_u32((uint16_t)pitch_accumulator);
+    uint32x4_t acc_a = vmlal_n_u16(pitchacclo_vec, vget_low_u16(multiples), pitch);
+    uint32x4_t acc_b = vmlal_n_u16(pitchacclo_vec, vget_high_u16(multiples), pitch);
+
+    do {
+        uint16x8x2_t unzipped = vuzpq_u16(vreinterpretq_u16_u32(acc_a), vreinterpretq_u16_u32(acc_b));
+        uint16x8_t tbl_positions = vshrq_n_u16(unzipped.val[0], 10);
+        uint16_t p[8];
+        int16x8_t tbl_entries[4];
+        int16x8_t samples[4];
+        int16x8x2_t unzipped1;
+        int16x8x2_t unzipped2;
+
+        vst1q_u16(p, unzipped.val[1]);
+        tbl_entries[0] = vcombine_s16(vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 0)]), vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 1)]));
+        tbl_entries[1] = vcombine_s16(vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 2)]), vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 3)]));
+        tbl_entries[2] = vcombine_s16(vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 4)]), vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 5)]));
+        tbl_entries[3] = vcombine_s16(vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 6)]), vld1_s16(resample_table[vgetq_lane_u16(tbl_positions, 7)]));
+
+        for (c = 0; c < 2; c++) {
+            samples[0] = vqrdmulhq_s16(vcombine_s16(vld1_s16(&in[c][p[0]]), vld1_s16(&in[c][p[1]])), tbl_entries[0]);
+            samples[1] = vqrdmulhq_s16(vcombine_s16(vld1_s16(&in[c][p[2]]), vld1_s16(&in[c][p[3]])), tbl_entries[1]);
+            samples[2] = vqrdmulhq_s16(vcombine_s16(vld1_s16(&in[c][p[4]]), vld1_s16(&in[c][p[5]])), tbl_entries[2]);
+            samples[3] = vqrdmulhq_s16(vcombine_s16(vld1_s16(&in[c][p[6]]), vld1_s16(&in[c][p[7]])), tbl_entries[3]);
+
+            unzipped1 = vuzpq_s16(samples[0], samples[1]);
+            unzipped2 = vuzpq_s16(samples[2], samples[3]);
+            samples[0] = vqaddq_s16(unzipped1.val[0], unzipped1.val[1]);
+            samples[1] = vqaddq_s16(unzipped2.val[0], unzipped2.val[1]);
+            unzipped1 = vuzpq_s16(samples[0], samples[1]);
+            vst1q_s16(out[c], vqaddq_s16(unzipped1.val[0], unzipped1.val[1]));
+            out[c] += 8;
+        }
+
+        acc_a = vaddq_u32(acc_a, pitchvec_8_steps);
+        acc_b = vaddq_u32(acc_b, pitchvec_8_steps);
+        nbytes -= 8 * sizeof(int16_t);
+    } while (nbytes > 0);
+    in[0] += vgetq_lane_u16(vreinterpretq_u16_u32(acc_a), 1);
+    in[1] += vgetq_lane_u16(vreinterpretq_u16_u32(acc_a), 1);
+    pitch_accumulator = vgetq_lane_u16(vreinterpretq_u16_u32(acc_a), 0);
+#else
+    do {
+        for (i = 0; i < 8; i++) {
+            tbl = resample_table[pitch_accumulator * 64 >> 16];
+            for (c = 0; c < 2; c++) {
+                sample = ((in[c][0] * tbl[0] + 0x4000) >> 15) +
+                         ((in[c][1] * tbl[1] + 0x4000) >> 15) +
+                         ((in[c][2] * tbl[2] + 0x4000) >> 15) +
+                         ((in[c][3] * tbl[3] + 0x4000) >> 15);
+                *out[c]++ = clamp16(sample);
+            }
+
+            pitch_accumulator += (pitch << 1);
+            in[0] += pitch_accumulator >> 16;
+            in[1] += pitch_accumulator >> 16;
+            pitch_accumulator %= 0x10000;
+        }
+        nbytes -= 8 * sizeof(int16_t);
+    } while (nbytes > 0);
+#endif
+
+    for (c = 0; c < 2; c++) {
+        state[c][4] = (int16_t)pitch_accumulator;
+        memcpy(state[c], in[c], 4 * sizeof(int16_t));
+        i = (in[c] - in_initial[c] + 4) & 7;
+        in[c] -= i;
+        if (i != 0) {
+            i = -8 - i;
+        }
+        state[c][5] = i;
+        memcpy(state[c] + 8, in[c], 8 * sizeof(int16_t));
+    }
+}
+
+/*
+ * The pan delay of the headset sound mode in one call, in place of the aResample, aDMEMMove, aLoadBuffer,
+ * aSaveBuffer and aMix sequence note_apply_headset_pan_effects() issues per note. The note's dry signal for
+ * the far ear is in pan_addr. It gets delayed by pan_shift bytes and mixed into dest_addr. When the delay
+ * changes (anything but A_INIT), the signal is first resampled with 'pitch' into temp_addr to stretch it to
+ * the new delay. The delayed signal is mixed straight from its pieces: the samples held back from the last
+ * update (pan_samples), then the new ones. The pieces are never assembled in DMEM. The result matches that
+ * sequence on the scalar mixer bit for bit, on every path (mixer_bench checks both).
+ */
+
+static const int16_t headset_pan_zeros[0x20];
+
+static void headset_pan_mix(int16_t *out, const int16_t *in, int count) {
+    int i = 0;
+
+    // The RSP's aMix arithmetic with a gain of 0x7fff on every path, which the SIMD paths of aMix only
+    // approximate: (out + in) * 0x7fff rounded is (out + in) + ((0x4000 - (out + in)) >> 15), in 32 bits
+#if HAS_SSE41
+    __m128i round_vec = _mm_set1_epi32(0x4000);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i out_vec = _mm_loadu_si128((const __m128i *)(out + i));
+        __m128i in_vec = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i sum_lo = _mm_add_epi32(_mm_cvtepi16_epi32(out_vec), _mm_cvtepi16_epi32(in_vec));
+        __m128i sum_hi = _mm_add_epi32(_mm_cvtepi16_epi32(_mm_srli_si128(out_vec, 8)),
+                                       _mm_cvtepi16_epi32(_mm_srli_si128(in_vec, 8)));
+        sum_lo = _mm_add_epi32(sum_lo, _mm_srai_epi32(_mm_sub_epi32(round_vec, sum_lo), 15));
+        sum_hi = _mm_add_epi32(sum_hi, _mm_srai_epi32(_mm_sub_epi32(round_vec, sum_hi), 15));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(sum_lo, sum_hi));
+    }
+#elif HAS_NEON
+    int32x4_t round_vec = vdupq_n_s32(0x4000);
+
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t out_vec = vld1q_s16(out + i);
+        int16x8_t in_vec = vld1q_s16(in + i);
+        int32x4_t sum_lo = vaddl_s16(vget_low_s16(out_vec), vget_low_s16(in_vec));
+        int32x4_t sum_hi = vaddl_s16(vget_high_s16(out_vec), vget_high_s16(in_vec));
+        sum_lo = vaddq_s32(sum_lo, vshrq_n_s32(vsubq_s32(round_vec, sum_lo), 15));
+        sum_hi = vaddq_s32(sum_hi, vshrq_n_s32(vsubq_s32(round_vec, sum_hi), 15));
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(sum_lo), vqmovn_s32(sum_hi)));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = clamp16(((out[i] * 0x7fff + in[i] * 0x7fff) + 0x4000) >> 15);
+    }
+}
+
+void aHeadsetPanImpl(uint8_t flags, uint16_t pitch, uint16_t pan_addr, uint16_t temp_addr, uint16_t dest_addr,
+                     uint16_t nbytes, uint16_t pan_shift, uint16_t prev_pan_shift,
+                     RESAMPLE_STATE state, int16_t *pan_samples) {
+    int16_t *pan = BUF_S16(pan_addr);
+    int16_t *dest = BUF_S16(dest_addr);
+    const int16_t *tail;
+    int n = nbytes / sizeof(int16_t);
+    int shift = pan_shift / sizeof(int16_t);
+    int prev = prev_pan_shift / sizeof(int16_t);
+    int zeros;
+
+    if (flags & A_INIT) {
+        // Just shift right. The RSP clears the gap in whole 16 byte rows, which can eat into the signal.
+        zeros = ROUND_UP_16(pan_shift) / sizeof(int16_t);
+        headset_pan_mix(dest, headset_pan_zeros, zeros);
+        headset_pan_mix(dest + zeros, pan + zeros - shift, n - zeros);
+        tail = pan + n - shift;
+    } else {
+        if (prev == 0) {
+            // The first samples become the resampler history, with the pitch accumulator at 0
+            memcpy(state, pan, 4 * sizeof(int16_t));
+            memset(state + 4, 0, 4 * sizeof(int16_t));
+            memcpy(state + 8, pan, 8 * sizeof(int16_t));
+            rspa.in = pan_addr + 8;
+        } else {
+            rspa.in = pan_addr;
+        }
+        rspa.out = temp_addr;
+        rspa.nbytes = pan_shift + nbytes - prev_pan_shift;
+        aResampleImpl(0, pitch, state);
+
+        headset_pan_mix(dest, pan_samples, prev);
+        headset_pan_mix(dest + prev, BUF_S16(temp_addr), n - prev);
+        tail = BUF_S16(temp_addr) + n - prev;
+    }
+
+    // Save excessive samples for next iteration
+    memcpy(pan_samples, tail, shift * sizeof(int16_t));
+}
+
+/*
+ * Optional windowed-sinc replacement for aResample, used for the final per-note resample when
+ * gResamplerTaps is 8, 16 or 32. Each tap count has a polyphase filter bank per pitch band, so that
+ * higher pitches (which skip through the input faster) get a lower cutoff instead of aliasing.
+ * Unlike the RSP's 4-tap filter, the history doesn't fit in a RESAMPLE_STATE, hence the separate state.
+ */
+
+#define RESAMPLE_HQ_PHASE_BITS 7
+#define RESAMPLE_HQ_PHASES (1 << RESAMPLE_HQ_PHASE_BITS)
+#define RESAMPLE_HQ_BANDS 5
+#define RESAMPLE_HQ_COEF_SHIFT 14
+
+int gResamplerTaps = 0;
+
+STATIC_ASSERT(sizeof(((struct NoteSynthesisBuffers *) 0)->finalResampleStateHQ) == sizeof(RESAMPLE_HQ_STATE),
+              "finalResampleStateHQ must match RESAMPLE_HQ_STATE");
+
+// [band][phase][tap], Q14
+static ALIGNED32 int16_t resample_hq_table_8[RESAMPLE_HQ_BANDS][RESAMPLE_HQ_PHASES][8];
+static ALIGNED32 int16_t resample_hq_table_16[RESAMPLE_HQ_BANDS][RESAMPLE_HQ_PHASES][16];
+static ALIGNED32 int16_t resample_hq_table_32[RESAMPLE_HQ_BANDS][RESAMPLE_HQ_PHASES][32];
+static bool resample_hq_tables_built;
+
+static int16_t resample_hq_buf[RESAMPLE_HQ_MAX_TAPS + BUF_SIZE / sizeof(int16_t)];
+
+static double resample_hq_bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    int k;
+
+    for (k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static void resample_hq_build_table(int16_t *table, int taps) {
+    double coefs[RESAMPLE_HQ_MAX_TAPS];
+    double beta = 2.0 + taps * 0.25;
+    double cutoff;
+    double sum;
+    double x;
+    double r;
+    int32_t quantized;
+    int32_t total;
+    int band, phase, j, largest;
+
+    for (band = 0; band < RESAMPLE_HQ_BANDS; band++) {
+        // Band n covers pitch steps up to 1 + n / 4 input samples per output sample
+        cutoff = 0.9 / (1.0 + band * 0.25);
+
+        for (phase = 0; phase < RESAMPLE_HQ_PHASES; phase++) {
+            sum = 0.0;
+            for (j = 0; j < taps; j++) {
+                // Same alignment as resample_table: phase 0 lands on tap taps / 2 - 1
+                x = j - (taps / 2 - 1) - (double) phase / RESAMPLE_HQ_PHASES;
+                r = x / (taps / 2);
+                coefs[j] = (x == 0.0) ? cutoff : sin(M_PI * cutoff * x) / (M_PI * x);
+                coefs[j] *= (r * r < 1.0) ? resample_hq_bessel_i0(beta * sqrt(1.0 - r * r)) / resample_hq_bessel_i0(beta) : 0.0;
+                sum += coefs[j];
+            }
+
+            // Normalize to unity gain at DC, putting the rounding error on the largest tap
+            total = 0;
+            largest = 0;
+            for (j = 0; j < taps; j++) {
+                quantized = (int32_t) lrint(coefs[j] / sum * (1 << RESAMPLE_HQ_COEF_SHIFT));
+                table[j] = quantized;
+                total += quantized;
+                if (coefs[j] > coefs[largest]) {
+                    largest = j;
+                }
+            }
+            table[largest] += (1 << RESAMPLE_HQ_COEF_SHIFT) - total;
+            table += taps;
+        }
+    }
+}
+
+static int16_t *resample_hq_get_table(int taps, uint16_t pitch) {
+    // pitch is the step in input samples per output sample, as 1.15 fixed point
+    int band = (pitch <= 0x8000) ? 0 : (pitch - 0x8000 + 0x1fff) >> 13;
+
+    if (!resample_hq_tables_built) {
+        resample_hq_build_table(resample_hq_table_8[0][0], 8);
+        resample_hq_build_table(resample_hq_table_16[0][0], 16);
+        resample_hq_build_table(resample_hq_table_32[0][0], 32);
+        resample_hq_tables_built = true;
+    }
+    if (band >= RESAMPLE_HQ_BANDS) {
+        band = RESAMPLE_HQ_BANDS - 1;
+    }
+
+    switch (taps) {
+        case 8:
+            return resample_hq_table_8[band][0];
+        case 16:
+            return resample_hq_table_16[band][0];
+        default:
+            return resample_hq_table_32[band][0];
+    }
+}
+
+/**
+ * Filters n_samples outputs starting at input position pos (16.16) and returns the position after them.
+ * Always inlined with a constant tap count, so that the tap loops unroll completely.
+ */
+static ALWAYS_INLINE uint32_t resample_hq_kernel(int16_t *out, int n_samples, const int16_t *buf,
+                                                 const int16_t *table, uint32_t pos, uint32_t step, const int taps) {
+    int i, j;
+#if HAS_SSE41
+    __m128i rounding = _mm_set1_epi32(1 << (RESAMPLE_HQ_COEF_SHIFT - 1));
+    __m128i sums[4];
+    int k;
+
+    for (i = 0; i < n_samples; i += 4) {
+        for (k = 0; k < 4; k++) {
+            const int16_t *src = buf + (pos >> 16);
+            const int16_t *coef = table + (((pos & 0xffff) >> (16 - RESAMPLE_HQ_PHASE_BITS)) * taps);
+#ifdef __AVX2__
+            if (taps >= 16) {
+                __m256i acc = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) src),
+                                                _mm256_load_si256((const __m256i *) coef));
+                for (j = 16; j < taps; j += 16) {
+                    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) (src + j)),
+                                                                  _mm256_load_si256((const __m256i *) (coef + j))));
+                }
+                sums[k] = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+            } else
+#endif
+            {
+                sums[k] = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) src), _mm_load_si128((const __m128i *) coef));
+                for (j = 8; j < taps; j += 8) {
+                    sums[k] = _mm_add_epi32(sums[k], _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (src + j)),
+                                                                    _mm_load_si128((const __m128i *) (coef + j))));
+                }
+            }
+            pos += step;
+        }
+
+        __m128i totals = _mm_hadd_epi32(_mm_hadd_epi32(sums[0], sums[1]), _mm_hadd_epi32(sums[2], sums[3]));
+        totals = _mm_srai_epi32(_mm_add_epi32(totals, rounding), RESAMPLE_HQ_COEF_SHIFT);
+        _mm_storel_epi64((__m128i *) (out + i), _mm_packs_epi32(totals, totals));
+    }
+#elif HAS_NEON
+    for (i = 0; i < n_samples; i++) {
+        const int16_t *src = buf + (pos >> 16);
+        const int16_t *coef = table + (((pos & 0xffff) >> (16 - RESAMPLE_HQ_PHASE_BITS)) * taps);
+        int32x4_t acc = vdupq_n_s32(0);
+        int32x2_t total;
+
+        for (j = 0; j < taps; j += 8) {
+            int16x8_t s = vld1q_s16(src + j);
+            int16x8_t c = vld1q_s16(coef + j);
+            acc = vmlal_s16(acc, vget_low_s16(s), vget_low_s16(c));
+            acc = vmlal_s16(acc, vget_high_s16(s), vget_high_s16(c));
+        }
+        total = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+        total = vpadd_s32(total, total);
+        out[i] = clamp16((vget_lane_s32(total, 0) + (1 << (RESAMPLE_HQ_COEF_SHIFT - 1))) >> RESAMPLE_HQ_COEF_SHIFT);
+        pos += step;
+    }
+#else
+    int32_t sum;
+
+    for (i = 0; i < n_samples; i++) {
+        const int16_t *src = buf + (pos >> 16);
+        const int16_t *coef = table + (((pos & 0xffff) >> (16 - RESAMPLE_HQ_PHASE_BITS)) * taps);
+
+        sum = 0;
+        for (j = 0; j < taps; j++) {
+            sum += src[j] * coef[j];
+        }
+        out[i] = clamp16((sum + (1 << (RESAMPLE_HQ_COEF_SHIFT - 1))) >> RESAMPLE_HQ_COEF_SHIFT);
+        pos += step;
+    }
+#endif
+    return pos;
+}
+
+void aResampleHQImpl(uint8_t flags, uint16_t pitch, RESAMPLE_HQ_STATE state) {
+    int16_t *in = BUF_S16(rspa.in);
+    int16_t *out = BUF_S16(rspa.out);
+    int n_samples = ROUND_UP_16(rspa.nbytes) / sizeof(int16_t);
+    int taps = (gResamplerTaps <= 8) ? 8 : (gResamplerTaps <= 16) ? 16 : 32;
+    int16_t *table = resample_hq_get_table(taps, pitch);
+    // The buffer always holds RESAMPLE_HQ_MAX_TAPS samples of history, of which only the last 'taps' are used
+    int16_t *buf = resample_hq_buf + RESAMPLE_HQ_MAX_TAPS - taps;
+    uint32_t step = (uint32_t) pitch << 1;
+    uint32_t pos;
+    int n_in;
+
+    if (flags & A_INIT) {
+        memset(state, 0, sizeof(RESAMPLE_HQ_STATE));
+    }
+    pos = (uint16_t) state[RESAMPLE_HQ_MAX_TAPS];
+
+    // Reads exactly as many new input samples as aResample would, since both keep 'taps' samples of history
+    n_in = (pos + step * n_samples) >> 16;
+    if (n_in > (int) (BUF_SIZE / sizeof(int16_t))) {
+        n_in = BUF_SIZE / sizeof(int16_t);
+    }
+    memcpy(resample_hq_buf, state, RESAMPLE_HQ_MAX_TAPS * sizeof(int16_t));
+    memcpy(resample_hq_buf + RESAMPLE_HQ_MAX_TAPS, in, n_in * sizeof(int16_t));
+
+    switch (taps) {
+        case 8:
+            pos = resample_hq_kernel(out, n_samples, buf, table, pos, step, 8);
+            break;
+        case 16:
+            pos = resample_hq_kernel(out, n_samples, buf, table, pos, step, 16);
+            break;
+        default:
+            pos = resample_hq_kernel(out, n_samples, buf, table, pos, step, 32);
+            break;
+    }
+
+    // Keep the last RESAMPLE_HQ_MAX_TAPS samples before the next read position as history
+    memcpy(state, resample_hq_buf + (pos >> 16), RESAMPLE_HQ_MAX_TAPS * sizeof(int16_t));
+    state[RESAMPLE_HQ_MAX_TAPS] = (int16_t) (pos & 0xffff);
+}
+
+/*
+ * Decimator for oversampled rendering (gAudioOversample), where the engine runs at factor times the output rate
+ * and this brings its interleaved stereo output back down, and for the reverb input on downsampling presets.
+ * Each factor has a Kaiser-windowed sinc lowpass of
+ * 32 * factor taps (the last one always zero) with its cutoff at the output Nyquist frequency, which makes the
+ * 2x filter a half-band filter. Only the kept output samples are ever computed.
+ */
+
+#define DECIMATE_COEF_SHIFT 15
+#define DECIMATE_CHUNK 256
+
+// [factor - 2][tap], Q15
+static ALIGNED32 int16_t decimate_table[DECIMATE_MAX_FACTOR - 1][DECIMATE_MAX_TAPS];
+static bool decimate_tables_built;
+
+// History, a chunk of input and room for the last group of 4 outputs to read past the end
+static ALIGNED32 int16_t decimate_buf[DECIMATE_MAX_TAPS + (DECIMATE_CHUNK + 4) * DECIMATE_MAX_FACTOR];
+static ALIGNED32 int16_t decimate_out[DECIMATE_CHUNK + 4];
+
+static void decimate_build_table(int16_t *table, int factor) {
+    double coefs[DECIMATE_MAX_TAPS];
+    int taps = 32 * factor - 1;
+    double beta = 7.86; // about 80 dB of stopband attenuation
+    double sum = 0.0;
+    double x;
+    double r;
+    int32_t quantized;
+    int32_t total = 0;
+    int j;
+
+    for (j = 0; j < taps; j++) {
+        x = j - (taps - 1) / 2;
+        r = x / ((taps - 1) / 2);
+        coefs[j] = (x == 0.0) ? 1.0 / factor : sin(M_PI * x / factor) / (M_PI * x);
+        coefs[j] *= resample_hq_bessel_i0(beta * sqrt(1.0 - r * r)) / resample_hq_bessel_i0(beta);
+        sum += coefs[j];
+    }
+
+    // Unity gain at DC, with the rounding error on the center tap
+    for (j = 0; j < taps; j++) {
+        quantized = (int32_t) lrint(coefs[j] / sum * (1 << DECIMATE_COEF_SHIFT));
+        table[j] = quantized;
+        total += quantized;
+    }
+    table[(taps - 1) / 2] += (1 << DECIMATE_COEF_SHIFT) - total;
+    table[taps] = 0;
+}
+
+/**
+ * Filters n_out samples of one channel, each taking the next 'factor' input samples. buf starts with
+ * taps - factor samples of history. Always inlined with constant arguments, like resample_hq_kernel.
+ */
+static ALWAYS_INLINE void decimate_kernel(int16_t *out, int n_out, const int16_t *buf, const int16_t *table,
+                                          const int factor) {
+    const int taps = 32 * factor;
+    int i, j;
+#if HAS_SSE41
+    __m128i rounding = _mm_set1_epi32(1 << (DECIMATE_COEF_SHIFT - 1));
+    __m128i sums[4];
+    int k;
+
+    for (i = 0; i < n_out; i += 4) {
+        for (k = 0; k < 4; k++) {
+            const int16_t *src = buf + (i + k) * factor;
+#ifdef __AVX2__
+            __m256i acc = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) src),
+                                            _mm256_load_si256((const __m256i *) table));
+            for (j = 16; j < taps; j += 16) {
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) (src + j)),
+                                                              _mm256_load_si256((const __m256i *) (table + j))));
+            }
+            sums[k] = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+#else
+            sums[k] = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) src), _mm_load_si128((const __m128i *) table));
+            for (j = 8; j < taps; j += 8) {
+                sums[k] = _mm_add_epi32(sums[k], _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (src + j)),
+                                                                _mm_load_si128((const __m128i *) (table + j))));
+            }
+#endif
+        }
+
+        __m128i totals = _mm_hadd_epi32(_mm_hadd_epi32(sums[0], sums[1]), _mm_hadd_epi32(sums[2], sums[3]));
+        totals = _mm_srai_epi32(_mm_add_epi32(totals, rounding), DECIMATE_COEF_SHIFT);
+        _mm_storel_epi64((__m128i *) (out + i), _mm_packs_epi32(totals, totals));
+    }
+#elif HAS_NEON
+    for (i = 0; i < n_out; i++) {
+        const int16_t *src = buf + i * factor;
+        int32x4_t acc = vdupq_n_s32(0);
+        int32x2_t total;
+
+        for (j = 0; j < taps; j += 8) {
+            int16x8_t s = vld1q_s16(src + j);
+            int16x8_t c = vld1q_s16(table + j);
+            acc = vmlal_s16(acc, vget_low_s16(s), vget_low_s16(c));
+            acc = vmlal_s16(acc, vget_high_s16(s), vget_high_s16(c));
+        }
+        total = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+        total = vpadd_s32(total, total);
+        out[i] = clamp16((vget_lane_s32(total, 0) + (1 << (DECIMATE_COEF_SHIFT - 1))) >> DECIMATE_COEF_SHIFT);
+    }
+#else
+    int32_t sum;
+
+    for (i = 0; i < n_out; i++) {
+        const int16_t *src = buf + i * factor;
+
+        sum = 0;
+        for (j = 0; j < taps; j++) {
+            sum += src[j] * table[j];
+        }
+        out[i] = clamp16((sum + (1 << (DECIMATE_COEF_SHIFT - 1))) >> DECIMATE_COEF_SHIFT);
+    }
+#endif
+}
+
+/**
+ * Decimates n_out samples of one channel, reading and writing with the given strides (2 for interleaved stereo).
+ * history holds the last 32 * factor - factor input samples between calls.
+ */
+static void decimate_channel(int16_t *out, int out_stride, const int16_t *in, int in_stride, int n_out, int factor,
+                             int16_t *history) {
+    int history_len = 32 * factor - factor;
+    int16_t *table;
+    int n, i;
+
+    if (!decimate_tables_built) {
+        for (i = 2; i <= DECIMATE_MAX_FACTOR; i++) {
+            decimate_build_table(decimate_table[i - 2], i);
+        }
+        decimate_tables_built = true;
+    }
+    table = decimate_table[factor - 2];
+
+    for (; n_out > 0; n_out -= n) {
+        n = (n_out < DECIMATE_CHUNK) ? n_out : DECIMATE_CHUNK;
+
+        memcpy(decimate_buf, history, history_len * sizeof(int16_t));
+        if (in_stride == 1) {
+            memcpy(decimate_buf + history_len, in, n * factor * sizeof(int16_t));
+        } else {
+            for (i = 0; i < n * factor; i++) {
+                decimate_buf[history_len + i] = in[i * in_stride];
+            }
+        }
+
+        switch (factor) {
+            case 2:
+                decimate_kernel(decimate_out, n, decimate_buf, table, 2);
+                break;
+            case 3:
+                decimate_kernel(decimate_out, n, decimate_buf, table, 3);
+                break;
+            default:
+                decimate_kernel(decimate_out, n, decimate_buf, table, 4);
+                break;
+        }
+
+        memcpy(history, decimate_buf + n * factor, history_len * sizeof(int16_t));
+        if (out_stride == 1) {
+            memcpy(out, decimate_out, n * sizeof(int16_t));
+        } else {
+            for (i = 0; i < n; i++) {
+                out[i * out_stride] = decimate_out[i];
+            }
+        }
+
+        in += n * factor * in_stride;
+        out += n * out_stride;
+    }
+}
+
+void aDecimateStereoImpl(int16_t *out, const int16_t *in, int n_frames, int factor, DECIMATE_STATE state) {
+    if (factor < 2 || factor > DECIMATE_MAX_FACTOR) {
+        return;
+    }
+    decimate_channel(out, 2, in, 2, n_frames, factor, state[0]);
+    decimate_channel(out + 1, 2, in + 1, 2, n_frames, factor, state[1]);
+}
+
+void aDecimateImpl(int16_t *out, const int16_t *in, int n_out, int factor, int16_t history[DECIMATE_MAX_TAPS]) {
+    if (factor < 2 || factor > DECIMATE_MAX_FACTOR) {
+        return;
+    }
+    decimate_channel(out, 1, in, 1, n_out, factor, history);
+}
+
+/*
+ * Level scans for starting and stopping audio dumps on silence. A sample is loud when its magnitude is above
+ * 'threshold'. Blocks of 8 are checked at once and only the block that holds the answer is searched sample by
+ * sample.
+ */
+static inline bool signal_loud(int16_t sample, int16_t threshold) {
+    return sample > threshold || sample < -threshold;
+}
+
+static inline bool signal_block_loud(const int16_t *in, int16_t threshold) {
+#if HAS_SSE41
+    __m128i x = _mm_loadu_si128((const __m128i *) in);
+    // Saturating negation, so that -32768 comes out as 32767 rather than staying negative
+    __m128i magnitude = _mm_max_epi16(x, _mm_subs_epi16(_mm_setzero_si128(), x));
+    return _mm_movemask_epi8(_mm_cmpgt_epi16(magnitude, _mm_set1_epi16(threshold))) != 0;
+#elif HAS_NEON
+    uint64x2_t loud = vreinterpretq_u64_u16(vcgtq_s16(vqabsq_s16(vld1q_s16(in)), vdupq_n_s16(threshold)));
+    return (vgetq_lane_u64(loud, 0) | vgetq_lane_u64(loud, 1)) != 0;
+#else
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        if (signal_loud(in[i], threshold)) {
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+// Index of the first loud sample, or count if there is none
+int aSignalStartImpl(const int16_t *in, int count, int16_t threshold) {
+    int i = 0;
+
+    while (i + 8 <= count && !signal_block_loud(in + i, threshold)) {
+        i += 8;
+    }
+    for (; i < count; i++) {
+        if (signal_loud(in[i], threshold)) {
+            return i;
+        }
+    }
+    return count;
+}
+
+// One past the last loud sample, or 0 if there is none
+int aSignalEndImpl(const int16_t *in, int count, int16_t threshold) {
+    int i = count;
+
+    while (i >= 8 && !signal_block_loud(in + i - 8, threshold)) {
+        i -= 8;
+    }
+    for (; i > 0; i--) {
+        if (signal_loud(in[i - 1], threshold)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
 #ifdef NEW_AUDIO_UCODE
 void aEnvSetup1Impl(uint8_t initial_vol_wet, uint16_t rate_wet, uint16_t rate_left, uint16_t rate_right) {
     rspa.vol_wet = (uint16_t)(initial_vol_wet << 8);
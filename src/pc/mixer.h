@@ -43,6 +43,29 @@ void aDMEMMoveImpl(uint16_t in_addr, uint16_t out_addr, int nbytes);
 void aSetLoopImpl(ADPCM_STATE *adpcm_loop_state);
 void aADPCMdecImpl(uint8_t flags, ADPCM_STATE state);
 void aResampleImpl(uint8_t flags, uint16_t pitch, RESAMPLE_STATE state);
+void aResampleStereoImpl(uint8_t flags, uint16_t pitch, uint16_t right_offset,
+                         RESAMPLE_STATE state_left, RESAMPLE_STATE state_right);
+void aHeadsetPanImpl(uint8_t flags, uint16_t pitch, uint16_t pan_addr, uint16_t temp_addr, uint16_t dest_addr,
+                     uint16_t nbytes, uint16_t pan_shift, uint16_t prev_pan_shift,
+                     RESAMPLE_STATE state, int16_t *pan_samples);
+
+// Windowed-sinc resampler with 8, 16 or 32 taps (gResamplerTaps), 0 keeps the original aResample
+#define RESAMPLE_HQ_MAX_TAPS 32
+typedef int16_t RESAMPLE_HQ_STATE[RESAMPLE_HQ_MAX_TAPS + 8];
+extern int gResamplerTaps;
+void aResampleHQImpl(uint8_t flags, uint16_t pitch, RESAMPLE_HQ_STATE state);
+
+// Lowpass and decimate interleaved stereo by 2, 3 or 4, for rendering at a multiple of the output rate
+#define DECIMATE_MAX_FACTOR 4
+#define DECIMATE_MAX_TAPS (32 * DECIMATE_MAX_FACTOR)
+typedef int16_t DECIMATE_STATE[2][DECIMATE_MAX_TAPS];
+void aDecimateStereoImpl(int16_t *out, const int16_t *in, int n_frames, int factor, DECIMATE_STATE state);
+// Same filter on a single channel, e.g. the reverb input before it gets downsampled
+void aDecimateImpl(int16_t *out, const int16_t *in, int n_out, int factor, int16_t history[DECIMATE_MAX_TAPS]);
+
+// Where the signal starts and ends in a buffer, ignoring anything within +/-threshold
+int aSignalStartImpl(const int16_t *in, int count, int16_t threshold);
+int aSignalEndImpl(const int16_t *in, int count, int16_t threshold);
 
 #ifndef NEW_AUDIO_UCODE
 void aSetVolumeImpl(uint8_t flags, int16_t v, int16_t t, int16_t r);
@@ -81,6 +104,9 @@ void aUnknown25Impl(uint8_t f, uint16_t count, uint16_t out_addr, uint16_t in_ad
 #define aSetLoop(pkt, a) aSetLoopImpl(a)
 #define aADPCMdec(pkt, f, s) aADPCMdecImpl(f, s)
 #define aResample(pkt, f, p, s) aResampleImpl(f, p, s)
+#define aResampleHQ(pkt, f, p, s) aResampleHQImpl(f, p, s)
+#define aResampleStereo(pkt, f, p, o, l, r) aResampleStereoImpl(f, p, o, l, r)
+#define aHeadsetPan(pkt, f, p, pan, tmp, d, c, s, ps, st, buf) aHeadsetPanImpl(f, p, pan, tmp, d, c, s, ps, st, buf)
 
 #ifndef NEW_AUDIO_UCODE
 #define aSetVolume(pkt, f, v, t, r) aSetVolumeImpl(f, v, t, r)
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -21,6 +22,9 @@
 #include "game/print.h"
 #include "audio/external.h"
 #include "audio/internal.h"
+#include "audio/heap.h"
+#include "audio/load.h"
+#include "audio/synthesis.h"
 
 #include "gfx/gfx_pc.h"
 #include "gfx/gfx_opengl.h"
@@ -41,6 +45,14 @@
 #include "controller/controller_keyboard.h"
 
 #include "configfile.h"
+#include "audio_bench.h"
+#include "audio_data_map.h"
+#include "audio_loudness.h"
+#include "audio_oversample.h"
+#include "audio_stats.h"
+#include "seq/seq_check.h"
+#include "seq/seq_midi.h"
+#include "mixer.h"
 
 #include "compat.h"
 
@@ -64,6 +76,24 @@ s8 gShowDebugText;
 
 FILE* audioDump;
 s16 dumpStrFrameCounter = 0;
+static char audioDumpName[128];
+
+// Auto dumps (configAudioDumpAuto): L arms them, and the file only covers the stretch between the first and
+// the last sound. Rounding noise from a fading reverb still counts as silence.
+#define DUMP_SILENCE_THRESHOLD 2
+static u8 audioDumpArmed = FALSE;
+static u8 audioDumpLevelSeqEnabled;
+// After the level music stops a dump, the next one waits for the tail to fade out (audioDumpSilenceMax samples
+// below the threshold in a row) or for new level music, rather than starting on the reverb
+static u8 audioDumpHoldOff;
+static u8 audioDumpLevelSeqWasEnabled;
+static size_t audioDumpQuietLen;
+// Level music that neither ends nor loops within this many ticks (30 minutes at 120 BPM) is cut off in the MIDI
+#define DUMP_MIDI_MAX_TICKS (30 * 60 * 2 * SEQ_MIDI_TICKS_PER_BEAT)
+// Silence held back until it's clear whether the sound resumes or the dump ends
+static s16 *audioDumpSilence = NULL;
+static size_t audioDumpSilenceLen;
+static size_t audioDumpSilenceMax;
 
 static struct AudioAPI *audio_api;
 static struct GfxWindowManagerAPI *wm_api;
@@ -74,7 +104,6 @@ static s32 samplesProcessed = 0;
 
 extern void gfx_run(Gfx *commands);
 extern void thread5_game_loop(void *arg);
-extern void create_next_audio_buffer(s16 *samples, u32 num_samples);
 void game_loop_one_iteration(void);
 
 void dispatch_audio_sptask(UNUSED struct SPTask *spTask) {
@@ -95,20 +124,30 @@ void exec_display_list(struct SPTask *spTask) {
 
 #define printf
 
+// Rounded up so that alternating HIGH/LOW buffers can keep up with rates that aren't a multiple of 16 per frame.
+// audio_init() keeps gAudioSampleRate at or below MAX_AUDIO_SAMPLE_RATE.
 #ifdef VERSION_EU
-#define SAMPLES_HIGH FLOOR16(FINAL_SAMPLE_RATE / 50)
+#define SAMPLES_HIGH ALIGN16(gAudioSampleRate / 50)
+#define SAMPLES_HIGH_MAX ALIGN16(MAX_AUDIO_SAMPLE_RATE / 50)
 #else
-#define SAMPLES_HIGH FLOOR16(FINAL_SAMPLE_RATE / 60)
+#define SAMPLES_HIGH ALIGN16(gAudioSampleRate / 60)
+#define SAMPLES_HIGH_MAX ALIGN16(MAX_AUDIO_SAMPLE_RATE / 60)
 #endif
 #define SAMPLES_LOW (SAMPLES_HIGH - 16)
 
 void print_debug() {
+#ifdef AUDIO_STATS
+    audio_stats_print();
+#endif
+
     if (dumpStrFrameCounter <= 0)
         return;
 
     dumpStrFrameCounter--;
     if (audioDump)
         print_text(GFX_DIMENSIONS_RECT_FROM_LEFT_EDGE(22), 197 - BORDER_HEIGHT, "AUDIO DUMP STARTED");
+    else if (audioDumpArmed)
+        print_text(GFX_DIMENSIONS_RECT_FROM_LEFT_EDGE(22), 197 - BORDER_HEIGHT, "AUDIO DUMP ARMED");
     else
         print_text(GFX_DIMENSIONS_RECT_FROM_LEFT_EDGE(22), 197 - BORDER_HEIGHT, "AUDIO DUMP STOPPED");
 }
@@ -141,10 +180,36 @@ u8 open_audio_file(char *buffer) {
     return FALSE;
 }
 
-#define SR FINAL_SAMPLE_RATE
+/**
+ * Writes the level music playing as the dump starts next to it as a MIDI file, starting where the player is in
+ * the sequence, at the current tempo setting. The walk skips all synthesis, so it only takes a moment.
+ */
+static void write_audio_dump_midi(const char *wavPath) {
+    struct SequencePlayer *seqPlayer = &gSequencePlayers[SEQ_PLAYER_LEVEL];
+    struct SeqWalkResult result;
+    char path[sizeof(audioDumpName)];
+    const char *ext = strrchr(wavPath, '.');
+    size_t stemLen = (ext != NULL) ? (size_t) (ext - wavPath) : strlen(wavPath);
+    u8 variation;
+
+    if (!seqPlayer->enabled || seqPlayer->seqData == NULL || stemLen > sizeof(path) - sizeof(".mid"))
+        return;
+
+    memcpy(path, wavPath, stemLen);
+    strcpy(path + stemLen, ".mid");
+#if defined(VERSION_EU) || defined(VERSION_SH)
+    variation = seqPlayer->seqVariationEu[0];
+#else
+    variation = seqPlayer->seqVariation;
+#endif
+    if (seq_midi_write(path, seqPlayer->seqData, gSeqFileHeader->seqArray[seqPlayer->seqId].len, variation,
+                       seqPlayer->ticks, DUMP_MIDI_MAX_TICKS, gTempoModifier, &result) != 0)
+        fprintf(stderr, "Audio dump: could not write %s\n", path);
+}
+
+#define SR gAudioSampleRate
 #define BR ((SR * 16 * 2) / 8)
 u8 open_audio_dump() {
-    char nameBuffer[128];
     // RIFF WAV Header Data
     u8 buff[0x2C] = {
         0x52, 0x49, 0x46, 0x46, 0x00, 0x00, 0x00, 0x00,
@@ -158,22 +223,36 @@ u8 open_audio_dump() {
     if (audioDump)
         return FALSE;
 
-    open_audio_file(nameBuffer);
+    open_audio_file(audioDumpName);
 
     if (!audioDump)
         return FALSE;
 
     fseek(audioDump, 0, SEEK_END);
     fwrite(buff, 1, 0x2C, audioDump);
+    audio_loudness_init(SR);
+    write_audio_dump_midi(audioDumpName);
 
     dumpStrFrameCounter = 60;
     return TRUE;
 }
 
 u8 close_audio_dump() {
+    struct LoudnessResult loudness;
+    u32 fileSize;
+
     if (!audioDump)
         return FALSE;
 
+    // The levels go in a bext chunk after the samples, and in a file of their own
+    audio_loudness_get_result(&loudness);
+    fseek(audioDump, 0, SEEK_END);
+    audio_loudness_write_bext(audioDump, &loudness);
+    fileSize = ftell(audioDump) - 8;
+    fseek(audioDump, 0x04, SEEK_SET);
+    fwrite(&fileSize, 4, 1, audioDump);
+    audio_loudness_write_sidecar(audioDumpName, &loudness);
+
     fclose(audioDump);
     audioDump = NULL;
 
@@ -181,7 +260,43 @@ u8 close_audio_dump() {
     return TRUE;
 }
 
+u8 arm_audio_dump() {
+    if (audioDumpArmed)
+        return FALSE;
+
+    audioDumpSilenceMax = (size_t) configAudioDumpSilenceMs * gAudioSampleRate / 1000 * 2;
+    audioDumpSilence = malloc((audioDumpSilenceMax + 1) * sizeof(s16));
+    if (!audioDumpSilence)
+        return FALSE;
+
+    audioDumpArmed = TRUE;
+    audioDumpHoldOff = FALSE;
+    dumpStrFrameCounter = 60;
+    return TRUE;
+}
+
+u8 disarm_audio_dump() {
+    if (!audioDumpArmed)
+        return FALSE;
+
+    audioDumpArmed = FALSE;
+    close_audio_dump();
+    free(audioDumpSilence);
+    audioDumpSilence = NULL;
+
+    dumpStrFrameCounter = 60;
+    return TRUE;
+}
+
 void on_l_pressed() {
+    if (configAudioDumpAuto) {
+        if (audioDumpArmed)
+            disarm_audio_dump();
+        else
+            arm_audio_dump();
+        return;
+    }
+
     if (audioDump) {
         close_audio_dump();
         return;
@@ -190,32 +305,104 @@ void on_l_pressed() {
     open_audio_dump();
 }
 
-void dump_audio(s16 *audioBuffer, size_t size) {
+void write_audio_dump(s16 *audioBuffer, size_t size) {
     u32 fileSize;
 
-    if (gPlayer1Controller->buttonPressed & L_TRIG)
-        on_l_pressed();
-
-    if (!audioDump)
-        return;
-
     fseek(audioDump, 0, SEEK_END);
     fwrite(audioBuffer, 2, size, audioDump);
     fseek(audioDump, 0, SEEK_END);
+    audio_loudness_feed(audioBuffer, size / 2);
 
     fileSize = ftell(audioDump);
 
     fseek(audioDump, 0x04, SEEK_SET);
+    fileSize -= 8;
     fwrite(&fileSize, 4, 1, audioDump);
 
     fseek(audioDump, 0x28, SEEK_SET);
-    fileSize -= 0x2C;
+    fileSize -= 0x2C - 8;
     fwrite(&fileSize, 4, 1, audioDump);
 
     if (fileSize >= 0x20000000) // 512 MB
         close_audio_dump();
 }
 
+/**
+ * Starts the dump at the first loud sample and ends it after the last one once the silence that follows has
+ * run for configAudioDumpSilenceMs, or once the level music that was playing at the start stops. The dump stays
+ * armed afterwards, so the next sound starts a new file; after the level music stopped, only once the game has
+ * gone quiet for as long or new level music starts.
+ */
+void auto_audio_dump(s16 *audioBuffer, size_t size) {
+    u8 levelSeqEnabled = gSequencePlayers[SEQ_PLAYER_LEVEL].enabled;
+    u8 levelSeqStarted = levelSeqEnabled && !audioDumpLevelSeqWasEnabled;
+    size_t start, end;
+
+    audioDumpLevelSeqWasEnabled = levelSeqEnabled;
+
+    if (!audioDump && audioDumpHoldOff) {
+        end = aSignalEndImpl(audioBuffer, size, DUMP_SILENCE_THRESHOLD);
+        audioDumpQuietLen = (end != 0) ? size - end : audioDumpQuietLen + size;
+        if (!levelSeqStarted) {
+            // The quiet run ends this buffer, so there's nothing to start on before the next one
+            audioDumpHoldOff = (audioDumpQuietLen < audioDumpSilenceMax);
+            return;
+        }
+        audioDumpHoldOff = FALSE;
+    }
+
+    if (!audioDump) {
+        start = aSignalStartImpl(audioBuffer, size, DUMP_SILENCE_THRESHOLD) & ~1;
+        if (start >= size || !open_audio_dump())
+            return;
+
+        audioDumpLevelSeqEnabled = levelSeqEnabled;
+        audioDumpSilenceLen = 0;
+        audioBuffer += start;
+        size -= start;
+    } else if (audioDumpLevelSeqEnabled && !levelSeqEnabled) {
+        close_audio_dump();
+        audioDumpHoldOff = TRUE;
+        audioDumpQuietLen = 0;
+        return;
+    }
+
+    // Whole frames, so the held back part always starts on the left channel
+    end = (aSignalEndImpl(audioBuffer, size, DUMP_SILENCE_THRESHOLD) + 1) & ~1;
+    if (end != 0) {
+        if (audioDumpSilenceLen != 0)
+            write_audio_dump(audioDumpSilence, audioDumpSilenceLen);
+        audioDumpSilenceLen = 0;
+        if (!audioDump)
+            return;
+        write_audio_dump(audioBuffer, end);
+        if (!audioDump)
+            return;
+    }
+
+    if (audioDumpSilenceLen + (size - end) > audioDumpSilenceMax) {
+        close_audio_dump();
+        return;
+    }
+    memcpy(audioDumpSilence + audioDumpSilenceLen, audioBuffer + end, (size - end) * sizeof(s16));
+    audioDumpSilenceLen += size - end;
+}
+
+void dump_audio(s16 *audioBuffer, size_t size) {
+    if (gPlayer1Controller->buttonPressed & L_TRIG)
+        on_l_pressed();
+
+    if (audioDumpArmed) {
+        auto_audio_dump(audioBuffer, size);
+        return;
+    }
+
+    if (!audioDump)
+        return;
+
+    write_audio_dump(audioBuffer, size);
+}
+
 s64 get_time_diff(struct timeval *old, struct timeval *new) {
     return ((s64) new->tv_sec - (s64) old->tv_sec) * 1000000L
      + (s64) new->tv_usec - (s64) old->tv_usec;
@@ -266,9 +453,9 @@ void calculate_wait_next_frame(void) {
     }
 }
 
-static s32 calculate_next_audio_buffer_size(void) {
+s32 calculate_next_audio_buffer_size(void) {
     s32 ret;
-    s32 samplesToProcessInSecond = ceil((FINAL_SAMPLE_RATE * (audioFrame+1)) / 60.0);
+    s32 samplesToProcessInSecond = ceil((gAudioSampleRate * (audioFrame+1)) / 60.0);
 
     if (samplesToProcessInSecond - samplesProcessed > SAMPLES_LOW) {
         ret = SAMPLES_HIGH;
@@ -280,7 +467,7 @@ static s32 calculate_next_audio_buffer_size(void) {
 
     if (++audioFrame >= 60) {
         audioFrame -= 60;
-        samplesProcessed -= FINAL_SAMPLE_RATE;
+        samplesProcessed -= gAudioSampleRate;
     }
 
     return ret;
@@ -292,17 +479,23 @@ void produce_one_frame(void) {
     gfx_start_frame();
     game_loop_one_iteration();
     
-    s16 audio_buffer[SAMPLES_HIGH * 2 * 2];
+    s16 audio_buffer[SAMPLES_HIGH_MAX * 2 * 2];
     s32 total_samples = 0;
     s16 *audio_buffer_pointer = &audio_buffer[0];
+#ifdef AUDIO_STATS
+    audio_stats_render_begin();
+#endif
     for (int i = 0; i < 2; i++) {
         u32 num_audio_samples = calculate_next_audio_buffer_size();
 
-        create_next_audio_buffer(audio_buffer_pointer, num_audio_samples);
+        audio_oversample_render(audio_buffer_pointer, num_audio_samples);
 
         total_samples += num_audio_samples;
         audio_buffer_pointer = &audio_buffer[total_samples * 2];
     }
+#ifdef AUDIO_STATS
+    audio_stats_render_end();
+#endif
 
     audio_api->play((u8 *)audio_buffer, 2 * total_samples * 2);
 
@@ -352,6 +545,25 @@ static void save_config(void) {
     configfile_save(CONFIG_FILE);
 }
 
+static s32 cliSampleRate = 0;
+static s32 cliResamplerTaps = -1;
+static s32 cliOversample = 0;
+static s32 cliAudioBenchSeconds = 0;
+static const char *cliAudioBenchOutput = AUDIO_BENCH_DEFAULT_OUTPUT;
+static s32 cliAudioHashSeq = -1;
+static s32 cliAudioHashFrames = AUDIO_HASH_DEFAULT_FRAMES;
+static const char *cliAudioHashFile = NULL;
+static u8 cliAudioHashRecord = FALSE;
+static s32 cliSeqCheckSeq = -1;
+static s32 cliSeqCheckFrames = SEQ_CHECK_DEFAULT_FRAMES;
+#ifdef BETTER_REVERB
+static s32 cliReverbPreset = -1;
+#endif
+#ifdef AUDIO_DATA_MAP
+static const char *cliExePath = NULL;
+static const char *cliSoundDataDir = NULL;
+#endif
+
 static void on_fullscreen_changed(bool is_now_fullscreen) {
     configFullscreen = is_now_fullscreen;
 }
@@ -369,6 +581,39 @@ void main_func(void) {
     configfile_load(CONFIG_FILE);
     atexit(save_config);
 
+    gAudioSampleRate = (cliSampleRate != 0) ? cliSampleRate : (s32) configAudioSampleRate;
+#ifdef AUDIO_LRU_CACHE
+    gAudioCacheBudget = configAudioCacheKB * 1024;
+#endif
+    gResamplerTaps = (cliResamplerTaps >= 0) ? cliResamplerTaps : (s32) configAudioResamplerTaps;
+    gAudioOversample = (cliOversample != 0) ? cliOversample : (s32) configAudioOversample;
+
+#ifdef BETTER_REVERB
+    if (cliReverbPreset >= 0) {
+        gBetterReverbPresetValue = cliReverbPreset;
+    }
+#endif
+#ifdef AUDIO_DATA_MAP
+    audio_data_set_dir(cliExePath, cliSoundDataDir);
+#endif
+
+    // Headless: renders the soundtrack without opening a window or an audio device, then exits
+    if (cliAudioBenchSeconds > 0) {
+        audio_init();
+        sound_init();
+        exit(audio_bench_run(cliAudioBenchSeconds, cliAudioBenchOutput));
+    }
+    if (cliAudioHashSeq >= 0 && cliAudioHashFile != NULL) {
+        audio_init();
+        sound_init();
+        exit(audio_hash_run(cliAudioHashSeq, cliAudioHashFrames, cliAudioHashFile, cliAudioHashRecord));
+    }
+    if (cliSeqCheckSeq >= 0) {
+        audio_init();
+        sound_init();
+        exit(seq_check_run(cliSeqCheckSeq, cliSeqCheckFrames));
+    }
+
     US_PER_FRAME_MIN = (configMaxSpeedupFrameRate > (s64) FRAMERATE) ? (1000000U / (u32) configMaxSpeedupFrameRate) : US_PER_FRAME;
     if (configMaxSpeedupFrameRate < 0)
         US_PER_FRAME_MIN = 0;
@@ -400,7 +645,10 @@ void main_func(void) {
     
     wm_api->set_fullscreen_changed_callback(on_fullscreen_changed);
     wm_api->set_keyboard_callbacks(keyboard_on_key_down, keyboard_on_key_up, keyboard_on_all_keys_up);
-    
+
+    // Settles the final output rate, so it has to run before any audio backend is opened
+    audio_init();
+
 #if HAVE_WASAPI
     if (audio_api == NULL && audio_wasapi.init()) {
         audio_api = &audio_wasapi;
@@ -425,7 +673,6 @@ void main_func(void) {
         audio_api = &audio_null;
     }
 
-    audio_init();
     sound_init();
 
     thread5_game_loop(NULL);
@@ -445,14 +692,64 @@ void main_func(void) {
 #endif
 }
 
+static void parse_cli_args(int argc, char *argv[]) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], "--sample-rate") == 0) {
+            cliSampleRate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--resampler-taps") == 0) {
+            cliResamplerTaps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--oversample") == 0) {
+            cliOversample = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--audio-bench") == 0) {
+            cliAudioBenchSeconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--audio-bench-output") == 0) {
+            cliAudioBenchOutput = argv[++i];
+        } else if (strcmp(argv[i], "--audio-hash") == 0) {
+            cliAudioHashSeq = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--audio-hash-frames") == 0) {
+            cliAudioHashFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--audio-hash-golden") == 0) {
+            cliAudioHashFile = argv[++i];
+            cliAudioHashRecord = FALSE;
+        } else if (strcmp(argv[i], "--audio-hash-record") == 0) {
+            cliAudioHashFile = argv[++i];
+            cliAudioHashRecord = TRUE;
+        } else if (strcmp(argv[i], "--seq-check") == 0) {
+            cliSeqCheckSeq = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seq-check-frames") == 0) {
+            cliSeqCheckFrames = atoi(argv[++i]);
+#ifdef BETTER_REVERB
+        } else if (strcmp(argv[i], "--reverb-preset") == 0) {
+            cliReverbPreset = atoi(argv[++i]);
+#endif
+#ifdef AUDIO_DATA_MAP
+        } else if (strcmp(argv[i], "--sound-data") == 0) {
+            cliSoundDataDir = argv[++i];
+#endif
+        }
+    }
+}
+
 #if defined(_WIN32) || defined(_WIN64)
 #include <windows.h>
 int WINAPI WinMain(UNUSED HINSTANCE hInstance, UNUSED HINSTANCE hPrevInstance, UNUSED LPSTR pCmdLine, UNUSED int nCmdShow) {
+    // The CRT splits the command line the same way for GUI programs
+    parse_cli_args(__argc, __argv);
+#ifdef AUDIO_DATA_MAP
+    static char exePath[MAX_PATH];
+    if (GetModuleFileNameA(NULL, exePath, sizeof(exePath)) != 0) {
+        cliExePath = exePath;
+    }
+#endif
     main_func();
     return 0;
 }
 #else
-int main(UNUSED int argc, UNUSED char *argv[]) {
+int main(int argc, char *argv[]) {
+    parse_cli_args(argc, argv);
+#ifdef AUDIO_DATA_MAP
+    cliExePath = argv[0];
+#endif
     main_func();
     return 0;
 }
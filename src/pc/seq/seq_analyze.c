@@ -0,0 +1,383 @@
+// seq_analyze.c - prints the length, loop point, tempo changes and per-channel notes and banks of sequences
+//
+// Built with `make seq-analyze`, which runs it on the built sequences.bin. The sequences are walked with
+// seq_walk.c, so nothing is rendered and a whole sequences.bin takes well under a second. With -o it also
+// writes each sequence as a MIDI file (seq_midi.c); `make seq-midi` does that for the built sequences.bin.
+// Usage: seq_analyze [-b bank_sets] [-H sequences_header] [-m tempo%] [-o midi_dir] [-s seq] [-t max_ticks]
+//                    [-V] sequences.bin | file.m64...
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "seq_midi.h"
+#include "seq_walk.h"
+
+#define SEQ_ANALYZE_DEFAULT_TICKS 0x400000 // over 10 hours at 120 BPM
+#define SEQ_ANALYZE_MAX_TEMPOS    8        // tempo changes listed before the rest are summed up
+
+#define SEQ_MAGIC 3 // TYPE_SEQ in assemble_sound.py
+
+struct SeqFile {
+    u8 *data;
+    u32 size;
+    u8 *header; // Shindou keeps the entry table in its own file
+    u32 headerSize;
+    s32 bigEndian;
+    s32 wordSize;
+    s32 numEntries;
+};
+
+struct SeqAnalysis {
+    u32 tempoTicks[SEQ_ANALYZE_MAX_TEMPOS];
+    u32 tempoBpm[SEQ_ANALYZE_MAX_TEMPOS];
+    s32 numTempos;
+    s32 moreTempos;
+    u32 notes[SEQ_WALK_CHANNELS];
+    u8 bank[SEQ_WALK_CHANNELS];
+    u8 banksUsed[SEQ_WALK_CHANNELS][256];
+    u8 banksSet[SEQ_WALK_CHANNELS][256];
+};
+
+static const char *sProgName;
+static const char *sMidiDir;
+static f32 sTempoModifier = 1.0f;
+
+static u8 *read_file(const char *path, u32 *size) {
+    FILE *file = fopen(path, "rb");
+    long length;
+    u8 *data;
+
+    if (file == NULL) {
+        fprintf(stderr, "%s: could not open %s\n", sProgName, path);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = malloc(length > 0 ? length : 1);
+    if (data == NULL || fread(data, 1, length, file) != (size_t) length) {
+        fprintf(stderr, "%s: could not read %s\n", sProgName, path);
+        exit(1);
+    }
+    fclose(file);
+    *size = length;
+    return data;
+}
+
+static u32 read_u16(const struct SeqFile *file, const u8 *p) {
+    return file->bigEndian ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+}
+
+static u32 read_u32(const struct SeqFile *file, const u8 *p) {
+    if (file->bigEndian) {
+        return ((u32) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    return ((u32) p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+// Offsets are small, so the upper half of a 64-bit word is always zero
+static u32 read_word(const struct SeqFile *file, const u8 *p) {
+    return read_u32(file, (file->wordSize == 8 && file->bigEndian) ? p + 4 : p);
+}
+
+/**
+ * Works out the byte order and word size assemble_sound.py wrote the file with. US/JP/EU sequences.bin starts
+ * with the magic, then entries of a word sized offset and a length padded to a word. Shindou's
+ * sequences_header starts with the count, then 16 or 24 byte entries from offset 16.
+ */
+static void seq_file_detect(struct SeqFile *file, const char *path) {
+    const u8 *p = (file->header != NULL) ? file->header : file->data;
+    u32 size = (file->header != NULL) ? file->headerSize : file->size;
+    s32 entrySize;
+
+    if (size < 16) {
+        fprintf(stderr, "%s: %s is too short for a sequence file\n", sProgName, path);
+        exit(1);
+    }
+    if (file->header != NULL) {
+        for (file->bigEndian = 1; file->bigEndian >= 0; file->bigEndian--) {
+            file->numEntries = read_u16(file, p);
+            for (entrySize = 16; entrySize <= 24; entrySize += 8) {
+                if (file->numEntries != 0 && size >= 16 + (u32) file->numEntries * entrySize
+                    && size < 16 + (u32) file->numEntries * entrySize + 16) {
+                    file->wordSize = entrySize == 16 ? 4 : 8;
+                    return;
+                }
+            }
+        }
+    } else {
+        file->bigEndian = (p[0] == 0);
+        if (read_u16(file, p) == SEQ_MAGIC) {
+            file->numEntries = read_u16(file, p + 2);
+            // The first entry's data starts right after the table, aligned to 16
+            file->wordSize = 4;
+            if (read_word(file, p + 4) != (u32) ((4 + file->numEntries * 8 + 15) & ~15)) {
+                file->wordSize = 8;
+            }
+            if (size >= 8 + (u32) file->numEntries * 2 * file->wordSize) {
+                return;
+            }
+        }
+    }
+    fprintf(stderr, "%s: %s is not a sequence file\n", sProgName, path);
+    exit(1);
+}
+
+static const u8 *seq_file_entry(const struct SeqFile *file, s32 index, u32 *len) {
+    const u8 *entry;
+    u32 offset;
+
+    if (file->header != NULL) {
+        entry = file->header + 16 + index * (file->wordSize == 4 ? 16 : 24);
+        offset = read_word(file, entry);
+        *len = read_u32(file, entry + file->wordSize);
+    } else {
+        entry = file->data + (file->wordSize == 4 ? 4 : 8) + index * 2 * file->wordSize;
+        offset = read_word(file, entry);
+        *len = read_u32(file, entry + file->wordSize);
+    }
+    if (offset > file->size || *len > file->size - offset) {
+        return NULL;
+    }
+    return file->data + offset;
+}
+
+static void seq_analyze_event(void *arg, const struct SeqWalkEvent *event) {
+    struct SeqAnalysis *analysis = arg;
+
+    switch (event->type) {
+        case SEQ_WALK_TEMPO:
+            // Settings made at the same tick replace each other
+            if (analysis->numTempos > 0 && analysis->tempoTicks[analysis->numTempos - 1] == event->tick) {
+                analysis->numTempos--;
+            } else if (analysis->numTempos == SEQ_ANALYZE_MAX_TEMPOS) {
+                analysis->moreTempos++;
+                break;
+            }
+            analysis->tempoTicks[analysis->numTempos] = event->tick;
+            analysis->tempoBpm[analysis->numTempos] = event->value;
+            analysis->numTempos++;
+            break;
+
+        case SEQ_WALK_BANK:
+            analysis->bank[event->channel] = event->value;
+            analysis->banksSet[event->channel][event->value & 0xff] = TRUE;
+            break;
+
+        case SEQ_WALK_NOTE:
+            analysis->notes[event->channel]++;
+            analysis->banksUsed[event->channel][analysis->bank[event->channel]] = TRUE;
+            break;
+    }
+}
+
+static void print_time(f64 seconds) {
+    printf("%d:%05.2f", (s32) seconds / 60, seconds - (s32) seconds / 60 * 60);
+}
+
+// Bank index 0 is the sequence's default bank; with bank_sets the index is looked up like chan_setbank does
+static void print_bank(const struct SeqFile *file, const u8 *bankSets, u32 bankSetsSize, s32 seqId, s32 index) {
+    u32 offset;
+    u32 count;
+
+    if (bankSets != NULL && (u32) seqId * 2 + 2 <= bankSetsSize) {
+        offset = read_u16(file, bankSets + seqId * 2);
+        count = (offset < bankSetsSize) ? bankSets[offset] : 0;
+        if ((u32) index <= count && offset + count - index < bankSetsSize && offset + count - index > offset) {
+            printf(" %02X", bankSets[offset + count - index]);
+            return;
+        }
+    }
+    printf(" #%d", index);
+}
+
+static s32 analyze(const struct SeqFile *file, const u8 *bankSets, u32 bankSetsSize, s32 seqId, const u8 *data,
+                   u32 len, const char *name, const char *midiName, u32 maxTicks, u8 variation) {
+    struct SeqAnalysis *analysis;
+    struct SeqWalkResult result;
+    char midiPath[1024];
+    s32 used;
+    s32 i;
+    s32 j;
+
+    analysis = calloc(1, sizeof(struct SeqAnalysis));
+    if (analysis == NULL || seq_walk(data, len, variation, maxTicks, seq_analyze_event, analysis, &result) != 0) {
+        fprintf(stderr, "%s: out of memory\n", sProgName);
+        exit(1);
+    }
+
+    printf("%s (%u bytes)\n", name, len);
+    printf("  length:  %u ticks, ", result.ticks);
+    print_time(result.seconds);
+    switch (result.status) {
+        case SEQ_WALK_ENDED:
+            printf(", then ends\n");
+            break;
+        case SEQ_WALK_LOOPED:
+            printf(", then loops back to tick %u (", result.loopStart);
+            print_time(result.loopStartSeconds);
+            printf("); loop is %u ticks, ", result.ticks - result.loopStart);
+            print_time(result.seconds - result.loopStartSeconds);
+            printf("\n");
+            break;
+        case SEQ_WALK_TICK_LIMIT:
+            printf(" without ending or looping (tick limit)\n");
+            break;
+    }
+
+    printf("  tempo:  ");
+    for (i = 0; i < analysis->numTempos; i++) {
+        printf(" %u BPM at %u%s", analysis->tempoBpm[i], analysis->tempoTicks[i],
+               (i + 1 < analysis->numTempos || analysis->moreTempos != 0) ? "," : "");
+    }
+    if (analysis->moreTempos != 0) {
+        printf(" and %d more", analysis->moreTempos);
+    }
+    printf("\n");
+
+    if (result.errors != 0 || result.unknownCommands != 0) {
+        printf("  problems: %u script(s) stopped for running off the data or overflowing the stack, "
+               "%u unknown command(s)\n", result.errors, result.unknownCommands);
+    }
+
+    printf("  channel  notes  banks\n");
+    for (i = 0; i < SEQ_WALK_CHANNELS; i++) {
+        used = FALSE;
+        for (j = 0; j < 256; j++) {
+            used |= analysis->banksSet[i][j];
+        }
+        if (analysis->notes[i] == 0 && !used) {
+            continue;
+        }
+        printf("  %7d  %5u ", i, analysis->notes[i]);
+        for (j = 0; j < 256; j++) {
+            if (analysis->banksUsed[i][j]) {
+                print_bank(file, bankSets, bankSetsSize, seqId, j);
+            }
+        }
+        // Banks switched to without playing a note on them
+        for (j = 0; j < 256; j++) {
+            if (analysis->banksSet[i][j] && !analysis->banksUsed[i][j]) {
+                print_bank(file, bankSets, bankSetsSize, seqId, j);
+                printf("(unused)");
+            }
+        }
+        printf("\n");
+    }
+
+    if (sMidiDir != NULL) {
+        snprintf(midiPath, sizeof(midiPath), "%s/%s.mid", sMidiDir, midiName);
+        if (seq_midi_write(midiPath, data, len, variation, 0, maxTicks, sTempoModifier, &result) != 0) {
+            fprintf(stderr, "%s: could not write %s\n", sProgName, midiPath);
+            exit(1);
+        }
+        printf("  midi:    %s\n", midiPath);
+    }
+    printf("\n");
+
+    free(analysis);
+    return result.errors != 0;
+}
+
+static s32 ends_with(const char *str, const char *suffix) {
+    size_t len = strlen(str);
+    size_t suffixLen = strlen(suffix);
+    return len >= suffixLen && strcmp(str + len - suffixLen, suffix) == 0;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: %s [-b bank_sets] [-H sequences_header] [-m tempo%%] [-o midi_dir] [-s seq] [-t max_ticks] "
+            "[-V] sequences.bin | file.m64...\n"
+            "  -b  name banks as in this bank_sets file instead of by index in the sequence's set\n"
+            "  -H  Shindou sequence table, which sequences.bin lacks there\n"
+            "  -m  tempo of the MIDI files in percent, like the game's tempo setting (default 100)\n"
+            "  -o  also write each sequence as a MIDI file to this directory\n"
+            "  -s  only this sequence of sequences.bin\n"
+            "  -t  stop walking after this many ticks (default %d)\n"
+            "  -V  start the sequences with SEQ_VARIATION set\n",
+            sProgName, SEQ_ANALYZE_DEFAULT_TICKS);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    struct SeqFile file;
+    const char *bankSetsPath = NULL;
+    const char *headerPath = NULL;
+    u8 *bankSets = NULL;
+    u32 bankSetsSize = 0;
+    u32 maxTicks = SEQ_ANALYZE_DEFAULT_TICKS;
+    u8 variation = 0;
+    s32 onlySeq = -1;
+    s32 failed = 0;
+    const u8 *data;
+    const char *base;
+    char name[32];
+    char midiName[256];
+    u32 len;
+    s32 i;
+
+    sProgName = argv[0];
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-V") == 0) {
+            variation = 0x80; // SEQ_VARIATION
+        } else if (i + 1 == argc) {
+            usage();
+        } else if (strcmp(argv[i], "-b") == 0) {
+            bankSetsPath = argv[++i];
+        } else if (strcmp(argv[i], "-H") == 0) {
+            headerPath = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            sTempoModifier = strtol(argv[++i], NULL, 0) / 100.0f;
+        } else if (strcmp(argv[i], "-o") == 0) {
+            sMidiDir = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0) {
+            onlySeq = strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            maxTicks = strtoul(argv[++i], NULL, 0);
+        } else {
+            usage();
+        }
+    }
+    if (i == argc) {
+        usage();
+    }
+
+    memset(&file, 0, sizeof(file));
+    if (ends_with(argv[i], ".m64")) {
+        for (; i < argc; i++) {
+            base = strrchr(argv[i], '/');
+            base = (base != NULL) ? base + 1 : argv[i];
+            snprintf(midiName, sizeof(midiName), "%.*s", (int) (strlen(base) - strlen(".m64")), base);
+            file.data = read_file(argv[i], &file.size);
+            failed |= analyze(&file, NULL, 0, -1, file.data, file.size, argv[i], midiName, maxTicks, variation);
+            free(file.data);
+        }
+        return failed;
+    }
+
+    file.data = read_file(argv[i], &file.size);
+    if (headerPath != NULL) {
+        file.header = read_file(headerPath, &file.headerSize);
+    }
+    seq_file_detect(&file, (headerPath != NULL) ? headerPath : argv[i]);
+    if (bankSetsPath != NULL) {
+        bankSets = read_file(bankSetsPath, &bankSetsSize);
+    }
+
+    for (i = 0; i < file.numEntries; i++) {
+        if (onlySeq >= 0 && i != onlySeq) {
+            continue;
+        }
+        data = seq_file_entry(&file, i, &len);
+        sprintf(name, "Sequence 0x%02X", i);
+        sprintf(midiName, "seq_%02X", i);
+        if (data == NULL) {
+            fprintf(stderr, "%s: entry %d is out of range\n", sProgName, i);
+            failed = 1;
+            continue;
+        }
+        failed |= analyze(&file, bankSets, bankSetsSize, i, data, len, name, midiName, maxTicks, variation);
+    }
+    return failed;
+}
@@ -0,0 +1,289 @@
+// seq_check.c - checks seq_walk.c against the real sequence player (--seq-check SEQ)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sm64.h"
+
+#include "audio/external.h"
+#include "audio/internal.h"
+#include "audio/load.h"
+#include "audio/seqplayer.h"
+
+#include "../audio_oversample.h"
+#include "seq_check.h"
+#include "seq_trace.h"
+#include "seq_walk.h"
+
+#define SEQ_CHECK_SAMPLES_MAX ALIGN16(MAX_AUDIO_SAMPLE_RATE / 50)
+#define SEQ_CHECK_DEFAULT_BPM 120 // init_sequence_player() and seq_walk() both start here
+
+void (*gSeqTraceTick)(struct SequencePlayer *seqPlayer) = NULL;
+void (*gSeqTraceNote)(struct SequenceChannelLayer *layer, u8 semitone) = NULL;
+
+struct SeqCheckEvent {
+    u32 tick;
+    s8 channel;
+    s8 layer;
+    u8 semitone;
+    u16 value; // the length of a note, or a tempo in BPM
+};
+
+struct SeqCheckList {
+    struct SeqCheckEvent *events;
+    u32 count;
+    u32 max;
+    u8 failed;
+};
+
+struct SeqCheckWalk {
+    struct SeqCheckList notes;
+    struct SeqCheckList tempos;
+};
+
+static struct SeqCheckList sPlayedNotes;
+static struct SeqCheckList sPlayedTempos;
+static u16 sPlayedBpm;
+
+extern s32 calculate_next_audio_buffer_size(void);
+
+static void seq_check_add(struct SeqCheckList *list, u32 tick, s32 channel, s32 layer, u8 semitone, u16 value) {
+    struct SeqCheckEvent *events;
+    struct SeqCheckEvent *event;
+
+    if (list->count == list->max) {
+        list->max = list->max * 2 + 256;
+        events = realloc(list->events, list->max * sizeof(struct SeqCheckEvent));
+        if (events == NULL) {
+            list->max = list->count;
+            list->failed = TRUE;
+            return;
+        }
+        list->events = events;
+    }
+    event = &list->events[list->count++];
+    event->tick = tick;
+    event->channel = channel;
+    event->layer = layer;
+    event->semitone = semitone;
+    event->value = value;
+}
+
+static void seq_check_tick(struct SequencePlayer *seqPlayer) {
+    u16 bpm;
+
+    if (seqPlayer != &gSequencePlayers[SEQ_PLAYER_LEVEL] || seqPlayer->ticks == 0) {
+        return;
+    }
+    // The tempo the previous tick left behind
+    bpm = seqPlayer->tempo / TEMPO_SCALE;
+    if (bpm != sPlayedBpm) {
+        seq_check_add(&sPlayedTempos, seqPlayer->ticks - 1, -1, -1, 0, bpm);
+        sPlayedBpm = bpm;
+    }
+}
+
+static void seq_check_note(struct SequenceChannelLayer *layer, u8 semitone) {
+    struct SequenceChannel *seqChannel = layer->seqChannel;
+    struct SequencePlayer *seqPlayer = seqChannel->seqPlayer;
+    s32 channel = 0;
+    s32 layerIndex = 0;
+
+    if (seqPlayer != &gSequencePlayers[SEQ_PLAYER_LEVEL]) {
+        return;
+    }
+    while (channel < CHANNELS_MAX && seqPlayer->channels[channel] != seqChannel) {
+        channel++;
+    }
+    while (layerIndex < LAYERS_MAX && seqChannel->layers[layerIndex] != layer) {
+        layerIndex++;
+    }
+    seq_check_add(&sPlayedNotes, seqPlayer->ticks - 1, channel, layerIndex, semitone, layer->delay);
+}
+
+static void seq_check_walk_event(void *arg, const struct SeqWalkEvent *event) {
+    struct SeqCheckWalk *walk = arg;
+
+    if (event->type == SEQ_WALK_NOTE) {
+        seq_check_add(&walk->notes, event->tick, event->channel, event->layer, event->note.semitone,
+                      event->note.length);
+    } else if (event->type == SEQ_WALK_TEMPO) {
+        seq_check_add(&walk->tempos, event->tick, -1, -1, 0, event->value);
+    }
+}
+
+/**
+ * Lays the walked events out over 'ticks' ticks the way the player meets them: the first pass up to the loop
+ * jump, then the looped part over and over.
+ */
+static void seq_check_unroll(const struct SeqCheckList *walked, const struct SeqWalkResult *result, u32 ticks,
+                             struct SeqCheckList *out) {
+    const struct SeqCheckEvent *event;
+    u32 offset;
+    u32 i;
+
+    for (i = 0; i < walked->count; i++) {
+        event = &walked->events[i];
+        if (event->tick < result->ticks && event->tick < ticks) {
+            seq_check_add(out, event->tick, event->channel, event->layer, event->semitone, event->value);
+        }
+    }
+    if (result->status != SEQ_WALK_LOOPED || result->loopStart >= result->ticks) {
+        return;
+    }
+    for (offset = result->ticks; offset < ticks; offset += result->ticks - result->loopStart) {
+        for (i = 0; i < walked->count; i++) {
+            event = &walked->events[i];
+            if (event->tick >= result->loopStart && event->tick < result->ticks
+                && event->tick - result->loopStart + offset < ticks) {
+                seq_check_add(out, event->tick - result->loopStart + offset, event->channel, event->layer,
+                              event->semitone, event->value);
+            }
+        }
+    }
+}
+
+// Keeps only the tempo each tick ends on, and only where it changes, as seq_check_tick() sees them
+static void seq_check_collapse_tempos(struct SeqCheckList *list) {
+    u16 bpm = SEQ_CHECK_DEFAULT_BPM;
+    u32 count = 0;
+    u32 i;
+
+    for (i = 0; i < list->count; i++) {
+        if (i + 1 < list->count && list->events[i + 1].tick == list->events[i].tick) {
+            continue;
+        }
+        if (list->events[i].value != bpm) {
+            bpm = list->events[i].value;
+            list->events[count++] = list->events[i];
+        }
+    }
+    list->count = count;
+}
+
+/**
+ * Compares two event lists up to 'ticks'. Returns the number of events that differ, and prints the first.
+ */
+static u32 seq_check_compare(const char *what, const struct SeqCheckList *walked,
+                             const struct SeqCheckList *played, u32 ticks) {
+    const struct SeqCheckEvent *a;
+    const struct SeqCheckEvent *b;
+    u32 walkedCount = 0;
+    u32 playedCount = 0;
+    u32 mismatches = 0;
+    u32 i;
+
+    while (walkedCount < walked->count && walked->events[walkedCount].tick < ticks) {
+        walkedCount++;
+    }
+    while (playedCount < played->count && played->events[playedCount].tick < ticks) {
+        playedCount++;
+    }
+    for (i = 0; i < walkedCount || i < playedCount; i++) {
+        a = (i < walkedCount) ? &walked->events[i] : NULL;
+        b = (i < playedCount) ? &played->events[i] : NULL;
+        if (a != NULL && b != NULL && a->tick == b->tick && a->channel == b->channel && a->layer == b->layer
+            && a->semitone == b->semitone && a->value == b->value) {
+            continue;
+        }
+        if (mismatches++ == 0) {
+            printf("Seq check: %s %u differs:\n", what, (unsigned) i);
+            if (a != NULL) {
+                printf("  walked tick %u channel %d layer %d semitone %d value %d\n", (unsigned) a->tick,
+                       a->channel, a->layer, a->semitone, a->value);
+            } else {
+                printf("  walked nothing\n");
+            }
+            if (b != NULL) {
+                printf("  played tick %u channel %d layer %d semitone %d value %d\n", (unsigned) b->tick,
+                       b->channel, b->layer, b->semitone, b->value);
+            } else {
+                printf("  played nothing\n");
+            }
+        }
+    }
+    if (mismatches == 0) {
+        printf("Seq check: %u %s match\n", (unsigned) walkedCount, what);
+    }
+    return mismatches;
+}
+
+s32 seq_check_run(s32 seqId, s32 frames) {
+    s16 buffer[SEQ_CHECK_SAMPLES_MAX * 2];
+    struct SequencePlayer *seqPlayer = &gSequencePlayers[SEQ_PLAYER_LEVEL];
+    struct SeqCheckWalk walk;
+    struct SeqCheckList walkedNotes;
+    struct SeqCheckList walkedTempos;
+    struct SeqWalkResult result;
+    u8 *data;
+    u32 len;
+    u32 ticks;
+    u32 mismatches;
+    s32 frame;
+    s32 ret = 1;
+
+    if (seqId < 0 || seqId >= gSequenceCount || frames <= 0) {
+        fprintf(stderr, "Seq check: need a sequence below %d and a positive frame count\n", (int) gSequenceCount);
+        return 2;
+    }
+
+    memset(&walk, 0, sizeof(walk));
+    memset(&walkedNotes, 0, sizeof(walkedNotes));
+    memset(&walkedTempos, 0, sizeof(walkedTempos));
+    memset(&sPlayedNotes, 0, sizeof(sPlayedNotes));
+    memset(&sPlayedTempos, 0, sizeof(sPlayedTempos));
+    sPlayedBpm = SEQ_CHECK_DEFAULT_BPM;
+
+    load_sequence(SEQ_PLAYER_LEVEL, seqId, FALSE);
+    if (!seqPlayer->enabled || seqPlayer->seqData == NULL) {
+        fprintf(stderr, "Seq check: could not load sequence %d\n", (int) seqId);
+        return 2;
+    }
+    // Taken before playing, since the player is free to write to its own data
+    len = gSeqFileHeader->seqArray[seqId].len;
+    data = malloc(len);
+    if (data == NULL) {
+        fprintf(stderr, "Seq check: out of memory\n");
+        return 2;
+    }
+    memcpy(data, seqPlayer->seqData, len);
+
+    gSeqTraceTick = seq_check_tick;
+    gSeqTraceNote = seq_check_note;
+    for (frame = 0; frame < frames; frame++) {
+        audio_oversample_render(buffer, calculate_next_audio_buffer_size());
+    }
+    gSeqTraceTick = NULL;
+    gSeqTraceNote = NULL;
+    ticks = seqPlayer->ticks;
+
+    if (seq_walk(data, len, 0, ticks, seq_check_walk_event, &walk, &result) != 0 || walk.notes.failed
+        || walk.tempos.failed || sPlayedNotes.failed || sPlayedTempos.failed) {
+        fprintf(stderr, "Seq check: out of memory\n");
+        ret = 2;
+    } else {
+        seq_check_unroll(&walk.notes, &result, ticks, &walkedNotes);
+        seq_check_unroll(&walk.tempos, &result, ticks, &walkedTempos);
+        seq_check_collapse_tempos(&walkedTempos);
+        if (walkedNotes.failed || walkedTempos.failed) {
+            fprintf(stderr, "Seq check: out of memory\n");
+            ret = 2;
+        } else {
+            printf("Seq check: sequence %d, %u ticks played\n", (int) seqId, (unsigned) ticks);
+            mismatches = seq_check_compare("notes", &walkedNotes, &sPlayedNotes, ticks);
+            // A change in the last tick only shows once the next one starts
+            mismatches += seq_check_compare("tempo changes", &walkedTempos, &sPlayedTempos,
+                                            (ticks > 0) ? ticks - 1 : 0);
+            ret = (mismatches == 0) ? 0 : 1;
+        }
+    }
+
+    free(data);
+    free(walk.notes.events);
+    free(walk.tempos.events);
+    free(walkedNotes.events);
+    free(walkedTempos.events);
+    free(sPlayedNotes.events);
+    free(sPlayedTempos.events);
+    return ret;
+}
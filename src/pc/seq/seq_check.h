@@ -0,0 +1,16 @@
+#ifndef SEQ_CHECK_H
+#define SEQ_CHECK_H
+
+#include <PR/ultratypes.h>
+
+#define SEQ_CHECK_DEFAULT_FRAMES 3600 // a minute
+
+/**
+ * Plays a sequence on the real sequence player for 'frames' audio buffers, the same way --audio-hash does, and
+ * checks that seq_walk.c finds the same notes (tick, channel, layer, semitone and length) and tempo changes,
+ * with its loop unrolled as far as the player got. Expects audio_init() and sound_init() to have been called.
+ * Returns the process exit code.
+ */
+s32 seq_check_run(s32 seqId, s32 frames);
+
+#endif // SEQ_CHECK_H
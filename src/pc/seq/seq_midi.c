@@ -0,0 +1,404 @@
+// seq_midi.c - writes the notes, programs, volumes, pans and tempos of a walked sequence as a MIDI file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "seq_midi.h"
+
+#define ARRAY_COUNT(arr) (s32)(sizeof(arr) / sizeof(arr[0]))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define SEQ_MIDI_TRACKS (SEQ_WALK_CHANNELS + 1) // the tempo track, then one per sequence channel
+
+#define SEQ_MIDI_KEY_OFFSET   21   // MIDI note of semitone 0; gNoteFrequencies has middle C at 39
+#define SEQ_MIDI_BEND_RANGE   12   // chan_pitchbend goes up to an octave either way
+#define SEQ_MIDI_MAX_TEMPO    0xffffff
+#define SEQ_MIDI_NOTE_OFF_VEL 0x40
+#define SEQ_MIDI_DROPPED      0xffffffff // tick of events seq_midi_start_at() leaves out
+
+// Events at the same tick go out in this order, then in the order they were walked
+enum SeqMidiPriority {
+    PRIORITY_NOTE_OFF, // so a note that ends as the same key starts again doesn't cut the new one
+    PRIORITY_SETUP,
+    PRIORITY_EVENT,
+};
+
+struct SeqMidiEvent {
+    u32 tick;
+    u32 order;
+    u8 track;
+    u8 priority;
+    u8 len;
+    u8 bytes[13];
+};
+
+struct SeqMidiBuffer {
+    u8 *data;
+    u32 size;
+    u32 max;
+    u8 failed;
+};
+
+struct SeqMidi {
+    struct SeqMidiEvent *events;
+    u32 numEvents;
+    u32 maxEvents;
+    u8 trackUsed[SEQ_MIDI_TRACKS];
+    u32 lastTempo; // index of the last tempo event, if numTempos != 0
+    u32 numTempos;
+    f32 tempoModifier;
+    u8 failed;
+};
+
+static void seq_midi_add(struct SeqMidi *midi, u32 tick, s32 track, s32 priority, const u8 *bytes, s32 len) {
+    struct SeqMidiEvent *events;
+    struct SeqMidiEvent *event;
+
+    if (midi->numEvents == midi->maxEvents) {
+        midi->maxEvents = midi->maxEvents * 2 + 256;
+        events = realloc(midi->events, midi->maxEvents * sizeof(struct SeqMidiEvent));
+        if (events == NULL) {
+            midi->maxEvents = midi->numEvents;
+            midi->failed = TRUE;
+            return;
+        }
+        midi->events = events;
+    }
+    event = &midi->events[midi->numEvents];
+    event->tick = tick;
+    event->order = midi->numEvents++;
+    event->track = track;
+    event->priority = priority;
+    event->len = len;
+    memcpy(event->bytes, bytes, len);
+}
+
+// Adds a channel message, setting the pitch bend range at the start of the channel's track the first time
+static void seq_midi_add_channel(struct SeqMidi *midi, u32 tick, s32 channel, s32 priority, u8 status, u8 data1,
+                                 u8 data2) {
+    static const u8 sBendRange[] = { 101, 0, 100, 0, 6, SEQ_MIDI_BEND_RANGE, 38, 0 }; // RPN 0
+    u8 bytes[3];
+    s32 i;
+
+    bytes[0] = status | channel;
+    if (!midi->trackUsed[channel + 1]) {
+        midi->trackUsed[channel + 1] = TRUE;
+        for (i = 0; i < ARRAY_COUNT(sBendRange); i += 2) {
+            bytes[0] = 0xb0 | channel;
+            bytes[1] = sBendRange[i];
+            bytes[2] = sBendRange[i + 1];
+            seq_midi_add(midi, 0, channel + 1, PRIORITY_SETUP, bytes, 3);
+        }
+        bytes[0] = status | channel;
+    }
+    bytes[1] = data1;
+    bytes[2] = data2;
+    seq_midi_add(midi, tick, channel + 1, priority, bytes, (status == 0xc0) ? 2 : 3);
+}
+
+// Microseconds per beat for a tempo in BPM, accumulated as seqplayer.c does with gTempoModifier
+static u32 seq_midi_tempo(struct SeqMidi *midi, s32 bpm) {
+    u16 tatums = bpm * SEQ_MIDI_TICKS_PER_BEAT * midi->tempoModifier + 0.5f;
+    f64 tempo;
+
+    if (tatums == 0) {
+        return SEQ_MIDI_MAX_TEMPO;
+    }
+    tempo = 60000000.0 * SEQ_MIDI_TICKS_PER_BEAT / tatums + 0.5;
+    return (tempo < SEQ_MIDI_MAX_TEMPO) ? (u32) tempo : SEQ_MIDI_MAX_TEMPO;
+}
+
+static void seq_midi_event(void *arg, const struct SeqWalkEvent *event) {
+    struct SeqMidi *midi = arg;
+    u8 bytes[6];
+    u32 tempo;
+    s32 bend;
+    s32 key;
+
+    switch (event->type) {
+        case SEQ_WALK_TEMPO:
+            tempo = seq_midi_tempo(midi, event->value);
+            bytes[0] = 0xff;
+            bytes[1] = 0x51;
+            bytes[2] = 3;
+            bytes[3] = tempo >> 16;
+            bytes[4] = tempo >> 8;
+            bytes[5] = tempo;
+            // Settings made at the same tick replace each other, such as the script's own over the default
+            if (midi->numTempos > 0 && midi->events[midi->lastTempo].tick == event->tick) {
+                memcpy(midi->events[midi->lastTempo].bytes, bytes, 6);
+                break;
+            }
+            seq_midi_add(midi, event->tick, 0, PRIORITY_EVENT, bytes, 6);
+            if (!midi->failed) {
+                midi->lastTempo = midi->numEvents - 1;
+                midi->numTempos++;
+            }
+            break;
+
+        case SEQ_WALK_INSTRUMENT:
+            // 0x7f switches to the drums and higher values to synthetic waves, which no program stands for
+            if (event->layer < 0 && event->value < 0x7f) {
+                seq_midi_add_channel(midi, event->tick, event->channel, PRIORITY_EVENT, 0xc0, event->value, 0);
+            }
+            break;
+
+        case SEQ_WALK_VOLUME:
+            seq_midi_add_channel(midi, event->tick, event->channel, PRIORITY_EVENT, 0xb0, 7,
+                                 MIN(event->value, 127));
+            break;
+
+        case SEQ_WALK_PAN:
+            if (event->layer < 0) {
+                seq_midi_add_channel(midi, event->tick, event->channel, PRIORITY_EVENT, 0xb0, 10,
+                                     MIN(event->value, 127));
+            }
+            break;
+
+        case SEQ_WALK_PITCHBEND:
+            bend = 0x2000 + event->value * 0x1fff / 127;
+            seq_midi_add_channel(midi, event->tick, event->channel, PRIORITY_EVENT, 0xe0, bend & 0x7f,
+                                 bend >> 7);
+            break;
+
+        case SEQ_WALK_NOTE:
+            // The player drops notes transposed out of range; a velocity of 0 plays nothing
+            key = event->note.key + SEQ_MIDI_KEY_OFFSET;
+            if ((!event->note.drum && event->note.key >= 0x80) || key > 127 || event->note.velocity == 0
+                || event->note.gate == 0) {
+                break;
+            }
+            seq_midi_add_channel(midi, event->tick, event->channel, PRIORITY_EVENT, 0x90, key,
+                                 MIN(event->note.velocity, 127));
+            seq_midi_add_channel(midi, event->tick + event->note.gate, event->channel, PRIORITY_NOTE_OFF, 0x80,
+                                 key, SEQ_MIDI_NOTE_OFF_VEL);
+            break;
+    }
+}
+
+static void seq_midi_add_marker(struct SeqMidi *midi, u32 tick, const char *text) {
+    u8 bytes[13];
+    s32 len = strlen(text);
+
+    bytes[0] = 0xff;
+    bytes[1] = 0x06;
+    bytes[2] = len;
+    memcpy(bytes + 3, text, len);
+    seq_midi_add(midi, tick, 0, PRIORITY_EVENT, bytes, len + 3);
+}
+
+static u8 seq_midi_is_note_on(const struct SeqMidiEvent *event) {
+    return event->track != 0 && (event->bytes[0] & 0xf0) == 0x90;
+}
+
+/**
+ * Moves the start of the file to 'start', a tick within the walked part of the sequence. Settings made before it
+ * are all made at the start instead, notes that ended before it are left out and notes still held are cut in.
+ * When 'start' is inside the loop, the part of the loop before it follows the loop end, so the file plays one
+ * full pass of the loop from where it starts. Returns the new end tick.
+ */
+static u32 seq_midi_start_at(struct SeqMidi *midi, const struct SeqWalkResult *result, u32 start) {
+    struct SeqMidiEvent note[2]; // copies, since adding events can move the array
+    struct SeqMidiEvent *event;
+    u32 numEvents = midi->numEvents;
+    u32 wrapOffset = result->ticks - start; // where the loop start goes when the file wraps around
+    u8 wrap = (result->status == SEQ_WALK_LOOPED && start > result->loopStart);
+    u32 onTick;
+    u32 offTick;
+    u32 count = 0;
+    u32 i;
+
+    for (i = 0; i < numEvents; i++) {
+        event = &midi->events[i];
+        if (seq_midi_is_note_on(event)) {
+            // seq_midi_event() adds the note off right after its note on
+            note[0] = event[0];
+            note[1] = event[1];
+            onTick = note[0].tick;
+            offTick = note[1].tick;
+            if (wrap && onTick >= result->loopStart && onTick < start) {
+                seq_midi_add(midi, onTick - result->loopStart + wrapOffset, note[0].track, note[0].priority,
+                             note[0].bytes, note[0].len);
+                seq_midi_add(midi, MIN(offTick, start) - result->loopStart + wrapOffset, note[1].track,
+                             note[1].priority, note[1].bytes, note[1].len);
+                event = &midi->events[i];
+            }
+            if (offTick <= start) {
+                event[0].tick = SEQ_MIDI_DROPPED;
+                event[1].tick = SEQ_MIDI_DROPPED;
+            } else {
+                event[0].tick = (onTick > start) ? onTick - start : 0;
+                event[1].tick = offTick - start;
+            }
+            i++;
+            continue;
+        }
+        if (wrap && event->tick >= result->loopStart && event->tick < start) {
+            note[0] = *event;
+            seq_midi_add(midi, note[0].tick - result->loopStart + wrapOffset, note[0].track, note[0].priority,
+                         note[0].bytes, note[0].len);
+            event = &midi->events[i];
+        }
+        event->tick = (event->tick > start) ? event->tick - start : 0;
+    }
+
+    for (i = 0; i < midi->numEvents; i++) {
+        if (midi->events[i].tick != SEQ_MIDI_DROPPED) {
+            midi->events[count++] = midi->events[i];
+        }
+    }
+    midi->numEvents = count;
+
+    if (wrap) {
+        seq_midi_add_marker(midi, 0, "loopStart");
+        seq_midi_add_marker(midi, result->ticks - result->loopStart, "loopEnd");
+        return result->ticks - result->loopStart;
+    }
+    if (result->status == SEQ_WALK_LOOPED) {
+        seq_midi_add_marker(midi, result->loopStart - start, "loopStart");
+        seq_midi_add_marker(midi, result->ticks - start, "loopEnd");
+    }
+    return result->ticks - start;
+}
+
+static int seq_midi_compare(const void *a, const void *b) {
+    const struct SeqMidiEvent *x = a;
+    const struct SeqMidiEvent *y = b;
+
+    if (x->track != y->track) {
+        return x->track - y->track;
+    }
+    if (x->tick != y->tick) {
+        return (x->tick < y->tick) ? -1 : 1;
+    }
+    if (x->priority != y->priority) {
+        return x->priority - y->priority;
+    }
+    return (x->order < y->order) ? -1 : 1;
+}
+
+static void seq_midi_write_bytes(struct SeqMidiBuffer *buf, const u8 *bytes, u32 len) {
+    u8 *data;
+
+    if (buf->failed) {
+        return;
+    }
+    if (buf->size + len > buf->max) {
+        data = realloc(buf->data, (buf->size + len) * 2);
+        if (data == NULL) {
+            buf->failed = TRUE;
+            return;
+        }
+        buf->data = data;
+        buf->max = (buf->size + len) * 2;
+    }
+    memcpy(buf->data + buf->size, bytes, len);
+    buf->size += len;
+}
+
+static void seq_midi_write_u32(struct SeqMidiBuffer *buf, u32 value) {
+    u8 bytes[4] = { value >> 24, value >> 16, value >> 8, value };
+
+    seq_midi_write_bytes(buf, bytes, 4);
+}
+
+static void seq_midi_write_vlq(struct SeqMidiBuffer *buf, u32 value) {
+    u8 bytes[5];
+    s32 i = 4;
+
+    bytes[i] = value & 0x7f;
+    while ((value >>= 7) != 0) {
+        bytes[--i] = 0x80 | (value & 0x7f);
+    }
+    seq_midi_write_bytes(buf, bytes + i, 5 - i);
+}
+
+static void seq_midi_write_tracks(struct SeqMidi *midi, struct SeqMidiBuffer *buf, u32 endTick) {
+    static const u8 sEndOfTrack[] = { 0xff, 0x2f, 0 };
+    static const u8 sHeader[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1 };
+    u8 counts[4];
+    u32 lengthOffset;
+    u32 lastTick;
+    u32 numTracks = 0;
+    u32 i = 0;
+    s32 track;
+
+    for (track = 0; track < SEQ_MIDI_TRACKS; track++) {
+        numTracks += (track == 0 || midi->trackUsed[track]);
+    }
+    counts[0] = 0;
+    counts[1] = numTracks;
+    counts[2] = 0;
+    counts[3] = SEQ_MIDI_TICKS_PER_BEAT;
+    seq_midi_write_bytes(buf, sHeader, sizeof(sHeader));
+    seq_midi_write_bytes(buf, counts, sizeof(counts));
+
+    for (track = 0; track < SEQ_MIDI_TRACKS; track++) {
+        if (track != 0 && !midi->trackUsed[track]) {
+            continue;
+        }
+        seq_midi_write_bytes(buf, (const u8 *) "MTrk", 4);
+        lengthOffset = buf->size;
+        seq_midi_write_u32(buf, 0);
+
+        lastTick = 0;
+        for (; i < midi->numEvents && midi->events[i].track == track; i++) {
+            seq_midi_write_vlq(buf, midi->events[i].tick - lastTick);
+            seq_midi_write_bytes(buf, midi->events[i].bytes, midi->events[i].len);
+            lastTick = midi->events[i].tick;
+        }
+        seq_midi_write_vlq(buf, endTick - lastTick);
+        seq_midi_write_bytes(buf, sEndOfTrack, sizeof(sEndOfTrack));
+
+        if (!buf->failed) {
+            buf->data[lengthOffset] = (buf->size - lengthOffset - 4) >> 24;
+            buf->data[lengthOffset + 1] = (buf->size - lengthOffset - 4) >> 16;
+            buf->data[lengthOffset + 2] = (buf->size - lengthOffset - 4) >> 8;
+            buf->data[lengthOffset + 3] = (buf->size - lengthOffset - 4);
+        }
+    }
+}
+
+s32 seq_midi_write(const char *path, const u8 *data, u32 len, u8 variation, u32 startTick, u32 maxTicks,
+                   f32 tempoModifier, struct SeqWalkResult *result) {
+    struct SeqMidi midi;
+    struct SeqMidiBuffer buf;
+    FILE *file;
+    s32 ret = -1;
+    u32 endTick;
+    u32 i;
+
+    memset(&midi, 0, sizeof(midi));
+    memset(&buf, 0, sizeof(buf));
+    midi.tempoModifier = tempoModifier;
+
+    if (seq_walk(data, len, variation, maxTicks, seq_midi_event, &midi, result) == 0 && !midi.failed) {
+        // Notes still held when the sequence ends or loops are cut there
+        for (i = 0; i < midi.numEvents; i++) {
+            midi.events[i].tick = MIN(midi.events[i].tick, result->ticks);
+        }
+        // A player that has gone around the loop is somewhere in the loop again
+        if (result->status == SEQ_WALK_LOOPED && startTick >= result->ticks) {
+            startTick = result->loopStart + (startTick - result->loopStart) % (result->ticks - result->loopStart);
+        }
+        endTick = seq_midi_start_at(&midi, result, MIN(startTick, result->ticks));
+        qsort(midi.events, midi.numEvents, sizeof(struct SeqMidiEvent), seq_midi_compare);
+        seq_midi_write_tracks(&midi, &buf, endTick);
+
+        if (!midi.failed && !buf.failed) {
+            file = fopen(path, "wb");
+            if (file != NULL) {
+                if (fwrite(buf.data, 1, buf.size, file) == buf.size) {
+                    ret = 0;
+                }
+                if (fclose(file) != 0) {
+                    ret = -1;
+                }
+            }
+        }
+    }
+
+    free(buf.data);
+    free(midi.events);
+    return ret;
+}
@@ -0,0 +1,28 @@
+#ifndef SEQ_MIDI_H
+#define SEQ_MIDI_H
+
+#include <PR/ultratypes.h>
+
+#include "seq_walk.h"
+
+/**
+ * Writes a sequence out as a Standard MIDI File (format 1, one tick per tatum) by walking it with seq_walk.c,
+ * so nothing is synthesized. Track 0 holds the tempo map and, for a sequence that loops, "loopStart" and
+ * "loopEnd" markers; every sequence channel that does something gets a track on the MIDI channel of the same
+ * number. Notes are keyed so that the player's middle C (semitone 39) is MIDI note 60, and drums keep their
+ * index in the bank the same way. Programs are the bank's own instrument numbers, not General MIDI ones.
+ * Instruments, pans and short note settings of single layers have no MIDI counterpart and are left out.
+ */
+
+#define SEQ_MIDI_TICKS_PER_BEAT 48 // TATUMS_PER_BEAT
+
+/**
+ * Walks the sequence in data[0..len) as seq_walk does and writes it to path. The file starts startTick ticks
+ * into the sequence (0 for the top), counting passes through the loop the way SequencePlayer.ticks does, with
+ * the settings made before then in place. tempoModifier scales the tempo like gTempoModifier does in the game.
+ * result gets the walk's result. Returns 0, or -1 if out of memory or the file could not be written.
+ */
+s32 seq_midi_write(const char *path, const u8 *data, u32 len, u8 variation, u32 startTick, u32 maxTicks,
+                   f32 tempoModifier, struct SeqWalkResult *result);
+
+#endif // SEQ_MIDI_H
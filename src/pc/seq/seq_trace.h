@@ -0,0 +1,36 @@
+#ifndef SEQ_TRACE_H
+#define SEQ_TRACE_H
+
+#include <PR/ultratypes.h>
+
+/**
+ * PC only: hooks into seqplayer.c for seq_check.c, which follows the real sequence player to check seq_walk.c
+ * against it. They are NULL unless a check is running.
+ */
+#ifndef TARGET_N64
+struct SequencePlayer;
+struct SequenceChannelLayer;
+
+// At the start of every tick a sequence player runs, before its ticks count goes up
+extern void (*gSeqTraceTick)(struct SequencePlayer *seqPlayer);
+// For every note command a layer runs, with the semitone before transposition; layer->delay holds its length
+extern void (*gSeqTraceNote)(struct SequenceChannelLayer *layer, u8 semitone);
+
+#define SEQ_TRACE_TICK(seqPlayer)                                                                              \
+    do {                                                                                                       \
+        if (gSeqTraceTick != NULL) {                                                                           \
+            gSeqTraceTick(seqPlayer);                                                                          \
+        }                                                                                                      \
+    } while (0)
+#define SEQ_TRACE_NOTE(layer, semitone)                                                                        \
+    do {                                                                                                       \
+        if (gSeqTraceNote != NULL) {                                                                           \
+            gSeqTraceNote(layer, semitone);                                                                    \
+        }                                                                                                      \
+    } while (0)
+#else
+#define SEQ_TRACE_TICK(seqPlayer)
+#define SEQ_TRACE_NOTE(layer, semitone)
+#endif
+
+#endif // SEQ_TRACE_H
@@ -0,0 +1,985 @@
+// seq_walk.c - steps the scripts of a compiled sequence like seqplayer.c does, without playing anything
+#include <stdlib.h>
+#include <string.h>
+
+#include "seq_walk.h"
+#include "audio/seq_opcodes.h"
+
+#define ARRAY_COUNT(arr) (s32)(sizeof(arr) / sizeof(arr[0]))
+
+#define TATUMS_PER_BEAT 48 // as in audio/internal.h; the tempo is kept in tatums (ticks) per minute
+
+// More commands than this without a delay means the script spins in place
+#define SEQ_WALK_MAX_COMMANDS 0x10000
+
+#define SEQ_WALK_DEFAULT_TABLE -1
+
+#define INSTRUMENT_DRUMS    0x7f // setinstr value that plays the bank's drums
+#define INSTRUMENT_INHERIT  0xff // layer setinstr value that goes back to the channel's instrument
+
+enum SeqWalkLevel {
+    LEVEL_SEQUENCE,
+    LEVEL_CHANNEL,
+    LEVEL_LAYER,
+    LEVEL_COUNT,
+};
+
+// M64ScriptState with offsets into the sequence instead of pointers
+struct SeqWalkScript {
+    u32 pc;
+    u32 stack[SEQ_WALK_DEPTH];
+    u8 remLoopIters[SEQ_WALK_DEPTH];
+    u8 depth;
+    u8 fault;
+};
+
+struct SeqWalkLayer {
+    u8 allocated;
+    u8 enabled;
+    u8 finished;
+    u16 delay;
+    u16 playPercentage;
+    u16 shortNoteDefaultPlayPercentage;
+    u8 noteDuration;
+    u8 velocity;
+    u8 instrument;
+    s8 transposition;
+    struct SeqWalkScript script;
+};
+
+struct SeqWalkChannel {
+    u8 allocated; // set up by initchannels, so it can be started
+    u8 enabled;
+    u8 finished;
+    u8 stopScript;
+    u8 largeNotes;
+    u8 instrument;
+    s8 transposition;
+    u16 delay;
+    u32 dynTable;
+    s8 soundScriptIO[8];
+    struct SeqWalkScript script;
+    struct SeqWalkLayer layers[SEQ_WALK_LAYERS];
+};
+
+struct SeqTempoChange {
+    u32 tick;
+    u16 tempo;
+};
+
+struct SeqWalk {
+    u8 *data;
+    u32 len;
+    u32 tick;
+    u8 enabled;
+    u8 looped;
+    u16 delay;
+    u16 tempo;
+    u8 variation;
+    s8 transposition;
+    s32 shortNoteVelocityTable; // offset into the data, or SEQ_WALK_DEFAULT_TABLE
+    s32 shortNoteDurationTable;
+    struct SeqWalkScript script;
+    struct SeqWalkChannel channels[SEQ_WALK_CHANNELS];
+    u32 *firstRun; // tick each byte of the data was first run as a sequence command
+    struct SeqTempoChange *tempos;
+    u32 numTempos;
+    u32 maxTempos;
+    SeqWalkCallback callback;
+    void *arg;
+    struct SeqWalkResult *result;
+};
+
+static const struct SeqOpcode *sOpcodes[LEVEL_COUNT][256];
+static const struct SeqOpcode *sNotes[2][0xc0];
+
+// gDefaultShortNoteVelocityTable and gDefaultShortNoteDurationTable in audio/data.c
+static const u8 sDefaultShortNoteVelocityTable[16] = {
+    12, 25, 38, 51, 57, 64, 71, 76, 83, 89, 96, 102, 109, 115, 121, 127,
+};
+static const u8 sDefaultShortNoteDurationTable[16] = {
+    229, 203, 177, 151, 139, 126, 113, 100, 87, 74, 61, 48, 36, 23, 10, 0,
+};
+
+static void seq_walk_fill(const struct SeqOpcode **lookup, const struct SeqOpcode *table, s32 count) {
+    s32 i;
+    s32 op;
+
+    for (i = 0; i < count; i++) {
+        for (op = table[i].first; op <= table[i].last; op++) {
+            lookup[op] = &table[i];
+        }
+    }
+}
+
+static void seq_walk_init_tables(void) {
+    if (sOpcodes[LEVEL_SEQUENCE][0xff] != NULL) {
+        return;
+    }
+    seq_walk_fill(sOpcodes[LEVEL_SEQUENCE], sSeqSequenceOpcodes, ARRAY_COUNT(sSeqSequenceOpcodes));
+    seq_walk_fill(sOpcodes[LEVEL_CHANNEL], sSeqChannelOpcodes, ARRAY_COUNT(sSeqChannelOpcodes));
+    seq_walk_fill(sOpcodes[LEVEL_LAYER], sSeqLayerOpcodes, ARRAY_COUNT(sSeqLayerOpcodes));
+    seq_walk_fill(sNotes[FALSE], sSeqLayerSmallNotes, ARRAY_COUNT(sSeqLayerSmallNotes));
+    seq_walk_fill(sNotes[TRUE], sSeqLayerLargeNotes, ARRAY_COUNT(sSeqLayerLargeNotes));
+}
+
+static u32 seq_walk_read_u8(struct SeqWalk *walk, struct SeqWalkScript *script) {
+    if (script->pc >= walk->len) {
+        script->fault = TRUE;
+        return 0;
+    }
+    return walk->data[script->pc++];
+}
+
+// Reads the operands listed in args, as m64_read_u8, m64_read_s16 and m64_read_compressed_u16 would
+static void seq_walk_read_args(struct SeqWalk *walk, struct SeqWalkScript *script, const char *args, s32 *out) {
+    s32 i;
+    u32 v;
+
+    for (i = 0; args[i] != '\0'; i++) {
+        v = seq_walk_read_u8(walk, script);
+        switch (args[i]) {
+            case 'h':
+                v = (v << 8) | seq_walk_read_u8(walk, script);
+                break;
+            case 'p':
+                if (out[0] & 0x80) {
+                    break;
+                }
+                // fallthrough
+            case 'v':
+                if (v & 0x80) {
+                    v = ((v << 8) & 0x7f00) | seq_walk_read_u8(walk, script);
+                }
+                break;
+        }
+        out[i] = v;
+    }
+}
+
+static u32 seq_walk_read_table(struct SeqWalk *walk, u32 table, u8 index) {
+    u32 offset = table + index * 2;
+
+    if (offset + 1 >= walk->len) {
+        return walk->len;
+    }
+    return (walk->data[offset] << 8) | walk->data[offset + 1];
+}
+
+static u8 seq_walk_read_short_note_table(struct SeqWalk *walk, s32 table, const u8 *defaultTable, u8 index) {
+    if (table == SEQ_WALK_DEFAULT_TABLE) {
+        return defaultTable[index];
+    }
+    return ((u32) table + index < walk->len) ? walk->data[table + index] : 0;
+}
+
+static void seq_walk_emit(struct SeqWalk *walk, struct SeqWalkEvent *event, u8 type, s32 channel, s32 layer,
+                          s32 value) {
+    event->type = type;
+    event->channel = channel;
+    event->layer = layer;
+    event->tick = walk->tick;
+    event->value = value;
+    if (walk->callback != NULL) {
+        walk->callback(walk->arg, event);
+    }
+}
+
+static void seq_walk_set_tempo(struct SeqWalk *walk, s32 tempo) {
+    struct SeqWalkEvent event;
+    struct SeqTempoChange *tempos;
+
+    if ((s16) tempo < 0) {
+        tempo = 0;
+    }
+    if (walk->numTempos == walk->maxTempos) {
+        walk->maxTempos = walk->maxTempos * 2 + 16;
+        tempos = realloc(walk->tempos, walk->maxTempos * sizeof(struct SeqTempoChange));
+        if (tempos == NULL) {
+            // Keep the old tempo map; only the time in seconds suffers
+            walk->maxTempos = walk->numTempos;
+            return;
+        }
+        walk->tempos = tempos;
+    }
+    walk->tempo = tempo;
+    walk->tempos[walk->numTempos].tick = walk->tick;
+    walk->tempos[walk->numTempos].tempo = tempo;
+    walk->numTempos++;
+
+    memset(&event, 0, sizeof(event));
+    seq_walk_emit(walk, &event, SEQ_WALK_TEMPO, -1, -1, tempo / TATUMS_PER_BEAT);
+}
+
+// Time from the start to the given tick. A tempo of 0 stops the clock.
+static f64 seq_walk_seconds(struct SeqWalk *walk, u32 tick) {
+    f64 seconds = 0.0;
+    u32 i;
+    u32 end;
+
+    for (i = 0; i < walk->numTempos && walk->tempos[i].tick < tick; i++) {
+        end = (i + 1 < walk->numTempos && walk->tempos[i + 1].tick < tick) ? walk->tempos[i + 1].tick : tick;
+        if (walk->tempos[i].tempo != 0) {
+            seconds += (end - walk->tempos[i].tick) * 60.0 / walk->tempos[i].tempo;
+        }
+    }
+    return seconds;
+}
+
+/**
+ * Control flow shared by the three script levels. Returns FALSE for anything else. 'end' at depth 0 is left
+ * to the caller, since what stops differs per level.
+ */
+static s32 seq_walk_flow(struct SeqWalkScript *script, u8 kind, const s32 *args, s32 value) {
+    switch (kind) {
+        case SEQ_OP_END:
+            script->pc = script->stack[--script->depth];
+            return TRUE;
+
+        case SEQ_OP_CALL:
+            if (script->depth >= SEQ_WALK_DEPTH) {
+                script->fault = TRUE;
+                return TRUE;
+            }
+            script->stack[script->depth++] = script->pc;
+            script->pc = args[0];
+            return TRUE;
+
+        case SEQ_OP_LOOP:
+            if (script->depth >= SEQ_WALK_DEPTH) {
+                script->fault = TRUE;
+                return TRUE;
+            }
+            script->remLoopIters[script->depth] = args[0];
+            script->stack[script->depth++] = script->pc;
+            return TRUE;
+
+        case SEQ_OP_LOOPEND:
+            if (script->depth == 0) {
+                script->fault = TRUE;
+            } else if (--script->remLoopIters[script->depth - 1] != 0) {
+                script->pc = script->stack[script->depth - 1];
+            } else {
+                script->depth--;
+            }
+            return TRUE;
+
+        case SEQ_OP_BREAK:
+            if (script->depth == 0) {
+                script->fault = TRUE;
+            } else {
+                script->depth--;
+            }
+            return TRUE;
+
+        case SEQ_OP_JUMP:
+        case SEQ_OP_BEQZ:
+        case SEQ_OP_BLTZ:
+        case SEQ_OP_BGEZ:
+            if ((kind == SEQ_OP_BEQZ && value != 0) || (kind == SEQ_OP_BLTZ && value >= 0)
+                || (kind == SEQ_OP_BGEZ && value < 0)) {
+                return TRUE;
+            }
+            script->pc = args[0];
+            return TRUE;
+
+        case SEQ_OP_JUMP_REL:
+        case SEQ_OP_BEQZ_REL:
+        case SEQ_OP_BLTZ_REL:
+            if ((kind == SEQ_OP_BEQZ_REL && value != 0) || (kind == SEQ_OP_BLTZ_REL && value >= 0)) {
+                return TRUE;
+            }
+            script->pc += (s8) args[0];
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void seq_walk_layer_disable(struct SeqWalkLayer *layer) {
+    layer->enabled = FALSE;
+    layer->finished = TRUE;
+}
+
+static void seq_walk_layer_free(struct SeqWalkLayer *layer) {
+    if (layer->allocated) {
+        seq_walk_layer_disable(layer);
+        layer->allocated = FALSE;
+    }
+}
+
+// seq_channel_set_layer
+static void seq_walk_layer_set(struct SeqWalkLayer *layer, u32 pc) {
+    if (!layer->allocated) {
+        layer->allocated = TRUE;
+        layer->playPercentage = 0;
+        layer->shortNoteDefaultPlayPercentage = 0;
+    }
+    layer->enabled = TRUE;
+    layer->finished = FALSE;
+    layer->noteDuration = 0x80;
+    layer->velocity = 0;
+    layer->instrument = INSTRUMENT_INHERIT;
+    layer->transposition = 0;
+    layer->delay = 0;
+    layer->script.depth = 0;
+    layer->script.fault = FALSE;
+    layer->script.pc = pc;
+}
+
+static void seq_walk_channel_disable(struct SeqWalkChannel *channel) {
+    s32 i;
+
+    for (i = 0; i < SEQ_WALK_LAYERS; i++) {
+        seq_walk_layer_free(&channel->layers[i]);
+    }
+    channel->enabled = FALSE;
+    channel->finished = TRUE;
+}
+
+// sequence_channel_init
+static void seq_walk_channel_init(struct SeqWalkChannel *channel) {
+    s32 i;
+
+    seq_walk_channel_disable(channel);
+    channel->allocated = TRUE;
+    channel->finished = FALSE;
+    channel->stopScript = FALSE;
+    channel->largeNotes = FALSE;
+    channel->instrument = 0;
+    channel->transposition = 0;
+    channel->delay = 0;
+    channel->script.depth = 0;
+    for (i = 0; i < 8; i++) {
+        channel->soundScriptIO[i] = -1;
+    }
+}
+
+static void seq_walk_fault(struct SeqWalk *walk) {
+    walk->result->errors++;
+}
+
+static const struct SeqOpcode *seq_walk_lookup(struct SeqWalk *walk, s32 level, u8 cmd) {
+    const struct SeqOpcode *op = sOpcodes[level][cmd];
+
+    if (op == NULL) {
+        walk->result->unknownCommands++;
+    }
+    return op;
+}
+
+static void seq_walk_layer(struct SeqWalk *walk, struct SeqWalkChannel *channel, s32 channelIndex,
+                           s32 layerIndex) {
+    struct SeqWalkLayer *layer = &channel->layers[layerIndex];
+    struct SeqWalkScript *script = &layer->script;
+    struct SeqWalkEvent event;
+    const struct SeqOpcode *op;
+    s32 args[8];
+    s32 count;
+    u16 length;
+    u8 cmd;
+    u8 kind;
+
+    if (!layer->enabled) {
+        return;
+    }
+    if (layer->delay > 1) {
+        layer->delay--;
+        return;
+    }
+
+    for (count = 0; count < SEQ_WALK_MAX_COMMANDS; count++) {
+        cmd = seq_walk_read_u8(walk, script);
+        op = (cmd < 0xc0) ? sNotes[channel->largeNotes][cmd] : seq_walk_lookup(walk, LEVEL_LAYER, cmd);
+        kind = (op != NULL) ? op->kind : SEQ_OP_OTHER;
+        seq_walk_read_args(walk, script, (op != NULL) ? op->args : "", args);
+        if (script->fault) {
+            break;
+        }
+
+        if (kind == SEQ_OP_END && script->depth == 0) {
+            seq_walk_layer_disable(layer);
+            return;
+        }
+        if (seq_walk_flow(script, kind, args, 0)) {
+            if (script->fault) {
+                break;
+            }
+            continue;
+        }
+
+        switch (kind) {
+            case SEQ_OP_LAYER_DELAY:
+                layer->delay = args[0];
+                return;
+
+            case SEQ_OP_LAYER_SETINSTR:
+                layer->instrument = args[0];
+                memset(&event, 0, sizeof(event));
+                seq_walk_emit(walk, &event, SEQ_WALK_INSTRUMENT, channelIndex, layerIndex, args[0]);
+                break;
+
+            case SEQ_OP_SETPAN:
+                memset(&event, 0, sizeof(event));
+                seq_walk_emit(walk, &event, SEQ_WALK_PAN, channelIndex, layerIndex, args[0]);
+                break;
+
+            case SEQ_OP_TRANSPOSE:
+                layer->transposition = args[0];
+                break;
+
+            case SEQ_OP_SETSHORTNOTEVELOCITY:
+                layer->velocity = args[0];
+                break;
+
+            case SEQ_OP_SETSHORTNOTEDURATION:
+                layer->noteDuration = args[0];
+                break;
+
+            case SEQ_OP_SETSHORTNOTEDEFAULTPLAYPERCENTAGE:
+                layer->shortNoteDefaultPlayPercentage = args[0];
+                break;
+
+            case SEQ_OP_SHORTNOTEVELOCITYFROMTABLE:
+                layer->velocity = seq_walk_read_short_note_table(walk, walk->shortNoteVelocityTable,
+                                                                 sDefaultShortNoteVelocityTable, cmd & 0xf);
+                break;
+
+            case SEQ_OP_SHORTNOTEDURATIONFROMTABLE:
+                layer->noteDuration = seq_walk_read_short_note_table(walk, walk->shortNoteDurationTable,
+                                                                     sDefaultShortNoteDurationTable, cmd & 0xf);
+                break;
+
+            case SEQ_OP_NOTE:
+                memset(&event, 0, sizeof(event));
+                event.note.semitone = cmd & 0x3f;
+                event.note.large = channel->largeNotes;
+                if (channel->largeNotes) {
+                    switch (cmd & 0xc0) {
+                        case 0x00:
+                            layer->playPercentage = args[0];
+                            layer->velocity = args[1];
+                            layer->noteDuration = args[2];
+                            break;
+                        case 0x40:
+                            layer->playPercentage = args[0];
+                            layer->velocity = args[1];
+                            layer->noteDuration = 0;
+                            break;
+                        case 0x80:
+                            layer->velocity = args[0];
+                            layer->noteDuration = args[1];
+                            break;
+                    }
+                    length = layer->playPercentage;
+                } else {
+                    switch (cmd & 0xc0) {
+                        case 0x00:
+                            length = layer->playPercentage = args[0];
+                            break;
+                        case 0x40:
+                            length = layer->shortNoteDefaultPlayPercentage;
+                            break;
+                        default:
+                            length = layer->playPercentage;
+                            break;
+                    }
+                }
+                event.note.velocity = layer->velocity;
+                event.note.length = length;
+                event.note.gate = length - (layer->noteDuration * length >> 8);
+#if defined(VERSION_EU) || defined(VERSION_SH)
+                event.note.drum = (layer->instrument == INSTRUMENT_INHERIT ? channel->instrument : layer->instrument)
+                                  == INSTRUMENT_DRUMS;
+#else
+                event.note.drum = channel->instrument == INSTRUMENT_DRUMS;
+#endif
+                // Drums don't follow the sequence's transposition
+                event.note.key = event.note.semitone + channel->transposition + layer->transposition;
+                if (!event.note.drum) {
+                    event.note.key += walk->transposition;
+                }
+                layer->delay = length;
+                seq_walk_emit(walk, &event, SEQ_WALK_NOTE, channelIndex, layerIndex, 0);
+                return;
+        }
+    }
+
+    // Ran off the data, overflowed the stack or never waited
+    seq_walk_fault(walk);
+    seq_walk_layer_disable(layer);
+}
+
+static void seq_walk_channel(struct SeqWalk *walk, s32 channelIndex) {
+    struct SeqWalkChannel *channel = &walk->channels[channelIndex];
+    struct SeqWalkScript *script = &channel->script;
+    struct SeqWalkChannel *other;
+    struct SeqWalkLayer *layer;
+    struct SeqWalkEvent event;
+    const struct SeqOpcode *op;
+    s32 args[8];
+    s32 count;
+    s32 i;
+    u32 offset;
+    s8 value = 0;
+    u8 loBits;
+    u8 cmd;
+    u8 kind;
+
+    if (!channel->enabled) {
+        return;
+    }
+
+    if (!channel->stopScript) {
+        if (channel->delay != 0) {
+            channel->delay--;
+        }
+        for (count = 0; channel->delay == 0; count++) {
+            if (count == SEQ_WALK_MAX_COMMANDS) {
+                script->fault = TRUE;
+            }
+            if (script->fault) {
+                seq_walk_fault(walk);
+                seq_walk_channel_disable(channel);
+                return;
+            }
+
+            cmd = seq_walk_read_u8(walk, script);
+            op = seq_walk_lookup(walk, LEVEL_CHANNEL, cmd);
+            kind = (op != NULL) ? op->kind : SEQ_OP_OTHER;
+            seq_walk_read_args(walk, script, (op != NULL) ? op->args : "", args);
+            if (script->fault) {
+                continue;
+            }
+            // Shindou's layer commands take the layer in the low three bits
+            loBits = cmd & ((op != NULL && op->last - op->first == 7) ? 7 : 0xf);
+
+            if (kind == SEQ_OP_END && script->depth == 0) {
+                seq_walk_channel_disable(channel);
+                return;
+            }
+            if (seq_walk_flow(script, kind, args, value)) {
+                continue;
+            }
+
+            switch (kind) {
+                case SEQ_OP_DELAY1:
+                    goto out;
+
+                case SEQ_OP_DELAY:
+                    channel->delay = args[0];
+                    goto out;
+
+                case SEQ_OP_DELAY_SHORT:
+                    channel->delay = loBits;
+                    goto out;
+
+                case SEQ_OP_HANG:
+                    channel->stopScript = TRUE;
+                    goto out;
+
+                case SEQ_OP_SETVAL:
+                    value = args[0];
+                    break;
+
+                case SEQ_OP_SUBTRACT:
+                    value -= args[0];
+                    break;
+
+                case SEQ_OP_BITAND:
+                    value &= args[0];
+                    break;
+
+                case SEQ_OP_READSEQ:
+                    i = (u16) args[0] + value;
+                    value = (i >= 0 && (u32) i < walk->len) ? walk->data[i] : 0;
+                    break;
+
+                case SEQ_OP_WRITESEQ:
+                    if ((u32) args[1] < walk->len) {
+                        walk->data[args[1]] = (u8) value + args[0];
+                    }
+                    break;
+
+                case SEQ_OP_SETDYNTABLE:
+                    channel->dynTable = args[0];
+                    break;
+
+                case SEQ_OP_DYNSETDYNTABLE:
+                    if (value != -1) {
+                        channel->dynTable = seq_walk_read_table(walk, channel->dynTable, value);
+                    }
+                    break;
+
+                case SEQ_OP_DYNCALL:
+                    if (value != -1) {
+                        args[0] = seq_walk_read_table(walk, channel->dynTable, value);
+                        seq_walk_flow(script, SEQ_OP_CALL, args, value);
+                    }
+                    break;
+
+                case SEQ_OP_STARTCHANNEL:
+                    other = &walk->channels[loBits];
+                    if (other->allocated) {
+                        seq_walk_channel_disable(other);
+                        other->enabled = TRUE;
+                        other->finished = FALSE;
+                        other->script.depth = 0;
+                        other->script.fault = FALSE;
+                        other->script.pc = args[0];
+                        other->delay = 0;
+                    }
+                    break;
+
+                case SEQ_OP_DISABLECHANNEL:
+                case SEQ_OP_DISABLECHANNEL_ARG:
+                    other = &walk->channels[(kind == SEQ_OP_DISABLECHANNEL ? loBits : args[0]) & 0xf];
+                    if (other->allocated) {
+                        seq_walk_channel_disable(other);
+                    }
+                    if (other == channel) {
+                        return;
+                    }
+                    break;
+
+                case SEQ_OP_SETLAYER:
+                    seq_walk_layer_set(&channel->layers[loBits & 3], args[0]);
+                    break;
+
+                case SEQ_OP_DYNSETLAYER:
+                    if (value != -1) {
+                        seq_walk_layer_set(&channel->layers[loBits & 3],
+                                           seq_walk_read_table(walk, channel->dynTable, value));
+                    }
+                    break;
+
+                case SEQ_OP_FREELAYER:
+                    seq_walk_layer_free(&channel->layers[loBits & 3]);
+                    break;
+
+                case SEQ_OP_FREELAYERS:
+                    for (i = 0; i < SEQ_WALK_LAYERS; i++) {
+                        seq_walk_layer_free(&channel->layers[i]);
+                    }
+                    break;
+
+                case SEQ_OP_TESTLAYERSFINISHED:
+                    value = TRUE;
+                    for (i = 0; i < SEQ_WALK_LAYERS; i++) {
+                        if (channel->layers[i].allocated && !channel->layers[i].finished) {
+                            value = FALSE;
+                            break;
+                        }
+                    }
+                    break;
+
+                case SEQ_OP_TESTLAYERFINISHED:
+                    layer = &channel->layers[loBits & 3];
+                    value = layer->allocated ? layer->finished : -1;
+                    break;
+
+                case SEQ_OP_IOWRITEVAL:
+                    channel->soundScriptIO[loBits & 7] = value;
+                    break;
+
+                case SEQ_OP_IOREADVAL:
+                    value = channel->soundScriptIO[loBits & 7];
+                    if (loBits < 4) {
+                        channel->soundScriptIO[loBits] = -1;
+                    }
+                    break;
+
+                case SEQ_OP_IOREADVALSUB:
+                    value -= channel->soundScriptIO[loBits & 7];
+                    break;
+
+                case SEQ_OP_IOWRITEVAL2:
+                    walk->channels[loBits].soundScriptIO[args[0] & 7] = value;
+                    break;
+
+                case SEQ_OP_IOREADVAL2:
+                    value = walk->channels[loBits].soundScriptIO[args[0] & 7];
+                    break;
+
+                case SEQ_OP_LARGENOTESON:
+                    channel->largeNotes = TRUE;
+                    break;
+
+                case SEQ_OP_LARGENOTESOFF:
+                    channel->largeNotes = FALSE;
+                    break;
+
+                case SEQ_OP_SETBANK:
+                case SEQ_OP_SETBANKANDINSTR:
+                    memset(&event, 0, sizeof(event));
+                    seq_walk_emit(walk, &event, SEQ_WALK_BANK, channelIndex, -1, args[0]);
+                    if (kind == SEQ_OP_SETBANK) {
+                        break;
+                    }
+                    args[0] = args[1];
+                    // fallthrough
+                case SEQ_OP_SETINSTR:
+                    channel->instrument = args[0];
+                    memset(&event, 0, sizeof(event));
+                    seq_walk_emit(walk, &event, SEQ_WALK_INSTRUMENT, channelIndex, -1, args[0]);
+                    break;
+
+                case SEQ_OP_SETVOL:
+                    memset(&event, 0, sizeof(event));
+                    seq_walk_emit(walk, &event, SEQ_WALK_VOLUME, channelIndex, -1, args[0]);
+                    break;
+
+                case SEQ_OP_SETPAN:
+                    memset(&event, 0, sizeof(event));
+                    seq_walk_emit(walk, &event, SEQ_WALK_PAN, channelIndex, -1, args[0]);
+                    break;
+
+                case SEQ_OP_PITCHBEND:
+                    memset(&event, 0, sizeof(event));
+                    seq_walk_emit(walk, &event, SEQ_WALK_PITCHBEND, channelIndex, -1, (s8) args[0]);
+                    break;
+
+                case SEQ_OP_TRANSPOSE:
+                    channel->transposition = args[0];
+                    break;
+
+                case SEQ_OP_SETCHANPARAMSFROMSEQ:
+                    // The eight setchanparams operands, stored in the sequence
+                    offset = args[0];
+                    for (i = 0; i < 8; i++) {
+                        args[i] = (offset + 7 < walk->len) ? walk->data[offset + i] : 0;
+                    }
+                    // fallthrough
+                case SEQ_OP_SETCHANPARAMS:
+                    channel->transposition = args[3];
+                    memset(&event, 0, sizeof(event));
+                    seq_walk_emit(walk, &event, SEQ_WALK_PAN, channelIndex, -1, args[4]);
+                    break;
+            }
+        }
+    }
+out:
+
+    for (i = 0; i < SEQ_WALK_LAYERS; i++) {
+        if (channel->layers[i].allocated) {
+            seq_walk_layer(walk, channel, channelIndex, i);
+        }
+    }
+}
+
+static void seq_walk_sequence(struct SeqWalk *walk) {
+    struct SeqWalkScript *script = &walk->script;
+    struct SeqWalkChannel *channel;
+    const struct SeqOpcode *op;
+    s32 args[8];
+    s32 count;
+    s32 value = 0;
+    s32 i;
+    u32 pc;
+    u8 cmd;
+    u8 kind;
+
+    for (count = 0; count < SEQ_WALK_MAX_COMMANDS; count++) {
+        pc = script->pc;
+        if (pc < walk->len && walk->firstRun[pc] == SEQ_WALK_NO_LOOP) {
+            walk->firstRun[pc] = walk->tick;
+        }
+        cmd = seq_walk_read_u8(walk, script);
+        op = seq_walk_lookup(walk, LEVEL_SEQUENCE, cmd);
+        kind = (op != NULL) ? op->kind : SEQ_OP_OTHER;
+        seq_walk_read_args(walk, script, (op != NULL) ? op->args : "", args);
+        if (script->fault) {
+            break;
+        }
+
+        if (kind == SEQ_OP_END && script->depth == 0) {
+            walk->enabled = FALSE;
+            return;
+        }
+
+        // Jumping back to a command first run at an earlier tick repeats the sequence from there. Conditional
+        // branches are left alone; they usually wait for something rather than loop the music.
+        if (kind == SEQ_OP_JUMP || kind == SEQ_OP_JUMP_REL) {
+            pc = (kind == SEQ_OP_JUMP) ? (u32) args[0] : script->pc + (s8) args[0];
+            if (pc < walk->len && walk->firstRun[pc] < walk->tick) {
+                walk->result->loopStart = walk->firstRun[pc];
+                walk->looped = TRUE;
+                return;
+            }
+        }
+        if (seq_walk_flow(script, kind, args, value)) {
+            if (script->fault) {
+                break;
+            }
+            continue;
+        }
+
+        switch (kind) {
+            case SEQ_OP_DELAY1:
+                walk->delay = 1;
+                return;
+
+            case SEQ_OP_DELAY:
+                walk->delay = args[0];
+                return;
+
+            case SEQ_OP_SETVAL:
+                value = args[0];
+                break;
+
+            case SEQ_OP_SUBTRACT:
+                value -= args[0];
+                break;
+
+            case SEQ_OP_BITAND:
+                value &= args[0];
+                break;
+
+            case SEQ_OP_WRITESEQ:
+                if ((u32) args[1] < walk->len) {
+                    walk->data[args[1]] = (u8) value + args[0];
+                }
+                break;
+
+            case SEQ_OP_SETTEMPO:
+                seq_walk_set_tempo(walk, args[0] * TATUMS_PER_BEAT);
+                break;
+
+            case SEQ_OP_ADDTEMPO:
+                seq_walk_set_tempo(walk, walk->tempo + (s8) args[0] * TATUMS_PER_BEAT);
+                break;
+
+            case SEQ_OP_INITCHANNELS:
+            case SEQ_OP_DISABLECHANNELS:
+                for (i = 0; i < SEQ_WALK_CHANNELS; i++) {
+                    if (args[0] & (1 << i)) {
+                        channel = &walk->channels[i];
+                        if (kind == SEQ_OP_INITCHANNELS) {
+                            seq_walk_channel_init(channel);
+                        } else if (channel->allocated) {
+                            seq_walk_channel_disable(channel);
+                            channel->allocated = FALSE;
+                        }
+                    }
+                }
+                break;
+
+            case SEQ_OP_TESTCHDISABLED:
+                channel = &walk->channels[cmd & 0xf];
+                if (channel->allocated) {
+                    value = channel->finished;
+                }
+                break;
+
+            case SEQ_OP_SUBVARIATION:
+                value -= walk->variation;
+                break;
+
+            case SEQ_OP_SETVARIATION:
+                walk->variation = value;
+                break;
+
+            case SEQ_OP_GETVARIATION:
+                value = walk->variation;
+                break;
+
+            case SEQ_OP_TRANSPOSE:
+                walk->transposition = args[0];
+                break;
+
+            case SEQ_OP_TRANSPOSEREL:
+                walk->transposition += args[0];
+                break;
+
+            case SEQ_OP_SETSHORTNOTEVELOCITYTABLE:
+                walk->shortNoteVelocityTable = args[0];
+                break;
+
+            case SEQ_OP_SETSHORTNOTEDURATIONTABLE:
+                walk->shortNoteDurationTable = args[0];
+                break;
+
+            case SEQ_OP_STARTCHANNEL:
+                channel = &walk->channels[cmd & 0xf];
+                if (channel->allocated) {
+                    seq_walk_channel_disable(channel);
+                    channel->enabled = TRUE;
+                    channel->finished = FALSE;
+                    channel->script.depth = 0;
+                    channel->script.fault = FALSE;
+                    channel->script.pc = args[0];
+                    channel->delay = 0;
+                }
+                break;
+        }
+    }
+
+    // A sequence script that can't go on stops the sequence
+    seq_walk_fault(walk);
+    walk->enabled = FALSE;
+}
+
+s32 seq_walk(const u8 *data, u32 len, u8 variation, u32 maxTicks, SeqWalkCallback callback, void *arg,
+             struct SeqWalkResult *result) {
+    struct SeqWalk *walk;
+    u32 i;
+    s32 j;
+
+    seq_walk_init_tables();
+    memset(result, 0, sizeof(*result));
+    result->loopStart = SEQ_WALK_NO_LOOP;
+
+    walk = calloc(1, sizeof(struct SeqWalk));
+    if (walk == NULL) {
+        return -1;
+    }
+    walk->data = malloc(len + 1);
+    walk->firstRun = malloc((len + 1) * sizeof(u32));
+    if (walk->data == NULL || walk->firstRun == NULL) {
+        free(walk->data);
+        free(walk->firstRun);
+        free(walk);
+        return -1;
+    }
+    memcpy(walk->data, data, len);
+    for (i = 0; i < len; i++) {
+        walk->firstRun[i] = SEQ_WALK_NO_LOOP;
+    }
+    walk->len = len;
+    walk->variation = variation;
+    walk->shortNoteVelocityTable = SEQ_WALK_DEFAULT_TABLE;
+    walk->shortNoteDurationTable = SEQ_WALK_DEFAULT_TABLE;
+    walk->callback = callback;
+    walk->arg = arg;
+    walk->result = result;
+    walk->enabled = TRUE;
+    seq_walk_set_tempo(walk, 120 * TATUMS_PER_BEAT);
+
+    for (walk->tick = 0; walk->tick < maxTicks; walk->tick++) {
+        if (walk->delay > 1) {
+            walk->delay--;
+        } else {
+            seq_walk_sequence(walk);
+            if (!walk->enabled || walk->looped) {
+                break;
+            }
+        }
+        for (j = 0; j < SEQ_WALK_CHANNELS; j++) {
+            if (walk->channels[j].allocated) {
+                seq_walk_channel(walk, j);
+            }
+        }
+    }
+
+    result->status = walk->looped ? SEQ_WALK_LOOPED : (walk->enabled ? SEQ_WALK_TICK_LIMIT : SEQ_WALK_ENDED);
+    result->ticks = walk->tick;
+    result->seconds = seq_walk_seconds(walk, walk->tick);
+    if (walk->looped) {
+        result->loopStartSeconds = seq_walk_seconds(walk, result->loopStart);
+    }
+
+    free(walk->tempos);
+    free(walk->firstRun);
+    free(walk->data);
+    free(walk);
+    return 0;
+}
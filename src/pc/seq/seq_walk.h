@@ -0,0 +1,75 @@
+#ifndef SEQ_WALK_H
+#define SEQ_WALK_H
+
+#include <PR/ultratypes.h>
+
+/**
+ * Host-side walker for compiled sequences (.m64). It steps the sequence, channel and layer scripts tick by tick
+ * the way seqplayer.c does, using the copy of its commands in audio/seq_opcodes.h, but plays nothing: it only
+ * reports what happens and when. Calls, loops, jumps, dynamic tables and writes to the sequence data are
+ * followed. Nothing from the game pokes the scripts, so IO slots read back what the scripts wrote (or -1)
+ * and the variation is whatever the caller sets.
+ */
+
+#define SEQ_WALK_CHANNELS 16 // CHANNELS_MAX
+#define SEQ_WALK_LAYERS   4  // LAYERS_MAX
+#define SEQ_WALK_DEPTH    4  // call and loop stack of M64ScriptState
+
+#define SEQ_WALK_NO_LOOP 0xffffffff
+
+enum SeqWalkEventType {
+    SEQ_WALK_TEMPO,      // value: new tempo in BPM
+    SEQ_WALK_BANK,       // value: index into the sequence's bank set, 0 being the default bank channels start on
+    SEQ_WALK_INSTRUMENT, // value: instrument; layer is -1 when set for the whole channel
+    SEQ_WALK_NOTE,       // note: the note a layer starts
+    SEQ_WALK_VOLUME,     // value: channel volume, 127 being full
+    SEQ_WALK_PAN,        // value: 0 (left) to 127 (right), 64 centered; set for a layer or the whole channel
+    SEQ_WALK_PITCHBEND,  // value: -127 to 127, an octave either way
+};
+
+enum SeqWalkStatus {
+    SEQ_WALK_ENDED,      // the sequence script ended, which stops the whole sequence
+    SEQ_WALK_LOOPED,     // the sequence script jumped back to where it was at an earlier tick
+    SEQ_WALK_TICK_LIMIT, // neither happened within the tick limit
+};
+
+struct SeqWalkNote {
+    u8 semitone; // the low six bits of the note command, before transposition
+    u8 key;      // after transposition: the drum, or the semitone of an instrument, where 0x80 and up is dropped
+    u8 drum;     // played on the channel's drums rather than an instrument
+    u8 large;    // played with large notes on
+    u8 velocity; // as given by the note, or by the layer's short note velocity
+    u16 length;  // ticks until the layer runs its next command
+    u16 gate;    // ticks the note is held before it is released
+};
+
+struct SeqWalkEvent {
+    u8 type;
+    s8 channel; // -1 for sequence level events
+    s8 layer;   // -1 for sequence and channel level events
+    u32 tick;
+    s32 value;
+    struct SeqWalkNote note;
+};
+
+struct SeqWalkResult {
+    u8 status;
+    u32 ticks;          // ticks walked: up to the end, to the jump back, or the limit
+    f64 seconds;        // the same at the tempo the script set, in real time
+    u32 loopStart;      // tick the sequence loops back to, or SEQ_WALK_NO_LOOP
+    f64 loopStartSeconds;
+    u32 errors;         // scripts stopped for running off the data or overflowing their stack
+    u32 unknownCommands;
+};
+
+typedef void (*SeqWalkCallback)(void *arg, const struct SeqWalkEvent *event);
+
+/**
+ * Walks the sequence in data[0..len) for at most maxTicks ticks. variation is the SEQ_VARIATION bit the
+ * sequence is started with. The data is copied first, so scripts that write to themselves leave it alone.
+ * Returns 0, or -1 if out of memory.
+ */
+s32 seq_walk(const u8 *data, u32 len, u8 variation, u32 maxTicks, SeqWalkCallback callback, void *arg,
+             struct SeqWalkResult *result);
+
+#endif // SEQ_WALK_H
@@ -0,0 +1,376 @@
+// vadpcm.c - VADPCM frame decoder, with SSE2, SSE4.1 and NEON paths and a scalar fallback
+#include <string.h>
+
+#include "vadpcm.h"
+
+#if !defined(__sgi) && defined(__SSE4_1__)
+#include <smmintrin.h>
+#define USE_SSE2 1
+#define USE_SSE41 1
+#elif !defined(__sgi) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define USE_SSE2 1
+#elif !defined(__sgi) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON 1
+#endif
+
+#pragma GCC optimize ("unroll-loops")
+
+// Position of coefficient 'i' of column 'c' in the interleaved layout of struct VadpcmDecoder.
+#define COL_INDEX(c, i) (((c) >> 1) * 16 + ((i) >> 2) * 8 + ((i) & 3) * 2 + ((c) & 1))
+
+static int16_t clamp16(int32_t x) {
+    if (x < -0x8000) {
+        return -0x8000;
+    }
+    if (x > 0x7fff) {
+        return 0x7fff;
+    }
+    return (int16_t) x;
+}
+
+/**
+ * Expand the codebook into per-input columns. Row k < order of predictor p weights the k-th previous output;
+ * the residuals are weighted by the last row shifted down one lane per input, with 1 << 11 on the diagonal.
+ */
+int vadpcm_decoder_init(struct VadpcmDecoder *dec, const int16_t *book, int order, int npredictors) {
+    int p, c, i;
+
+    if (order < 1 || order > VADPCM_MAX_ORDER || npredictors < 1 || npredictors > VADPCM_MAX_PREDICTORS) {
+        return -1;
+    }
+    dec->order = order;
+    dec->npredictors = npredictors;
+    dec->ncols = (order + 8 + 1) & ~1;
+    for (p = 0; p < npredictors; p++) {
+        for (c = 0; c < order; c++) {
+            for (i = 0; i < 8; i++) {
+                dec->book[p][c][i] = book[(p * order + c) * 8 + i];
+            }
+        }
+    }
+#if defined(USE_SSE41) || defined(USE_NEON)
+    // vadpcm_decode_order2() works from the rows. The mixer loads a book for every note it plays, so this matters.
+    if (order == 2) {
+        return 0;
+    }
+#endif
+
+    // Predictors past npredictors are never read
+    memset(dec->cols, 0, npredictors * sizeof(dec->cols[0]));
+    for (p = 0; p < npredictors; p++) {
+        const int16_t *rows = book + p * order * 8;
+        int16_t *cols = dec->cols[p];
+
+        for (c = 0; c < order; c++) {
+            for (i = 0; i < 8; i++) {
+                cols[COL_INDEX(c, i)] = rows[c * 8 + i];
+            }
+        }
+        for (c = 0; c < 8; c++) {
+            cols[COL_INDEX(order + c, c)] = 1 << 11;
+            for (i = c + 1; i < 8; i++) {
+                cols[COL_INDEX(order + c, i)] = rows[(order - 1) * 8 + i - c - 1];
+            }
+        }
+    }
+    return 0;
+}
+
+// The 8 scaled residuals of one half frame
+static void vadpcm_residuals(const uint8_t *frame, int half, int16_t *ins) {
+    int shift = frame[0] >> 4;
+    int i;
+
+    for (i = 0; i < 8; i += 2) {
+        uint8_t b = frame[1 + half * 4 + i / 2];
+        ins[i] = (int16_t) (((int32_t) ((b >> 4) ^ 8) - 8) * (1 << shift));
+        ins[i + 1] = (int16_t) (((int32_t) ((b & 0xf) ^ 8) - 8) * (1 << shift));
+    }
+}
+
+// The same without truncating them to 16 bits, for vadpcm_decode_frame_s32()
+static void vadpcm_residuals_s32(const uint8_t *frame, int half, int32_t *ins) {
+    int shift = frame[0] >> 4;
+    int i;
+
+    for (i = 0; i < 8; i += 2) {
+        uint8_t b = frame[1 + half * 4 + i / 2];
+        ins[i] = ((int32_t) ((b >> 4) ^ 8) - 8) * (1 << shift);
+        ins[i + 1] = ((int32_t) ((b & 0xf) ^ 8) - 8) * (1 << shift);
+    }
+}
+
+static int vadpcm_predictor(const struct VadpcmDecoder *dec, const uint8_t *frame) {
+    int pred = frame[0] & 0xf;
+    return pred < dec->npredictors ? pred : 0;
+}
+
+#if defined(USE_SSE41)
+/**
+ * Order 2, the only one the game's banks use and so the one the mixer runs. The history stays interleaved in a
+ * register from one half frame to the next, and the residuals are weighted by the second book row reversed and
+ * shifted one lane per residual, summed with horizontal adds.
+ */
+static void vadpcm_decode_order2(const struct VadpcmDecoder *dec, const uint8_t *frames, uint32_t numFrames,
+                                 int16_t *out) {
+    const __m128i tblrev = _mm_setr_epi8(12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1, -1, -1);
+    const __m128i pos0 = _mm_set_epi8(3, -1, 3, -1, 2, -1, 2, -1, 1, -1, 1, -1, 0, -1, 0, -1);
+    const __m128i pos1 = _mm_set_epi8(7, -1, 7, -1, 6, -1, 6, -1, 5, -1, 5, -1, 4, -1, 4, -1);
+    const __m128i mult = _mm_set_epi16(0x10, 0x01, 0x10, 0x01, 0x10, 0x01, 0x10, 0x01);
+    __m128i prev_interleaved = _mm_set1_epi32((uint16_t) out[-2] | ((uint32_t) (uint16_t) out[-1] << 16));
+    uint32_t n;
+    int i;
+
+    for (n = 0; n < numFrames; n++, frames += VADPCM_FRAME_SIZE) {
+        const int16_t (*tbl)[8] = dec->book[vadpcm_predictor(dec, frames)];
+        // _mm_loadu_si64 needs GCC 9, and this compiles to the same instructions
+        uint64_t v;
+        memcpy(&v, frames + 1, 8);
+        __m128i inv = _mm_set_epi64x(0, v);
+        __m128i invec[2] = { _mm_shuffle_epi8(inv, pos0), _mm_shuffle_epi8(inv, pos1) };
+        __m128i tblvec0 = _mm_loadu_si128((const __m128i *) tbl[0]);
+        __m128i tblvec1 = _mm_loadu_si128((const __m128i *) tbl[1]);
+        __m128i tbllo = _mm_unpacklo_epi16(tblvec0, tblvec1);
+        __m128i tblhi = _mm_unpackhi_epi16(tblvec0, tblvec1);
+        __m128i shiftcount = _mm_cvtsi32_si128(frames[0] >> 4);
+        __m128i tblvec1_rev[8];
+
+        tblvec1_rev[0] = _mm_insert_epi16(_mm_shuffle_epi8(tblvec1, tblrev), 1 << 11, 7);
+        tblvec1_rev[1] = _mm_bsrli_si128(tblvec1_rev[0], 2);
+        tblvec1_rev[2] = _mm_bsrli_si128(tblvec1_rev[0], 4);
+        tblvec1_rev[3] = _mm_bsrli_si128(tblvec1_rev[0], 6);
+        tblvec1_rev[4] = _mm_bsrli_si128(tblvec1_rev[0], 8);
+        tblvec1_rev[5] = _mm_bsrli_si128(tblvec1_rev[0], 10);
+        tblvec1_rev[6] = _mm_bsrli_si128(tblvec1_rev[0], 12);
+        tblvec1_rev[7] = _mm_bsrli_si128(tblvec1_rev[0], 14);
+        for (i = 0; i < 2; i++) {
+            __m128i acc0 = _mm_madd_epi16(prev_interleaved, tbllo);
+            __m128i acc1 = _mm_madd_epi16(prev_interleaved, tblhi);
+            __m128i muls[8];
+            __m128i result;
+            // Each nibble ends up in the top bits of its lane; sign extend it, then scale it by shifting left,
+            // which drops the same high bits as vadpcm_residuals()
+            invec[i] = _mm_sll_epi16(_mm_srai_epi16(_mm_mullo_epi16(invec[i], mult), 12), shiftcount);
+
+            muls[7] = _mm_madd_epi16(tblvec1_rev[0], invec[i]);
+            muls[6] = _mm_madd_epi16(tblvec1_rev[1], invec[i]);
+            muls[5] = _mm_madd_epi16(tblvec1_rev[2], invec[i]);
+            muls[4] = _mm_madd_epi16(tblvec1_rev[3], invec[i]);
+            muls[3] = _mm_madd_epi16(tblvec1_rev[4], invec[i]);
+            muls[2] = _mm_madd_epi16(tblvec1_rev[5], invec[i]);
+            muls[1] = _mm_madd_epi16(tblvec1_rev[6], invec[i]);
+            muls[0] = _mm_madd_epi16(tblvec1_rev[7], invec[i]);
+
+            acc0 = _mm_add_epi32(acc0, _mm_hadd_epi32(_mm_hadd_epi32(muls[0], muls[1]),
+                                                      _mm_hadd_epi32(muls[2], muls[3])));
+            acc1 = _mm_add_epi32(acc1, _mm_hadd_epi32(_mm_hadd_epi32(muls[4], muls[5]),
+                                                      _mm_hadd_epi32(muls[6], muls[7])));
+
+            result = _mm_packs_epi32(_mm_srai_epi32(acc0, 11), _mm_srai_epi32(acc1, 11));
+            _mm_storeu_si128((__m128i *) out, result);
+            out += 8;
+
+            prev_interleaved = _mm_shuffle_epi32(result, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+    }
+}
+#elif defined(USE_NEON)
+/**
+ * Order 2, the only one the game's banks use and so the one the mixer runs. The residuals are weighted by the
+ * second book row shifted one lane per residual, and the last two outputs carry over in 'result'.
+ */
+static void vadpcm_decode_order2(const struct VadpcmDecoder *dec, const uint8_t *frames, uint32_t numFrames,
+                                 int16_t *out) {
+    static const int8_t pos0_data[] = { -1, 0, -1, 0, -1, 1, -1, 1, -1, 2, -1, 2, -1, 3, -1, 3 };
+    static const int8_t pos1_data[] = { -1, 4, -1, 4, -1, 5, -1, 5, -1, 6, -1, 6, -1, 7, -1, 7 };
+    static const int16_t mult_data[] = { 0x01, 0x10, 0x01, 0x10, 0x01, 0x10, 0x01, 0x10 };
+    static const int16_t table_prefix_data[] = { 0, 0, 0, 0, 0, 0, 0, 1 << 11 };
+    const int8x16_t pos0 = vld1q_s8(pos0_data);
+    const int8x16_t pos1 = vld1q_s8(pos1_data);
+    const int16x8_t mult = vld1q_s16(mult_data);
+    const int16x8_t table_prefix = vld1q_s16(table_prefix_data);
+    // Only lanes 6 and 7 are read
+    int16x8_t result = vsetq_lane_s16(out[-1], vsetq_lane_s16(out[-2], vdupq_n_s16(0), 6), 7);
+    uint32_t n;
+    int i;
+
+    for (n = 0; n < numFrames; n++, frames += VADPCM_FRAME_SIZE) {
+        const int16_t (*tbl)[8] = dec->book[vadpcm_predictor(dec, frames)];
+        int8x8_t inv = vld1_s8((const int8_t *) (frames + 1));
+        int16x8_t tblvec[2] = { vld1q_s16(tbl[0]), vld1q_s16(tbl[1]) };
+        int16x8_t invec[2] = { vreinterpretq_s16_s8(vcombine_s8(vtbl1_s8(inv, vget_low_s8(pos0)),
+                                                                vtbl1_s8(inv, vget_high_s8(pos0)))),
+                               vreinterpretq_s16_s8(vcombine_s8(vtbl1_s8(inv, vget_low_s8(pos1)),
+                                                                vtbl1_s8(inv, vget_high_s8(pos1)))) };
+        int16x8_t shiftcount = vdupq_n_s16(frames[0] >> 4);
+        int16x8_t tblvec1[8];
+
+        tblvec1[0] = vextq_s16(table_prefix, tblvec[1], 7);
+        invec[0] = vmulq_s16(invec[0], mult);
+        tblvec1[1] = vextq_s16(table_prefix, tblvec[1], 6);
+        invec[1] = vmulq_s16(invec[1], mult);
+        tblvec1[2] = vextq_s16(table_prefix, tblvec[1], 5);
+        tblvec1[3] = vextq_s16(table_prefix, tblvec[1], 4);
+        // Sign extend each nibble from the top bits of its lane, then scale it without saturating, which drops
+        // the same high bits as vadpcm_residuals()
+        invec[0] = vshlq_s16(vshrq_n_s16(invec[0], 12), shiftcount);
+        tblvec1[4] = vextq_s16(table_prefix, tblvec[1], 3);
+        invec[1] = vshlq_s16(vshrq_n_s16(invec[1], 12), shiftcount);
+        tblvec1[5] = vextq_s16(table_prefix, tblvec[1], 2);
+        tblvec1[6] = vextq_s16(table_prefix, tblvec[1], 1);
+        tblvec1[7] = table_prefix;
+        for (i = 0; i < 2; i++) {
+            int32x4_t acc0;
+            int32x4_t acc1;
+
+            acc1 = vmull_lane_s16(vget_high_s16(tblvec[0]), vget_high_s16(result), 2);
+            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec[1]), vget_high_s16(result), 3);
+            acc0 = vmull_lane_s16(vget_low_s16(tblvec[0]), vget_high_s16(result), 2);
+            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec[1]), vget_high_s16(result), 3);
+
+            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[0]), vget_low_s16(invec[i]), 0);
+            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[1]), vget_low_s16(invec[i]), 1);
+            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[2]), vget_low_s16(invec[i]), 2);
+            acc0 = vmlal_lane_s16(acc0, vget_low_s16(tblvec1[3]), vget_low_s16(invec[i]), 3);
+
+            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[0]), vget_low_s16(invec[i]), 0);
+            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[1]), vget_low_s16(invec[i]), 1);
+            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[2]), vget_low_s16(invec[i]), 2);
+            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[3]), vget_low_s16(invec[i]), 3);
+            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[4]), vget_high_s16(invec[i]), 0);
+            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[5]), vget_high_s16(invec[i]), 1);
+            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[6]), vget_high_s16(invec[i]), 2);
+            acc1 = vmlal_lane_s16(acc1, vget_high_s16(tblvec1[7]), vget_high_s16(invec[i]), 3);
+
+            result = vcombine_s16(vqshrn_n_s32(acc0, 11), vqshrn_n_s32(acc1, 11));
+            vst1q_s16(out, result);
+            out += 8;
+        }
+    }
+}
+#endif
+
+void vadpcm_decode(const struct VadpcmDecoder *dec, const uint8_t *frames, uint32_t numFrames, int16_t *out) {
+#if defined(USE_SSE2) || defined(USE_NEON)
+    int16_t x[VADPCM_MAX_COLUMNS + 1];
+    uint32_t n;
+    int half, c;
+
+#if defined(USE_SSE41) || defined(USE_NEON)
+    if (dec->order == 2) {
+        vadpcm_decode_order2(dec, frames, numFrames, out);
+        return;
+    }
+#endif
+    for (n = 0; n < numFrames; n++, frames += VADPCM_FRAME_SIZE, out += VADPCM_FRAME_SAMPLES) {
+        const int16_t *cols = dec->cols[vadpcm_predictor(dec, frames)];
+
+        for (half = 0; half < 2; half++) {
+            // The last 'order' outputs, the 8 residuals and a zero to fill the last pair
+            for (c = 0; c < dec->order; c++) {
+                x[c] = out[half * 8 - dec->order + c];
+            }
+            vadpcm_residuals(frames, half, x + dec->order);
+            x[dec->order + 8] = 0;
+#if defined(USE_SSE2)
+            {
+                __m128i acc0 = _mm_setzero_si128();
+                __m128i acc1 = _mm_setzero_si128();
+                for (c = 0; c < dec->ncols; c += 2) {
+                    __m128i xs = _mm_set1_epi32((uint16_t) x[c] | ((uint32_t) (uint16_t) x[c + 1] << 16));
+                    acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (cols + c * 8)), xs));
+                    acc1 = _mm_add_epi32(acc1,
+                                         _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (cols + c * 8 + 8)), xs));
+                }
+                _mm_storeu_si128((__m128i *) (out + half * 8),
+                                 _mm_packs_epi32(_mm_srai_epi32(acc0, 11), _mm_srai_epi32(acc1, 11)));
+            }
+#else
+            {
+                int32x4_t acc0 = vdupq_n_s32(0);
+                int32x4_t acc1 = vdupq_n_s32(0);
+                for (c = 0; c < dec->ncols; c += 2) {
+                    int16x8x2_t pair = vld2q_s16(cols + c * 8);
+                    acc0 = vmlal_n_s16(acc0, vget_low_s16(pair.val[0]), x[c]);
+                    acc1 = vmlal_n_s16(acc1, vget_high_s16(pair.val[0]), x[c]);
+                    acc0 = vmlal_n_s16(acc0, vget_low_s16(pair.val[1]), x[c + 1]);
+                    acc1 = vmlal_n_s16(acc1, vget_high_s16(pair.val[1]), x[c + 1]);
+                }
+                vst1q_s16(out + half * 8, vcombine_s16(vqshrn_n_s32(acc0, 11), vqshrn_n_s32(acc1, 11)));
+            }
+#endif
+        }
+    }
+#else
+    vadpcm_decode_scalar(dec, frames, numFrames, out);
+#endif
+}
+
+// Inlined with a constant order for the common order 2, so that the compiler can unroll it.
+static inline void vadpcm_decode_rows(const struct VadpcmDecoder *dec, const uint8_t *frames, uint32_t numFrames,
+                                      int16_t *out, int order) {
+    int16_t prev[VADPCM_MAX_ORDER];
+    int16_t ins[8];
+    uint32_t n;
+    int half, i, k;
+
+    for (n = 0; n < numFrames; n++, frames += VADPCM_FRAME_SIZE, out += VADPCM_FRAME_SAMPLES) {
+        const int16_t (*book)[8] = dec->book[vadpcm_predictor(dec, frames)];
+
+        for (half = 0; half < 2; half++) {
+            // Copied, as the compiler can't tell that the stores to 'out' leave them alone
+            for (k = 0; k < order; k++) {
+                prev[k] = out[half * 8 - order + k];
+            }
+            vadpcm_residuals(frames, half, ins);
+            for (i = 0; i < 8; i++) {
+                // Wraps like the 32-bit vector lanes do.
+                uint32_t acc = (uint32_t) (ins[i] * (1 << 11));
+                for (k = 0; k < order; k++) {
+                    acc += (uint32_t) (book[k][i] * prev[k]);
+                }
+                for (k = 0; k < i; k++) {
+                    acc += (uint32_t) (book[order - 1][i - k - 1] * ins[k]);
+                }
+                out[half * 8 + i] = clamp16((int32_t) acc >> 11);
+            }
+        }
+    }
+}
+
+void vadpcm_decode_scalar(const struct VadpcmDecoder *dec, const uint8_t *frames, uint32_t numFrames,
+                          int16_t *out) {
+    if (dec->order == 2) {
+        vadpcm_decode_rows(dec, frames, numFrames, out, 2);
+    } else {
+        vadpcm_decode_rows(dec, frames, numFrames, out, dec->order);
+    }
+}
+
+void vadpcm_decode_frame_s32(const struct VadpcmDecoder *dec, const uint8_t *frame, int32_t *state) {
+    const int16_t (*book)[8] = dec->book[vadpcm_predictor(dec, frame)];
+    int32_t prev[VADPCM_MAX_ORDER];
+    int32_t ins[8];
+    int half, i, k;
+
+    for (half = 0; half < 2; half++) {
+        // The first half continues from the end of the previous frame, the second from the first half
+        for (k = 0; k < dec->order; k++) {
+            prev[k] = state[(half == 0 ? VADPCM_FRAME_SAMPLES : 8) - dec->order + k];
+        }
+        vadpcm_residuals_s32(frame, half, ins);
+        for (i = 0; i < 8; i++) {
+            // Wraps at 32 bits like the SDK's inner_product(), without its signed overflow
+            uint32_t acc = (uint32_t) ins[i] * (1 << 11);
+            for (k = 0; k < dec->order; k++) {
+                acc += (uint32_t) book[k][i] * (uint32_t) prev[k];
+            }
+            for (k = 0; k < i; k++) {
+                acc += (uint32_t) book[dec->order - 1][i - k - 1] * (uint32_t) ins[k];
+            }
+            state[half * 8 + i] = (int32_t) acc >> 11;
+        }
+    }
+}
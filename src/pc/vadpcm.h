@@ -0,0 +1,51 @@
+#ifndef PC_VADPCM_H
+#define PC_VADPCM_H
+
+#include <stdint.h>
+
+// VADPCM frame decoder shared by the mixer (src/pc/mixer.c) and the offline tools (tools/extract_bank_samples.c,
+// tools/aifc_decode.c and the SDK's tools/sdk-tools/adpcm/vdecode.c). It only needs the C library, so the tools can
+// build it outside the game. The guard isn't VADPCM_H, which the SDK tools' own header uses.
+//
+// vadpcm_decode() follows the RSP microcode: the history of each half frame is the saturated 16-bit output, so the
+// result is exactly what the game plays, and residuals scaled past 16 bits (shifts above 12) wrap. All of its
+// kernels agree bit for bit. vadpcm_decode_frame_s32() keeps 32-bit history and residuals instead, as the SDK
+// decoder and aifc_decode do; the two only differ on clipping samples and on those shifts.
+
+#define VADPCM_MAX_ORDER 8
+#define VADPCM_MAX_PREDICTORS 16
+#define VADPCM_MAX_COLUMNS (VADPCM_MAX_ORDER + 8)
+#define VADPCM_FRAME_SIZE 9
+#define VADPCM_FRAME_SAMPLES 16
+
+struct VadpcmDecoder {
+    int order;
+    int npredictors;
+    int ncols; // order + 8 inputs, rounded up to a pair
+    // Per predictor, ncols columns of 8 coefficients: how much each input (the last 'order' outputs, then the 8
+    // new residuals) adds to each of the 8 outputs, in units of 1/2048. Adjacent columns are stored interleaved
+    // in groups of four outputs, so that one 16-bit multiply-add covers two of them.
+    int16_t cols[VADPCM_MAX_PREDICTORS][VADPCM_MAX_COLUMNS * 8];
+    // The codebook as given, for the scalar path
+    int16_t book[VADPCM_MAX_PREDICTORS][VADPCM_MAX_ORDER][8];
+};
+
+// Expands a codebook of npredictors * order rows of 8 coefficients in host byte order.
+// Returns 0, or -1 if order or npredictors is out of range.
+int vadpcm_decoder_init(struct VadpcmDecoder *dec, const int16_t *book, int order, int npredictors);
+
+// Decodes numFrames consecutive 9-byte frames into numFrames * 16 samples. out[-order..-1] must hold the
+// history for the first frame; each later frame uses the output of the one before. Frames naming a predictor
+// past the codebook use predictor 0.
+void vadpcm_decode(const struct VadpcmDecoder *dec, const uint8_t *frames, uint32_t numFrames, int16_t *out);
+
+// Same without vector instructions. It works from the codebook rows rather than the expanded columns, so it also
+// checks the vector path.
+void vadpcm_decode_scalar(const struct VadpcmDecoder *dec, const uint8_t *frames, uint32_t numFrames,
+                          int16_t *out);
+
+// Decodes one frame with 32-bit history that is never saturated, nor are the scaled residuals. state[0..15]
+// holds the previous frame's output, of which the last 'order' samples are used, and gets this frame's.
+void vadpcm_decode_frame_s32(const struct VadpcmDecoder *dec, const uint8_t *frame, int32_t *state);
+
+#endif // PC_VADPCM_H
@@ -10,6 +10,8 @@
 #include <stdlib.h>
 #include <stdarg.h>
 
+#include "vadpcm.h"
+
 typedef signed char s8;
 typedef short s16;
 typedef int s32;
@@ -228,45 +230,6 @@ s32 inner_product(s32 length, s32 *v1, s32 *v2)
     return dout - (out - fiout < 0);
 }
 
-void my_decodeframe(u8 *frame, s32 *state, s32 order, s32 ***coefTable)
-{
-    s32 ix[16];
-
-    u8 header = frame[0];
-    s32 scale = 1 << (header >> 4);
-    s32 optimalp = header & 0xf;
-
-    for (s32 i = 0; i < 16; i += 2) {
-        u8 c = frame[1 + i/2];
-        ix[i] = c >> 4;
-        ix[i + 1] = c & 0xf;
-    }
-
-    for (s32 i = 0; i < 16; i++) {
-        if (ix[i] >= 8) ix[i] -= 16;
-        ix[i] *= scale;
-    }
-
-    for (s32 j = 0; j < 2; j++) {
-        s32 in_vec[16];
-        if (j == 0) {
-            for (s32 i = 0; i < order; i++) {
-                in_vec[i] = state[16 - order + i];
-            }
-        } else {
-            for (s32 i = 0; i < order; i++) {
-                in_vec[i] = state[8 - order + i];
-            }
-        }
-
-        for (s32 i = 0; i < 8; i++) {
-            s32 ind = j * 8 + i;
-            in_vec[order + i] = ix[ind];
-            state[ind] = inner_product(order + i, coefTable[optimalp][i], in_vec) + ix[ind];
-        }
-    }
-}
-
 void my_encodeframe(u8 *out, s16 *inBuffer, s32 *state, s32 ***coefTable, s32 order, s32 npredictors)
 {
     s16 ix[16];
@@ -389,6 +352,8 @@ int main(int argc, char **argv)
     ALADPCMloop *aloops = NULL;
     s16 npredictors = -1;
     s32 ***coefTable = NULL;
+    struct VadpcmDecoder decoder;
+    s16 *book;
     s32 state[16];
     s32 soundPointer = -1;
     s32 currPos = 0;
@@ -522,6 +487,22 @@ int main(int argc, char **argv)
         fail_parse("Codebook missing from bitstream");
     }
 
+    // Frames are decoded by the game's src/pc/vadpcm.c in its 32-bit mode, which is the arithmetic the encoder
+    // search below inverts. Frames can only name the first 16 predictors.
+    book = malloc(npredictors * order * 8 * sizeof(s16));
+    for (s32 i = 0; i < npredictors; i++) {
+        for (s32 j = 0; j < order; j++) {
+            for (s32 k = 0; k < 8; k++) {
+                book[(i * order + j) * 8 + k] = coefTable[i][k][j];
+            }
+        }
+    }
+    if (vadpcm_decoder_init(&decoder, book, order,
+                            npredictors < VADPCM_MAX_PREDICTORS ? npredictors : VADPCM_MAX_PREDICTORS) != 0) {
+        fail_parse("codebook of order %d with %d predictors is not supported", order, npredictors);
+    }
+    free(book);
+
     for (s32 i = 0; i < order; i++) {
         state[15 - i] = 0;
     }
@@ -542,7 +523,7 @@ int main(int argc, char **argv)
         checked_fread(input, 9, 1, ifile);
 
         // Decode for real
-        my_decodeframe(input, state, order, coefTable);
+        vadpcm_decode_frame_s32(&decoder, input, state);
         memcpy(decoded, state, sizeof(lastState));
 
         // Create a guess from that, by clamping to 16 bits
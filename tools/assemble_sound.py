@@ -16,6 +16,8 @@ DUMP_INDIVIDUAL_BINS = False
 ENDIAN_MARKER = ">"
 WORD_BYTES = 4
 
+# Output rate the instrument tunings are baked for; the build passes FINAL_SAMPLE_RATE from
+# include/config/config_audio.h with --sample-rate
 FINAL_SAMPLE_RATE = 48000
 
 orderedJsonDecoder = JSONDecoder(object_pairs_hook=OrderedDict)
@@ -898,6 +900,7 @@ def main():
     global DUMP_INDIVIDUAL_BINS
     global ENDIAN_MARKER
     global WORD_BYTES
+    global FINAL_SAMPLE_RATE
     need_help = False
     skip_next = 0
     cpp_command = None
@@ -938,6 +941,14 @@ def main():
                     fail("--bitwidth takes argument 32, 64 or native")
                 WORD_BYTES = int(bitwidth) // 8
             skip_next = 1
+        elif a == "--sample-rate":
+            try:
+                FINAL_SAMPLE_RATE = int(sys.argv[i + 1])
+            except ValueError:
+                fail("--sample-rate takes a rate in Hz")
+            if FINAL_SAMPLE_RATE <= 0:
+                fail("--sample-rate takes a rate in Hz")
+            skip_next = 1
         elif a.startswith("-D"):
             defines.append(a[2:])
         elif a == "--stack-trace":
@@ -982,6 +993,7 @@ def main():
             " <out .tbl file> <out .tbl Shindou header file>"
             " [--cpp <preprocessor>]"
             " [-D <symbol>]"
+            " [--sample-rate <Hz>]"
             " [--stack-trace]"
             " | --sequences <out sequence .bin> <out Shindou sequence header .bin> "
             "<out bank sets .bin> <sound bank dir> <sequences.json> <inputs...>".format(
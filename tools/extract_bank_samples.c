@@ -0,0 +1,507 @@
+/**
+ * Batch sample extractor: walks every instrument and drum of the built
+ * sound_data.ctl, decodes the VADPCM samples they reference from
+ * sound_data.tbl and writes them out as WAV files with loop points.
+ *
+ * Both files are read once into memory and samples are decoded in parallel
+ * on the thread pool shared by the tools (tools/parallel.c), one sample per
+ * job. Decoding uses the mixer's own decoder (src/pc/vadpcm.c),
+ * so the WAVs contain exactly what the game plays. -c also decodes every
+ * sample with its scalar path and fails if the two disagree.
+ *
+ * Only the US/JP/EU layout is supported; Shindou keeps its headers in
+ * separate files.
+ */
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parallel.h"
+#include "vadpcm.h"
+
+typedef signed char s8;
+typedef short s16;
+typedef int s32;
+typedef unsigned char u8;
+typedef unsigned short u16;
+typedef unsigned int u32;
+typedef float f32;
+
+#define NORETURN __attribute__((noreturn))
+
+#define TYPE_CTL 1
+#define TYPE_TBL 2
+
+// Must match FINAL_SAMPLE_RATE in assemble_sound.py, which divides the AIFC
+// sample rate by it to get the tuning stored in the bank.
+#define FINAL_SAMPLE_RATE 48000
+
+typedef struct {
+    u8 *data;
+    size_t size;
+    s32 bigEndian;
+    s32 wordSize;
+    s32 numEntries;
+    u32 dataStart;
+} SeqFile;
+
+typedef struct {
+    const u8 *frames;
+    u32 numFrames;
+    u32 numSamples;
+    s32 order;
+    s32 npredictors;
+    const u8 *book;
+    u32 loopStart;
+    u32 loopEnd;
+    u32 loopCount;
+    u32 sampleRate;
+    char path[1024];
+} SampleJob;
+
+static char usage[] = "[-j threads] [-c] [-v] sound_data.ctl sound_data.tbl outdir";
+static const char *progname;
+static s32 sBigEndian;
+static s32 sWordSize;
+
+static SampleJob *sJobs;
+static s32 sNumJobs;
+static s32 sCheck;
+
+NORETURN
+static void fail(const char *fmt, ...)
+{
+    va_list ap;
+    fprintf(stderr, "%s: ", progname);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static u32 read_u16(const u8 *p)
+{
+    return sBigEndian ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+}
+
+static u32 read_u32(const u8 *p)
+{
+    if (sBigEndian) {
+        return ((u32) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    return ((u32) p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+// Pointers are offsets, so the upper half of a 64-bit word is always zero.
+static u32 read_word(const u8 *p)
+{
+    if (sWordSize == 8 && sBigEndian) {
+        return read_u32(p + 4);
+    }
+    return read_u32(p);
+}
+
+static f32 read_f32(const u8 *p)
+{
+    u32 bits = read_u32(p);
+    f32 f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static u8 *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    u8 *buf;
+    long len;
+
+    if (f == NULL) {
+        fail("could not open %s: %s", path, strerror(errno));
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(len > 0 ? len : 1);
+    if (len < 0 || fread(buf, 1, len, f) != (size_t) len) {
+        fail("could not read %s", path);
+    }
+    fclose(f);
+    *size = len;
+    return buf;
+}
+
+/**
+ * Parse the table at the start of a .ctl/.tbl file. Endianness comes from
+ * the magic number and the word size from where the first entry points,
+ * since assemble_sound.py writes whatever the target platform uses.
+ */
+static void open_seq_file(SeqFile *file, const char *path, u32 magic)
+{
+    s32 wordSize;
+
+    file->data = read_file(path, &file->size);
+    if (file->size < 16) {
+        fail("%s is too small", path);
+    }
+    if (file->data[0] == 0 && file->data[1] == magic) {
+        file->bigEndian = 1;
+    } else if (file->data[0] == magic && file->data[1] == 0) {
+        file->bigEndian = 0;
+    } else {
+        fail("%s is not a %s file (or is a Shindou one)", path, magic == TYPE_CTL ? ".ctl" : ".tbl");
+    }
+    sBigEndian = file->bigEndian;
+    file->numEntries = read_u16(file->data + 2);
+
+    file->wordSize = 0;
+    for (wordSize = 4; wordSize <= 8; wordSize += 4) {
+        u32 headerSize = (wordSize + file->numEntries * 2 * wordSize + 15) & ~15;
+        sWordSize = wordSize;
+        if (file->numEntries > 0 && headerSize <= file->size
+            && read_word(file->data + wordSize) == headerSize) {
+            file->wordSize = wordSize;
+            file->dataStart = headerSize;
+            break;
+        }
+    }
+    if (file->wordSize == 0) {
+        fail("could not make sense of the header of %s", path);
+    }
+}
+
+static void seq_file_entry(const SeqFile *file, s32 index, u32 *offset, u32 *length)
+{
+    const u8 *entry = file->data + file->wordSize + index * 2 * file->wordSize;
+    *offset = read_word(entry);
+    *length = read_u32(entry + file->wordSize);
+    if (*offset > file->size || *length > file->size - *offset) {
+        fail("entry %d lies outside the file", index);
+    }
+}
+
+static void put_u16le(u8 *p, u32 v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+static void put_u32le(u8 *p, u32 v)
+{
+    put_u16le(p, v & 0xffff);
+    put_u16le(p + 2, v >> 16);
+}
+
+/**
+ * Write 16-bit mono PCM as a WAV file, with an 'smpl' chunk describing the
+ * loop if there is one.
+ */
+static s32 write_wav(const char *path, const s16 *samples, u32 numSamples, u32 sampleRate,
+                     s32 hasLoop, u32 loopStart, u32 loopEnd, u32 loopCount)
+{
+    u8 header[44 + 8 + 36 + 24];
+    u8 *p = header;
+    u32 dataSize = numSamples * 2;
+    u32 smplSize = hasLoop ? 8 + 36 + 24 : 0;
+    u8 *pcm;
+    FILE *f;
+    u32 i;
+    s32 ok;
+
+    memcpy(p, "RIFF", 4);
+    put_u32le(p + 4, 4 + 24 + smplSize + 8 + dataSize);
+    memcpy(p + 8, "WAVE", 4);
+    memcpy(p + 12, "fmt ", 4);
+    put_u32le(p + 16, 16);
+    put_u16le(p + 20, 1); // PCM
+    put_u16le(p + 22, 1); // mono
+    put_u32le(p + 24, sampleRate);
+    put_u32le(p + 28, sampleRate * 2);
+    put_u16le(p + 32, 2);
+    put_u16le(p + 34, 16);
+    p += 36;
+
+    if (hasLoop) {
+        memset(p, 0, 8 + 36 + 24);
+        memcpy(p, "smpl", 4);
+        put_u32le(p + 4, 36 + 24);
+        put_u32le(p + 16, (u32) (1000000000.0 / sampleRate));
+        put_u32le(p + 20, 60); // MIDI unity note
+        put_u32le(p + 36, 1);  // number of loops
+        put_u32le(p + 52, loopStart);
+        put_u32le(p + 56, loopEnd - 1);
+        // The N64 uses -1 for an endless loop, WAV uses 0
+        put_u32le(p + 64, loopCount == 0xffffffff ? 0 : loopCount);
+        p += 8 + 36 + 24;
+    }
+
+    memcpy(p, "data", 4);
+    put_u32le(p + 4, dataSize);
+    p += 8;
+
+    pcm = malloc(dataSize > 0 ? dataSize : 1);
+    for (i = 0; i < numSamples; i++) {
+        put_u16le(pcm + i * 2, (u16) samples[i]);
+    }
+
+    if ((f = fopen(path, "wb")) == NULL) {
+        fprintf(stderr, "%s: could not open %s: %s\n", progname, path, strerror(errno));
+        free(pcm);
+        return 0;
+    }
+    ok = fwrite(header, p - header, 1, f) == 1 && (dataSize == 0 || fwrite(pcm, dataSize, 1, f) == 1);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        fprintf(stderr, "%s: could not write %s\n", progname, path);
+        remove(path);
+    }
+    free(pcm);
+    return ok;
+}
+
+static s32 decode_sample(const SampleJob *job)
+{
+    struct VadpcmDecoder dec;
+    s16 book[VADPCM_MAX_PREDICTORS * VADPCM_MAX_ORDER * 8];
+    u32 count = VADPCM_MAX_ORDER + job->numFrames * VADPCM_FRAME_SAMPLES;
+    s16 *samples;
+    s32 i, ok;
+
+    for (i = 0; i < job->npredictors * job->order * 8; i++) {
+        book[i] = (s16) read_u16(job->book + i * 2);
+    }
+    vadpcm_decoder_init(&dec, book, job->order, job->npredictors);
+
+    // Leading VADPCM_MAX_ORDER zeroes are the history for the first frame.
+    samples = calloc(count, sizeof(s16));
+    vadpcm_decode(&dec, job->frames, job->numFrames, samples + VADPCM_MAX_ORDER);
+
+    if (sCheck) {
+        s16 *check = calloc(count, sizeof(s16));
+        vadpcm_decode_scalar(&dec, job->frames, job->numFrames, check + VADPCM_MAX_ORDER);
+        ok = memcmp(samples, check, count * sizeof(s16)) == 0;
+        free(check);
+        if (!ok) {
+            fprintf(stderr, "%s: vector and scalar decoding of %s differ\n", progname, job->path);
+            free(samples);
+            return 0;
+        }
+    }
+
+    ok = write_wav(job->path, samples + VADPCM_MAX_ORDER, job->numSamples, job->sampleRate,
+                   job->loopCount != 0, job->loopStart, job->loopEnd, job->loopCount);
+    free(samples);
+    return ok;
+}
+
+static int decode_job(void *arg, int index)
+{
+    return !decode_sample(&sJobs[index]);
+}
+
+/**
+ * Queue the sample a sound points at, unless an earlier instrument or drum
+ * (in this bank or another one sharing its sample bank) already did.
+ */
+static void add_sound(const SeqFile *tbl, const u8 *bank, u32 bankLen,
+                      u32 tblOffset, u32 tblLen, const u8 *sound, const char *path, s32 verbose)
+{
+    u32 sampleAddr = read_word(sound);
+    f32 tuning = read_f32(sound + sWordSize);
+    const u8 *sample, *book, *loop;
+    u32 addr, len, loopAddr, bookAddr;
+    SampleJob *job;
+    s32 i;
+
+    if (sampleAddr == 0) {
+        return;
+    }
+    if (sampleAddr + 4 * sWordSize + 4 > bankLen) {
+        fail("sample at 0x%x lies outside its bank", sampleAddr);
+    }
+    sample = bank + sampleAddr;
+    addr = read_word(sample + sWordSize);
+    loopAddr = read_word(sample + 2 * sWordSize);
+    bookAddr = read_word(sample + 3 * sWordSize);
+    len = read_u32(sample + 4 * sWordSize);
+    if (addr > tblLen || len > tblLen - addr || loopAddr + 16 > bankLen || bookAddr + 8 > bankLen) {
+        fail("sample at 0x%x has bad offsets", sampleAddr);
+    }
+
+    for (i = 0; i < sNumJobs; i++) {
+        if (sJobs[i].frames == tbl->data + tblOffset + addr) {
+            if (verbose) {
+                printf("%s -> %s\n", path, sJobs[i].path);
+            }
+            return;
+        }
+    }
+
+    job = &sJobs[sNumJobs++];
+    memset(job, 0, sizeof(*job));
+    job->frames = tbl->data + tblOffset + addr;
+    job->numFrames = len / VADPCM_FRAME_SIZE;
+    job->numSamples = job->numFrames * VADPCM_FRAME_SAMPLES;
+
+    book = bank + bookAddr;
+    job->order = (s32) read_u32(book);
+    job->npredictors = (s32) read_u32(book + 4);
+    job->book = book + 8;
+    if (job->order < 1 || job->order > VADPCM_MAX_ORDER
+        || job->npredictors < 1 || job->npredictors > VADPCM_MAX_PREDICTORS
+        || bookAddr + 8 + job->order * job->npredictors * 16 > bankLen) {
+        fail("sample at 0x%x has a bad codebook", sampleAddr);
+    }
+
+    loop = bank + loopAddr;
+    job->loopStart = read_u32(loop);
+    job->loopEnd = read_u32(loop + 4);
+    job->loopCount = read_u32(loop + 8);
+    if (job->loopCount == 0) {
+        // Without a loop, 'end' is the sample length.
+        if (job->loopEnd < job->numSamples) {
+            job->numSamples = job->loopEnd;
+        }
+    } else if (job->loopStart >= job->loopEnd || job->loopEnd > job->numSamples) {
+        fprintf(stderr, "%s: ignoring bad loop of sample at 0x%x\n", progname, sampleAddr);
+        job->loopCount = 0;
+    }
+
+    job->sampleRate = (u32) lroundf(tuning * FINAL_SAMPLE_RATE);
+    if (job->sampleRate == 0) {
+        job->sampleRate = 32000;
+    }
+    snprintf(job->path, sizeof(job->path), "%s", path);
+    if (verbose) {
+        printf("%s\n", path);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    SeqFile ctl, tbl;
+    const char *outdir;
+    s32 threads = 0;
+    s32 verbose = 0;
+    s32 maxJobs = 0;
+    s32 failed;
+    s32 opt, b, i;
+
+    progname = argv[0];
+    while ((opt = getopt(argc, argv, "cj:v")) != -1) {
+        switch (opt) {
+        case 'c':
+            sCheck = 1;
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "%s %s\n", progname, usage);
+            exit(1);
+        }
+    }
+    if (argc - optind != 3) {
+        fprintf(stderr, "%s %s\n", progname, usage);
+        exit(1);
+    }
+    outdir = argv[optind + 2];
+    if (mkdir(outdir, 0755) != 0 && errno != EEXIST) {
+        fail("could not create %s: %s", outdir, strerror(errno));
+    }
+
+    open_seq_file(&tbl, argv[optind + 1], TYPE_TBL);
+    open_seq_file(&ctl, argv[optind], TYPE_CTL);
+    if (tbl.bigEndian != ctl.bigEndian || tbl.wordSize != ctl.wordSize || tbl.numEntries != ctl.numEntries) {
+        fail("%s and %s do not belong together", argv[optind], argv[optind + 1]);
+    }
+
+    // Every sound of every bank is at most one job.
+    for (b = 0; b < ctl.numEntries; b++) {
+        u32 offset, len;
+        seq_file_entry(&ctl, b, &offset, &len);
+        if (len >= 16) {
+            maxJobs += 3 * read_u32(ctl.data + offset) + read_u32(ctl.data + offset + 4);
+        }
+    }
+    sJobs = calloc(maxJobs > 0 ? maxJobs : 1, sizeof(SampleJob));
+
+    for (b = 0; b < ctl.numEntries; b++) {
+        static const char *soundNames[3] = { "_lo", "", "_hi" };
+        u32 ctlOffset, ctlLen, tblOffset, tblLen;
+        u32 numInstruments, numDrums;
+        const u8 *bank;
+        u32 bankLen;
+        char path[1024];
+
+        seq_file_entry(&ctl, b, &ctlOffset, &ctlLen);
+        seq_file_entry(&tbl, b, &tblOffset, &tblLen);
+        if (ctlLen < 16) {
+            continue;
+        }
+        numInstruments = read_u32(ctl.data + ctlOffset);
+        numDrums = read_u32(ctl.data + ctlOffset + 4);
+        // Offsets inside a bank are relative to the end of its 16-byte header.
+        bank = ctl.data + ctlOffset + 16;
+        bankLen = ctlLen - 16;
+        if ((numInstruments + 1) * sWordSize > bankLen) {
+            fail("bank %02X is truncated", b);
+        }
+
+        for (i = 0; i < (s32) numInstruments; i++) {
+            u32 inst = read_word(bank + sWordSize * (i + 1));
+            s32 s;
+
+            if (inst == 0) {
+                continue;
+            }
+            if (inst + 2 * sWordSize + 3 * 2 * sWordSize > bankLen) {
+                fail("instrument %d of bank %02X lies outside the bank", i, b);
+            }
+            for (s = 0; s < 3; s++) {
+                snprintf(path, sizeof(path), "%s/%02X_inst%03d%s.wav", outdir, b, i, soundNames[s]);
+                add_sound(&tbl, bank, bankLen, tblOffset, tblLen,
+                          bank + inst + 2 * sWordSize + s * 2 * sWordSize, path, verbose);
+            }
+        }
+
+        if (numDrums > 0) {
+            u32 drums = read_word(bank);
+            if (drums + numDrums * sWordSize > bankLen) {
+                fail("drums of bank %02X lie outside the bank", b);
+            }
+            for (i = 0; i < (s32) numDrums; i++) {
+                u32 drum = read_word(bank + drums + i * sWordSize);
+                if (drum == 0) {
+                    continue;
+                }
+                if (drum + 3 * sWordSize > bankLen) {
+                    fail("drum %d of bank %02X lies outside the bank", i, b);
+                }
+                snprintf(path, sizeof(path), "%s/%02X_drum%03d.wav", outdir, b, i);
+                add_sound(&tbl, bank, bankLen, tblOffset, tblLen, bank + drum + sWordSize, path, verbose);
+            }
+        }
+    }
+
+    if (threads <= 0) {
+        threads = parallel_thread_count();
+    }
+    failed = parallel_jobs(sNumJobs, threads, decode_job, NULL);
+
+    if (verbose) {
+        printf("%d samples, %d failed\n", sNumJobs, failed);
+    }
+    free(sJobs);
+    free(ctl.data);
+    free(tbl.data);
+    return failed != 0;
+}
@@ -18,43 +18,55 @@
 // types
 typedef struct
 {
-   int *indexes;
-   int allocated;
-   int count;
-   int start;
-} lookback;
+   const unsigned char *buf;
+   int length;
+   int *head;     // latest position for each hash of three bytes, -1 if none
+   int *prev;     // previous position with the same hash, for every position
+   int max_chain; // positions to compare per search, 0 to compare all of them
+} match_finder;
 
 // functions
-#define LOOKBACK_COUNT 256
-#define LOOKBACK_INIT_SIZE 128
-static lookback *lookback_init(void)
+#define MATCH_HASH_BITS 15
+#define MATCH_HASH_SIZE (1 << MATCH_HASH_BITS)
+#define MATCH_WINDOW 4096
+// chain depth for MIO0_FAST
+#define MATCH_FAST_CHAIN 32
+
+static inline unsigned int match_hash(const unsigned char *p)
 {
-   lookback *lb = malloc(LOOKBACK_COUNT * sizeof(*lb));
-   for (int i = 0; i < LOOKBACK_COUNT; i++) {
-      lb[i].allocated = LOOKBACK_INIT_SIZE;
-      lb[i].indexes = malloc(lb[i].allocated * sizeof(*lb[i].indexes));
-      lb[i].count = 0;
-      lb[i].start = 0;
-   }
-   return lb;
+   unsigned int key = (p[0] << 16) | (p[1] << 8) | p[2];
+   return (key * 2654435761u) >> (32 - MATCH_HASH_BITS);
 }
 
-static void lookback_free(lookback *lb)
+static void match_finder_init(match_finder *mf, const unsigned char *buf, int length, int max_chain)
 {
-   for (int i = 0; i < LOOKBACK_COUNT; i++) {
-      free(lb[i].indexes);
+   mf->buf = buf;
+   mf->length = length;
+   mf->head = malloc(MATCH_HASH_SIZE * sizeof(*mf->head));
+   mf->prev = malloc(MAX(length, 1) * sizeof(*mf->prev));
+   mf->max_chain = max_chain;
+   for (int i = 0; i < MATCH_HASH_SIZE; i++) {
+      mf->head[i] = -1;
    }
-   free(lb);
 }
 
-static inline void lookback_push(lookback *lkbk, unsigned char val, int index)
+static void match_finder_free(match_finder *mf)
 {
-   lookback *lb = &lkbk[val];
-   if (lb->count == lb->allocated) {
-      lb->allocated *= 4;
-      lb->indexes = realloc(lb->indexes, lb->allocated * sizeof(*lb->indexes));
-   }
-   lb->indexes[lb->count++] = index;
+   free(mf->head);
+   free(mf->prev);
+}
+
+// make 'index' available to later searches; positions must be added in order
+static inline void match_finder_push(match_finder *mf, int index)
+{
+   unsigned int hash;
+   // a match needs three bytes, so the last two positions can never start one
+   if (index + 2 >= mf->length) {
+      return;
+   }
+   hash = match_hash(&mf->buf[index]);
+   mf->prev[index] = mf->head[hash];
+   mf->head[hash] = index;
 }
 
 static void PUT_BIT(unsigned char *buf, int bit, int val)
@@ -65,58 +77,55 @@ static void PUT_BIT(unsigned char *buf, int bit, int val)
 }
 
 // used to find longest matching stream in buffer
-// buf: buffer
+// mf: match finder holding every position before start_offset
 // start_offset: offset in buf to look back from
 // max_search: max number of bytes to find
 // found_offset: returned offset found (0 if none found)
-// returns max length of matching stream (0 if none found)
-static int find_longest(const unsigned char *buf, int start_offset, int max_search, int *found_offset, lookback *lkbk)
+// returns max length of matching stream, or 0 if it is shorter than 3 bytes,
+// which is too short to encode anyway
+//
+// With an unlimited chain this finds the same match as comparing every
+// earlier position in the window: the longest one, and of those the farthest
+// back. With a limited chain it takes the longest of the nearest few.
+static int find_longest(match_finder *mf, int start_offset, int max_search, int *found_offset)
 {
+   const unsigned char *buf = mf->buf;
+   const unsigned char *cur = &buf[start_offset];
    int best_length = 0;
    int best_offset = 0;
-   int cur_length;
-   int search_len;
-   int farthest, off, i;
-   int lb_idx;
-   const unsigned char first = buf[start_offset];
-   lookback *lb = &lkbk[first];
-
-   // buf
-   //  |    off        start                  max
-   //  V     |+i->       |+i->                 |
-   //  |--------------raw-data-----------------|
-   //        |+i->       |      |+i->
-   //                       +cur_length
+   int farthest;
+   int chain = mf->max_chain;
+   int off, i;
+
+   *found_offset = 0;
+   if (max_search < 3) {
+      return 0;
+   }
 
    // check at most the past 4096 values
-   farthest = MAX(start_offset - 4096, 0);
-   // find starting index
-   for (lb_idx = lb->start; lb_idx < lb->count && lb->indexes[lb_idx] < farthest; lb_idx++) {}
-   lb->start = lb_idx;
-   for ( ; lb_idx < lb->count && lb->indexes[lb_idx] < start_offset; lb_idx++) {
-      off = lb->indexes[lb_idx];
-      // check at most requested max or up until start
-      search_len = MIN(max_search, start_offset - off);
-      for (i = 0; i < search_len; i++) {
-         if (buf[start_offset + i] != buf[off + i]) {
-            break;
-         }
-      }
-      cur_length = i;
-      // if matched up until start, continue matching in already matched parts
-      if (cur_length == search_len) {
-         // check at most requested max less current length
-         search_len = max_search - cur_length;
-         for (i = 0; i < search_len; i++) {
-            if (buf[start_offset + cur_length + i] != buf[off + i]) {
+   farthest = MAX(start_offset - MATCH_WINDOW, 0);
+   for (off = mf->head[match_hash(cur)]; off >= farthest; off = mf->prev[off]) {
+      // the hash can collide; the first three bytes still have to match.
+      // Bytes past start_offset are the ones the match itself will produce,
+      // so comparing against buf directly handles overlapping matches.
+      if (buf[off] == cur[0] && buf[off + 1] == cur[1] && buf[off + 2] == cur[2]) {
+         for (i = 3; i < max_search && buf[off + i] == cur[i]; i++) {}
+         if (mf->max_chain == 0) {
+            // walking from nearest to farthest, so keep the last of equals
+            if (i >= best_length) {
+               best_offset = start_offset - off;
+               best_length = i;
+            }
+         } else if (i > best_length) {
+            best_offset = start_offset - off;
+            best_length = i;
+            if (best_length == max_search) {
                break;
             }
          }
-         cur_length += i;
       }
-      if (cur_length > best_length) {
-         best_offset = start_offset - off;
-         best_length = cur_length;
+      if (chain != 0 && --chain == 0) {
+         break;
       }
    }
 
@@ -193,7 +202,7 @@ int mio0_decode(const unsigned char *in, unsigned char *out, unsigned int *end)
    return bytes_written;
 }
 
-int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out)
+int mio0_encode_mode(const unsigned char *in, unsigned int length, unsigned char *out, mio0_mode_t mode)
 {
    unsigned char *bit_buf;
    unsigned char *comp_buf;
@@ -206,10 +215,10 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    int bit_idx = 0;
    int comp_idx = 0;
    int uncomp_idx = 0;
-   lookback *lookbacks;
+   match_finder mf;
 
-   // initialize lookback buffer
-   lookbacks = lookback_init();
+   // initialize match finder
+   match_finder_init(&mf, in, length, (mode == MIO0_FAST) ? MATCH_FAST_CHAIN : 0);
 
    // allocate some temporary buffers worst case size
    bit_buf = malloc((length + 7) / 8); // 1-bit/byte
@@ -219,7 +228,7 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
 
    // encode data
    // special case for first byte
-   lookback_push(lookbacks, in[0], 0);
+   match_finder_push(&mf, 0);
    uncomp_buf[uncomp_idx] = in[0];
    uncomp_idx += 1;
    bytes_proc += 1;
@@ -227,14 +236,14 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    while (bytes_proc < length) {
       int offset;
       int max_length = MIN(length - bytes_proc, 18);
-      int longest_match = find_longest(in, bytes_proc, max_length, &offset, lookbacks);
+      int longest_match = find_longest(&mf, bytes_proc, max_length, &offset);
       // push current byte before checking next longer match
-      lookback_push(lookbacks, in[bytes_proc], bytes_proc);
+      match_finder_push(&mf, bytes_proc);
       if (longest_match > 2) {
          int lookahead_offset;
          // lookahead to next byte to see if longer match
          int lookahead_length = MIN(length - bytes_proc - 1, 18);
-         int lookahead_match = find_longest(in, bytes_proc + 1, lookahead_length, &lookahead_offset, lookbacks);
+         int lookahead_match = find_longest(&mf, bytes_proc + 1, lookahead_length, &lookahead_offset);
          // better match found, use uncompressed + lookahead compressed
          if ((longest_match + 1) < lookahead_match) {
             // uncompressed byte
@@ -245,11 +254,11 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
             longest_match = lookahead_match;
             offset = lookahead_offset;
             bit_idx++;
-            lookback_push(lookbacks, in[bytes_proc], bytes_proc);
+            match_finder_push(&mf, bytes_proc);
          }
          // first byte already pushed above
          for (int i = 1; i < longest_match; i++) {
-            lookback_push(lookbacks, in[bytes_proc + i], bytes_proc + i);
+            match_finder_push(&mf, bytes_proc + i);
          }
          // compressed block
          comp_buf[comp_idx] = (((longest_match - 3) & 0x0F) << 4) |
@@ -283,6 +292,8 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    write_u32_be(&out[12], uncomp_offset);
    // output data
    memcpy(&out[MIO0_HEADER_LENGTH], bit_buf, bit_length);
+   // zero the alignment padding rather than leave whatever 'out' held
+   memset(&out[MIO0_HEADER_LENGTH + bit_length], 0, comp_offset - (MIO0_HEADER_LENGTH + bit_length));
    memcpy(&out[comp_offset], comp_buf, comp_idx);
    memcpy(&out[uncomp_offset], uncomp_buf, uncomp_idx);
 
@@ -290,11 +301,16 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    free(bit_buf);
    free(comp_buf);
    free(uncomp_buf);
-   lookback_free(lookbacks);
+   match_finder_free(&mf);
 
    return bytes_written;
 }
 
+int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out)
+{
+   return mio0_encode_mode(in, length, out, MIO0_COMPAT);
+}
+
 static FILE *mio0_open_out_file(const char *out_file) {
    if (strcmp(out_file, "-") == 0) {
 #if defined(_WIN32) || defined(_WIN64)
@@ -382,7 +398,7 @@ free_all:
    return ret_val;
 }
 
-int mio0_encode_file(const char *in_file, const char *out_file)
+int mio0_encode_file_mode(const char *in_file, const char *out_file, mio0_mode_t mode)
 {
    FILE *in;
    FILE *out;
@@ -416,7 +432,7 @@ int mio0_encode_file(const char *in_file, const char *out_file)
    out_buf = malloc(MIO0_HEADER_LENGTH + ((file_size+7)/8) + file_size);
 
    // compress data in MIO0 format
-   bytes_encoded = mio0_encode(in_buf, file_size, out_buf);
+   bytes_encoded = mio0_encode_mode(in_buf, file_size, out_buf, mode);
 
    // open output file
    out = mio0_open_out_file(out_file);
@@ -447,34 +463,65 @@ free_all:
    return ret_val;
 }
 
+int mio0_encode_file(const char *in_file, const char *out_file)
+{
+   return mio0_encode_file_mode(in_file, out_file, MIO0_COMPAT);
+}
+
 // mio0 standalone executable
 #ifdef MIO0_STANDALONE
+#include "parallel.h"
+
 typedef struct
 {
    char *in_filename;
    char *out_filename;
+   char *list_filename;
    unsigned int offset;
    int compress;
+   int threads;
+   mio0_mode_t mode;
 } arg_config;
 
+typedef struct
+{
+   char in_filename[1024];
+   char out_filename[1024];
+} batch_file;
+
+typedef struct
+{
+   const arg_config *config;
+   batch_file *files;
+   int count;
+} batch_queue;
+
 static arg_config default_config =
 {
    NULL,
    NULL,
+   NULL,
+   0,
+   1,
    0,
-   1
+   MIO0_COMPAT
 };
 
 static void print_usage(void)
 {
-   ERROR("Usage: mio0 [-c / -d] [-o OFFSET] FILE [OUTPUT]\n"
+   ERROR("Usage: mio0 [-c / -d] [-f] [-o OFFSET] FILE [OUTPUT]\n"
+         "       mio0 [-c / -d] [-f] [-o OFFSET] [-j THREADS] -b LIST\n"
          "\n"
          "mio0 v" MIO0_VERSION ": MIO0 compression and decompression tool\n"
          "\n"
          "Optional arguments:\n"
          " -c           compress raw data into MIO0 (default: compress)\n"
          " -d           decompress MIO0 into raw data\n"
+         " -f           compress faster with a shorter match search; output will\n"
+         "              differ from the original tool (default: identical output)\n"
          " -o OFFSET    starting offset in FILE (default: 0)\n"
+         " -b LIST      process every \"FILE OUTPUT\" line of LIST\n"
+         " -j THREADS   files processed at once with -b (default: one per CPU)\n"
          "\n"
          "File arguments:\n"
          " FILE        input file\n"
@@ -500,12 +547,27 @@ static void parse_arguments(int argc, char *argv[], arg_config *config)
             case 'd':
                config->compress = 0;
                break;
+            case 'f':
+               config->mode = MIO0_FAST;
+               break;
             case 'o':
                if (++i >= argc) {
                   print_usage();
                }
                config->offset = strtoul(argv[i], NULL, 0);
                break;
+            case 'b':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->list_filename = argv[i];
+               break;
+            case 'j':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->threads = MAX(atoi(argv[i]), 1);
+               break;
             default:
                print_usage();
                break;
@@ -525,51 +587,111 @@ static void parse_arguments(int argc, char *argv[], arg_config *config)
          file_count++;
       }
    }
-   if (file_count < 1) {
+   if (file_count < 1 && config->list_filename == NULL) {
       print_usage();
    }
 }
 
-int main(int argc, char *argv[])
+static int process_file(const arg_config *config, const char *in_filename, const char *out_filename)
 {
-   char out_filename[FILENAME_MAX];
-   arg_config config;
    int ret_val;
 
-   // get configuration from arguments
-   config = default_config;
-   parse_arguments(argc, argv, &config);
-   if (config.out_filename == NULL) {
-      config.out_filename = out_filename;
-      sprintf(config.out_filename, "%s.out", config.in_filename);
-   }
-
    // operation
-   if (config.compress) {
-      ret_val = mio0_encode_file(config.in_filename, config.out_filename);
+   if (config->compress) {
+      ret_val = mio0_encode_file_mode(in_filename, out_filename, config->mode);
    } else {
-      ret_val = mio0_decode_file(config.in_filename, config.offset, config.out_filename);
+      ret_val = mio0_decode_file(in_filename, config->offset, out_filename);
    }
 
    switch (ret_val) {
       case 1:
-         ERROR("Error opening input file \"%s\"\n", config.in_filename);
+         ERROR("Error opening input file \"%s\"\n", in_filename);
          break;
       case 2:
-         ERROR("Error reading from input file \"%s\"\n", config.in_filename);
+         ERROR("Error reading from input file \"%s\"\n", in_filename);
          break;
       case 3:
-         ERROR("Error decoding MIO0 data. Wrong offset (0x%X)?\n", config.offset);
+         ERROR("Error decoding MIO0 data. Wrong offset (0x%X)?\n", config->offset);
          break;
       case 4:
-         ERROR("Error opening output file \"%s\"\n", config.out_filename);
+         ERROR("Error opening output file \"%s\"\n", out_filename);
          break;
       case 5:
-         ERROR("Error writing bytes to output file \"%s\"\n", config.out_filename);
+         ERROR("Error writing bytes to output file \"%s\"\n", out_filename);
          break;
    }
 
    return ret_val;
 }
-#endif // MIO0_STANDALONE
 
+static int batch_job(void *arg, int index)
+{
+   batch_queue *queue = arg;
+   batch_file *file = &queue->files[index];
+
+   return process_file(queue->config, file->in_filename, file->out_filename) != 0;
+}
+
+// process every file in the list, each file on one of 'threads' threads
+// the build compresses each .bin in its own make rule, so this is only for running the tool by hand
+static int process_batch(const arg_config *config)
+{
+   batch_queue queue;
+   int allocated = 0;
+   int failed;
+   int i;
+   FILE *list;
+
+   list = fopen(config->list_filename, "r");
+   if (list == NULL) {
+      ERROR("Error opening list file \"%s\"\n", config->list_filename);
+      return 1;
+   }
+
+   queue.config = config;
+   queue.files = NULL;
+   queue.count = 0;
+   for (;;) {
+      if (queue.count == allocated) {
+         allocated = allocated * 2 + 64;
+         queue.files = realloc(queue.files, allocated * sizeof(*queue.files));
+      }
+      i = fscanf(list, "%1023s %1023s", queue.files[queue.count].in_filename, queue.files[queue.count].out_filename);
+      if (i != 2) {
+         break;
+      }
+      queue.count++;
+   }
+   fclose(list);
+   if (i != EOF) {
+      ERROR("Error reading list file \"%s\": expected \"FILE OUTPUT\" on every line\n", config->list_filename);
+      free(queue.files);
+      return 1;
+   }
+
+   failed = parallel_jobs(queue.count, (config->threads > 0) ? config->threads : parallel_thread_count(),
+                          batch_job, &queue);
+   free(queue.files);
+
+   return failed > 0;
+}
+
+int main(int argc, char *argv[])
+{
+   char out_filename[FILENAME_MAX];
+   arg_config config;
+
+   // get configuration from arguments
+   config = default_config;
+   parse_arguments(argc, argv, &config);
+   if (config.list_filename != NULL) {
+      return process_batch(&config);
+   }
+   if (config.out_filename == NULL) {
+      config.out_filename = out_filename;
+      sprintf(config.out_filename, "%s.out", config.in_filename);
+   }
+
+   return process_file(&config, config.in_filename, config.out_filename);
+}
+#endif // MIO0_STANDALONE
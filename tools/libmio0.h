@@ -7,6 +7,12 @@
 
 // typedefs
 
+typedef enum
+{
+   MIO0_COMPAT, // same output as the original encoder, which the matching build relies on
+   MIO0_FAST,   // searches fewer earlier positions; output may be slightly larger
+} mio0_mode_t;
+
 typedef struct
 {
    unsigned int dest_size;
@@ -36,6 +42,11 @@ int mio0_decode(const unsigned char *in, unsigned char *out, unsigned int *end);
 // returns size of compressed data in 'out' including MIO0 header
 int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out);
 
+// encode MIO0 data in memory with a choice of match search
+// mode: MIO0_COMPAT or MIO0_FAST
+// returns size of compressed data in 'out' including MIO0 header
+int mio0_encode_mode(const unsigned char *in, unsigned int length, unsigned char *out, mio0_mode_t mode);
+
 // decode an entire MIO0 block at an offset from file to output file
 // in_file: input filename
 // offset: offset to start decoding from in_file
@@ -47,4 +58,8 @@ int mio0_decode_file(const char *in_file, unsigned long offset, const char *out_
 // out_file: output filename to write MIO0 compressed data to
 int mio0_encode_file(const char *in_file, const char *out_file);
 
+// encode an entire file with a choice of match search
+// mode: MIO0_COMPAT or MIO0_FAST
+int mio0_encode_file_mode(const char *in_file, const char *out_file, mio0_mode_t mode);
+
 #endif // LIBMIO0_H_
@@ -1,7 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 
+#if !defined(__sgi) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define USE_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON 1
+#endif
+
 #define STBI_NO_LINEAR
 #define STBI_NO_HDR
 #define STBI_NO_TGA
@@ -21,6 +30,10 @@
 #define SCALE_3_8(VAL_) ((VAL_) * 0x24)
 #define SCALE_8_3(VAL_) ((VAL_) / 0x24)
 
+// The vector packers divide with multiply and shift, which is exact for every value they see:
+// n / 255 == (n + 1 + (n >> 8)) >> 8 for n < 65535, v / 17 == (v * 241) >> 12 and v / 36 == (v * 57) >> 11 for
+// v < 256.
+
 
 typedef struct
 {
@@ -204,21 +217,203 @@ uint8_t *ci2raw(const uint8_t *rawci, const uint8_t *palette, int width, int hei
 // returns length written to 'raw' used or -1 on error
 //---------------------------------------------------------
 
+// Each packer converts pixels [0, count) with vectors where available and leaves the rest to its scalar loop,
+// which starts where the vectors stopped. 4-bit packers always stop on an even pixel.
+
+#if defined(USE_SSE2)
+static inline __m128i scale_8_5_sse2(__m128i val)
+{
+   __m128i n = _mm_mullo_epi16(_mm_add_epi16(val, _mm_set1_epi16(4)), _mm_set1_epi16(0x1F));
+   return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(n, _mm_set1_epi16(1)), _mm_srli_epi16(n, 8)), 8);
+}
+
+static inline __m128i scale_8_4_sse2(__m128i val)
+{
+   return _mm_srli_epi16(_mm_mullo_epi16(val, _mm_set1_epi16(241)), 12);
+}
+
+static inline __m128i scale_8_3_sse2(__m128i val)
+{
+   return _mm_srli_epi16(_mm_mullo_epi16(val, _mm_set1_epi16(57)), 11);
+}
+
+// two 4-bit values per byte, the first one high, from 16 nibbles in 16-bit lanes
+static inline void store_nibbles_sse2(uint8_t *raw, __m128i lo, __m128i hi)
+{
+   __m128i pairs = _mm_packus_epi16(lo, hi);
+   __m128i bytes = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(pairs, _mm_set1_epi16(0xFF)), 4),
+                                _mm_srli_epi16(pairs, 8));
+   _mm_storel_epi64((__m128i *)raw, _mm_packus_epi16(bytes, bytes));
+}
+#elif defined(USE_NEON)
+static inline uint16x8_t scale_8_5_neon(uint8x8_t val)
+{
+   uint16x8_t n = vmulq_n_u16(vaddl_u8(val, vdup_n_u8(4)), 0x1F);
+   return vshrq_n_u16(vaddq_u16(vaddq_u16(n, vdupq_n_u16(1)), vshrq_n_u16(n, 8)), 8);
+}
+
+static inline uint8x16_t scale_8_4_neon(uint8x16_t val)
+{
+   uint16x8_t lo = vshrq_n_u16(vmull_u8(vget_low_u8(val), vdup_n_u8(241)), 12);
+   uint16x8_t hi = vshrq_n_u16(vmull_u8(vget_high_u8(val), vdup_n_u8(241)), 12);
+   return vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+}
+
+static inline uint8x16_t scale_8_3_neon(uint8x16_t val)
+{
+   uint16x8_t lo = vshrq_n_u16(vmull_u8(vget_low_u8(val), vdup_n_u8(57)), 11);
+   uint16x8_t hi = vshrq_n_u16(vmull_u8(vget_high_u8(val), vdup_n_u8(57)), 11);
+   return vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+}
+
+static inline void store_nibbles_neon(uint8_t *raw, uint8x16_t nibbles)
+{
+   uint8x8x2_t pairs = vuzp_u8(vget_low_u8(nibbles), vget_high_u8(nibbles));
+   vst1_u8(raw, vorr_u8(vshl_n_u8(pairs.val[0], 4), pairs.val[1]));
+}
+#endif
+
+static void pack_rgba16(uint8_t *raw, const rgba *img, int count)
+{
+   int i = 0;
+
+#if defined(USE_SSE2)
+   const __m128i mask = _mm_set1_epi32(0xFF);
+   for (; i + 8 <= count; i += 8) {
+      __m128i p0 = _mm_loadu_si128((const __m128i *)&img[i]);
+      __m128i p1 = _mm_loadu_si128((const __m128i *)&img[i + 4]);
+      __m128i r = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+      __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+      __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+      __m128i a = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+      __m128i val = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(scale_8_5_sse2(r), 11), _mm_slli_epi16(scale_8_5_sse2(g), 6)),
+                                 _mm_or_si128(_mm_slli_epi16(scale_8_5_sse2(b), 1), _mm_min_epi16(a, _mm_set1_epi16(1))));
+      _mm_storeu_si128((__m128i *)&raw[i*2], _mm_or_si128(_mm_slli_epi16(val, 8), _mm_srli_epi16(val, 8)));
+   }
+#elif defined(USE_NEON)
+   for (; i + 16 <= count; i += 16) {
+      uint8x16x4_t p = vld4q_u8((const uint8_t *)&img[i]);
+      uint8x16_t a = vminq_u8(p.val[3], vdupq_n_u8(1));
+      uint16x8_t lo = vorrq_u16(vorrq_u16(vshlq_n_u16(scale_8_5_neon(vget_low_u8(p.val[0])), 11),
+                                          vshlq_n_u16(scale_8_5_neon(vget_low_u8(p.val[1])), 6)),
+                                vorrq_u16(vshlq_n_u16(scale_8_5_neon(vget_low_u8(p.val[2])), 1), vmovl_u8(vget_low_u8(a))));
+      uint16x8_t hi = vorrq_u16(vorrq_u16(vshlq_n_u16(scale_8_5_neon(vget_high_u8(p.val[0])), 11),
+                                          vshlq_n_u16(scale_8_5_neon(vget_high_u8(p.val[1])), 6)),
+                                vorrq_u16(vshlq_n_u16(scale_8_5_neon(vget_high_u8(p.val[2])), 1), vmovl_u8(vget_high_u8(a))));
+      vst1q_u8(&raw[i*2], vrev16q_u8(vreinterpretq_u8_u16(lo)));
+      vst1q_u8(&raw[i*2 + 16], vrev16q_u8(vreinterpretq_u8_u16(hi)));
+   }
+#endif
+   for (; i < count; i++) {
+      uint8_t r, g, b, a;
+      r = SCALE_8_5(img[i].red);
+      g = SCALE_8_5(img[i].green);
+      b = SCALE_8_5(img[i].blue);
+      a = img[i].alpha ? 0x1 : 0x0;
+      raw[i*2]   = (r << 3) | (g >> 2);
+      raw[i*2+1] = ((g & 0x3) << 6) | (b << 1) | a;
+   }
+}
+
+static void pack_ia8(uint8_t *raw, const ia *img, int count)
+{
+   int i = 0;
+
+#if defined(USE_SSE2)
+   const __m128i mask = _mm_set1_epi16(0xFF);
+   for (; i + 16 <= count; i += 16) {
+      __m128i p0 = _mm_loadu_si128((const __m128i *)&img[i]);
+      __m128i p1 = _mm_loadu_si128((const __m128i *)&img[i + 8]);
+      __m128i lo = _mm_or_si128(_mm_slli_epi16(scale_8_4_sse2(_mm_and_si128(p0, mask)), 4),
+                                scale_8_4_sse2(_mm_srli_epi16(p0, 8)));
+      __m128i hi = _mm_or_si128(_mm_slli_epi16(scale_8_4_sse2(_mm_and_si128(p1, mask)), 4),
+                                scale_8_4_sse2(_mm_srli_epi16(p1, 8)));
+      _mm_storeu_si128((__m128i *)&raw[i], _mm_packus_epi16(lo, hi));
+   }
+#elif defined(USE_NEON)
+   for (; i + 16 <= count; i += 16) {
+      uint8x16x2_t p = vld2q_u8((const uint8_t *)&img[i]);
+      vst1q_u8(&raw[i], vorrq_u8(vshlq_n_u8(scale_8_4_neon(p.val[0]), 4), scale_8_4_neon(p.val[1])));
+   }
+#endif
+   for (; i < count; i++) {
+      uint8_t val = SCALE_8_4(img[i].intensity);
+      uint8_t alpha = SCALE_8_4(img[i].alpha);
+      raw[i] = (val << 4) | alpha;
+   }
+}
+
+// 'raw' must be cleared
+static void pack_ia4(uint8_t *raw, const ia *img, int count)
+{
+   int i = 0;
+
+#if defined(USE_SSE2)
+   const __m128i mask = _mm_set1_epi16(0xFF);
+   const __m128i one = _mm_set1_epi16(1);
+   for (; i + 16 <= count; i += 16) {
+      __m128i p0 = _mm_loadu_si128((const __m128i *)&img[i]);
+      __m128i p1 = _mm_loadu_si128((const __m128i *)&img[i + 8]);
+      __m128i lo = _mm_or_si128(_mm_slli_epi16(scale_8_3_sse2(_mm_and_si128(p0, mask)), 1),
+                                _mm_min_epi16(_mm_srli_epi16(p0, 8), one));
+      __m128i hi = _mm_or_si128(_mm_slli_epi16(scale_8_3_sse2(_mm_and_si128(p1, mask)), 1),
+                                _mm_min_epi16(_mm_srli_epi16(p1, 8), one));
+      store_nibbles_sse2(&raw[i/2], lo, hi);
+   }
+#elif defined(USE_NEON)
+   for (; i + 16 <= count; i += 16) {
+      uint8x16x2_t p = vld2q_u8((const uint8_t *)&img[i]);
+      store_nibbles_neon(&raw[i/2], vorrq_u8(vshlq_n_u8(scale_8_3_neon(p.val[0]), 1), vminq_u8(p.val[1], vdupq_n_u8(1))));
+   }
+#endif
+   for (; i < count; i++) {
+      uint8_t val = SCALE_8_3(img[i].intensity);
+      uint8_t alpha = img[i].alpha ? 0x01 : 0x00;
+      uint8_t old = raw[i/2];
+      if (i % 2) {
+         raw[i/2] = (old & 0xF0) | (val << 1) | alpha;
+      } else {
+         raw[i/2] = (old & 0x0F) | (((val << 1) | alpha) << 4);
+      }
+   }
+}
+
+// 'raw' must be cleared
+static void pack_i4(uint8_t *raw, const ia *img, int count)
+{
+   int i = 0;
+
+#if defined(USE_SSE2)
+   const __m128i mask = _mm_set1_epi16(0xFF);
+   for (; i + 16 <= count; i += 16) {
+      __m128i p0 = _mm_loadu_si128((const __m128i *)&img[i]);
+      __m128i p1 = _mm_loadu_si128((const __m128i *)&img[i + 8]);
+      store_nibbles_sse2(&raw[i/2], scale_8_4_sse2(_mm_and_si128(p0, mask)), scale_8_4_sse2(_mm_and_si128(p1, mask)));
+   }
+#elif defined(USE_NEON)
+   for (; i + 16 <= count; i += 16) {
+      uint8x16x2_t p = vld2q_u8((const uint8_t *)&img[i]);
+      store_nibbles_neon(&raw[i/2], scale_8_4_neon(p.val[0]));
+   }
+#endif
+   for (; i < count; i++) {
+      uint8_t val = SCALE_8_4(img[i].intensity);
+      uint8_t old = raw[i/2];
+      if (i % 2) {
+         raw[i/2] = (old & 0xF0) | val;
+      } else {
+         raw[i/2] = (old & 0x0F) | (val << 4);
+      }
+   }
+}
+
 int rgba2raw(uint8_t *raw, const rgba *img, int width, int height, int depth)
 {
    int size = (width * height * depth + 7) / 8;
    INFO("Converting RGBA%d %dx%d to raw\n", depth, width, height);
 
    if (depth == 16) {
-      for (int i = 0; i < width * height; i++) {
-         uint8_t r, g, b, a;
-         r = SCALE_8_5(img[i].red);
-         g = SCALE_8_5(img[i].green);
-         b = SCALE_8_5(img[i].blue);
-         a = img[i].alpha ? 0x1 : 0x0;
-         raw[i*2]   = (r << 3) | (g >> 2);
-         raw[i*2+1] = ((g & 0x3) << 6) | (b << 1) | a;
-      }
+      pack_rgba16(raw, img, width * height);
    } else if (depth == 32) {
       for (int i = 0; i < width * height; i++) {
          raw[i*4]   = img[i].red;
@@ -248,23 +443,10 @@ int ia2raw(uint8_t *raw, const ia *img, int width, int height, int depth)
          }
          break;
       case 8:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t val = SCALE_8_4(img[i].intensity);
-            uint8_t alpha = SCALE_8_4(img[i].alpha);
-            raw[i] = (val << 4) | alpha;
-         }
+         pack_ia8(raw, img, width * height);
          break;
       case 4:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t val = SCALE_8_3(img[i].intensity);
-            uint8_t alpha = img[i].alpha ? 0x01 : 0x00;
-            uint8_t old = raw[i/2];
-            if (i % 2) {
-               raw[i/2] = (old & 0xF0) | (val << 1) | alpha;
-            } else {
-               raw[i/2] = (old & 0x0F) | (((val << 1) | alpha) << 4);
-            }
-         }
+         pack_ia4(raw, img, width * height);
          break;
       case 1:
          for (int i = 0; i < width * height; i++) {
@@ -300,15 +482,7 @@ int i2raw(uint8_t *raw, const ia *img, int width, int height, int depth)
          }
          break;
       case 4:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t val = SCALE_8_4(img[i].intensity);
-            uint8_t old = raw[i/2];
-            if (i % 2) {
-               raw[i/2] = (old & 0xF0) | val;
-            } else {
-               raw[i/2] = (old & 0x0F) | (val << 4);
-            }
-         }
+         pack_i4(raw, img, width * height);
          break;
       default:
          ERROR("Error invalid depth %d\n", depth);
@@ -319,7 +493,6 @@ int i2raw(uint8_t *raw, const ia *img, int width, int height, int depth)
    return size;
 }
 
-
 //---------------------------------------------------------
 // internal RGBA/IA -> PNG
 //---------------------------------------------------------
@@ -541,9 +714,14 @@ int raw2ci(uint8_t *rawci, palette_t *pal, const uint8_t *raw, int raw_len, int
    pal->used = 0;
    memset(pal->data, 0, sizeof(pal->data));
    int ci_idx = 0;
+   // textures are mostly runs of one color, so skip the palette search for a repeat of the last one
+   uint16_t last_val = 0;
+   int last_idx = -1;
    for (int i = 0; i < raw_len; i += sizeof(uint16_t)) {
       uint16_t val = read_u16_be(&raw[i]);
-      int pal_idx = pal_add_color(pal, val);
+      int pal_idx = (last_idx >= 0 && val == last_val) ? last_idx : pal_add_color(pal, val);
+      last_val = val;
+      last_idx = pal_idx;
       if (pal_idx < 0) {
          ERROR("Error adding color @ (%d): %d (used: %d/%d)\n", i, pal_idx, pal->used, pal->max);
          return 0;
@@ -578,8 +756,8 @@ const char *n64graphics_get_write_version(void)
 }
 
 #ifdef N64GRAPHICS_STANDALONE
-#define N64GRAPHICS_VERSION "0.4"
-#include <string.h>
+#define N64GRAPHICS_VERSION "0.5"
+#include "parallel.h"
 
 typedef enum
 {
@@ -592,6 +770,7 @@ typedef struct
    char *img_filename;
    char *bin_filename;
    char *pal_filename;
+   char *batch_filename;
    tool_mode mode;
    write_encoding encoding;
    unsigned int bin_offset;
@@ -602,13 +781,27 @@ typedef struct
    int height;
    int bin_truncate;
    int pal_truncate;
+   int threads;
 } graphics_config;
 
+typedef struct
+{
+   char *line;
+   graphics_config config;
+} batch_entry;
+
+typedef struct
+{
+   batch_entry *entries;
+   int count;
+} batch_queue;
+
 static const graphics_config default_config =
 {
    .img_filename = NULL,
    .bin_filename = NULL,
    .pal_filename = NULL,
+   .batch_filename = NULL,
    .mode = MODE_EXPORT,
    .encoding = ENCODING_RAW,
    .bin_offset = 0,
@@ -619,6 +812,7 @@ static const graphics_config default_config =
    .height = 32,
    .bin_truncate = 1,
    .pal_truncate = 1,
+   .threads = 0,
 };
 
 typedef struct
@@ -702,6 +896,7 @@ static int parse_encoding(write_encoding *encoding, const char *str)
 static void print_usage(void)
 {
    ERROR("Usage: n64graphics -e/-i BIN_FILE -g IMG_FILE [-p PAL_FILE] [-o BIN_OFFSET] [-P PAL_OFFSET] [-f FORMAT] [-c CI_FORMAT] [-w WIDTH] [-h HEIGHT] [-V]\n"
+         "       n64graphics -b MANIFEST [-j THREADS] [OPTIONS]\n"
          "\n"
          "n64graphics v" N64GRAPHICS_VERSION ": N64 graphics manipulator\n"
          "\n"
@@ -719,6 +914,10 @@ static void print_usage(void)
          " -c CI_FORMAT  CI palette format: rgba16, ia16 (default: %s)\n"
          " -p PAL_FILE   palette binary file to import/export from/to\n"
          " -P PAL_OFFSET starting offset in PAL_FILE (prevents truncation during import)\n"
+         "Batch arguments:\n"
+         " -b MANIFEST   run every line of MANIFEST, each holding the arguments of one\n"
+         "               conversion; other OPTIONS apply to every line, '#' starts a comment\n"
+         " -j THREADS    conversions run at once with -b (default: number of CPUs)\n"
          "Other arguments:\n"
          " -v            verbose logging\n"
          " -V            print version information\n",
@@ -743,6 +942,10 @@ static int parse_arguments(int argc, char *argv[], graphics_config *config)
    for (int i = 1; i < argc; i++) {
       if (argv[i][0] == '-') {
          switch (argv[i][1]) {
+            case 'b':
+               if (++i >= argc) return 0;
+               config->batch_filename = argv[i];
+               break;
             case 'c':
                if (++i >= argc) return 0;
                if (!parse_format(&config->pal_format, argv[i])) {
@@ -773,6 +976,10 @@ static int parse_arguments(int argc, char *argv[], graphics_config *config)
                config->bin_filename = argv[i];
                config->mode = MODE_IMPORT;
                break;
+            case 'j':
+               if (++i >= argc) return 0;
+               config->threads = MAX(atoi(argv[i]), 1);
+               break;
             case 'o':
                if (++i >= argc) return 0;
                config->bin_offset = strtoul(argv[i], NULL, 0);
@@ -830,23 +1037,23 @@ static int valid_config(const graphics_config *config)
    return 1;
 }
 
-int main(int argc, char *argv[])
+// import or export one texture, returns EXIT_SUCCESS or EXIT_FAILURE
+static int convert(const graphics_config *in_config)
 {
-   graphics_config config = default_config;
-   rgba *imgr;
-   ia   *imgi;
-   FILE *bin_fp;
-   uint8_t *raw;
+   graphics_config config = *in_config;
+   rgba *imgr = NULL;
+   ia   *imgi = NULL;
+   FILE *bin_fp = NULL;
+   FILE *pal_fp = NULL;
+   uint8_t *raw = NULL;
+   uint8_t *raw16 = NULL;
+   uint8_t *pal = NULL;
+   uint8_t *raw_fmt = NULL;
    int raw_size;
    int length = 0;
    int flength;
-   int res;
-
-   int valid = parse_arguments(argc, argv, &config);
-   if (!valid || !valid_config(&config)) {
-      print_usage();
-      exit(EXIT_FAILURE);
-   }
+   int res = 0;
+   int ret = EXIT_FAILURE;
 
    if (config.mode == MODE_IMPORT) {
       if (0 == strcmp("-", config.bin_filename)) {
@@ -860,7 +1067,7 @@ int main(int argc, char *argv[])
       }
       if (!bin_fp) {
          ERROR("Error opening \"%s\"\n", config.bin_filename);
-         return -1;
+         return EXIT_FAILURE;
       }
       if (!config.bin_truncate) {
          fseek(bin_fp, config.bin_offset, SEEK_SET);
@@ -868,39 +1075,48 @@ int main(int argc, char *argv[])
       switch (config.format.format) {
          case IMG_FORMAT_RGBA:
             imgr = png2rgba(config.img_filename, &config.width, &config.height);
+            if (!imgr) {
+               goto cleanup;
+            }
             raw_size = (config.width * config.height * config.format.depth + 7) / 8;
             raw = malloc(raw_size);
             if (!raw) {
                ERROR("Error allocating %u bytes\n", raw_size);
+               goto cleanup;
             }
             length = rgba2raw(raw, imgr, config.width, config.height, config.format.depth);
             break;
          case IMG_FORMAT_IA:
             imgi = png2ia(config.img_filename, &config.width, &config.height);
+            if (!imgi) {
+               goto cleanup;
+            }
             raw_size = (config.width * config.height * config.format.depth + 7) / 8;
             raw = malloc(raw_size);
             if (!raw) {
                ERROR("Error allocating %u bytes\n", raw_size);
+               goto cleanup;
             }
             length = ia2raw(raw, imgi, config.width, config.height, config.format.depth);
             break;
          case IMG_FORMAT_I:
             imgi = png2ia(config.img_filename, &config.width, &config.height);
+            if (!imgi) {
+               goto cleanup;
+            }
             raw_size = (config.width * config.height * config.format.depth + 7) / 8;
             raw = malloc(raw_size);
             if (!raw) {
                ERROR("Error allocating %u bytes\n", raw_size);
+               goto cleanup;
             }
             length = i2raw(raw, imgi, config.width, config.height, config.format.depth);
             break;
          case IMG_FORMAT_CI:
          {
-            palette_t pal = {0};
-            FILE *pal_fp;
-            uint8_t *raw16;
+            palette_t pal_data = {0};
             int raw16_size;
             int raw16_length;
-            uint8_t *ci;
             int ci_length;
             int pal_success;
             int pal_length;
@@ -912,48 +1128,59 @@ int main(int argc, char *argv[])
             }
             if (!pal_fp) {
                ERROR("Error opening \"%s\"\n", config.pal_filename);
-               return EXIT_FAILURE;
+               goto cleanup;
             }
             if (!config.pal_truncate) {
                fseek(pal_fp, config.bin_offset, SEEK_SET);
             }
 
-            raw16_size = config.width * config.height * config.pal_format.depth / 8;
-            raw16 = malloc(raw16_size);
-            if (!raw16) {
-               ERROR("Error allocating %d bytes\n", raw16_size);
-               return EXIT_FAILURE;
-            }
+            // load the image first, raw16 takes its size
             switch (config.pal_format.format) {
                case IMG_FORMAT_RGBA:
                   imgr = png2rgba(config.img_filename, &config.width, &config.height);
-                  raw16_length = rgba2raw(raw16, imgr, config.width, config.height, config.pal_format.depth);
                   break;
                case IMG_FORMAT_IA:
                   imgi = png2ia(config.img_filename, &config.width, &config.height);
-                  raw16_length = ia2raw(raw16, imgi, config.width, config.height, config.pal_format.depth);
                   break;
                default:
                   ERROR("Unsupported palette format: %s\n", format2str(&config.pal_format));
-                  exit(EXIT_FAILURE);
+                  goto cleanup;
+            }
+            if (!imgr && !imgi) {
+               goto cleanup;
+            }
+            raw16_size = config.width * config.height * config.pal_format.depth / 8;
+            raw16 = malloc(raw16_size);
+            if (!raw16) {
+               ERROR("Error allocating %d bytes\n", raw16_size);
+               goto cleanup;
+            }
+            if (imgr) {
+               raw16_length = rgba2raw(raw16, imgr, config.width, config.height, config.pal_format.depth);
+            } else {
+               raw16_length = ia2raw(raw16, imgi, config.width, config.height, config.pal_format.depth);
             }
 
             // convert raw to palette
-            pal.max = (1 << config.format.depth);
+            pal_data.max = (1 << config.format.depth);
             ci_length = config.width * config.height * config.format.depth / 8;
-            ci = malloc(ci_length);
-            pal_success = raw2ci(ci, &pal, raw16, raw16_length, config.format.depth);
+            raw = malloc(ci_length);
+            if (!raw) {
+               ERROR("Error allocating %d bytes\n", ci_length);
+               goto cleanup;
+            }
+            pal_success = raw2ci(raw, &pal_data, raw16, raw16_length, config.format.depth);
             if (!pal_success) {
                ERROR("Error converting palette\n");
-               exit(EXIT_FAILURE);
+               goto cleanup;
             }
 
             // pack the bytes
-            uint8_t raw_pal[sizeof(pal.data)];
-            for (int i = 0; i < pal.max; i++) {
-               write_u16_be(&raw_pal[2*i], pal.data[i]);
+            uint8_t raw_pal[sizeof(pal_data.data)];
+            for (int i = 0; i < pal_data.max; i++) {
+               write_u16_be(&raw_pal[2*i], pal_data.data[i]);
             }
-            pal_length = pal.max * sizeof(pal.data[0]);
+            pal_length = pal_data.max * sizeof(pal_data.data[0]);
             INFO("Writing 0x%X bytes to offset 0x%X of \"%s\"\n", pal_length, config.pal_offset, config.pal_filename);
             flength = fprint_write_output(pal_fp, config.encoding, raw_pal, pal_length);
             if (config.encoding == ENCODING_RAW && flength != pal_length) {
@@ -961,19 +1188,15 @@ int main(int argc, char *argv[])
             }
             INFO("Wrote 0x%X bytes to \"%s\"\n", flength, config.pal_filename);
 
-            raw = ci;
             length = ci_length;
-
-            free(raw16);
-            fclose(pal_fp);
             break;
          }
          default:
-            return EXIT_FAILURE;
+            goto cleanup;
       }
       if (length <= 0) {
          ERROR("Error converting to raw format\n");
-         return EXIT_FAILURE;
+         goto cleanup;
       }
       INFO("Writing 0x%X bytes to offset 0x%X of \"%s\"\n", length, config.bin_offset, config.bin_filename);
       flength = fprint_write_output(bin_fp, config.encoding, raw, length);
@@ -981,9 +1204,7 @@ int main(int argc, char *argv[])
          ERROR("Error writing %d bytes to \"%s\"\n", length, config.bin_filename);
       }
       INFO("Wrote 0x%X bytes to \"%s\"\n", flength, config.bin_filename);
-      if (bin_fp != stdout) {
-         fclose(bin_fp);
-      }
+      ret = EXIT_SUCCESS;
 
    } else {
       if (config.width <= 0 || config.height <= 0 || config.format.depth <= 0) {
@@ -993,10 +1214,14 @@ int main(int argc, char *argv[])
       bin_fp = fopen(config.bin_filename, "rb");
       if (!bin_fp) {
          ERROR("Error opening \"%s\"\n", config.bin_filename);
-         return -1;
+         return EXIT_FAILURE;
       }
       raw_size = (config.width * config.height * config.format.depth + 7) / 8;
       raw = malloc(raw_size);
+      if (!raw) {
+         ERROR("Error allocating %u bytes\n", raw_size);
+         goto cleanup;
+      }
       if (config.bin_offset > 0) {
          fseek(bin_fp, config.bin_offset, SEEK_SET);
       }
@@ -1019,9 +1244,6 @@ int main(int argc, char *argv[])
             break;
          case IMG_FORMAT_CI:
          {
-            FILE *pal_fp;
-            uint8_t *pal;
-            uint8_t *raw_fmt;
             int pal_size;
 
             INFO("Extracting %s offset 0x%X, pal.offset 0x%0X, pal.format %s\n", format2str(&config.format),
@@ -1030,7 +1252,7 @@ int main(int argc, char *argv[])
             pal_fp = fopen(config.pal_filename, "rb");
             if (!pal_fp) {
                ERROR("Error opening \"%s\"\n", config.bin_filename);
-               return EXIT_FAILURE;
+               goto cleanup;
             }
             if (config.pal_offset > 0) {
                fseek(pal_fp, config.pal_offset, SEEK_SET);
@@ -1039,6 +1261,10 @@ int main(int argc, char *argv[])
             pal_size = sizeof(uint16_t) * (1 << config.format.depth);
             INFO("Palette size: %d\n", pal_size);
             pal = malloc(pal_size);
+            if (!pal) {
+               ERROR("Error allocating %d bytes\n", pal_size);
+               goto cleanup;
+            }
             flength = fread(pal, 1, pal_size, pal_fp);
             if (flength != pal_size) {
                ERROR("Error reading %d bytes from \"%s\"\n", pal_size, config.pal_filename);
@@ -1057,21 +1283,150 @@ int main(int argc, char *argv[])
                   break;
                default:
                   ERROR("Unsupported palette format: %s\n", format2str(&config.pal_format));
-                  return EXIT_FAILURE;
+                  goto cleanup;
             }
-            free(raw_fmt);
-            free(pal);
             break;
          }
          default:
-            return EXIT_FAILURE;
+            goto cleanup;
       }
       if (!res) {
          ERROR("Error writing to \"%s\"\n", config.img_filename);
-         return EXIT_FAILURE;
+         goto cleanup;
+      }
+      ret = EXIT_SUCCESS;
+   }
+
+cleanup:
+   if (bin_fp && bin_fp != stdout) {
+      fclose(bin_fp);
+   }
+   if (pal_fp) {
+      fclose(pal_fp);
+   }
+   free(imgr);
+   free(imgi);
+   free(raw);
+   free(raw16);
+   free(pal);
+   free(raw_fmt);
+   return ret;
+}
+
+static int batch_job(void *arg, int index)
+{
+   batch_queue *queue = arg;
+
+   return convert(&queue->entries[index].config) != EXIT_SUCCESS;
+}
+
+// split a manifest line into whitespace separated arguments, stopping at '#'
+// returns the argument count, or -1 if there are more than max_args
+static int split_line(char *line, char *argv[], int max_args)
+{
+   int argc = 1;
+   char *c = line;
+
+   for (;;) {
+      while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n') {
+         c++;
+      }
+      if (*c == '\0' || *c == '#') {
+         return argc;
+      }
+      if (argc == max_args) {
+         return -1;
+      }
+      argv[argc++] = c;
+      while (*c != '\0' && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n') {
+         c++;
+      }
+      if (*c != '\0') {
+         *c++ = '\0';
+      }
+   }
+}
+
+// read every conversion of the manifest, then run them on 'threads' threads
+// conversions don't depend on each other, so a CI texture and its palette must be on the same line
+static int process_batch(const graphics_config *config)
+{
+   batch_queue queue;
+   graphics_config base = *config;
+   char *args[64];
+   char buf[4096];
+   int allocated = 0;
+   int failed = 0;
+   int line_num = 0;
+   int valid = 1;
+   int argc;
+   int i;
+   FILE *manifest;
+
+   manifest = fopen(config->batch_filename, "r");
+   if (manifest == NULL) {
+      ERROR("Error opening manifest \"%s\"\n", config->batch_filename);
+      return EXIT_FAILURE;
+   }
+
+   base.batch_filename = NULL;
+   args[0] = "n64graphics";
+   queue.entries = NULL;
+   queue.count = 0;
+   while (fgets(buf, sizeof(buf), manifest) != NULL) {
+      line_num++;
+      if (queue.count == allocated) {
+         allocated = allocated * 2 + 64;
+         queue.entries = realloc(queue.entries, allocated * sizeof(*queue.entries));
       }
+      batch_entry *entry = &queue.entries[queue.count];
+      entry->line = strdup(buf);
+      entry->config = base;
+      argc = split_line(entry->line, args, DIM(args));
+      if (argc == 1) {
+         free(entry->line);
+         continue;
+      }
+      if (argc < 0 || !parse_arguments(argc, args, &entry->config) || !valid_config(&entry->config) ||
+          entry->config.batch_filename != NULL) {
+         ERROR("Error in manifest \"%s\" line %d: %s", config->batch_filename, line_num, buf);
+         free(entry->line);
+         valid = 0;
+         continue;
+      }
+      queue.count++;
+   }
+   fclose(manifest);
+
+   if (valid) {
+      INFO("Converting %d textures on %d threads\n", queue.count, MAX(MIN(config->threads, queue.count), 1));
+      failed = parallel_jobs(queue.count, config->threads, batch_job, &queue);
+   }
+
+   for (i = 0; i < queue.count; i++) {
+      free(queue.entries[i].line);
+   }
+   free(queue.entries);
+
+   return (valid && failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+   graphics_config config = default_config;
+
+   int valid = parse_arguments(argc, argv, &config);
+   if (valid && config.batch_filename) {
+      if (config.threads <= 0) {
+         config.threads = parallel_thread_count();
+      }
+      return process_batch(&config);
+   }
+   if (!valid || !valid_config(&config)) {
+      print_usage();
+      exit(EXIT_FAILURE);
    }
 
-   return EXIT_SUCCESS;
+   return convert(&config);
 }
 #endif // N64GRAPHICS_STANDALONE
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+typedef struct
+{
+   void (*body)(void *arg, int start, int end);
+   void *arg;
+   int count;
+   int grain;
+   int next;
+   pthread_mutex_t lock;
+} parallel_work;
+
+typedef struct
+{
+   int (*job)(void *arg, int index);
+   void *arg;
+   int failed;
+   pthread_mutex_t lock;
+} parallel_job_list;
+
+static void *parallel_worker(void *ptr)
+{
+   parallel_work *work = ptr;
+   int start;
+
+   for (;;) {
+      pthread_mutex_lock(&work->lock);
+      start = work->next;
+      work->next += work->grain;
+      pthread_mutex_unlock(&work->lock);
+
+      if (start >= work->count) {
+         return NULL;
+      }
+      work->body(work->arg, start, (work->count - start < work->grain) ? work->count : start + work->grain);
+   }
+}
+
+int parallel_thread_count(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+   long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+   if (n > 0) {
+      return (int)n;
+   }
+#endif
+   return 1;
+}
+
+void parallel_for(int count, int grain, int threads, void (*body)(void *arg, int start, int end), void *arg)
+{
+   parallel_work work;
+   pthread_t *thread_ids;
+   int i;
+
+   if (grain < 1) {
+      grain = 1;
+   }
+   if (threads > (count + grain - 1) / grain) {
+      threads = (count + grain - 1) / grain;
+   }
+   if (threads <= 1) {
+      if (count > 0) {
+         body(arg, 0, count);
+      }
+      return;
+   }
+
+   work.body = body;
+   work.arg = arg;
+   work.count = count;
+   work.grain = grain;
+   work.next = 0;
+   pthread_mutex_init(&work.lock, NULL);
+
+   thread_ids = malloc(threads * sizeof(*thread_ids));
+   for (i = 1; i < threads; i++) {
+      pthread_create(&thread_ids[i], NULL, parallel_worker, &work);
+   }
+   parallel_worker(&work);
+   for (i = 1; i < threads; i++) {
+      pthread_join(thread_ids[i], NULL);
+   }
+   free(thread_ids);
+   pthread_mutex_destroy(&work.lock);
+}
+
+static void parallel_run_jobs(void *arg, int start, int end)
+{
+   parallel_job_list *jobs = arg;
+   int i;
+
+   for (i = start; i < end; i++) {
+      if (jobs->job(jobs->arg, i) != 0) {
+         pthread_mutex_lock(&jobs->lock);
+         jobs->failed++;
+         pthread_mutex_unlock(&jobs->lock);
+      }
+   }
+}
+
+int parallel_jobs(int count, int threads, int (*job)(void *arg, int index), void *arg)
+{
+   parallel_job_list jobs;
+
+   jobs.job = job;
+   jobs.arg = arg;
+   jobs.failed = 0;
+   pthread_mutex_init(&jobs.lock, NULL);
+   parallel_for(count, 1, threads, parallel_run_jobs, &jobs);
+   pthread_mutex_destroy(&jobs.lock);
+   return jobs.failed;
+}
@@ -0,0 +1,19 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+// thread pool shared by the tools with a batch mode (vadpcm_enc, tabledesign, mio0, n64graphics,
+// extract_bank_samples)
+
+// number of threads to use when none was asked for: one per CPU
+int parallel_thread_count(void);
+
+// call body(arg, start, end) over [0, count) in ranges of 'grain' items, handed out to up to
+// 'threads' threads as they become free. the calling thread works too. ranges must not depend
+// on each other; anything order-sensitive is left to the caller
+void parallel_for(int count, int grain, int threads, void (*body)(void *arg, int start, int end), void *arg);
+
+// call job(arg, index) for every index in [0, count) on up to 'threads' threads, one at a time
+// returns the number of jobs that returned non-zero
+int parallel_jobs(int count, int threads, int (*job)(void *arg, int index), void *arg);
+
+#endif // PARALLEL_H_
@@ -0,0 +1,748 @@
+// Native vadpcm_enc: encodes in memory with vencoder.c and can encode a list
+// of files on several threads (tools/parallel.c). The build still runs it once
+// per sample and lets make spread those over its jobs; -b is for encoding
+// sample sets by hand. IRIX builds use the SDK's vadpcm_enc.c and vencode.c
+// instead, so that they still match the original binary.
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include "parallel.h"
+#include "vadpcm.h"
+#include "vencoder.h"
+
+static char usage[] = "[-t -l min_loop_length] -c codebook aifcfile compressedfile\n"
+                      "       [-t -l min_loop_length] [-j threads] -b listfile\n"
+                      "\n"
+                      "With -b, every line of listfile names a codebook, an input and an output file,\n"
+                      "and the files are encoded on 'threads' threads (default: one per CPU).";
+
+typedef struct
+{
+    char codebook[1024];
+    char input[1024];
+    char output[1024];
+} EncodeJob;
+
+typedef struct
+{
+    EncodeJob *jobs;
+    s32 njobs;
+} EncodeQueue;
+
+// Decoded sample data of the input, read like the file it came from
+typedef struct
+{
+    s16 *samples;
+    s32 count;
+    s32 pos;
+} SampleReader;
+
+// Encoded sound data, written to the file once the whole sample is done
+typedef struct
+{
+    u8 *data;
+    s32 size;
+    s32 capacity;
+} FrameBuffer;
+
+static char *progname;
+static s32 truncateLoops = 0;
+static s32 minLoopLength = 800;
+
+/**
+ * Read up to 'count' samples, with the semantics of fread: returns how many
+ * were available.
+ */
+static s32 read_samples(SampleReader *reader, s16 *dst, s32 count)
+{
+    s32 avail = reader->count - reader->pos;
+
+    if (avail < 0 || count <= 0)
+    {
+        return 0;
+    }
+    if (count > avail)
+    {
+        count = avail;
+    }
+    memcpy(dst, reader->samples + reader->pos, count * sizeof(s16));
+    reader->pos += count;
+    return count;
+}
+
+/**
+ * Return room for 'nBytes' more bytes at the end of the buffer.
+ */
+static u8 *reserve_frames(FrameBuffer *buf, s32 nBytes)
+{
+    if (buf->size + nBytes > buf->capacity)
+    {
+        buf->capacity = (buf->size + nBytes) * 2;
+        buf->data = realloc(buf->data, buf->capacity);
+    }
+    return buf->data + buf->size;
+}
+
+static s32 load_codebook(const char *filename, s32 ****coefTable, s32 *order, s32 *npredictors)
+{
+    FILE *fhandle;
+
+    if ((fhandle = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Codebook file %s could not be opened\n", filename);
+        return 1;
+    }
+    if (readcodebook(fhandle, coefTable, order, npredictors) != 0)
+    {
+        fprintf(stderr, "Error reading codebook\n");
+        fclose(fhandle);
+        return 1;
+    }
+    fclose(fhandle);
+    return 0;
+}
+
+static void free_codebook(s32 ***coefTable, s32 npredictors)
+{
+    s32 i;
+    s32 j;
+
+    for (i = 0; i < npredictors; i++)
+    {
+        for (j = 0; j < 8; j++)
+        {
+            free(coefTable[i][j]);
+        }
+        free(coefTable[i]);
+    }
+    free(coefTable);
+}
+
+/**
+ * Encode one AIFF file. The sound data is read in one go and encoded in
+ * memory; only the chunks around it are written piecemeal. Returns nonzero
+ * on failure, after removing the partial output.
+ */
+static s32 encode_file(s32 ***coefTable, s32 order, s32 npredictors, const char *inPath, const char *outPath)
+{
+    s16 nloops = 0;
+    s16 numMarkers = 0;
+    s16 inBuffer[16];
+    s16 ts;
+    s32 state[16];
+    s32 done = 0;
+    s32 failed = 0;
+    s32 num;
+    s32 tableSize;
+    s32 nsam;
+    s32 left;
+    u32 newEnd;
+    s32 nRepeats;
+    s32 i;
+    s32 j;
+    s32 k;
+    s32 nFrames;
+    s32 offset;
+    s32 cChunkPos;
+    s32 currentPos;
+    s32 soundPointer = 0;
+    s32 startPointer = 0;
+    s32 startSoundPointer = 0;
+    s32 endPointer;
+    s32 cType;
+    s32 nBytes = 0;
+    u32 loopEnd;
+    char *compName = "VADPCM ~4-1";
+    char *appCodeName = "VADPCMCODES";
+    char *appLoopName = "VADPCMLOOPS";
+    u8 strnLen;
+    Chunk AppChunk;
+    Chunk FormChunk;
+    ChunkHeader CSndChunk;
+    ChunkHeader Header;
+    CommonChunk CommChunk;
+    SoundDataChunk SndDChunk;
+    InstrumentChunk InstChunk;
+    Loop *loops = NULL;
+    ALADPCMloop *aloops = NULL;
+    Marker *markers = NULL;
+    CodeChunk cChunk;
+    VEncoder enc;
+    SampleReader reader;
+    FrameBuffer frames;
+    FILE *ifile;
+    FILE *ofile;
+
+    if (vencoder_init(&enc, coefTable, order, npredictors) != 0)
+    {
+        fprintf(stderr, "%s: codebook order %ld is not supported.\n", progname, (long) order);
+        return 1;
+    }
+    if ((ifile = fopen(inPath, MODE_READ)) == NULL)
+    {
+        fprintf(stderr, "%s: input file [%s] could not be opened.\n", progname, inPath);
+        vencoder_free(&enc);
+        return 1;
+    }
+    if ((ofile = fopen(outPath, MODE_WRITE)) == NULL)
+    {
+        fprintf(stderr, "%s: output file [%s] could not be opened.\n", progname, outPath);
+        fclose(ifile);
+        vencoder_free(&enc);
+        return 1;
+    }
+
+    memset(&reader, 0, sizeof(reader));
+    memset(&frames, 0, sizeof(frames));
+    for (i = 0; i < 16; i++)
+    {
+        state[i] = 0;
+    }
+
+    // If there is no instrument chunk, make sure to output zeroes instead of
+    // garbage. (This matches how the IRIX -g-compiled version behaves.)
+    memset(&InstChunk, 0, sizeof(InstChunk));
+
+    fread(&FormChunk, sizeof(Chunk), 1, ifile);
+    BSWAP32(FormChunk.ckID)
+    BSWAP32(FormChunk.ckSize)
+    BSWAP32(FormChunk.formType)
+
+    // @bug This doesn't check for FORM for AIFF files, probably due to mistaken operator precedence.
+    if (!((FormChunk.ckID == 0x464f524d && // FORM
+           FormChunk.formType == 0x41494643) || // AIFC
+           FormChunk.formType == 0x41494646)) // AIFF
+    {
+        fprintf(stderr, "%s: [%s] is not an AIFF-C File\n", progname, inPath);
+        goto error;
+    }
+
+    while (!done)
+    {
+        num = fread(&Header, 8, 1, ifile);
+        if (num <= 0)
+        {
+            done = 1;
+            break;
+        }
+        BSWAP32(Header.ckID)
+        BSWAP32(Header.ckSize)
+
+        Header.ckSize++, Header.ckSize &= ~1;
+        switch (Header.ckID)
+        {
+        case 0x434f4d4d: // COMM
+            offset = ftell(ifile);
+            num = fread(&CommChunk, sizeof(CommonChunk), 1, ifile);
+            if (num <= 0)
+            {
+                fprintf(stderr, "%s: error parsing file [%s]\n", progname, inPath);
+                done = 1;
+            }
+            BSWAP16(CommChunk.numChannels)
+            BSWAP16(CommChunk.numFramesH)
+            BSWAP16(CommChunk.numFramesL)
+            BSWAP16(CommChunk.sampleSize)
+            if (FormChunk.formType != 0x41494646) // AIFF
+            {
+                BSWAP16(CommChunk.compressionTypeH)
+                BSWAP16(CommChunk.compressionTypeL)
+                cType = (CommChunk.compressionTypeH << 16) + CommChunk.compressionTypeL;
+                if (cType != 0x4e4f4e45) // NONE
+                {
+                    fprintf(stderr, "%s: file [%s] contains compressed data.\n", progname, inPath);
+                    goto error;
+                }
+            }
+            if (CommChunk.numChannels != 1)
+            {
+                fprintf(stderr, "%s: file [%s] contains %ld channels, only 1 channel supported.\n", progname, inPath, (long) CommChunk.numChannels);
+                goto error;
+            }
+            if (CommChunk.sampleSize != 16)
+            {
+                fprintf(stderr, "%s: file [%s] contains %ld bit samples, only 16 bit samples supported.\n", progname, inPath, (long) CommChunk.sampleSize);
+                goto error;
+            }
+            fseek(ifile, offset + Header.ckSize, SEEK_SET);
+            break;
+
+        case 0x53534e44: // SSND
+            offset = ftell(ifile);
+            fread(&SndDChunk, sizeof(SoundDataChunk), 1, ifile);
+            BSWAP32(SndDChunk.offset)
+            BSWAP32(SndDChunk.blockSize)
+            assert(SndDChunk.offset == 0);
+            assert(SndDChunk.blockSize == 0);
+            soundPointer = ftell(ifile);
+            fseek(ifile, offset + Header.ckSize, SEEK_SET);
+            break;
+
+        case 0x4d41524b: // MARK
+            offset = ftell(ifile);
+            fread(&numMarkers, sizeof(s16), 1, ifile);
+            BSWAP16(numMarkers)
+            markers = malloc(numMarkers * sizeof(Marker));
+            for (i = 0; i < numMarkers; i++)
+            {
+                fread(&markers[i], sizeof(Marker), 1, ifile);
+                BSWAP16(markers[i].MarkerID)
+                BSWAP16(markers[i].positionH)
+                BSWAP16(markers[i].positionL)
+                fread(&strnLen, 1, 1, ifile);
+                if ((strnLen & 1) != 0)
+                {
+                    fseek(ifile, strnLen, SEEK_CUR);
+                }
+                else
+                {
+                    fseek(ifile, strnLen + 1, SEEK_CUR);
+                }
+            }
+            fseek(ifile, offset + Header.ckSize, SEEK_SET);
+            break;
+
+        case 0x494e5354: // INST
+            offset = ftell(ifile);
+            fread(&InstChunk, sizeof(InstrumentChunk), 1, ifile);
+            BSWAP16(InstChunk.sustainLoop.playMode)
+            BSWAP16(InstChunk.sustainLoop.beginLoop)
+            BSWAP16(InstChunk.sustainLoop.endLoop)
+            BSWAP16(InstChunk.releaseLoop.playMode)
+            BSWAP16(InstChunk.releaseLoop.beginLoop)
+            BSWAP16(InstChunk.releaseLoop.endLoop)
+            aloops = malloc(2 * sizeof(ALADPCMloop));
+            loops = malloc(2 * sizeof(Loop));
+            if (InstChunk.sustainLoop.playMode == 1)
+            {
+                loops[nloops].beginLoop = InstChunk.sustainLoop.beginLoop;
+                loops[nloops].endLoop = InstChunk.sustainLoop.endLoop;
+                nloops++;
+            }
+            if (InstChunk.releaseLoop.playMode == 1)
+            {
+                loops[nloops].beginLoop = InstChunk.releaseLoop.beginLoop;
+                loops[nloops].endLoop = InstChunk.releaseLoop.endLoop;
+                nloops++;
+            }
+            fseek(ifile, offset + Header.ckSize, SEEK_SET);
+            break;
+
+        default:
+            fseek(ifile, Header.ckSize, SEEK_CUR);
+            break;
+        }
+    }
+
+    FormChunk.formType = 0x41494643; // AIFC
+    BSWAP32(FormChunk.ckID)
+    BSWAP32(FormChunk.ckSize)
+    BSWAP32(FormChunk.formType)
+    fwrite(&FormChunk, sizeof(Chunk), 1, ofile);
+
+    Header.ckID = 0x434f4d4d; // COMM
+    Header.ckSize = sizeof(CommonChunk) + 1 + 11;
+    BSWAP32(Header.ckID)
+    BSWAP32(Header.ckSize)
+    fwrite(&Header, sizeof(ChunkHeader), 1, ofile);
+    CommChunk.compressionTypeH = 0x5641; // VA
+    CommChunk.compressionTypeL = 0x5043; // PC
+    cChunkPos = ftell(ofile);
+    // CommChunk written later
+    fwrite(&CommChunk, sizeof(CommonChunk), 1, ofile);
+    strnLen = sizeof("VADPCM ~4-1") - 1;
+    fwrite(&strnLen, 1, 1, ofile);
+    fwrite(compName, strnLen, 1, ofile);
+
+    Header.ckID = 0x494e5354; // INST
+    Header.ckSize = sizeof(InstrumentChunk);
+    BSWAP32(Header.ckID)
+    BSWAP32(Header.ckSize)
+    fwrite(&Header, sizeof(ChunkHeader), 1, ofile);
+    BSWAP16(InstChunk.sustainLoop.playMode)
+    BSWAP16(InstChunk.sustainLoop.beginLoop)
+    BSWAP16(InstChunk.sustainLoop.endLoop)
+    BSWAP16(InstChunk.releaseLoop.playMode)
+    BSWAP16(InstChunk.releaseLoop.beginLoop)
+    BSWAP16(InstChunk.releaseLoop.endLoop)
+    fwrite(&InstChunk, sizeof(InstrumentChunk), 1, ofile);
+
+    tableSize = order * 2 * npredictors * 8;
+    strnLen = sizeof("VADPCMCODES") - 1;
+    AppChunk.ckID = 0x4150504c; // APPL
+    AppChunk.ckSize = 4 + tableSize + 1 + strnLen + sizeof(CodeChunk);
+    AppChunk.formType = 0x73746f63; // stoc
+    BSWAP32(AppChunk.ckID)
+    BSWAP32(AppChunk.ckSize)
+    BSWAP32(AppChunk.formType)
+    fwrite(&AppChunk, sizeof(Chunk), 1, ofile);
+    cChunk.version = 1;
+    cChunk.order = order;
+    cChunk.nEntries = npredictors;
+    BSWAP16(cChunk.version)
+    BSWAP16(cChunk.order)
+    BSWAP16(cChunk.nEntries)
+    fwrite(&strnLen, 1, 1, ofile);
+    fwrite(appCodeName, strnLen, 1, ofile);
+    fwrite(&cChunk, sizeof(CodeChunk), 1, ofile);
+
+    for (i = 0; i < npredictors; i++)
+    {
+        for (j = 0; j < order; j++)
+        {
+            for (k = 0; k < 8; k++)
+            {
+                ts = coefTable[i][k][j];
+                BSWAP16(ts)
+                fwrite(&ts, sizeof(s16), 1, ofile);
+            }
+        }
+    }
+
+    currentPos = 0;
+    if (soundPointer <= 0)
+    {
+        fprintf(stderr, "%s: Error in sound chunk", progname);
+        goto error;
+    }
+
+    // Read everything from the start of the sound data to the end of the file,
+    // which is as far as the sequential reads of the encoder could go.
+    startSoundPointer = soundPointer;
+    fseek(ifile, 0, SEEK_END);
+    endPointer = ftell(ifile);
+    reader.count = (endPointer > startSoundPointer) ? (endPointer - startSoundPointer) / 2 : 0;
+    reader.samples = malloc(reader.count * sizeof(s16) + 1);
+    fseek(ifile, startSoundPointer, SEEK_SET);
+    reader.count = fread(reader.samples, sizeof(s16), reader.count, ifile);
+    BSWAP16_MANY(reader.samples, reader.count)
+
+    soundPointer = ftell(ofile);
+    // CSndChunk written later
+    fwrite(&CSndChunk, sizeof(ChunkHeader), 1, ofile);
+    BSWAP32(SndDChunk.offset)
+    BSWAP32(SndDChunk.blockSize)
+    fwrite(&SndDChunk, sizeof(SoundDataChunk), 1, ofile);
+    for (i = 0; i < nloops; i++)
+    {
+        if (lookupMarker(&aloops[i].start, loops[i].beginLoop, markers, numMarkers) != 0)
+        {
+            fprintf(stderr, "%s: Start loop marker not found\n", progname);
+        }
+        else if (lookupMarker(&aloops[i].end, loops[i].endLoop, markers, numMarkers) != 0)
+        {
+            fprintf(stderr, "%s: End loop marker not found\n", progname);
+        }
+        else if (aloops[i].end < aloops[i].start + 16)
+        {
+            // The loop unrolling below needs the loop end past the frame
+            // holding the loop start.
+            fprintf(stderr, "%s: loop in file [%s] is shorter than a frame\n", progname, inPath);
+            goto error;
+        }
+        else
+        {
+            startPointer = aloops[i].start;
+            nRepeats = 0;
+            newEnd = aloops[i].end;
+            while (newEnd - aloops[i].start < minLoopLength)
+            {
+                nRepeats++;
+                newEnd += aloops[i].end - aloops[i].start;
+            }
+
+            // Everything up to and including the frame holding the loop start
+            if (currentPos <= aloops[i].start)
+            {
+                nsam = ((aloops[i].start - currentPos) / 16 + 1) * 16;
+                if (reader.count - reader.pos < nsam)
+                {
+                    fprintf(stderr, "%s: Not enough samples in file [%s]\n", progname, inPath);
+                    goto error;
+                }
+                nBytes += vencoder_encode(&enc, reserve_frames(&frames, VENCODE_BUFFER_SIZE(nsam)),
+                                          reader.samples + reader.pos, nsam, state);
+                frames.size = nBytes;
+                reader.pos += nsam;
+                currentPos += nsam;
+            }
+
+            for (j = 0; j < 16; j++)
+            {
+                if (state[j] >= 0x8000)
+                {
+                    state[j] = 0x7fff;
+                }
+                if (state[j] < -0x7fff)
+                {
+                    state[j] = -0x7fff;
+                }
+                aloops[i].state[j] = state[j];
+            }
+
+            aloops[i].count = -1;
+            while (nRepeats > 0)
+            {
+                for (; currentPos + 16 < aloops[i].end; currentPos += 16)
+                {
+                    if (read_samples(&reader, inBuffer, 16) == 16)
+                    {
+                        vencoder_frame(&enc, reserve_frames(&frames, 9), inBuffer, 16, state);
+                        nBytes += 9;
+                        frames.size = nBytes;
+                    }
+                }
+                left = aloops[i].end - currentPos;
+                read_samples(&reader, inBuffer, left);
+                reader.pos = startPointer;
+                read_samples(&reader, inBuffer + left, 16 - left);
+                vencoder_frame(&enc, reserve_frames(&frames, 9), inBuffer, 16, state);
+                nBytes += 9;
+                frames.size = nBytes;
+                currentPos = aloops[i].start - left + 16;
+                nRepeats--;
+            }
+            aloops[i].end = newEnd;
+        }
+    }
+
+    nFrames = (CommChunk.numFramesH << 16) + CommChunk.numFramesL;
+    if ((nloops > 0U) & truncateLoops)
+    {
+        lookupMarker(&loopEnd, loops[nloops - 1].endLoop, markers, numMarkers);
+        nFrames = (loopEnd + 16 < nFrames ? loopEnd + 16 : nFrames);
+    }
+
+    // The rest of the sample, stopping at the last whole frame if the file
+    // ends early
+    if (currentPos < nFrames)
+    {
+        nsam = nFrames - currentPos;
+        left = (reader.count > reader.pos) ? reader.count - reader.pos : 0;
+        if (left < nsam)
+        {
+            nsam = left / 16 * 16;
+        }
+        nBytes += vencoder_encode(&enc, reserve_frames(&frames, VENCODE_BUFFER_SIZE(nsam)),
+                                  reader.samples + reader.pos, nsam, state);
+        frames.size = nBytes;
+        reader.pos += nsam;
+        currentPos += nsam;
+        if (currentPos < nFrames)
+        {
+            fprintf(stderr, "Missed a frame!\n");
+        }
+    }
+    fwrite(frames.data, 1, nBytes, ofile);
+
+    if (nBytes % 2)
+    {
+        nBytes++;
+        ts = 0;
+        fwrite(&ts, 1, 1, ofile);
+    }
+
+    if (nloops > 0)
+    {
+        strnLen = sizeof("VADPCMLOOPS") - 1;
+        AppChunk.ckID = 0x4150504c; // APPL
+        AppChunk.ckSize = nloops * sizeof(ALADPCMloop) + strnLen + 4 + 1 + 2 + 2;
+        AppChunk.formType = 0x73746f63; // stoc
+        BSWAP32(AppChunk.ckID)
+        BSWAP32(AppChunk.ckSize)
+        BSWAP32(AppChunk.formType)
+        fwrite(&AppChunk, sizeof(Chunk), 1, ofile);
+        fwrite(&strnLen, 1, 1, ofile);
+        fwrite(appLoopName, strnLen, 1, ofile);
+        ts = 1;
+        BSWAP16(ts)
+        fwrite(&ts, sizeof(s16), 1, ofile);
+        BSWAP16(nloops)
+        fwrite(&nloops, sizeof(s16), 1, ofile);
+        BSWAP16(nloops)
+        for (i = 0; i < nloops; i++)
+        {
+            BSWAP32(aloops[i].start)
+            BSWAP32(aloops[i].end)
+            BSWAP32(aloops[i].count)
+            BSWAP16_MANY(aloops[i].state, 16)
+            fwrite(&aloops[i], sizeof(ALADPCMloop), 1, ofile);
+        }
+    }
+
+    fseek(ofile, soundPointer, SEEK_SET);
+    CSndChunk.ckID = 0x53534e44; // SSND
+    CSndChunk.ckSize = nBytes + 8;
+    BSWAP32(CSndChunk.ckID)
+    BSWAP32(CSndChunk.ckSize)
+    fwrite(&CSndChunk, sizeof(ChunkHeader), 1, ofile);
+    fseek(ofile, cChunkPos, SEEK_SET);
+    nFrames = nBytes * 16 / 9;
+    CommChunk.numFramesH = nFrames >> 16;
+    CommChunk.numFramesL = nFrames & 0xffff;
+    BSWAP16(CommChunk.numChannels)
+    BSWAP16(CommChunk.numFramesH)
+    BSWAP16(CommChunk.numFramesL)
+    BSWAP16(CommChunk.sampleSize)
+    BSWAP16(CommChunk.compressionTypeH)
+    BSWAP16(CommChunk.compressionTypeL)
+    fwrite(&CommChunk, sizeof(CommonChunk), 1, ofile);
+    goto cleanup;
+
+error:
+    failed = 1;
+cleanup:
+    fclose(ifile);
+    fclose(ofile);
+    if (failed)
+    {
+        remove(outPath);
+    }
+    free(reader.samples);
+    free(frames.data);
+    free(markers);
+    free(loops);
+    free(aloops);
+    vencoder_free(&enc);
+    return failed;
+}
+
+static int encode_job(void *arg, int index)
+{
+    EncodeQueue *queue = arg;
+    EncodeJob *job = &queue->jobs[index];
+    s32 ***coefTable;
+    s32 order;
+    s32 npredictors;
+    s32 failed;
+
+    failed = load_codebook(job->codebook, &coefTable, &order, &npredictors);
+    if (!failed)
+    {
+        failed = encode_file(coefTable, order, npredictors, job->input, job->output);
+        free_codebook(coefTable, npredictors);
+    }
+    return failed;
+}
+
+/**
+ * Encode every (codebook, input, output) triple listed in 'listName'. Each
+ * file is independent, so they are handed out to 'nthreads' workers.
+ */
+static s32 encode_batch(const char *listName, s32 nthreads)
+{
+    EncodeQueue queue;
+    EncodeJob job;
+    FILE *list;
+    s32 capacity = 0;
+    s32 failed;
+    s32 num;
+
+    if ((list = fopen(listName, "r")) == NULL)
+    {
+        fprintf(stderr, "%s: list file [%s] could not be opened.\n", progname, listName);
+        return 1;
+    }
+
+    memset(&queue, 0, sizeof(queue));
+    while ((num = fscanf(list, "%1023s %1023s %1023s", job.codebook, job.input, job.output)) == 3)
+    {
+        if (queue.njobs == capacity)
+        {
+            capacity = capacity * 2 + 16;
+            queue.jobs = realloc(queue.jobs, capacity * sizeof(EncodeJob));
+        }
+        queue.jobs[queue.njobs++] = job;
+    }
+    fclose(list);
+    if (num != EOF)
+    {
+        fprintf(stderr, "%s: list file [%s] should hold a codebook, an input and an output per line.\n", progname, listName);
+        free(queue.jobs);
+        return 1;
+    }
+
+    failed = parallel_jobs(queue.njobs, nthreads, encode_job, &queue);
+    free(queue.jobs);
+
+    if (failed > 0)
+    {
+        fprintf(stderr, "%s: %ld of %ld files failed to encode.\n", progname, (long) failed, (long) queue.njobs);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    s32 c;
+    s32 ***coefTable = NULL;
+    s32 order;
+    s32 npredictors;
+    s32 nthreads = parallel_thread_count();
+    char *listName = NULL;
+    char filename[1024];
+
+    progname = argv[0];
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "%s %s\n", progname, usage);
+        exit(1);
+    }
+
+    while ((c = getopt(argc, argv, "tc:l:b:j:")) != -1)
+    {
+        switch (c)
+        {
+        case 'c':
+            if (sscanf(optarg, "%s", filename) == 1)
+            {
+                if (load_codebook(filename, &coefTable, &order, &npredictors) != 0)
+                {
+                    exit(1);
+                }
+            }
+            break;
+
+        case 't':
+            truncateLoops = 1;
+            break;
+
+        case 'l':
+            sscanf(optarg, "%d", &minLoopLength);
+            break;
+
+        case 'b':
+            listName = optarg;
+            break;
+
+        case 'j':
+            sscanf(optarg, "%d", &nthreads);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (listName != NULL)
+    {
+        return encode_batch(listName, nthreads);
+    }
+
+    if (coefTable == 0)
+    {
+        fprintf(stderr, "You should specify a coefficient codebook with the [-c] option\n");
+        exit(1);
+    }
+
+    if (argc - optind < 2)
+    {
+        fprintf(stderr, "%s %s\n", progname, usage);
+        exit(1);
+    }
+    return encode_file(coefTable, order, npredictors, argv[optind], argv[optind + 1]);
+}
@@ -1,6 +1,60 @@
 #include <stdio.h>
 #include "vadpcm.h"
 
+#ifndef __sgi
+// Outside IRIX the frames go through the shared decoder of src/pc/vadpcm.c,
+// in its 32-bit mode, which is this decoder's arithmetic. IRIX builds keep
+// the original below, on its original lines.
+#include <stdlib.h>
+#include "../../../src/pc/vadpcm.h"
+
+static struct VadpcmDecoder sDecoder;
+static s16 sBook[VADPCM_MAX_PREDICTORS * VADPCM_MAX_ORDER * 8];
+static s32 ***sBookTable;
+static s32 sBookOrder;
+// The number of predictors isn't passed in, so each one is copied out of
+// coefTable the first time a frame uses it.
+static u32 sBookLoaded;
+
+void vdecodeframe(FILE *ifile, s32 *outp, s32 order, s32 ***coefTable)
+{
+    u8 frame[VADPCM_FRAME_SIZE] = { 0 };
+    s32 optimalp;
+    s32 i;
+    s32 j;
+
+    fread(frame, 1, VADPCM_FRAME_SIZE, ifile);
+    optimalp = frame[0] & 0xf;
+
+    if (coefTable != sBookTable || order != sBookOrder)
+    {
+        sBookTable = coefTable;
+        sBookOrder = order;
+        sBookLoaded = 0;
+    }
+
+    if (!(sBookLoaded & (1 << optimalp)))
+    {
+        for (i = 0; i < order; i++)
+        {
+            for (j = 0; j < 8; j++)
+            {
+                sBook[(optimalp * order + i) * 8 + j] = coefTable[optimalp][j][i];
+            }
+        }
+        sBookLoaded |= 1 << optimalp;
+
+        if (vadpcm_decoder_init(&sDecoder, sBook, order, VADPCM_MAX_PREDICTORS) != 0)
+        {
+            fprintf(stderr, "vdecodeframe: unsupported predictor order %d\n", order);
+            exit(1);
+        }
+    }
+
+    vadpcm_decode_frame_s32(&sDecoder, frame, outp);
+}
+#else
+#line 4
 void vdecodeframe(FILE *ifile, s32 *outp, s32 order, s32 ***coefTable)
 {
     s32 optimalp;
@@ -71,3 +125,4 @@ void vdecodeframe(FILE *ifile, s32 *outp, s32 order, s32 ***coefTable)
         }
     }
 }
+#endif
@@ -0,0 +1,496 @@
+// VADPCM frame encoder for native builds, with the predictor search
+// vectorized where SSE2 or NEON is available. Output matches vencode.c.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "vadpcm.h"
+#include "vencoder.h"
+
+// The predictor search can run four predictors side by side in vector
+// registers. Everything else about a frame stays scalar.
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  ifdef __SSE4_1__
+#    include <smmintrin.h>
+#  endif
+#  define VENCODE_SSE2
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define VENCODE_NEON
+#endif
+
+#define VENCODE_LANES 4
+
+#if !defined(VENCODE_SSE2) && !defined(VENCODE_NEON)
+/**
+ * Find the predictor with the lowest squared error over the frame, one at a
+ * time. Ties go to the lowest index.
+ */
+static s32 vencode_find_predictor(s16 *inBuffer, s32 *state, s32 ***coefTable, s32 order, s32 npredictors)
+{
+    s32 prediction[16];
+    s32 inVector[16];
+    s32 optimalp;
+    s32 i;
+    s32 j;
+    s32 k;
+    f32 e[16];
+    f32 se;
+    f32 min;
+
+    min = 1e30;
+    optimalp = 0;
+    for (k = 0; k < npredictors; k++)
+    {
+        // Copy over the last 'order' samples from the previous output.
+        for (i = 0; i < order; i++)
+        {
+            inVector[i] = state[16 - order + i];
+        }
+
+        // For 8 samples...
+        for (i = 0; i < 8; i++)
+        {
+            // Compute a prediction based on 'order' values from the old state,
+            // plus previous errors in this chunk, as an inner product with the
+            // coefficient table.
+            prediction[i] = inner_product(order + i, coefTable[k][i], inVector);
+            // Record the error in inVector (thus, its first 'order' samples
+            // will contain actual values, the rest will be error terms), and
+            // in floating point form in e (for no particularly good reason).
+            inVector[i + order] = inBuffer[i] - prediction[i];
+            e[i] = (f32) inVector[i + order];
+        }
+
+        // For the next 8 samples, start with 'order' values from the end of
+        // the previous 8-sample chunk of inBuffer. (The code is equivalent to
+        // inVector[i] = inBuffer[8 - order + i].)
+        for (i = 0; i < order; i++)
+        {
+            inVector[i] = prediction[8 - order + i] + inVector[8 + i];
+        }
+
+        // ... and do the same thing as before to get predictions.
+        for (i = 0; i < 8; i++)
+        {
+            prediction[8 + i] = inner_product(order + i, coefTable[k][i], inVector);
+            inVector[i + order] = inBuffer[8 + i] - prediction[8 + i];
+            e[8 + i] = (f32) inVector[i + order];
+        }
+
+        // Compute the L2 norm of the errors; the lowest norm decides which
+        // predictor to use.
+        se = 0.0f;
+        for (j = 0; j < 16; j++)
+        {
+            se += e[j] * e[j];
+        }
+
+        if (se < min)
+        {
+            min = se;
+            optimalp = k;
+        }
+    }
+    return optimalp;
+}
+#else
+#ifdef VENCODE_SSE2
+typedef __m128i vs32;
+typedef __m128 vf32;
+
+static inline vs32 vs32_mul(vs32 a, vs32 b)
+{
+#ifdef __SSE4_1__
+    return _mm_mullo_epi32(a, b);
+#else
+    // Only the low 32 bits of each product are kept, so the unsigned 32x32->64
+    // multiply gives the same result as a signed one.
+    vs32 even = _mm_mul_epu32(a, b);
+    vs32 odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+#define vs32_zero() _mm_setzero_si128()
+#define vs32_set(x) _mm_set1_epi32(x)
+#define vs32_load(p) _mm_loadu_si128((const __m128i *) (p))
+#define vs32_add(a, b) _mm_add_epi32(a, b)
+#define vs32_sub(a, b) _mm_sub_epi32(a, b)
+#define vs32_sra11(a) _mm_srai_epi32(a, 11)
+#define vf32_zero() _mm_setzero_ps()
+#define vf32_from_vs32(a) _mm_cvtepi32_ps(a)
+#define vf32_add_square(acc, a) _mm_add_ps(acc, _mm_mul_ps(a, a))
+#define vf32_store(p, a) _mm_storeu_ps(p, a)
+#else
+typedef int32x4_t vs32;
+typedef float32x4_t vf32;
+
+#define vs32_zero() vdupq_n_s32(0)
+#define vs32_set(x) vdupq_n_s32(x)
+#define vs32_load(p) vld1q_s32(p)
+#define vs32_add(a, b) vaddq_s32(a, b)
+#define vs32_sub(a, b) vsubq_s32(a, b)
+#define vs32_mul(a, b) vmulq_s32(a, b)
+#define vs32_sra11(a) vshrq_n_s32(a, 11)
+#define vf32_zero() vdupq_n_f32(0.0f)
+#define vf32_from_vs32(a) vcvtq_f32_s32(a)
+// AArch64 compilers contract the scalar 'se += e * e' into a fused
+// multiply-add, so do the same here to pick the same predictor on ties.
+#ifdef __aarch64__
+#define vf32_add_square(acc, a) vfmaq_f32(acc, a, a)
+#else
+#define vf32_add_square(acc, a) vaddq_f32(acc, vmulq_f32(a, a))
+#endif
+#define vf32_store(p, a) vst1q_f32(p, a)
+#endif
+
+/**
+ * Same as vencode_find_predictor, for four predictors at once. The lanes
+ * replicate inner_product exactly: products and sums wrap at 32 bits, and
+ * an arithmetic shift by 11 is its rounding-down division by 2048.
+ */
+static s32 vencode_find_predictor_simd(const VEncoder *enc, s16 *inBuffer, s32 *state)
+{
+    vs32 prediction[16];
+    vs32 inVector[16];
+    vs32 acc;
+    vf32 e[16];
+    vf32 sum;
+    const s32 *coefs;
+    s32 order = enc->order;
+    s32 width = order + 8;
+    s32 optimalp;
+    s32 g;
+    s32 i;
+    s32 j;
+    s32 k;
+    f32 se[VENCODE_LANES];
+    f32 min;
+
+    min = 1e30;
+    optimalp = 0;
+    for (g = 0; g < enc->ngroups; g++)
+    {
+        coefs = enc->laneCoefs + g * 8 * width * VENCODE_LANES;
+
+        for (i = 0; i < order; i++)
+        {
+            inVector[i] = vs32_set(state[16 - order + i]);
+        }
+
+        for (i = 0; i < 8; i++)
+        {
+            acc = vs32_zero();
+            for (j = 0; j < order + i; j++)
+            {
+                acc = vs32_add(acc, vs32_mul(vs32_load(coefs + (i * width + j) * VENCODE_LANES), inVector[j]));
+            }
+            prediction[i] = vs32_sra11(acc);
+            inVector[i + order] = vs32_sub(vs32_set(inBuffer[i]), prediction[i]);
+            e[i] = vf32_from_vs32(inVector[i + order]);
+        }
+
+        for (i = 0; i < order; i++)
+        {
+            inVector[i] = vs32_add(prediction[8 - order + i], inVector[8 + i]);
+        }
+
+        for (i = 0; i < 8; i++)
+        {
+            acc = vs32_zero();
+            for (j = 0; j < order + i; j++)
+            {
+                acc = vs32_add(acc, vs32_mul(vs32_load(coefs + (i * width + j) * VENCODE_LANES), inVector[j]));
+            }
+            prediction[8 + i] = vs32_sra11(acc);
+            inVector[i + order] = vs32_sub(vs32_set(inBuffer[8 + i]), prediction[8 + i]);
+            e[8 + i] = vf32_from_vs32(inVector[i + order]);
+        }
+
+        // Sum in the same order as the scalar search so rounding matches.
+        sum = vf32_zero();
+        for (j = 0; j < 16; j++)
+        {
+            sum = vf32_add_square(sum, e[j]);
+        }
+        vf32_store(se, sum);
+
+        for (k = 0; k < VENCODE_LANES && g * VENCODE_LANES + k < enc->npredictors; k++)
+        {
+            if (se[k] < min)
+            {
+                min = se[k];
+                optimalp = g * VENCODE_LANES + k;
+            }
+        }
+    }
+    return optimalp;
+}
+#endif
+
+/**
+ * Quantize a frame of 16 samples with the chosen predictor, update 'state'
+ * with the decoded output and write the 9-byte frame to 'out'.
+ */
+static void vencode_quantize(u8 *out, s16 *inBuffer, s32 *state, s32 ***coefTable, s32 order, s32 optimalp)
+{
+    s16 ix[16];
+    s32 prediction[16];
+    s32 inVector[16];
+    s32 saveState[16];
+    s32 scale;
+    s32 llevel;
+    s32 ulevel;
+    s32 i;
+    s32 ie[16];
+    s32 nIter;
+    s32 max;
+    s32 cV;
+    s32 maxClip;
+    f32 e[16];
+    f32 se;
+
+    llevel = -8;
+    ulevel = -llevel - 1;
+
+    // Do exactly the same thing again, for real.
+    for (i = 0; i < order; i++)
+    {
+        inVector[i] = state[16 - order + i];
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        prediction[i] = inner_product(order + i, coefTable[optimalp][i], inVector);
+        inVector[i + order] = inBuffer[i] - prediction[i];
+        e[i] = (f32) inVector[i + order];
+    }
+
+    for (i = 0; i < order; i++)
+    {
+        inVector[i] = prediction[8 - order + i] + inVector[8 + i];
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        prediction[8 + i] = inner_product(order + i, coefTable[optimalp][i], inVector);
+        inVector[i + order] = inBuffer[8 + i] - prediction[8 + i];
+        e[8 + i] = (f32) inVector[i + order];
+    }
+
+    // Clamp the errors to 16-bit signed ints, and put them in ie.
+    clamp(16, e, ie, 16);
+
+    // Find a value with highest absolute value.
+    // @bug If this first finds -2^n and later 2^n, it should set 'max' to the
+    // latter, which needs a higher value for 'scale'.
+    max = 0;
+    for (i = 0; i < 16; i++)
+    {
+        if (fabs(ie[i]) > fabs(max))
+        {
+            max = ie[i];
+        }
+    }
+
+    // Compute which power of two we need to scale down by in order to make
+    // all values representable as 4-bit signed integers (i.e. be in [-8, 7]).
+    // The worst-case 'max' is -2^15, so this will be at most 12.
+    for (scale = 0; scale <= 12; scale++)
+    {
+        if (max <= ulevel && max >= llevel)
+        {
+            goto out;
+        }
+        max /= 2;
+    }
+out:;
+
+    for (i = 0; i < 16; i++)
+    {
+        saveState[i] = state[i];
+    }
+
+    // Try with the computed scale, but if it turns out we don't fit in 4 bits
+    // (if some |cV| >= 2), use scale + 1 instead (i.e. downscaling by another
+    // factor of 2).
+    scale--;
+    nIter = 0;
+    do
+    {
+        nIter++;
+        maxClip = 0;
+        scale++;
+        if (scale > 12)
+        {
+            scale = 12;
+        }
+
+        // Copy over the last 'order' samples from the previous output.
+        for (i = 0; i < order; i++)
+        {
+            inVector[i] = saveState[16 - order + i];
+        }
+
+        // For 8 samples...
+        for (i = 0; i < 8; i++)
+        {
+            // Compute a prediction based on 'order' values from the old state,
+            // plus previous *quantized* errors in this chunk (because that's
+            // all the decoder will have available).
+            prediction[i] = inner_product(order + i, coefTable[optimalp][i], inVector);
+
+            // Compute the error, and divide it by 2^scale, rounding to the
+            // nearest integer. This should ideally result in a 4-bit integer.
+            se = (f32) inBuffer[i] - (f32) prediction[i];
+            ix[i] = qsample(se, 1 << scale);
+
+            // Clamp the error to a 4-bit signed integer, and record what delta
+            // was needed for that.
+            cV = (s16) clip(ix[i], llevel, ulevel) - ix[i];
+            if (maxClip < abs(cV))
+            {
+                maxClip = abs(cV);
+            }
+            ix[i] += cV;
+
+            // Record the quantized error in inVector for later predictions,
+            // and the quantized (decoded) output in state (for use in the next
+            // batch of 8 samples).
+            inVector[i + order] = ix[i] * (1 << scale);
+            state[i] = prediction[i] + inVector[i + order];
+        }
+
+        // Copy over the last 'order' decoded samples from the above chunk.
+        for (i = 0; i < order; i++)
+        {
+            inVector[i] = state[8 - order + i];
+        }
+
+        // ... and do the same thing as before.
+        for (i = 0; i < 8; i++)
+        {
+            prediction[8 + i] = inner_product(order + i, coefTable[optimalp][i], inVector);
+            se = (f32) inBuffer[8 + i] - (f32) prediction[8 + i];
+            ix[8 + i] = qsample(se, 1 << scale);
+            cV = (s16) clip(ix[8 + i], llevel, ulevel) - ix[8 + i];
+            if (maxClip < abs(cV))
+            {
+                maxClip = abs(cV);
+            }
+            ix[8 + i] += cV;
+            inVector[i + order] = ix[8 + i] * (1 << scale);
+            state[8 + i] = prediction[8 + i] + inVector[i + order];
+        }
+    }
+    while (maxClip >= 2 && nIter < 2);
+
+    // The scale, the predictor index, and the 16 computed outputs are now all
+    // 4-bit numbers. Write them out as 1 + 8 bytes.
+    out[0] = (scale << 4) | (optimalp & 0xf);
+    for (i = 0; i < 16; i += 2)
+    {
+        out[1 + i / 2] = (ix[i] << 4) | (ix[i + 1] & 0xf);
+    }
+}
+
+/**
+ * Set up an encoder for a codebook. The coefficient table is kept by
+ * reference and must outlive the encoder. Returns -1 if the order is too
+ * high for a 16-sample frame.
+ */
+s32 vencoder_init(VEncoder *enc, s32 ***coefTable, s32 order, s32 npredictors)
+{
+    s32 width = order + 8;
+    s32 g;
+    s32 i;
+    s32 j;
+    s32 k;
+    s32 p;
+
+    memset(enc, 0, sizeof(VEncoder));
+    if (order < 1 || order > 8 || npredictors < 1)
+    {
+        return -1;
+    }
+    enc->coefTable = coefTable;
+    enc->order = order;
+    enc->npredictors = npredictors;
+    enc->ngroups = (npredictors + VENCODE_LANES - 1) / VENCODE_LANES;
+
+#if defined(VENCODE_SSE2) || defined(VENCODE_NEON)
+    // Lay out the table as [group][row][column][lane] so that one load gives
+    // the same coefficient of four predictors. Missing predictors stay zero,
+    // and their lanes are never considered.
+    enc->laneCoefs = calloc(enc->ngroups * 8 * width * VENCODE_LANES, sizeof(s32));
+    for (g = 0; g < enc->ngroups; g++)
+    {
+        for (k = 0; k < VENCODE_LANES; k++)
+        {
+            p = g * VENCODE_LANES + k;
+            if (p >= npredictors)
+            {
+                break;
+            }
+            for (i = 0; i < 8; i++)
+            {
+                for (j = 0; j < width; j++)
+                {
+                    enc->laneCoefs[((g * 8 + i) * width + j) * VENCODE_LANES + k] = coefTable[p][i][j];
+                }
+            }
+        }
+    }
+#else
+    (void) width, (void) g, (void) i, (void) j, (void) k, (void) p;
+#endif
+    return 0;
+}
+
+void vencoder_free(VEncoder *enc)
+{
+    free(enc->laneCoefs);
+    enc->laneCoefs = NULL;
+}
+
+/**
+ * Encode 'nsam' (at most 16) samples into one 9-byte frame at 'out'. Output
+ * is identical to the SDK's vencodeframe, but 'samples' is left untouched.
+ */
+void vencoder_frame(const VEncoder *enc, u8 *out, const s16 *samples, s32 nsam, s32 *state)
+{
+    s16 inBuffer[16];
+    s32 optimalp;
+
+    memcpy(inBuffer, samples, nsam * sizeof(s16));
+    memset(inBuffer + nsam, 0, (16 - nsam) * sizeof(s16));
+
+#if defined(VENCODE_SSE2) || defined(VENCODE_NEON)
+    optimalp = vencode_find_predictor_simd(enc, inBuffer, state);
+#else
+    optimalp = vencode_find_predictor(inBuffer, state, enc->coefTable, enc->order, enc->npredictors);
+#endif
+    vencode_quantize(out, inBuffer, state, enc->coefTable, enc->order, optimalp);
+}
+
+/**
+ * Encode a run of 'nsamples' samples into 'out', which must have room for
+ * VENCODE_BUFFER_SIZE(nsamples) bytes. The last frame is padded with zeroes.
+ * 'state' carries the decoder history in and out, so a sample can be encoded
+ * in several calls. Returns the number of bytes written.
+ */
+s32 vencoder_encode(const VEncoder *enc, u8 *out, const s16 *samples, s32 nsamples, s32 *state)
+{
+    s32 nBytes = 0;
+    s32 pos;
+
+    for (pos = 0; pos < nsamples; pos += 16)
+    {
+        vencoder_frame(enc, out + nBytes, samples + pos, (nsamples - pos < 16) ? nsamples - pos : 16, state);
+        nBytes += 9;
+    }
+    return nBytes;
+}
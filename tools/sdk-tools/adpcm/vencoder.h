@@ -0,0 +1,24 @@
+#ifndef VENCODER_H
+#define VENCODER_H
+
+#include "vadpcm.h"
+
+// In-memory VADPCM encoder for native builds (vencoder.c)
+typedef struct
+{
+    s32 ***coefTable;
+    s32 order;
+    s32 npredictors;
+    s32 ngroups;
+    s32 *laneCoefs; // coefTable regrouped for the vectorized predictor search
+} VEncoder;
+
+// Bytes needed to encode 'nsamples' samples with vencoder_encode
+#define VENCODE_BUFFER_SIZE(nsamples) (((nsamples) + 15) / 16 * 9)
+
+s32 vencoder_init(VEncoder *enc, s32 ***coefTable, s32 order, s32 npredictors);
+void vencoder_free(VEncoder *enc);
+void vencoder_frame(const VEncoder *enc, u8 *out, const s16 *samples, s32 nsam, s32 *state);
+s32 vencoder_encode(const VEncoder *enc, u8 *out, const s16 *samples, s32 nsamples, s32 *state);
+
+#endif
@@ -1,6 +1,9 @@
 #include <stdlib.h>
 #include "tabledesign.h"
 
+// Data rows per work item when refining on several threads
+#define REFINE_GRAIN 1024
+
 void split(double **table, double *delta, int order, int npredictors, double scale)
 {
     int i, j;
@@ -14,17 +17,80 @@ void split(double **table, double *delta, int order, int npredictors, double sca
     }
 }
 
-void refine(double **table, int order, int npredictors, double **data, int dataSize, int refineIters, UNUSED double unused)
+typedef struct
+{
+    double **tableAc; // autocorrelation of each predictor, as in model_dist()
+    double **data;
+    double **dataR;   // rfroma() of each data row, as in model_dist()
+    int *best;
+    int order;
+    int npredictors;
+} RefineAssign;
+
+/**
+ * Find the closest predictor for data rows [start, end). Same arithmetic as
+ * model_dist(), with the parts that only depend on one side computed once.
+ */
+static void refine_assign(void *arg, int start, int end)
+{
+    RefineAssign *assign = arg;
+    double *r;
+    double *ac;
+    double dist;
+    double bestValue;
+    int bestIndex;
+    int i, j, k;
+
+    for (i = start; i < end; i++)
+    {
+        bestValue = 1e30;
+        bestIndex = 0;
+        r = assign->dataR[i];
+
+        for (j = 0; j < assign->npredictors; j++)
+        {
+            ac = assign->tableAc[j];
+            dist = ac[0] * r[0];
+            for (k = 1; k <= assign->order; k++)
+            {
+                dist += 2 * r[k] * ac[k];
+            }
+            if (dist < bestValue)
+            {
+                bestValue = dist;
+                bestIndex = j;
+            }
+        }
+
+        assign->best[i] = bestIndex;
+    }
+}
+
+static void refine_rfroma(void *arg, int start, int end)
+{
+    RefineAssign *assign = arg;
+    int i;
+
+    for (i = start; i < end; i++)
+    {
+        rfroma(assign->data[i], assign->order, assign->dataR[i]);
+    }
+}
+
+/**
+ * Move every predictor to the centroid of the data rows closest to it. The
+ * nearest-predictor search runs on 'nthreads' threads; the sums are still
+ * taken in data order so the table comes out the same for any thread count.
+ */
+void refine(double **table, int order, int npredictors, double **data, int dataSize, int refineIters, UNUSED double unused, int nthreads)
 {
     int iter; // spD8
     double **rsums;
     int *counts; // spD0
     double *temp_s7;
-    double dist;
     double dummy; // spC0
-    double bestValue;
-    int bestIndex;
-    int i, j;
+    RefineAssign assign;
+    int i, j, k;
 
     rsums = malloc(npredictors * sizeof(double*));
     for (i = 0; i < npredictors; i++)
@@ -35,6 +101,24 @@ void refine(double **table, int order, int npredictors, double **data, int dataS
     counts = malloc(npredictors * sizeof(int));
     temp_s7 = malloc((order + 1) * sizeof(double));
 
+    assign.order = order;
+    assign.npredictors = npredictors;
+    assign.best = malloc((dataSize > 0 ? dataSize : 1) * sizeof(int));
+    assign.tableAc = malloc(npredictors * sizeof(double*));
+    for (i = 0; i < npredictors; i++)
+    {
+        assign.tableAc[i] = malloc((order + 1) * sizeof(double));
+    }
+
+    // The data rows don't change between iterations, so convert them once.
+    assign.data = data;
+    assign.dataR = malloc((dataSize > 0 ? dataSize : 1) * sizeof(double*));
+    for (i = 0; i < dataSize; i++)
+    {
+        assign.dataR[i] = malloc((order + 1) * sizeof(double));
+    }
+    parallel_for(dataSize, REFINE_GRAIN, nthreads, refine_rfroma, &assign);
+
     for (iter = 0; iter < refineIters; iter++)
     {
         for (i = 0; i < npredictors; i++)
@@ -46,26 +130,26 @@ void refine(double **table, int order, int npredictors, double **data, int dataS
             }
         }
 
-        for (i = 0; i < dataSize; i++)
+        for (i = 0; i < npredictors; i++)
         {
-            bestValue = 1e30;
-            bestIndex = 0;
-
-            for (j = 0; j < npredictors; j++)
+            for (j = 0; j <= order; j++)
             {
-                dist = model_dist(table[j], data[i], order);
-                if (dist < bestValue)
+                assign.tableAc[i][j] = 0.0;
+                for (k = 0; k <= order - j; k++)
                 {
-                    bestValue = dist;
-                    bestIndex = j;
+                    assign.tableAc[i][j] += table[i][k] * table[i][j + k];
                 }
             }
+        }
 
-            counts[bestIndex]++;
-            rfroma(data[i], order, temp_s7);
+        parallel_for(dataSize, REFINE_GRAIN, nthreads, refine_assign, &assign);
+
+        for (i = 0; i < dataSize; i++)
+        {
+            counts[assign.best[i]]++;
             for (j = 0; j <= order; j++)
             {
-                rsums[bestIndex][j] += temp_s7[j];
+                rsums[assign.best[i]][j] += assign.dataR[i][j];
             }
         }
 
@@ -98,7 +182,15 @@ void refine(double **table, int order, int npredictors, double **data, int dataS
     for (i = 0; i < npredictors; i++)
     {
         free(rsums[i]);
+        free(assign.tableAc[i]);
+    }
+    for (i = 0; i < dataSize; i++)
+    {
+        free(assign.dataR[i]);
     }
     free(rsums);
     free(temp_s7);
+    free(assign.best);
+    free(assign.tableAc);
+    free(assign.dataR);
 }
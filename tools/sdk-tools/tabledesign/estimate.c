@@ -2,6 +2,14 @@
 #include <stdlib.h>
 #include "tabledesign.h"
 
+#if !defined(__sgi) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define TABLEDESIGN_SSE2
+#elif !defined(__sgi) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TABLEDESIGN_NEON
+#endif
+
 /**
  * Computes the autocorrelation of a vector. More precisely, it computes the
  * dot products of vec[i:] and vec[:-i] for i in [0, k). Unused.
@@ -191,19 +199,84 @@ double model_dist(double *arg0, double *arg1, int n)
     return ret;
 }
 
+/**
+ * Dot product of two runs of 'm' samples. Every product fits in 31 bits and
+ * the sum is kept in 64, so the result is exact and matches summing the
+ * products one by one in doubles, as long as the sum stays below 2^53.
+ */
+static double dot_samples(const short *a, const short *b, int m)
+{
+    long long sum = 0;
+    int k = 0;
+
+#if defined(TABLEDESIGN_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    __m128i lo, hi, p, sign;
+
+    for (; k + 8 <= m; k += 8)
+    {
+        lo = _mm_loadu_si128((const __m128i *) (a + k));
+        hi = _mm_loadu_si128((const __m128i *) (b + k));
+        p = _mm_mullo_epi16(lo, hi);
+        hi = _mm_mulhi_epi16(lo, hi);
+        lo = _mm_unpacklo_epi16(p, hi);
+        hi = _mm_unpackhi_epi16(p, hi);
+
+        // Sign-extend the 32-bit products to 64 bits before adding them up
+        sign = _mm_srai_epi32(lo, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(lo, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(lo, sign));
+        sign = _mm_srai_epi32(hi, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(hi, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(hi, sign));
+    }
+    {
+        long long lanes[2];
+        _mm_storeu_si128((__m128i *) lanes, acc);
+        sum = lanes[0] + lanes[1];
+    }
+#elif defined(TABLEDESIGN_NEON)
+    int64x2_t acc = vdupq_n_s64(0);
+    int16x8_t va, vb;
+
+    for (; k + 8 <= m; k += 8)
+    {
+        va = vld1q_s16(a + k);
+        vb = vld1q_s16(b + k);
+        acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(va), vget_low_s16(vb)));
+        acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(va), vget_high_s16(vb)));
+    }
+    sum = vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1);
+#endif
+
+    for (; k < m; k++)
+    {
+        sum += a[k] * b[k];
+    }
+    return (double) sum;
+}
+
 // compute autocorrelation matrix?
 void acmat(short *in, int n, int m, double **out)
 {
-    int i, j, k;
-    for (i = 1; i <= n; i++)
+    int i, j;
+    double sum;
+
+    // The matrix is symmetric, and walking down a diagonal only slides the
+    // window by one sample, so each diagonal needs a single dot product and
+    // then one sample entering and one leaving per step. The sums are exact
+    // integers, so this gives the same values as summing every entry.
+    for (j = 1; j <= n; j++)
     {
-        for (j = 1; j <= n; j++)
+        sum = dot_samples(in - 1, in - j, m);
+        out[1][j] = sum;
+        out[j][1] = sum;
+        for (i = 2; i + j - 1 <= n; i++)
         {
-            out[i][j] = 0.0;
-            for (k = 0; k < m; k++)
-            {
-                out[i][j] += in[k - i] * in[k - j];
-            }
+            sum += in[-i] * in[-i - j + 1];
+            sum -= in[m - i] * in[m - i - j + 1];
+            out[i][i + j - 1] = sum;
+            out[i + j - 1][i] = sum;
         }
     }
 }
@@ -211,14 +284,10 @@ void acmat(short *in, int n, int m, double **out)
 // compute autocorrelation vector?
 void acvect(short *in, int n, int m, double *out)
 {
-    int i, j;
+    int i;
     for (i = 0; i <= n; i++)
     {
-        out[i] = 0.0;
-        for (j = 0; j < m; j++)
-        {
-            out[i] -= in[j - i] * in[j];
-        }
+        out[i] = 0.0 - dot_samples(in - i, in, m);
     }
 }
 
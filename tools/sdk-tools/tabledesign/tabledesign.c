@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <audiofile.h>
 #include "tabledesign.h"
 
@@ -25,6 +27,7 @@ typedef int SampleFormat;
 #define AFgetframecnt afGetFrameCount
 #define AFgetrate afGetRate
 #define AFreadframes afReadFrames
+#define AFclosefile afCloseFile
 
 #define MODE_READ "rb"
 
@@ -37,117 +40,64 @@ typedef int SampleFormat;
         exit(1); \
     }
 
-char filename[1024] = "";
-char usage[80] = "[-o order -s bits -t thresh -i refine_iter -f frame_size -p filename] aifcfile";
+char usage[] = "[-o order -s bits -t thresh -i refine_iter -f frame_size -j threads] (-p filename aifcfile | -b listfile)";
 
-#ifndef EXTRACT_CODEBOOK
-int main(int argc, char **argv)
-#else
-int tabledesign_entry(int argc, char **argv)
-#endif
+// Frames per work item when analyzing a file on several threads
+#define FRAME_GRAIN 256
+
+typedef struct
+{
+    int order;
+    int bits;
+    int refineIters;
+    int frameSize;
+    double thresh;
+    int nthreads;
+} DesignOptions;
+
+typedef struct
+{
+    const DesignOptions *opts;
+    short *samples; // frameSize zeroes, then every whole frame of the file
+    double **rows;  // predictor of each frame, or NULL if the frame was skipped
+} FrameAnalysis;
+
+typedef struct
+{
+    const char *programName;
+    const DesignOptions *opts;
+    char (*files)[2][1024];
+} DesignBatch;
+
+// The audiofile library isn't known to be thread-safe, so only one file is
+// read at a time.
+static pthread_mutex_t sAudioFileLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Read every whole frame of a mono 16-bit file, after 'frameSize' zeroes that
+ * stand in for the frame before the first. Returns the number of frames, or
+ * -1 on failure.
+ */
+static int read_frames(const char *programName, const char *path, int frameSize, short **samplesOut)
 {
-    const char *programName; // sp118
-    double thresh; // sp110
-    int order; // sp10C
-    int bits; // sp108
-    int refineIters; // sp104
-    int frameSize; // sp100
-    UNUSED int rate;
-    int frameCount;
-    int opt;
-    double *spF4;
-    double dummy; // spE8
-    double **mat; // spE4
-    double **data; // spD0
-    double *splitDelta; // spCC
-    int j; // spC0
-    int permDet;
-    int curBits; // spB8
-    int npredictors; // spB4
-    int *perm; // spB0
-    int numOverflows; // spAC
     SampleFormat sampleFormat; // sp90
     SampleFormat sampleWidth; // sp8C
     AFfilehandle afFile; // sp88
     int channels;
     int tracks;
-    double *vec; // s2
-    double **temp_s1;
-    short *temp_s3;
-    int i;
-    int dataSize; // s4
-    FILE *outfile;
-
-    order = 2;
-    bits = 2;
-    refineIters = 2;
-    frameSize = 16;
-    numOverflows = 0;
-    programName = argv[0];
-    thresh = 10.0;
-
-    if (argc < 2)
-    {
-        fprintf(stderr, "%s %s\n", argv[0], usage);
-        exit(1);
-    }
-
-    while ((opt = getopt(argc, argv, "o:s:t:i:f:p:")) != -1)
-    {
-        switch (opt)
-        {
-        case 'o':
-            if (sscanf(optarg, "%d", &order) != 1)
-                order = 2;
-            break;
-        case 's':
-            if (sscanf(optarg, "%d", &bits) != 1)
-                bits = 2;
-            break;
-        case 'f':
-            if (sscanf(optarg, "%d", &frameSize) != 1)
-                frameSize = 16;
-            break;
-        case 'i':
-            if (sscanf(optarg, "%d", &refineIters) != 1)
-                refineIters = 2;
-            break;
-        case 't':
-            if (sscanf(optarg, "%lf", &thresh) != 1)
-                thresh = 10.0;
-            break;
-        case 'p':
-            if (sscanf(optarg, "%s", filename) != 1) {
-                fprintf(stderr, "%s: No valid out file!\n", programName);
-                exit(1);
-            } else {
-                if ((outfile = fopen(filename, "w")) == NULL) {
-                    fprintf(stderr, "%s: Could not open %s for writing\n", programName, filename);
-                    exit(1);
-                }
-            }
-            break;
-        }
-    }
-
-    if (outfile == NULL) {
-        fprintf(stderr, "%s: No out file!\n", programName);
-        exit(1);
-    }
-
-    argv = &argv[optind - 1];
+    int frameCount;
+    int numRead;
+    short *samples;
 
-    afFile = AFopenfile(argv[1], MODE_READ, NULL);
+    pthread_mutex_lock(&sAudioFileLock);
+    afFile = AFopenfile(path, MODE_READ, NULL);
     if (afFile == NULL)
     {
         fprintf(stderr,
                 "%s: input AIFC file [%s] could not be opened.\n",
-                programName, argv[1]);
-
-        fclose(outfile);
-        outfile = NULL;
-
-        exit(1);
+                programName, path);
+        pthread_mutex_unlock(&sAudioFileLock);
+        return -1;
     }
 
     channels = AFgetchannels(afFile, AF_DEFAULT_TRACK);
@@ -155,12 +105,10 @@ int tabledesign_entry(int argc, char **argv)
     {
         fprintf(stderr,
                 "%s: file [%s] contains %d channels, only 1 channel supported.\n",
-                programName, argv[1], channels);
-
-        fclose(outfile);
-        outfile = NULL;
-
-        exit(1);
+                programName, path, channels);
+        AFclosefile(afFile);
+        pthread_mutex_unlock(&sAudioFileLock);
+        return -1;
     }
 
     tracks = AFgettrackids(afFile, NULL);
@@ -168,12 +116,10 @@ int tabledesign_entry(int argc, char **argv)
     {
         fprintf(stderr,
                 "%s: file [%s] contains %d tracks, only 1 track supported.\n",
-                programName, argv[1], tracks);
-
-        fclose(outfile);
-        outfile = NULL;
-
-        exit(1);
+                programName, path, tracks);
+        AFclosefile(afFile);
+        pthread_mutex_unlock(&sAudioFileLock);
+        return -1;
     }
 
     AFgetsampfmt(afFile, AF_DEFAULT_TRACK, &sampleFormat, &sampleWidth);
@@ -181,26 +127,45 @@ int tabledesign_entry(int argc, char **argv)
     {
         fprintf(stderr,
                 "%s: file [%s] contains %d bit samples, only 16 bit samples supported.\n",
-                programName, argv[1], (int)sampleWidth);
-
-        fclose(outfile);
-        outfile = NULL;
-
-        exit(1);
+                programName, path, (int)sampleWidth);
+        AFclosefile(afFile);
+        pthread_mutex_unlock(&sAudioFileLock);
+        return -1;
     }
 
-    mallocErr(temp_s1, (1 << bits) * sizeof(double*), "temp_s1");
-    for (i = 0; i < (1 << bits); i++)
+    frameCount = AFgetframecnt(afFile, AF_DEFAULT_TRACK);
+    if (frameCount < 0)
     {
-        mallocErr(temp_s1[i], (order + 1) * sizeof(double), "temp_si[i]");
+        frameCount = 0;
     }
+    mallocErr(samples, (frameCount + frameSize) * sizeof(short), "samples");
+    memset(samples, 0, frameSize * sizeof(short));
+    numRead = AFreadframes(afFile, AF_DEFAULT_TRACK, samples + frameSize, frameCount);
+    AFclosefile(afFile);
+    pthread_mutex_unlock(&sAudioFileLock);
+
+    *samplesOut = samples;
+    return (numRead > 0) ? numRead / frameSize : 0;
+}
 
-    mallocErr(splitDelta, (order + 1) * sizeof(double), "splitDelta");
-    mallocErr(temp_s3, frameSize * 2 * sizeof(short), "temp_s3");
-    for (i = 0; i < frameSize * 2; i++)
-    {
-        temp_s3[i] = 0;
-    }
+/**
+ * Fit a predictor to each of frames [start, end). Every frame only looks at
+ * itself and the frame before, so frames can be analyzed in any order.
+ */
+static void analyze_frames(void *arg, int start, int end)
+{
+    FrameAnalysis *analysis = arg;
+    const char *programName = "tabledesign";
+    int order = analysis->opts->order;
+    int frameSize = analysis->opts->frameSize;
+    double *spF4;
+    double **mat; // spE4
+    double *vec; // s2
+    short *frame;
+    int permDet;
+    int *perm; // spB0
+    int f;
+    int i;
 
     mallocErr(vec, (order + 1) * sizeof(double), "vec");
     mallocErr(spF4, (order + 1) * sizeof(double), "spF4");
@@ -209,27 +174,25 @@ int tabledesign_entry(int argc, char **argv)
     {
         mallocErr(mat[i], (order + 1) * sizeof(double), "mat[i]");
     }
-
     mallocErr(perm, (order + 1) * sizeof(int), "perm");
-    frameCount = AFgetframecnt(afFile, AF_DEFAULT_TRACK);
-    rate = AFgetrate(afFile, AF_DEFAULT_TRACK);
-    mallocErr(data, frameCount * sizeof(double*), "data");
-    dataSize = 0;
 
-    while (AFreadframes(afFile, AF_DEFAULT_TRACK, temp_s3 + frameSize, frameSize) == frameSize)
+    for (f = start; f < end; f++)
     {
-        acvect(temp_s3 + frameSize, order, frameSize, vec);
-        if (fabs(vec[0]) > thresh)
+        frame = analysis->samples + (f + 1) * frameSize;
+        analysis->rows[f] = NULL;
+
+        acvect(frame, order, frameSize, vec);
+        if (fabs(vec[0]) > analysis->opts->thresh)
         {
-            acmat(temp_s3 + frameSize, order, frameSize, mat);
+            acmat(frame, order, frameSize, mat);
             if (lud(mat, order, perm, &permDet) == 0)
             {
                 lubksb(mat, order, perm, vec);
                 vec[0] = 1.0;
                 if (kfroma(vec, spF4, order) == 0)
                 {
-                    mallocErr(data[dataSize], (order + 1) * sizeof(double), "data[dataSize]");
-                    data[dataSize][0] = 1.0;
+                    mallocErr(analysis->rows[f], (order + 1) * sizeof(double), "data[dataSize]");
+                    analysis->rows[f][0] = 1.0;
 
                     for (i = 1; i <= order; i++)
                     {
@@ -237,15 +200,77 @@ int tabledesign_entry(int argc, char **argv)
                         if (spF4[i] <= -1.0) spF4[i] = -0.9999999999;
                     }
 
-                    afromk(spF4, data[dataSize], order);
-                    dataSize++;
+                    afromk(spF4, analysis->rows[f], order);
                 }
             }
         }
+    }
+
+    for (i = 0; i <= order; i++)
+    {
+        free(mat[i]);
+    }
+    free(mat);
+    free(perm);
+    free(spF4);
+    free(vec);
+}
+
+/**
+ * Design a codebook for one file and write it to 'outPath'. Returns nonzero
+ * on failure.
+ */
+static int design_codebook(const char *programName, const DesignOptions *opts, const char *inPath, const char *outPath)
+{
+    int order = opts->order;
+    int bits = opts->bits;
+    double *spF4;
+    double dummy; // spE8
+    double **data; // spD0
+    double *splitDelta; // spCC
+    int j; // spC0
+    int curBits; // spB8
+    int npredictors; // spB4
+    int numOverflows; // spAC
+    int numFrames;
+    double *vec; // s2
+    double **temp_s1;
+    short *samples;
+    int i;
+    int dataSize; // s4
+    FrameAnalysis analysis;
+    FILE *outfile;
+
+    numFrames = read_frames(programName, inPath, opts->frameSize, &samples);
+    if (numFrames < 0)
+    {
+        return 1;
+    }
+
+    mallocErr(temp_s1, (1 << bits) * sizeof(double*), "temp_s1");
+    for (i = 0; i < (1 << bits); i++)
+    {
+        mallocErr(temp_s1[i], (order + 1) * sizeof(double), "temp_si[i]");
+    }
+
+    mallocErr(splitDelta, (order + 1) * sizeof(double), "splitDelta");
+    mallocErr(vec, (order + 1) * sizeof(double), "vec");
+    mallocErr(spF4, (order + 1) * sizeof(double), "spF4");
+    mallocErr(data, (numFrames + 1) * sizeof(double*), "data");
+
+    analysis.opts = opts;
+    analysis.samples = samples;
+    analysis.rows = data;
+    parallel_for(numFrames, FRAME_GRAIN, opts->nthreads, analyze_frames, &analysis);
+    free(samples);
 
-        for (i = 0; i < frameSize; i++)
+    // Keep the frames that gave a predictor, in file order
+    dataSize = 0;
+    for (i = 0; i < numFrames; i++)
+    {
+        if (data[i] != NULL)
         {
-            temp_s3[i] = temp_s3[i + frameSize];
+            data[dataSize++] = data[i];
         }
     }
 
@@ -288,24 +313,201 @@ int tabledesign_entry(int argc, char **argv)
         splitDelta[order - 1] = -1.0;
         split(temp_s1, splitDelta, order, 1 << curBits, 0.01);
         curBits++;
-        refine(temp_s1, order, 1 << curBits, data, dataSize, refineIters, 0.0);
+        refine(temp_s1, order, 1 << curBits, data, dataSize, opts->refineIters, 0.0, opts->nthreads);
     }
 
+    for (i = 0; i < dataSize; i++)
+    {
+        free(data[i]);
+    }
+    free(data);
+    free(splitDelta);
+    free(vec);
+    free(spF4);
+
     npredictors = 1 << curBits;
-    fprintf(outfile, "%d\n%d\n", order, npredictors);
+    if ((outfile = fopen(outPath, "w")) == NULL)
+    {
+        fprintf(stderr, "%s: Could not open %s for writing\n", programName, outPath);
+        numOverflows = -1;
+    }
+    else
+    {
+        fprintf(outfile, "%d\n%d\n", order, npredictors);
+
+        numOverflows = 0;
+        for (i = 0; i < npredictors; i++)
+        {
+            numOverflows += print_entry(outfile, temp_s1[i], order);
+        }
+
+        if (numOverflows > 0)
+        {
+            fprintf(stderr, "There was overflow - check the table\n");
+        }
 
-    for (i = 0; i < npredictors; i++)
+        fclose(outfile);
+        outfile = NULL;
+    }
+
+    for (i = 0; i < (1 << bits); i++)
     {
-        numOverflows += print_entry(outfile, temp_s1[i], order);
+        free(temp_s1[i]);
     }
+    free(temp_s1);
+    return numOverflows < 0;
+}
 
-    if (numOverflows > 0)
+static int design_batch_file(void *arg, int index)
+{
+    DesignBatch *batch = arg;
+
+    return design_codebook(batch->programName, batch->opts, batch->files[index][0], batch->files[index][1]) != 0;
+}
+
+/**
+ * Design codebooks for every (input, output) pair listed in 'listName', one
+ * file per thread. The build designs each codebook in its own make rule, so
+ * this is only for designing sample sets by hand.
+ */
+static int design_batch(const char *programName, const DesignOptions *opts, const char *listName)
+{
+    DesignOptions fileOpts = *opts;
+    DesignBatch batch;
+    char input[1024];
+    char output[1024];
+    int capacity = 0;
+    int count = 0;
+    int failed;
+    int num;
+    FILE *list;
+
+    if ((list = fopen(listName, "r")) == NULL)
+    {
+        fprintf(stderr, "%s: list file [%s] could not be opened.\n", programName, listName);
+        return 1;
+    }
+
+    batch.files = NULL;
+    while ((num = fscanf(list, "%1023s %1023s", input, output)) == 2)
     {
-        fprintf(stderr, "There was overflow - check the table\n");
+        if (count == capacity)
+        {
+            capacity = capacity * 2 + 16;
+            batch.files = realloc(batch.files, capacity * sizeof(*batch.files));
+        }
+        strcpy(batch.files[count][0], input);
+        strcpy(batch.files[count][1], output);
+        count++;
+    }
+    fclose(list);
+    if (num != EOF)
+    {
+        fprintf(stderr, "%s: list file [%s] should hold an input and an output per line.\n", programName, listName);
+        free(batch.files);
+        return 1;
     }
 
-    fclose(outfile);
-    outfile = NULL;
+    // The threads go to whole files; each file is designed on one.
+    fileOpts.nthreads = 1;
+    batch.programName = programName;
+    batch.opts = &fileOpts;
+    failed = parallel_jobs(count, opts->nthreads, design_batch_file, &batch);
+    free(batch.files);
 
+    if (failed > 0)
+    {
+        fprintf(stderr, "%s: %d of %d codebooks could not be designed.\n", programName, failed, count);
+        return 1;
+    }
+    return 0;
+}
+
+#ifndef EXTRACT_CODEBOOK
+int main(int argc, char **argv)
+#else
+int tabledesign_entry(int argc, char **argv)
+#endif
+{
+    const char *programName; // sp118
+    DesignOptions opts;
+    char filename[1024] = "";
+    const char *listName = NULL;
+    int opt;
+
+    opts.order = 2;
+    opts.bits = 2;
+    opts.refineIters = 2;
+    opts.frameSize = 16;
+    opts.thresh = 10.0;
+    opts.nthreads = parallel_thread_count();
+    programName = argv[0];
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "%s %s\n", argv[0], usage);
+        exit(1);
+    }
+
+    while ((opt = getopt(argc, argv, "o:s:t:i:f:p:j:b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            if (sscanf(optarg, "%d", &opts.order) != 1)
+                opts.order = 2;
+            break;
+        case 's':
+            if (sscanf(optarg, "%d", &opts.bits) != 1)
+                opts.bits = 2;
+            break;
+        case 'f':
+            if (sscanf(optarg, "%d", &opts.frameSize) != 1)
+                opts.frameSize = 16;
+            break;
+        case 'i':
+            if (sscanf(optarg, "%d", &opts.refineIters) != 1)
+                opts.refineIters = 2;
+            break;
+        case 't':
+            if (sscanf(optarg, "%lf", &opts.thresh) != 1)
+                opts.thresh = 10.0;
+            break;
+        case 'j':
+            if (sscanf(optarg, "%d", &opts.nthreads) != 1 || opts.nthreads < 1)
+                opts.nthreads = 1;
+            break;
+        case 'b':
+            listName = optarg;
+            break;
+        case 'p':
+            if (sscanf(optarg, "%s", filename) != 1) {
+                fprintf(stderr, "%s: No valid out file!\n", programName);
+                exit(1);
+            }
+            break;
+        }
+    }
+
+    if (listName != NULL)
+    {
+        return design_batch(programName, &opts, listName);
+    }
+
+    if (filename[0] == '\0') {
+        fprintf(stderr, "%s: No out file!\n", programName);
+        exit(1);
+    }
+
+    if (optind >= argc)
+    {
+        fprintf(stderr, "%s %s\n", argv[0], usage);
+        exit(1);
+    }
+
+    if (design_codebook(programName, &opts, argv[optind], filename) != 0)
+    {
+        exit(1);
+    }
     return 0;
 }
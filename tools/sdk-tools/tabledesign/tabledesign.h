@@ -22,11 +22,14 @@ void lubksb(double **a, int n, int *indx, double *b);
 
 // codebook.c
 void split(double **table, double *delta, int order, int npredictors, double scale);
-void refine(double **table, int order, int npredictors, double **data, int dataSize, int refineIters, double unused);
+void refine(double **table, int order, int npredictors, double **data, int dataSize, int refineIters, double unused, int nthreads);
 
 // print.c
 int print_entry(FILE *out, double *row, int order);
 
+// parallel_for() and parallel_thread_count(), from the thread pool shared by the tools
+#include "parallel.h"
+
 #ifdef EXTRACT_CODEBOOK
 int tabledesign_entry(int, char**);
 #endif